@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -35,12 +36,13 @@ namespace tensorflow {
 
 BFCAllocator::BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
                            bool allow_growth, const string& name,
-                           bool garbage_collection)
+                           bool garbage_collection, bool thread_caching)
     : garbage_collection_(garbage_collection),
       sub_allocator_(sub_allocator),
       name_(name),
       free_chunks_list_(kInvalidChunkHandle),
-      next_allocation_id_(1) {
+      next_allocation_id_(1),
+      thread_caching_(thread_caching) {
   if (allow_growth) {
     // 1MiB smallest initial allocation, unless total memory available
     // is less.
@@ -71,6 +73,25 @@ BFCAllocator::BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
       CHECK_NE(BinForSize(bin_size * 2), BinFromIndex(b));
     }
   }
+
+  if (thread_caching_) {
+    const int num_shards = std::max(1, port::MaxParallelism());
+    cache_shards_.reserve(num_shards);
+    for (int i = 0; i < num_shards; ++i) {
+      cache_shards_.emplace_back(new CacheShard);
+      CacheShard* shard = cache_shards_.back().get();
+      mutex_lock l(shard->mu);
+      for (int c = 0; c < kNumCacheClasses; ++c) {
+        // Spilling happens once a list exceeds its capacity, so this is the
+        // most a list ever holds and pushing a block never allocates.
+        shard->free_blocks[c].reserve(CacheClassCapacity(c) + 1);
+      }
+    }
+    slab_table_.reset(new std::atomic<uintptr_t>[kSlabTableSize]);
+    for (int i = 0; i < kSlabTableSize; ++i) {
+      slab_table_[i].store(0, std::memory_order_relaxed);
+    }
+  }
 }
 
 BFCAllocator::~BFCAllocator() {
@@ -80,6 +101,9 @@ BFCAllocator::~BFCAllocator() {
   for (const auto& region : region_manager_.regions()) {
     sub_allocator_->Free(region.ptr(), region.memory_size());
   }
+  for (void* slab : slabs_) {
+    sub_allocator_->Free(slab, kSlabBytes);
+  }
 
   for (BinNum b = 0; b < kNumBins; b++) {
     BinFromIndex(b)->~Bin();
@@ -225,6 +249,14 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(1) << "AllocateRaw " << Name() << "  " << num_bytes;
+  // Cached blocks are never subject to timestamped reuse, so requests that
+  // depend on freed_at_count always take the regular path.
+  if (thread_caching_ && num_bytes > 0 &&
+      num_bytes <= kMaxCachedAllocationSize &&
+      allocation_attr.freed_by_func == nullptr && timing_counter_ == nullptr) {
+    void* ptr = AllocateFromCache(num_bytes);
+    if (ptr != nullptr) return ptr;
+  }
   if (allocation_attr.no_retry_on_failure) {
     // Return immediately upon the first failure if this is for allocating an
     // optional scratch space.
@@ -548,10 +580,143 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 void BFCAllocator::DeallocateRaw(void* ptr) {
   VLOG(1) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
+  // A cached block can never satisfy a request that is waiting for memory in
+  // AllocateRawInternalWithRetry(), so there is no need to notify.
+  if (thread_caching_ && ptr != nullptr && DeallocateToCache(ptr)) return;
   DeallocateRawInternal(ptr);
   retry_helper_.NotifyDealloc();
 }
 
+BFCAllocator::CacheShard* BFCAllocator::CurrentCacheShard() {
+  int cpu = port::GetCurrentCPU();
+  if (cpu < 0) {
+    // The current CPU is unknown on this platform; spread threads over the
+    // shards instead.
+    static std::atomic<int> next_thread_shard{0};
+    static thread_local int thread_shard =
+        next_thread_shard.fetch_add(1, std::memory_order_relaxed);
+    cpu = thread_shard;
+  }
+  return cache_shards_[cpu % cache_shards_.size()].get();
+}
+
+void* BFCAllocator::AllocateFromCache(size_t num_bytes) {
+  const int cache_class = CacheClassForSize(num_bytes);
+  CacheShard* shard = CurrentCacheShard();
+  void* ptr;
+  {
+    mutex_lock l(shard->mu);
+    std::vector<void*>& blocks = shard->free_blocks[cache_class];
+    if (blocks.empty()) {
+      // Refill with half of the shard's capacity so that the next few
+      // allocations and deallocations on this CPU don't need lock_.
+      mutex_lock central_lock(lock_);
+      std::vector<void*>& central = central_free_blocks_[cache_class];
+      if (central.empty() && !AddSlab(cache_class)) return nullptr;
+      const size_t n =
+          std::min(central.size(), CacheClassCapacity(cache_class) / 2);
+      blocks.insert(blocks.end(), central.end() - n, central.end());
+      central.resize(central.size() - n);
+    }
+    ptr = blocks.back();
+    blocks.pop_back();
+  }
+
+  const int64 size = CacheClassSize(cache_class);
+  cache_num_allocs_.fetch_add(1, std::memory_order_relaxed);
+  const int64 in_use =
+      cache_bytes_in_use_.fetch_add(size, std::memory_order_relaxed) + size;
+  int64 peak = cache_peak_bytes_in_use_.load(std::memory_order_relaxed);
+  while (in_use > peak && !cache_peak_bytes_in_use_.compare_exchange_weak(
+                              peak, in_use, std::memory_order_relaxed)) {
+  }
+  int64 largest = cache_largest_alloc_size_.load(std::memory_order_relaxed);
+  while (static_cast<int64>(num_bytes) > largest &&
+         !cache_largest_alloc_size_.compare_exchange_weak(
+             largest, num_bytes, std::memory_order_relaxed)) {
+  }
+  return ptr;
+}
+
+bool BFCAllocator::DeallocateToCache(void* ptr) {
+  const int cache_class = CacheClassForPtr(ptr);
+  if (cache_class < 0) return false;
+  cache_bytes_in_use_.fetch_sub(CacheClassSize(cache_class),
+                                std::memory_order_relaxed);
+  CacheShard* shard = CurrentCacheShard();
+  mutex_lock l(shard->mu);
+  std::vector<void*>& blocks = shard->free_blocks[cache_class];
+  blocks.push_back(ptr);
+  if (blocks.size() > CacheClassCapacity(cache_class)) {
+    // Keep half, so that a thread that keeps freeing blocks allocated on
+    // another CPU only takes lock_ once per batch.
+    const size_t n = blocks.size() - blocks.size() / 2;
+    mutex_lock central_lock(lock_);
+    std::vector<void*>& central = central_free_blocks_[cache_class];
+    central.insert(central.end(), blocks.end() - n, blocks.end());
+    blocks.resize(blocks.size() - n);
+  }
+  return true;
+}
+
+namespace {
+
+// 'slab_number' is the slab's base address divided by the slab size.
+size_t SlabTableIndex(uintptr_t slab_number, int table_size) {
+  return static_cast<size_t>(slab_number * 0x9E3779B97F4A7C15ull) % table_size;
+}
+
+}  // namespace
+
+int BFCAllocator::CacheClassForPtr(const void* ptr) const {
+  if (!thread_caching_) return -1;
+  const uintptr_t mask = kSlabBytes - 1;
+  const uintptr_t base = reinterpret_cast<uintptr_t>(ptr) & ~mask;
+  // kSlabTableSize is twice the maximum number of slabs, so probing always
+  // reaches an empty entry.
+  for (size_t i = SlabTableIndex(base / kSlabBytes, kSlabTableSize);;
+       i = (i + 1) % kSlabTableSize) {
+    const uintptr_t entry = slab_table_[i].load(std::memory_order_acquire);
+    if (entry == 0) return -1;
+    if ((entry & ~mask) == base) {
+      return static_cast<int>(entry & mask) - 1;
+    }
+  }
+}
+
+bool BFCAllocator::AddSlab(int cache_class) {
+  if (slabs_.size() >= kMaxSlabs ||
+      total_region_allocated_bytes_ + kSlabBytes > memory_limit_) {
+    return false;
+  }
+  void* slab = sub_allocator_->Alloc(kSlabBytes, kSlabBytes);
+  if (slab == nullptr) return false;
+  const uintptr_t base = reinterpret_cast<uintptr_t>(slab);
+  if ((base & (kSlabBytes - 1)) != 0) {
+    LOG(WARNING) << "Sub-allocator of " << Name()
+                 << " returned a misaligned slab; not caching allocations.";
+    sub_allocator_->Free(slab, kSlabBytes);
+    return false;
+  }
+  total_region_allocated_bytes_ += kSlabBytes;
+  slabs_.push_back(slab);
+
+  size_t i = SlabTableIndex(base / kSlabBytes, kSlabTableSize);
+  while (slab_table_[i].load(std::memory_order_relaxed) != 0) {
+    i = (i + 1) % kSlabTableSize;
+  }
+  // Publish the slab before any of its blocks can be handed out.
+  slab_table_[i].store(base | (cache_class + 1), std::memory_order_release);
+
+  const size_t block_size = CacheClassSize(cache_class);
+  std::vector<void*>& central = central_free_blocks_[cache_class];
+  for (size_t offset = 0; offset + block_size <= kSlabBytes;
+       offset += block_size) {
+    central.push_back(static_cast<char*>(slab) + offset);
+  }
+  return true;
+}
+
 void BFCAllocator::DeallocateRawInternal(void* ptr) {
   if (ptr == nullptr) {
     VLOG(2) << "tried to deallocate nullptr";
@@ -792,6 +957,9 @@ bool BFCAllocator::TracksAllocationSizes() const { return true; }
 
 size_t BFCAllocator::RequestedSize(const void* ptr) const {
   CHECK(ptr);
+  // The requested size of cached blocks is not tracked.
+  const int cache_class = CacheClassForPtr(ptr);
+  if (cache_class >= 0) return CacheClassSize(cache_class);
   mutex_lock l(lock_);
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle)
@@ -801,6 +969,8 @@ size_t BFCAllocator::RequestedSize(const void* ptr) const {
 }
 
 size_t BFCAllocator::AllocatedSize(const void* ptr) const {
+  const int cache_class = CacheClassForPtr(ptr);
+  if (cache_class >= 0) return CacheClassSize(cache_class);
   mutex_lock l(lock_);
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle)
@@ -810,6 +980,7 @@ size_t BFCAllocator::AllocatedSize(const void* ptr) const {
 }
 
 int64 BFCAllocator::AllocationId(const void* ptr) const {
+  if (CacheClassForPtr(ptr) >= 0) return 0;
   mutex_lock l(lock_);
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle)
@@ -1074,8 +1245,23 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
 }
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
-  mutex_lock l(lock_);
-  return stats_;
+  AllocatorStats stats;
+  {
+    mutex_lock l(lock_);
+    stats = stats_;
+  }
+  if (thread_caching_) {
+    stats.num_allocs += cache_num_allocs_.load(std::memory_order_relaxed);
+    stats.bytes_in_use += cache_bytes_in_use_.load(std::memory_order_relaxed);
+    // The two peaks may have been reached at different times, so this is an
+    // upper bound of the actual peak.
+    stats.peak_bytes_in_use +=
+        cache_peak_bytes_in_use_.load(std::memory_order_relaxed);
+    stats.largest_alloc_size =
+        std::max(stats.largest_alloc_size,
+                 cache_largest_alloc_size_.load(std::memory_order_relaxed));
+  }
+  return stats;
 }
 
 void BFCAllocator::ClearStats() {
@@ -1083,6 +1269,11 @@ void BFCAllocator::ClearStats() {
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
+  cache_num_allocs_.store(0, std::memory_order_relaxed);
+  cache_peak_bytes_in_use_.store(
+      cache_bytes_in_use_.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  cache_largest_alloc_size_.store(0, std::memory_order_relaxed);
 }
 
 std::array<BFCAllocator::BinDebugInfo, BFCAllocator::kNumBins>
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_BFC_ALLOCATOR_H_
 
 #include <array>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <string>
@@ -46,12 +47,18 @@ class MemoryDump;
 // coalescing.  One assumption we make is that the process using this
 // allocator owns pretty much all of the memory, and that nearly
 // all requests to allocate memory go through this interface.
+//
+// If 'thread_caching' is true, small requests are served from per-CPU caches
+// of fixed-size blocks that only take the allocator-wide lock when they need
+// to be refilled or have grown too large. This trades some memory (idle
+// cached blocks are not coalesced) for much less lock contention when many
+// threads allocate small tensors concurrently, as is common on CPU.
 class BFCAllocator : public Allocator {
  public:
   // Takes ownership of sub_allocator.
   BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
                bool allow_growth, const string& name,
-               bool garbage_collection = false);
+               bool garbage_collection = false, bool thread_caching = false);
   ~BFCAllocator() override;
 
   string Name() override { return name_; }
@@ -98,6 +105,61 @@ class BFCAllocator : public Allocator {
 
   void DeallocateRawInternal(void* ptr);
 
+  // Small-allocation caching.
+  //
+  // Cached blocks are carved out of slabs of kSlabBytes bytes, each of which
+  // holds blocks of a single size class 256 << c. Slabs are aligned to their
+  // size, so the slab, and therefore the size class, of any pointer can be
+  // found without taking a lock by looking up its aligned base address in
+  // slab_table_. Free blocks live either in a per-CPU CacheShard or in the
+  // central lists guarded by lock_; shards move blocks to and from the
+  // central lists in batches.
+  static constexpr int kNumCacheClasses = 7;
+  static constexpr size_t kMaxCachedAllocationSize = size_t{256}
+                                                     << (kNumCacheClasses - 1);
+  static constexpr size_t kSlabBytes = size_t{1} << 20;
+  static constexpr int kMaxSlabs = 1024;
+  static constexpr int kSlabTableSize = 2 * kMaxSlabs;
+  // Bytes of free blocks a shard may hold per size class before spilling
+  // half of them to the central list.
+  static constexpr size_t kMaxCachedBytesPerClass = size_t{256} << 10;
+
+  struct CacheShard {
+    mutex mu;
+    std::vector<void*> free_blocks[kNumCacheClasses] GUARDED_BY(mu);
+  };
+
+  static size_t CacheClassSize(int cache_class) {
+    return size_t{256} << cache_class;
+  }
+  static size_t CacheClassCapacity(int cache_class) {
+    return kMaxCachedBytesPerClass / CacheClassSize(cache_class);
+  }
+  int CacheClassForSize(size_t num_bytes) {
+    if (num_bytes <= kMinAllocationSize) return 0;
+    return Log2FloorNonZero((num_bytes - 1) >> kMinAllocationBits) + 1;
+  }
+
+  // Returns the shard for the CPU the calling thread is running on.
+  CacheShard* CurrentCacheShard();
+
+  // Returns a cached block of at least 'num_bytes' bytes, or nullptr if no
+  // slab could be added, in which case the caller falls back to the regular
+  // allocation path.
+  void* AllocateFromCache(size_t num_bytes);
+
+  // Returns false if 'ptr' is not a cached block.
+  bool DeallocateToCache(void* ptr);
+
+  // Returns the size class of the slab containing 'ptr', or -1 if 'ptr' is not
+  // in a slab.
+  int CacheClassForPtr(const void* ptr) const;
+
+  // Allocates a new slab for 'cache_class' and adds its blocks to the central
+  // free list. Returns false if the memory limit has been reached or the
+  // sub-allocator fails.
+  bool AddSlab(int cache_class) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Chunks whose freed_at_count is later than the safe frontier value are kept
   // on a special list and not subject to merging immediately upon being freed.
   //
@@ -534,6 +596,20 @@ class BFCAllocator : public Allocator {
 
   // Stats.
   AllocatorStats stats_ GUARDED_BY(lock_);
+
+  // Small-allocation caching state; see AllocateFromCache().
+  const bool thread_caching_;
+  std::vector<std::unique_ptr<CacheShard>> cache_shards_;
+  // Entries are slab base addresses tagged with their size class plus one in
+  // the low bits, or 0 if empty. Entries are only ever added.
+  std::unique_ptr<std::atomic<uintptr_t>[]> slab_table_;
+  std::vector<void*> slabs_ GUARDED_BY(lock_);
+  std::vector<void*> central_free_blocks_[kNumCacheClasses] GUARDED_BY(lock_);
+  // Stats of cached blocks, which are not reflected in stats_.
+  std::atomic<int64> cache_num_allocs_{0};
+  std::atomic<int64> cache_bytes_in_use_{0};
+  std::atomic<int64> cache_peak_bytes_in_use_{0};
+  std::atomic<int64> cache_largest_alloc_size_{0};
 #ifdef TENSORFLOW_MEM_DEBUG
   int64 action_counter_ GUARDED_BY(lock_);
 #define MEM_DEBUG_SIZE_HISTORY_SIZE 4096
@@ -0,0 +1,191 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+BFCAllocator* NewCPUBFCAllocator(size_t total_memory, bool thread_caching) {
+  return new BFCAllocator(
+      new BasicCPUAllocator(port::kNUMANoAffinity, {}, {}), total_memory,
+      true /*allow_growth*/, "cpu_bfc", false /*garbage_collection*/,
+      thread_caching);
+}
+
+TEST(BFCAllocatorTest, ThreadCachedAllocationsDoNotOverlap) {
+  std::unique_ptr<BFCAllocator> a(NewCPUBFCAllocator(1 << 30, true));
+  random::PhiloxRandom philox(123, 17);
+  random::SimplePhilox rand(&philox);
+
+  // Mix small, cached sizes with larger ones served by the regular bins.
+  std::vector<std::pair<char*, size_t>> live;
+  for (int i = 0; i < 2000; ++i) {
+    const size_t size =
+        rand.OneIn(8) ? 65536 + rand.Uniform(65536) : 1 + rand.Uniform(16384);
+    char* ptr = static_cast<char*>(a->AllocateRaw(1, size));
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) %
+                     Allocator::kAllocatorAlignment);
+    EXPECT_GE(a->AllocatedSize(ptr), size);
+    memset(ptr, i & 0xff, size);
+    live.emplace_back(ptr, size);
+    if (rand.OneIn(3)) {
+      const int victim = rand.Uniform(live.size());
+      a->DeallocateRaw(live[victim].first);
+      live[victim] = live.back();
+      live.pop_back();
+    }
+  }
+  std::sort(live.begin(), live.end());
+  for (int i = 1; i < live.size(); ++i) {
+    EXPECT_LE(live[i - 1].first + live[i - 1].second, live[i].first);
+  }
+  for (const auto& p : live) {
+    a->DeallocateRaw(p.first);
+  }
+  EXPECT_EQ(0, a->GetStats()->bytes_in_use);
+}
+
+TEST(BFCAllocatorTest, ThreadCachedStats) {
+  std::unique_ptr<BFCAllocator> a(NewCPUBFCAllocator(1 << 30, true));
+  void* small = a->AllocateRaw(1, 1000);
+  void* large = a->AllocateRaw(1, 1 << 20);
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  EXPECT_EQ(2, stats->num_allocs);
+  // The small request is rounded up to its size class.
+  EXPECT_EQ(1024 + (1 << 20), stats->bytes_in_use);
+  EXPECT_EQ(1 << 20, stats->largest_alloc_size);
+  EXPECT_EQ(1024, a->AllocatedSize(small));
+
+  a->DeallocateRaw(small);
+  a->DeallocateRaw(large);
+  stats = a->GetStats();
+  EXPECT_EQ(0, stats->bytes_in_use);
+  EXPECT_EQ(1024 + (1 << 20), stats->peak_bytes_in_use);
+
+  a->ClearStats();
+  stats = a->GetStats();
+  EXPECT_EQ(0, stats->num_allocs);
+  EXPECT_EQ(0, stats->peak_bytes_in_use);
+  EXPECT_EQ(0, stats->largest_alloc_size);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheRespectsMemoryLimit) {
+  // Too small for a single slab, so every request takes the regular path.
+  std::unique_ptr<BFCAllocator> a(NewCPUBFCAllocator(1 << 19, true));
+  void* ptr = a->AllocateRaw(1, 256);
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(256, a->RequestedSize(ptr));
+  EXPECT_NE(0, a->AllocationId(ptr));
+  a->DeallocateRaw(ptr);
+}
+
+TEST(BFCAllocatorTest, ThreadCachedConcurrentAllocations) {
+  std::unique_ptr<BFCAllocator> a(NewCPUBFCAllocator(1 << 30, true));
+  const int kNumThreads = 8;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, t]() {
+        std::vector<char*> ptrs;
+        for (int i = 0; i < 10000; ++i) {
+          char* ptr = static_cast<char*>(a->AllocateRaw(1, 64 << (i % 8)));
+          ptr[0] = static_cast<char>(t);
+          ptrs.push_back(ptr);
+          if (ptrs.size() > 32) {
+            // Blocks are freed in a different order, and possibly on a
+            // different CPU, than they were allocated.
+            for (char* p : ptrs) {
+              EXPECT_EQ(static_cast<char>(t), p[0]);
+              a->DeallocateRaw(p);
+            }
+            ptrs.clear();
+          }
+        }
+        for (char* p : ptrs) a->DeallocateRaw(p);
+      });
+    }
+  }
+  EXPECT_EQ(0, a->GetStats()->bytes_in_use);
+}
+
+// Each thread repeatedly allocates and frees a small working set of small
+// buffers, which is the typical allocation pattern of CPU kernels.
+static void BM_AllocationThreaded(int iters, int num_threads,
+                                  bool thread_caching) {
+  testing::StopTiming();
+  std::unique_ptr<BFCAllocator> a(
+      NewCPUBFCAllocator(1uLL << 33, thread_caching));
+  thread::ThreadPool pool(Env::Default(), "test", num_threads);
+  std::atomic_int_fast32_t count(iters);
+  mutex done_lock;
+  condition_variable done;
+  bool done_flag = false;
+  testing::StartTiming();
+
+  for (int t = 0; t < num_threads; t++) {
+    pool.Schedule([&a, &count, &done_lock, &done, &done_flag, iters]() {
+      const std::vector<int> sizes = {256, 4096, 1024, 64, 16384, 512, 128};
+      void* ptrs[4] = {};
+      int size_index = 0;
+      for (int i = 0; i < iters; i++) {
+        void*& p = ptrs[i % 4];
+        if (p != nullptr) a->DeallocateRaw(p);
+        p = a->AllocateRaw(1, sizes[size_index++ % sizes.size()]);
+        const int64 remaining = count.fetch_sub(1);
+        if (remaining <= 1) {
+          if (remaining == 1) {
+            mutex_lock l(done_lock);
+            done_flag = true;
+            done.notify_all();
+          }
+          break;
+        }
+      }
+      for (void* p : ptrs) {
+        if (p != nullptr) a->DeallocateRaw(p);
+      }
+    });
+  }
+  mutex_lock l(done_lock);
+  if (!done_flag) {
+    done.wait(l);
+  }
+}
+
+static void BM_AllocationThreaded_Locked(int iters, int num_threads) {
+  BM_AllocationThreaded(iters, num_threads, false);
+}
+static void BM_AllocationThreaded_ThreadCached(int iters, int num_threads) {
+  BM_AllocationThreaded(iters, num_threads, true);
+}
+
+BENCHMARK(BM_AllocationThreaded_Locked)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(BM_AllocationThreaded_ThreadCached)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -555,8 +555,15 @@ Status DirectSession::RunInternal(
 
   // Start parallel Executors.
   const size_t num_executors = executors_and_keys->items.size();
+  // Static arena allocators used by this step. They are released once all
+  // executors are done, before `run_state.executors_done` is notified.
+  std::vector<StepArenaAllocator*> step_arenas;
   ExecutorBarrier* barrier = new ExecutorBarrier(
-      num_executors, run_state.rendez, [&run_state](const Status& ret) {
+      num_executors, run_state.rendez,
+      [&run_state, &step_arenas](const Status& ret) {
+        for (StepArenaAllocator* step_arena : step_arenas) {
+          step_arena->EndStep();
+        }
         {
           mutex_lock l(run_state.mu);
           run_state.status.Update(ret);
@@ -696,6 +703,12 @@ Status DirectSession::RunInternal(
     if (handler != nullptr) {
       args.user_intra_op_threadpool = handler->AsIntraThreadPoolInterface();
     }
+    StepArenaAllocator* step_arena = nullptr;
+    if (item.step_arena_pool != nullptr) {
+      step_arena = item.step_arena_pool->Get();
+      step_arenas.push_back(step_arena);
+    }
+    args.step_allocator = step_arena;
 
     item.executor->RunAsync(args, barrier->Get());
   }
@@ -1362,6 +1375,11 @@ Status DirectSession::CreateExecutors(
 
     item->executor = nullptr;
     item->device = device;
+    if (options_.config.experimental().use_static_step_arena() &&
+        device->device_type() == DEVICE_CPU) {
+      item->step_arena_pool = std::make_shared<StepArenaPool>(
+          device->GetAllocator(AllocatorAttributes()));
+    }
     auto executor_type = options_.config.experimental().executor_type();
     TF_RETURN_IF_ERROR(
         NewExecutor(executor_type, params, *partition_graph, &item->executor));
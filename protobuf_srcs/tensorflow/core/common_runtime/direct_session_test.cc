@@ -226,6 +226,32 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_OptimizeForStaticGraph) {
       absl::StrContains(s.error_message(), "optimize_for_static_graph"));
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_StaticStepArena) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options(DefaultSessionOptions());
+  options.config.mutable_experimental()->set_use_static_step_arena(true);
+  auto session = absl::WrapUnique(NewSession(options));
+
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+  std::vector<std::pair<string, Tensor>> inputs;
+  std::vector<string> output_names = {y_ + ":0", z_ + ":0"};
+
+  // The first run records the allocations, later runs replay them from the
+  // arena. Outputs of earlier runs must stay valid across later runs.
+  std::vector<std::vector<Tensor>> all_outputs(4);
+  for (std::vector<Tensor>& outputs : all_outputs) {
+    TF_ASSERT_OK(session->Run(inputs, output_names, {}, &outputs));
+  }
+  for (const std::vector<Tensor>& outputs : all_outputs) {
+    ASSERT_EQ(2, outputs.size());
+    EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+    EXPECT_FLOAT_EQ(-1.0, outputs[0].matrix<float>()(1, 0));
+    EXPECT_FLOAT_EQ(-5.0, outputs[1].matrix<float>()(0, 0));
+    EXPECT_FLOAT_EQ(1.0, outputs[1].matrix<float>()(1, 0));
+  }
+}
+
 TEST_F(DirectSessionMinusAXTest,
        RunSimpleNetwork_DisableOutputPartitionGraphs) {
   Initialize({3, 2, -1, 0});
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/executor.h"
 
+#include <algorithm>
 #include <atomic>
 #include <deque>
 #include <memory>
@@ -42,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_reference.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -67,6 +69,7 @@ limitations under the License.
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/profiler/internal/traceme_recorder.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
 
 namespace tensorflow {
@@ -79,6 +82,42 @@ bool IsInitializationOp(const Node* node) {
   return node->op_def().allows_uninitialized_input();
 }
 
+// Graphs with at most this many nodes, no control flow and no asynchronous
+// kernels are executed entirely on the thread that calls RunAsync(), without
+// dispatching any closures to the inter-op runner, in the steps where none of
+// their kernels is expensive. For such small graphs the cost of scheduling a
+// closure is typically higher than the cost of running the kernel itself,
+// while expensive kernels are still run in parallel. Setting
+// TF_EXECUTOR_INLINE_MAX_NODES to 0 disables this.
+int64 InlineExecutionMaxNodes() {
+  static const int64 max_nodes = []() {
+    int64 value;
+    Status s = ReadInt64FromEnvVar("TF_EXECUTOR_INLINE_MAX_NODES",
+                                   /*default_val=*/16, &value);
+    if (!s.ok()) {
+      LOG(ERROR) << s.error_message();
+      value = 0;
+    }
+    return value;
+  }();
+  return max_nodes;
+}
+
+// If positive, executors of graphs without control flow time every kernel
+// during their first TF_EXECUTOR_COST_MODEL_STEPS steps. Later steps use the
+// measured costs to run cheap nodes inline and to dispatch the nodes on the
+// longest remaining path first. Read whenever an executor is created.
+int64 CostModelSteps() {
+  int64 value;
+  Status s = ReadInt64FromEnvVar("TF_EXECUTOR_COST_MODEL_STEPS",
+                                 /*default_val=*/0, &value);
+  if (!s.ok()) {
+    LOG(ERROR) << s.error_message();
+    value = 0;
+  }
+  return value;
+}
+
 // Helper routines for collecting step stats.
 namespace nodestats {
 inline int64 NowInNsec() { return Env::Default()->NowNanos(); }
@@ -310,6 +349,106 @@ class GraphView {
   TF_DISALLOW_COPY_AND_ASSIGN(GraphView);
 };
 
+// Per-node execution costs learned from the first steps of an executor, used
+// to prioritize nodes on the critical path and to run cheap nodes inline.
+class NodeCostModel {
+ public:
+  enum class CostClass { kUnknown, kCheap, kExpensive };
+
+  // The schedule derived from the measured costs. Immutable once built.
+  struct Schedule {
+    // Indexed by node id.
+    std::vector<CostClass> cost_class;
+    // The measured cost of the most expensive path from a node to any sink,
+    // including the node itself, in CPU cycles. Indexed by node id.
+    std::vector<int64> critical_path;
+  };
+
+  // 'topo_order' holds the ids of all nodes of 'gview' in topological order.
+  NodeCostModel(const GraphView* gview, std::vector<int> topo_order,
+                int64 num_learning_steps)
+      : gview_(gview),
+        topo_order_(std::move(topo_order)),
+        num_learning_steps_(num_learning_steps),
+        total_cycles_(new std::atomic<int64>[gview->num_nodes()]),
+        num_samples_(new std::atomic<int64>[gview->num_nodes()]) {
+    for (int32 i = 0; i < gview_->num_nodes(); ++i) {
+      total_cycles_[i] = 0;
+      num_samples_[i] = 0;
+    }
+  }
+
+  // Returns true if the calling step should record the cost of its kernels,
+  // in which case it must call EndLearningStep() when it is done.
+  bool StartStep() {
+    return steps_started_.fetch_add(1, std::memory_order_relaxed) <
+           num_learning_steps_;
+  }
+
+  void Record(int node_id, uint64 cycles) {
+    total_cycles_[node_id].fetch_add(cycles, std::memory_order_relaxed);
+    num_samples_[node_id].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Builds the schedule once the last learning step is done.
+  void EndLearningStep() {
+    if (steps_ended_.fetch_add(1) + 1 == num_learning_steps_) {
+      std::shared_ptr<const Schedule> schedule = BuildSchedule();
+      mutex_lock l(mu_);
+      schedule_ = std::move(schedule);
+    }
+  }
+
+  // Returns nullptr until the learning steps are done.
+  std::shared_ptr<const Schedule> schedule() {
+    mutex_lock l(mu_);
+    return schedule_;
+  }
+
+ private:
+  std::shared_ptr<const Schedule> BuildSchedule() const {
+    const int32 num_nodes = gview_->num_nodes();
+    auto schedule = std::make_shared<Schedule>();
+    schedule->cost_class.resize(num_nodes, CostClass::kUnknown);
+    schedule->critical_path.resize(num_nodes, 0);
+    for (auto it = topo_order_.rbegin(); it != topo_order_.rend(); ++it) {
+      const int id = *it;
+      const NodeItem* item = gview_->node(id);
+      if (item == nullptr) continue;
+      int64 cost = 0;
+      const int64 num_samples = num_samples_[id];
+      if (num_samples > 0) {
+        cost = total_cycles_[id] / num_samples;
+        schedule->cost_class[id] =
+            cost <= static_cast<int64>(OpKernel::kOpIsExpensiveThresholdCycles)
+                ? CostClass::kCheap
+                : CostClass::kExpensive;
+      }
+      int64 max_successor_path = 0;
+      for (size_t e = 0; e < item->num_output_edges; ++e) {
+        max_successor_path =
+            std::max(max_successor_path,
+                     schedule->critical_path[item->output_edge(e).dst_id]);
+      }
+      schedule->critical_path[id] = cost + max_successor_path;
+    }
+    return schedule;
+  }
+
+  const GraphView* const gview_;
+  const std::vector<int> topo_order_;
+  const int64 num_learning_steps_;
+  std::unique_ptr<std::atomic<int64>[]> total_cycles_;
+  std::unique_ptr<std::atomic<int64>[]> num_samples_;
+  std::atomic<int64> steps_started_{0};
+  std::atomic<int64> steps_ended_{0};
+
+  mutex mu_;
+  std::shared_ptr<const Schedule> schedule_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(NodeCostModel);
+};
+
 class ExecutorImpl : public Executor {
  public:
   explicit ExecutorImpl(const LocalExecutorParams& p) : params_(p), gview_() {
@@ -395,6 +534,29 @@ class ExecutorImpl : public Executor {
   // A cached value of params_
   bool device_record_tensor_accesses_ = false;
 
+  // Returns true if this step can run all nodes on the caller thread in
+  // topological order, i.e. if the graph is small enough and none of its
+  // kernels is currently expensive. See InlineExecutionMaxNodes().
+  bool RunInline() const {
+    if (!may_run_inline_) return false;
+    for (int32 id = 0; id < gview_.num_nodes(); ++id) {
+      const NodeItem* item = gview_.node(id);
+      if (item != nullptr && item->kernel != nullptr &&
+          item->kernel->IsExpensive()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // If true, steps whose kernels are all inexpensive run inline. See
+  // RunInline().
+  bool may_run_inline_ = false;
+
+  // Learns per-node costs to guide scheduling. Null if disabled, see
+  // CostModelSteps().
+  std::unique_ptr<NodeCostModel> cost_model_;
+
   // Root nodes (with no in edges) that should form the initial ready queue
   std::vector<const NodeItem*> root_nodes_;
 
@@ -704,6 +866,36 @@ Status ExecutorImpl::Initialize(const Graph& graph) {
   // all nodes.
   InitializePending(&graph, cf_info);
 
+  // Decide whether this graph is small enough to be executed inline. Async
+  // kernels may complete on another thread and graphs with control flow may
+  // need to run an unbounded number of iterations, so both are excluded.
+  if (graph.num_nodes() <= InlineExecutionMaxNodes() &&
+      frame_info_.size() == 1) {
+    may_run_inline_ = true;
+    for (const Node* n : graph.nodes()) {
+      if (gview_.node(n->id())->kernel_is_async) {
+        may_run_inline_ = false;
+        break;
+      }
+    }
+  }
+  VLOG_IF(1, may_run_inline_)
+      << "Executing graph with " << graph.num_nodes()
+      << " nodes inline on the caller thread once its kernels are cheap.";
+
+  const int64 cost_model_steps = CostModelSteps();
+  if (cost_model_steps > 0 && !may_run_inline_ && frame_info_.size() == 1) {
+    std::vector<Node*> order;
+    GetReversePostOrder(graph, &order);
+    std::vector<int> topo_order;
+    topo_order.reserve(order.size());
+    for (const Node* n : order) {
+      topo_order.push_back(n->id());
+    }
+    cost_model_ = absl::make_unique<NodeCostModel>(
+        &gview_, std::move(topo_order), cost_model_steps);
+  }
+
   return gview_.SetAllocAttrs(&graph, params_.device);
 }
 
@@ -1308,9 +1500,18 @@ class ExecutorState {
   CancellationManager* cancellation_manager_;
   // If not null, use this device to schedule intra-op operation
   std::unique_ptr<DeviceBase> user_device_;
+  Allocator* step_allocator_;
   Executor::Args::Runner runner_;
   bool sync_on_finish_;
 
+  // True if this step records the cost of its kernels in impl_->cost_model_.
+  bool learn_costs_ = false;
+  // True if this step runs all nodes on the caller thread, see
+  // ExecutorImpl::RunInline().
+  bool run_inline_ = false;
+  // The learned schedule, if available when this step started.
+  std::shared_ptr<const NodeCostModel::Schedule> schedule_;
+
   // Owned.
 
   // A flag that is set on error after the frame state has been
@@ -1362,6 +1563,11 @@ class ExecutorState {
   // Process a ready node in current thread.
   void Process(TaggedNode node, int64 scheduled_nsec);
 
+  // Process all nodes in 'inline_ready', and any nodes that become ready as a
+  // result, on the current thread. Expensive nodes may still be dispatched to
+  // other threads unless the executor runs in inline mode.
+  void ProcessInline(TaggedNodeReadyQueue* inline_ready, int64 scheduled_nsec);
+
   // Before invoking item->kernel, fills in its "inputs".
   Status PrepareInputs(const NodeItem& item, Entry* first_input,
                        TensorValueVec* inputs,
@@ -1389,6 +1595,13 @@ class ExecutorState {
   void ScheduleReady(const TaggedNodeSeq& ready,
                      TaggedNodeReadyQueue* inline_ready);
 
+  // Like ScheduleReady(), but uses the learned costs in schedule_ instead of
+  // the kernels' own estimates to decide which nodes to run inline, and
+  // dispatches nodes on longer critical paths first.
+  void ScheduleReadyByCost(const TaggedNodeSeq& ready,
+                           TaggedNodeReadyQueue* inline_ready,
+                           int64 scheduled_nsec);
+
   // For debugging/logging only.
   inline void MaybeMarkCompleted(FrameState* frame, int64 iter,
                                  const NodeItem& item);
@@ -1440,6 +1653,7 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
       call_frame_(args.call_frame),
       impl_(impl),
       cancellation_manager_(args.cancellation_manager),
+      step_allocator_(args.step_allocator),
       runner_(args.runner),
       sync_on_finish_(args.sync_on_finish),
       num_outstanding_ops_(0) {
@@ -1462,6 +1676,13 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
                             root_frame_->total_input_tensors));
 
   outstanding_frames_.insert({root_frame_->frame_name, root_frame_});
+
+  if (impl_->cost_model_) {
+    learn_costs_ = impl_->cost_model_->StartStep();
+    if (!learn_costs_) {
+      schedule_ = impl_->cost_model_->schedule();
+    }
+  }
 }
 
 ExecutorState::~ExecutorState() {
@@ -1472,6 +1693,9 @@ ExecutorState::~ExecutorState() {
     device_context_->Unref();
   }
   delete slice_reader_cache_;
+  if (learn_costs_) {
+    impl_->cost_model_->EndLearningStep();
+  }
 }
 
 Status ExecutorImpl::BuildControlFlowInfo(const Graph* g,
@@ -1584,8 +1808,21 @@ void ExecutorState::RunAsync(Executor::DoneCallback done) {
       root_frame_->GetIteration(0)->outstanding_ops = ready.size();
     }
     done_cb_ = std::move(done);
-    // Schedule to run all the ready ops in thread pool.
-    ScheduleReady(ready, nullptr);
+    run_inline_ = impl_->RunInline();
+    if (run_inline_) {
+      // Run the whole graph on the caller thread. `this` may be deleted by
+      // the time ProcessInline() returns.
+      const int64 scheduled_nsec =
+          stats_collector_ ? nodestats::NowInNsec() : 0;
+      TaggedNodeReadyQueue inline_ready;
+      for (const TaggedNode& tagged_node : ready) {
+        inline_ready.push_back(tagged_node);
+      }
+      ProcessInline(&inline_ready, scheduled_nsec);
+    } else {
+      // Schedule to run all the ready ops in thread pool.
+      ScheduleReady(ready, nullptr);
+    }
   }
 }
 
@@ -1653,6 +1890,13 @@ bool MightTrace(const NodeItem& item,
 }
 
 void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
+  TaggedNodeReadyQueue inline_ready;
+  inline_ready.push_back(tagged_node);
+  ProcessInline(&inline_ready, scheduled_nsec);
+}
+
+void ExecutorState::ProcessInline(TaggedNodeReadyQueue* inline_ready,
+                                  int64 scheduled_nsec) {
   profiler::TraceMe activity(
       [&] {
         int64 id = step_id_;
@@ -1664,7 +1908,6 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
       2);
   WithContext wc(context_);
   TaggedNodeSeq ready;
-  TaggedNodeReadyQueue inline_ready;
 
   // Parameters passed to OpKernel::Compute.
   TensorValueVec inputs;
@@ -1697,6 +1940,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
   params.inputs = &inputs;
   params.input_alloc_attrs = &input_alloc_attrs;
   params.runner = &runner_;
+  params.step_allocator = step_allocator_;
   params.stats_collector = stats_collector_;
   params.inc_num_deferred_ops_function = [this]() {
     mutex_lock lock(num_deferred_ops_mu_);
@@ -1725,10 +1969,9 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
 
   EntryVector outputs;
   bool completed = false;
-  inline_ready.push_back(tagged_node);
-  while (!inline_ready.empty()) {
-    tagged_node = inline_ready.front();
-    inline_ready.pop_front();
+  while (!inline_ready->empty()) {
+    const TaggedNode tagged_node = inline_ready->front();
+    inline_ready->pop_front();
     const NodeItem& item = *tagged_node.node_item;
     FrameState* input_frame = tagged_node.input_frame;
     const int64 input_iter = tagged_node.input_iter;
@@ -1784,7 +2027,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
         }
         MaybeMarkCompleted(input_frame, input_iter, item);
         // Continue to process the nodes in 'inline_ready'.
-        completed = NodeDone(s, ready, stats, &inline_ready);
+        completed = NodeDone(s, ready, stats, inline_ready);
         continue;
       }
 
@@ -1887,7 +2130,14 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
           device->Compute(op_kernel, &ctx);
         } else {
           // In the common case, avoid creating any tracing objects.
-          if (op_kernel->IsExpensive()) {
+          if (TF_PREDICT_FALSE(learn_costs_)) {
+            const bool is_expensive = op_kernel->IsExpensive();
+            KernelTimer timer;
+            device->Compute(op_kernel, &ctx);
+            const uint64 cycles = timer.ElapsedCycles();
+            impl_->cost_model_->Record(id, cycles);
+            if (is_expensive) op_kernel->UpdateCostEstimate(cycles);
+          } else if (op_kernel->IsExpensive()) {
             KernelTimer timer;
             device->Compute(op_kernel, &ctx);
             op_kernel->UpdateCostEstimate(timer.ElapsedCycles());
@@ -1935,9 +2185,9 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
         scheduled_nsec = nodestats::NowInNsec();
       }
       // Postprocess.
-      completed = NodeDone(s, ready, stats, &inline_ready);
+      completed = NodeDone(s, ready, stats, inline_ready);
     }
-  }  // while !inline_ready.empty()
+  }  // while !inline_ready->empty()
 
   // This thread of computation is done if completed = true.
   if (completed) ScheduleFinish();
@@ -2311,6 +2561,11 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
     scheduled_nsec = nodestats::NowInNsec();
   }
 
+  if (schedule_) {
+    ScheduleReadyByCost(ready, inline_ready, scheduled_nsec);
+    return;
+  }
+
   if (inline_ready == nullptr) {
     // Schedule to run all the ready ops in thread pool.
     for (auto& tagged_node : ready) {
@@ -2319,6 +2574,15 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
     return;
   }
 
+  if (run_inline_) {
+    // Never leave the caller thread: append everything to the inline queue,
+    // which yields a topological execution order.
+    for (auto& tagged_node : ready) {
+      inline_ready->push_back(tagged_node);
+    }
+    return;
+  }
+
   const TaggedNode* curr_expensive_node = nullptr;
   for (auto& tagged_node : ready) {
     const NodeItem& item = *tagged_node.node_item;
@@ -2347,6 +2611,49 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
   }
 }
 
+void ExecutorState::ScheduleReadyByCost(const TaggedNodeSeq& ready,
+                                        TaggedNodeReadyQueue* inline_ready,
+                                        int64 scheduled_nsec) {
+  const NodeCostModel::Schedule& schedule = *schedule_;
+  // Nodes that were measured to be cheap run inline regardless of the
+  // kernel's own estimate. The remaining nodes are dispatched in decreasing
+  // order of their critical path, so the longest chains start first.
+  gtl::InlinedVector<const TaggedNode*, 8> expensive;
+  for (auto& tagged_node : ready) {
+    const NodeItem& item = *tagged_node.node_item;
+    NodeCostModel::CostClass cost_class = schedule.cost_class[item.node_id];
+    if (cost_class == NodeCostModel::CostClass::kUnknown) {
+      cost_class = item.kernel->IsExpensive()
+                       ? NodeCostModel::CostClass::kExpensive
+                       : NodeCostModel::CostClass::kCheap;
+    }
+    if (inline_ready != nullptr &&
+        (tagged_node.is_dead ||
+         cost_class == NodeCostModel::CostClass::kCheap)) {
+      inline_ready->push_back(tagged_node);
+    } else {
+      expensive.push_back(&tagged_node);
+    }
+  }
+  std::stable_sort(expensive.begin(), expensive.end(),
+                   [&schedule](const TaggedNode* a, const TaggedNode* b) {
+                     return schedule.critical_path[a->node_item->node_id] >
+                            schedule.critical_path[b->node_item->node_id];
+                   });
+  auto it = expensive.begin();
+  if (inline_ready != nullptr && inline_ready->empty() &&
+      it != expensive.end()) {
+    // Keep the most critical node on this thread, which is already running.
+    // It starts after the dispatched nodes are enqueued, but without the
+    // latency of waking up another thread.
+    inline_ready->push_back(**it);
+    ++it;
+  }
+  for (; it != expensive.end(); ++it) {
+    runner_(std::bind(&ExecutorState::Process, this, **it, scheduled_nsec));
+  }
+}
+
 inline void ExecutorState::MaybeMarkCompleted(FrameState* frame, int64 iter,
                                               const NodeItem& item) {
   // TODO(misard) Replace with a finer-grain enabling flag once we
@@ -100,6 +100,10 @@ class Executor {
     CollectiveExecutor* collective_executor = nullptr;
     thread::ThreadPoolInterface* user_intra_op_threadpool = nullptr;
 
+    // If not null, kernels allocate tensors with default allocator
+    // attributes from this allocator instead of the device's allocator.
+    Allocator* step_allocator = nullptr;
+
     // If true, calls Sync() on the device.
     bool sync_on_finish = false;
 
@@ -16,6 +16,9 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
@@ -170,6 +173,45 @@ TEST_F(ExecutorTest, SimpleAdd) {
   EXPECT_EQ(2.0, V(out));  // out = 1.0 + 1.0 = 2.0
 }
 
+TEST_F(ExecutorTest, SmallGraphRunsInline) {
+  // c = (a + b) + (a + b), where a and b are constants. The graph has no
+  // asynchronous kernels, so once the cost estimates of its kernels show they
+  // are cheap, every node runs on the calling thread and the runner is only
+  // used to deliver the done callback.
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto a = test::graph::Constant(g.get(), V(1.0));
+  auto b = test::graph::Constant(g.get(), V(2.0));
+  auto sum0 = test::graph::Add(g.get(), a, b);
+  auto sum1 = test::graph::Add(g.get(), a, b);
+  auto tmp = test::graph::Add(g.get(), sum0, sum1);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  Create(std::move(g));
+  std::atomic<int> num_closures(0);
+  runner_ = [&num_closures](std::function<void()> fn) {
+    ++num_closures;
+    fn();
+  };
+  Rendezvous::Args args;
+  Tensor out = V(-1);
+  bool is_dead = false;
+
+  // Kernels start out expensive, so the first step runs them in parallel.
+  TF_ASSERT_OK(Run(rendez_));
+  EXPECT_LT(1, num_closures.load());
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_EQ(6.0, V(out));
+
+  for (int step = 0; step < 1000 && num_closures.load() != 1; ++step) {
+    num_closures = 0;
+    TF_ASSERT_OK(Run(rendez_));
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(6.0, V(out));
+  }
+  EXPECT_EQ(1, num_closures.load());
+}
+
 TEST_F(ExecutorTest, SelfAdd) {
   // v0 <- a
   // v1 = v0 + v0
@@ -250,6 +292,27 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, CostModelSchedule) {
+  // The first two steps measure the kernels, the remaining ones are
+  // scheduled based on the measured costs.
+  setenv("TF_EXECUTOR_COST_MODEL_STEPS", "2", 1);
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(256, g.get());
+  Create(std::move(g));
+  unsetenv("TF_EXECUTOR_COST_MODEL_STEPS");
+  for (int step = 0; step < 5; ++step) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(256.0, V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -470,6 +533,12 @@ BENCHMARK(BM_executor)->ArgPair(8192, 32);
 // Tall fat graph
 BENCHMARK(BM_executor)->ArgPair(1024, 1024);
 
+// Small serving-sized graphs. Those with at most TF_EXECUTOR_INLINE_MAX_NODES
+// nodes are executed inline on the caller thread.
+BENCHMARK(BM_executor)->ArgPair(2, 2);
+BENCHMARK(BM_executor)->ArgPair(4, 4);
+BENCHMARK(BM_executor)->ArgPair(8, 8);
+
 static void BM_FeedInputFetchOutput(int iters) {
   Graph* g = new Graph(OpRegistry::Global());
   // z = x + y: x and y are provided as benchmark inputs.  z is the
@@ -494,4 +563,96 @@ static void BM_FeedInputFetchOutput(int iters) {
 }
 BENCHMARK(BM_FeedInputFetchOutput);
 
+Node* RandomMatrix(Graph* g, int rows, int cols) {
+  Tensor t(DT_FLOAT, TensorShape({rows, cols}));
+  t.flat<float>().setRandom();
+  return test::graph::Constant(g, t);
+}
+
+// An Inception-like graph: 'num_modules' modules of four parallel branches
+// of very different cost, whose outputs are summed.
+Graph* InceptionLikeGraph(int num_modules) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* w = RandomMatrix(g, 256, 256);
+  Node* x = RandomMatrix(g, 32, 256);
+  for (int m = 0; m < num_modules; ++m) {
+    std::vector<Node*> branches;
+    for (int depth = 1; depth <= 3; ++depth) {
+      Node* b = x;
+      for (int i = 0; i < depth; ++i) {
+        b = test::graph::Unary(g, "Tanh",
+                               test::graph::Matmul(g, b, w, false, false));
+      }
+      branches.push_back(b);
+    }
+    Node* b = x;
+    for (int i = 0; i < 4; ++i) {
+      b = test::graph::Unary(g, i % 2 == 0 ? "Square" : "Tanh", b);
+    }
+    branches.push_back(b);
+    x = test::graph::Unary(g, "Tanh", test::graph::Multi(g, "AddN", branches));
+  }
+  return g;
+}
+
+// A BERT-like graph: 'num_layers' transformer layers, each consisting of
+// self-attention and a feed-forward block. Every layer has a few large
+// matrix multiplications and a chain of cheap element-wise ops.
+Graph* BertLikeGraph(int num_layers) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* w = RandomMatrix(g, 256, 256);
+  Node* x = RandomMatrix(g, 128, 256);
+  for (int l = 0; l < num_layers; ++l) {
+    Node* q = test::graph::Matmul(g, x, w, false, false);
+    Node* k = test::graph::Matmul(g, x, w, false, false);
+    Node* v = test::graph::Matmul(g, x, w, false, false);
+    Node* scores = test::graph::Matmul(g, q, k, false, true);
+    Node* probs = test::graph::Unary(g, "Tanh", scores);
+    Node* context = test::graph::Matmul(g, probs, v, false, false);
+    Node* projected = test::graph::Matmul(g, context, w, false, false);
+    Node* attention = test::graph::Add(g, x, projected);
+    Node* y = test::graph::Unary(
+        g, "Tanh",
+        test::graph::Add(
+            g, test::graph::Binary(g, "Mul", attention, attention), attention));
+    Node* hidden = test::graph::Unary(
+        g, "Tanh", test::graph::Matmul(g, y, w, false, false));
+    Node* ffn = test::graph::Matmul(g, hidden, w, false, false);
+    x = test::graph::Unary(g, "Tanh", test::graph::Add(g, y, ffn));
+  }
+  return g;
+}
+
+// Runs 'g' and reports the median and 99th percentile step latency. If
+// 'cost_model' is true, the executor learns the kernel costs during the
+// warmup steps and uses them to schedule the timed steps.
+static void RunWithLatencyPercentiles(int iters, Graph* g, bool cost_model) {
+#ifdef PLATFORM_GOOGLE
+  BenchmarkUseRealTime();
+#endif  // PLATFORM_GOOGLE
+  setenv("TF_EXECUTOR_COST_MODEL_STEPS", cost_model ? "3" : "0", 1);
+  test::Benchmark benchmark("cpu", g);
+  unsetenv("TF_EXECUTOR_COST_MODEL_STEPS");
+  std::vector<int64> step_micros;
+  benchmark.RunAndRecordStepTimes(iters, &step_micros);
+  if (step_micros.empty()) return;
+  std::sort(step_micros.begin(), step_micros.end());
+#ifdef PLATFORM_GOOGLE
+  SetBenchmarkLabel(
+      strings::StrCat("p50: ", step_micros[step_micros.size() / 2],
+                      "us p99: ", step_micros[step_micros.size() * 99 / 100],
+                      "us"));
+#endif  // PLATFORM_GOOGLE
+}
+
+static void BM_InceptionLike(int iters, int cost_model) {
+  RunWithLatencyPercentiles(iters, InceptionLikeGraph(8), cost_model);
+}
+BENCHMARK(BM_InceptionLike)->Arg(0)->Arg(1);
+
+static void BM_BertLike(int iters, int cost_model) {
+  RunWithLatencyPercentiles(iters, BertLikeGraph(6), cost_model);
+}
+BENCHMARK(BM_BertLike)->Arg(0)->Arg(1);
+
 }  // namespace tensorflow
@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/types.h"
@@ -119,6 +120,11 @@ Benchmark::~Benchmark() {
 
 void Benchmark::Run(int iters) { RunWithRendezvousArgs({}, {}, iters); }
 
+void Benchmark::RunAndRecordStepTimes(int iters,
+                                      std::vector<int64>* step_micros) {
+  RunSteps({}, {}, iters, step_micros);
+}
+
 string GetRendezvousKey(const Node* node) {
   string send_device;
   TF_CHECK_OK(GetNodeAttr(node->attrs(), "send_device", &send_device));
@@ -136,6 +142,12 @@ string GetRendezvousKey(const Node* node) {
 void Benchmark::RunWithRendezvousArgs(
     const std::vector<std::pair<string, Tensor>>& inputs,
     const std::vector<string>& outputs, int iters) {
+  RunSteps(inputs, outputs, iters, nullptr);
+}
+
+void Benchmark::RunSteps(const std::vector<std::pair<string, Tensor>>& inputs,
+                         const std::vector<string>& outputs, int iters,
+                         std::vector<int64>* step_micros) {
   if (!device_ || iters == 0) {
     return;
   }
@@ -167,6 +179,8 @@ void Benchmark::RunWithRendezvousArgs(
 
   testing::StartTiming();
   while (iters-- > 0) {
+    const uint64 start_micros =
+        step_micros != nullptr ? Env::Default()->NowMicros() : 0;
     for (const auto& p : inputs) {
       Rendezvous::ParsedKey parsed;
       TF_CHECK_OK(Rendezvous::ParseKey(p.first, &parsed));
@@ -178,6 +192,9 @@ void Benchmark::RunWithRendezvousArgs(
       TF_CHECK_OK(Rendezvous::ParseKey(key, &parsed));
       TF_CHECK_OK(rendez_->Recv(parsed, Rendezvous::Args(), &unused, &is_dead));
     }
+    if (step_micros != nullptr) {
+      step_micros->push_back(Env::Default()->NowMicros() - start_micros);
+    }
   }
 
   TF_CHECK_OK(device_->Sync());
@@ -54,7 +54,15 @@ class Benchmark {
       const std::vector<std::pair<string, Tensor>>& inputs,
       const std::vector<string>& outputs, int iters);
 
+  // Like Run(), but also appends the wall time of each timed execution, in
+  // microseconds, to "step_micros".
+  void RunAndRecordStepTimes(int iters, std::vector<int64>* step_micros);
+
  private:
+  void RunSteps(const std::vector<std::pair<string, Tensor>>& inputs,
+                const std::vector<string>& outputs, int iters,
+                std::vector<int64>* step_micros);
+
   thread::ThreadPool* pool_ = nullptr;
   std::unique_ptr<Device> device_ = nullptr;
   Rendezvous* rendez_ = nullptr;
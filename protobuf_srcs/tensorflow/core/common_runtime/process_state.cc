@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
 #include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/common_runtime/size_class_pool_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/tracking_allocator.h"
@@ -73,9 +74,16 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
     if (!status.ok()) {
       LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
     }
+    bool use_size_class_pool = false;
+    status = ReadBoolFromEnvVar("TF_CPU_ALLOCATOR_USE_SIZE_CLASS_POOL", false,
+                                &use_size_class_pool);
+    if (!status.ok()) {
+      LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+    }
     Allocator* allocator = nullptr;
     SubAllocator* sub_allocator =
-        (numa_enabled_ || alloc_visitors_defined || use_bfc_allocator)
+        (numa_enabled_ || alloc_visitors_defined || use_bfc_allocator ||
+         use_size_class_pool)
             ? new BasicCPUAllocator(
                   numa_enabled_ ? numa_node : port::kNUMANoAffinity,
                   cpu_alloc_visitors_, cpu_free_visitors_)
@@ -90,12 +98,25 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
         LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
       }
       int64 cpu_mem_limit = cpu_mem_limit_in_mb * (1LL << 20);
+      bool thread_caching = false;
+      status = ReadBoolFromEnvVar("TF_CPU_BFC_THREAD_CACHE", false,
+                                  &thread_caching);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
       DCHECK(sub_allocator);
-      allocator =
-          new BFCAllocator(sub_allocator, cpu_mem_limit, true /*allow_growth*/,
-                           "bfc_cpu_allocator_for_gpu" /*name*/);
+      allocator = new BFCAllocator(
+          sub_allocator, cpu_mem_limit, true /*allow_growth*/,
+          "bfc_cpu_allocator_for_gpu" /*name*/, false /*garbage_collection*/,
+          thread_caching);
       VLOG(2) << "Using BFCAllocator with memory limit of "
               << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
+    } else if (use_size_class_pool) {
+      DCHECK(sub_allocator);
+      allocator = new SizeClassPoolAllocator(sub_allocator,
+                                             SizeClassPoolAllocator::Options(),
+                                             "cpu_size_class_pool");
+      VLOG(2) << "Using SizeClassPoolAllocator for ProcessState CPU allocator";
     } else if (sub_allocator) {
       DCHECK(sub_allocator);
       allocator =
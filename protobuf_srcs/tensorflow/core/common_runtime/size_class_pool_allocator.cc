@@ -0,0 +1,395 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/size_class_pool_allocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Every block starts with a BlockPrefix, padded to a full cache line. The
+// pointer returned to the user immediately follows it.
+struct BlockPrefix {
+  // Start of the memory obtained from the sub-allocator, and its size.
+  void* block;
+  size_t block_bytes;
+  size_t requested_bytes;
+  // -1 if the block is not pooled.
+  int size_class;
+};
+constexpr size_t kPrefixBytes = Allocator::kAllocatorAlignment;
+static_assert(sizeof(BlockPrefix) <= kPrefixBytes,
+              "BlockPrefix must fit in the block prefix");
+
+BlockPrefix* PrefixFor(const void* ptr) {
+  return reinterpret_cast<BlockPrefix*>(
+      static_cast<char*>(const_cast<void*>(ptr)) - kPrefixBytes);
+}
+
+// Threads check whether a trim is due every this many operations.
+constexpr int64 kTrimCheckPeriod = 1024;
+
+const std::vector<size_t>& SizeClassTable() {
+  static const std::vector<size_t>* table = [] {
+    auto* sizes = new std::vector<size_t>;
+    for (size_t size = 64; size <= 1024; size += 64) {
+      sizes->push_back(size);
+    }
+    for (size_t base = 1024; base < (1 << 20); base *= 2) {
+      for (int k = 1; k <= 4; ++k) {
+        sizes->push_back(base + k * base / 4);
+      }
+    }
+    return sizes;
+  }();
+  return *table;
+}
+
+void UpdateMax(std::atomic<int64>* max, int64 value) {
+  int64 current = max->load(std::memory_order_relaxed);
+  while (value > current &&
+         !max->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+std::atomic<uint64> next_allocator_id{1};
+
+}  // namespace
+
+// static
+int SizeClassPoolAllocator::SizeClassForBytes(size_t num_bytes) {
+  const std::vector<size_t>& table = SizeClassTable();
+  auto it = std::lower_bound(table.begin(), table.end(), num_bytes);
+  return it == table.end() ? -1 : it - table.begin();
+}
+
+// static
+size_t SizeClassPoolAllocator::SizeClassBytes(int size_class) {
+  return SizeClassTable()[size_class];
+}
+
+SizeClassPoolAllocator::SizeClassPoolAllocator(SubAllocator* sub_allocator,
+                                               const Options& options,
+                                               string name)
+    : name_(std::move(name)),
+      options_(options),
+      sub_allocator_(sub_allocator),
+      env_(options.env != nullptr ? options.env : Env::Default()),
+      id_(next_allocator_id.fetch_add(1, std::memory_order_relaxed)),
+      next_trim_micros_(env_->NowMicros() + options.trim_interval_micros) {
+  CHECK_LE(options_.max_pooled_bytes, SizeClassTable().back());
+  mutex_lock l(mu_);
+  shared_lists_.resize(SizeClassTable().size());
+}
+
+SizeClassPoolAllocator::~SizeClassPoolAllocator() {
+  mutex_lock l(mu_);
+  for (const auto& cache : thread_caches_) {
+    cache->allocator_destroyed = true;
+    mutex_lock cache_lock(cache->mu);
+    for (int c = 0; c < cache->lists.size(); ++c) {
+      FreeBlocks(c, cache->lists[c].blocks);
+      cache->lists[c].blocks.clear();
+    }
+  }
+  for (int c = 0; c < shared_lists_.size(); ++c) {
+    FreeBlocks(c, shared_lists_[c].blocks);
+  }
+}
+
+SizeClassPoolAllocator::ThreadCache* SizeClassPoolAllocator::GetThreadCache() {
+  // The calling thread's caches, one per allocator it has used. The
+  // allocator holds another reference to each, and treats a cache whose
+  // thread reference is gone as belonging to an exited thread.
+  static thread_local std::vector<
+      std::pair<uint64, std::shared_ptr<ThreadCache>>>
+      thread_caches;
+  for (const auto& entry : thread_caches) {
+    if (entry.first == id_) return entry.second.get();
+  }
+
+  thread_caches.erase(
+      std::remove_if(
+          thread_caches.begin(), thread_caches.end(),
+          [](const std::pair<uint64, std::shared_ptr<ThreadCache>>& entry) {
+            return entry.second->allocator_destroyed.load();
+          }),
+      thread_caches.end());
+  auto cache = std::make_shared<ThreadCache>();
+  {
+    mutex_lock l(cache->mu);
+    cache->lists.resize(SizeClassTable().size());
+  }
+  {
+    mutex_lock l(mu_);
+    thread_caches_.push_back(cache);
+  }
+  thread_caches.emplace_back(id_, cache);
+  return cache.get();
+}
+
+size_t SizeClassPoolAllocator::ThreadCacheCapacity(int size_class) const {
+  return std::max<size_t>(1, options_.max_thread_cached_bytes_per_class /
+                                SizeClassBytes(size_class));
+}
+
+void* SizeClassPoolAllocator::NewBlock(int size_class) {
+  const size_t block_bytes = kPrefixBytes + SizeClassBytes(size_class);
+  void* block = sub_allocator_->Alloc(kPrefixBytes, block_bytes);
+  if (block != nullptr) {
+    RecordReserved(block_bytes);
+  }
+  return block;
+}
+
+void SizeClassPoolAllocator::FreeBlocks(int size_class,
+                                        const std::vector<void*>& blocks) {
+  const size_t block_bytes = kPrefixBytes + SizeClassBytes(size_class);
+  for (void* block : blocks) {
+    sub_allocator_->Free(block, block_bytes);
+  }
+  bytes_reserved_.fetch_sub(block_bytes * blocks.size(),
+                            std::memory_order_relaxed);
+}
+
+// static
+void SizeClassPoolAllocator::TakeOldest(FreeList* list, size_t n,
+                                        std::vector<void*>* out) {
+  n = std::min(n, list->blocks.size());
+  out->insert(out->end(), list->blocks.begin(), list->blocks.begin() + n);
+  list->blocks.erase(list->blocks.begin(), list->blocks.begin() + n);
+  list->low_water = std::min(list->low_water, list->blocks.size());
+}
+
+void SizeClassPoolAllocator::RecordReserved(size_t block_bytes) {
+  UpdateMax(&peak_bytes_reserved_,
+            bytes_reserved_.fetch_add(block_bytes, std::memory_order_relaxed) +
+                block_bytes);
+}
+
+void SizeClassPoolAllocator::RecordAllocation(size_t allocated_bytes) {
+  num_allocs_.fetch_add(1, std::memory_order_relaxed);
+  UpdateMax(&peak_bytes_in_use_,
+            bytes_in_use_.fetch_add(allocated_bytes,
+                                    std::memory_order_relaxed) +
+                allocated_bytes);
+  UpdateMax(&largest_alloc_size_, allocated_bytes);
+}
+
+void* SizeClassPoolAllocator::AllocateRaw(size_t alignment, size_t num_bytes) {
+  if (num_bytes == 0) return nullptr;
+  const int size_class =
+      (alignment <= kAllocatorAlignment &&
+       num_bytes <= options_.max_pooled_bytes)
+          ? SizeClassForBytes(num_bytes)
+          : -1;
+
+  void* block = nullptr;
+  size_t block_bytes;
+  size_t offset = kPrefixBytes;
+  if (size_class < 0) {
+    offset = std::max(alignment, kPrefixBytes);
+    block_bytes = offset + num_bytes;
+    block = sub_allocator_->Alloc(offset, block_bytes);
+    if (block == nullptr) return nullptr;
+    RecordReserved(block_bytes);
+  } else {
+    ThreadCache* cache = GetThreadCache();
+    bool check_trim;
+    {
+      mutex_lock l(cache->mu);
+      FreeList& list = cache->lists[size_class];
+      if (list.blocks.empty()) {
+        // Take up to half of the thread's capacity, so that the following
+        // allocations of this size class don't need the shared lock either.
+        mutex_lock shared_lock(mu_);
+        FreeList& shared = shared_lists_[size_class];
+        const size_t n =
+            std::min(shared.blocks.size(),
+                     std::max<size_t>(1, ThreadCacheCapacity(size_class) / 2));
+        list.blocks.insert(list.blocks.end(), shared.blocks.end() - n,
+                           shared.blocks.end());
+        shared.blocks.resize(shared.blocks.size() - n);
+        shared.low_water = std::min(shared.low_water, shared.blocks.size());
+      }
+      if (!list.blocks.empty()) {
+        block = list.blocks.back();
+        list.blocks.pop_back();
+        list.low_water = std::min(list.low_water, list.blocks.size());
+      }
+      check_trim = ++cache->ops_since_trim_check >= kTrimCheckPeriod;
+      if (check_trim) cache->ops_since_trim_check = 0;
+    }
+    if (block == nullptr) {
+      block = NewBlock(size_class);
+      if (block == nullptr) return nullptr;
+    }
+    block_bytes = kPrefixBytes + SizeClassBytes(size_class);
+    if (check_trim) MaybeTrim();
+  }
+
+  void* ptr = static_cast<char*>(block) + offset;
+  BlockPrefix* prefix = PrefixFor(ptr);
+  prefix->block = block;
+  prefix->block_bytes = block_bytes;
+  prefix->requested_bytes = num_bytes;
+  prefix->size_class = size_class;
+  RecordAllocation(block_bytes - offset);
+  return ptr;
+}
+
+void SizeClassPoolAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) return;
+  const BlockPrefix* prefix = PrefixFor(ptr);
+  void* block = prefix->block;
+  const size_t block_bytes = prefix->block_bytes;
+  const int size_class = prefix->size_class;
+  bytes_in_use_.fetch_sub(
+      block_bytes - (static_cast<char*>(ptr) - static_cast<char*>(block)),
+      std::memory_order_relaxed);
+  if (size_class < 0) {
+    sub_allocator_->Free(block, block_bytes);
+    bytes_reserved_.fetch_sub(block_bytes, std::memory_order_relaxed);
+    return;
+  }
+
+  ThreadCache* cache = GetThreadCache();
+  bool check_trim;
+  {
+    mutex_lock l(cache->mu);
+    FreeList& list = cache->lists[size_class];
+    list.blocks.push_back(block);
+    if (list.blocks.size() > ThreadCacheCapacity(size_class)) {
+      // Keep the most recently freed half, which is most likely to still be
+      // in this CPU's cache.
+      std::vector<void*> spilled;
+      TakeOldest(&list, list.blocks.size() - list.blocks.size() / 2, &spilled);
+      mutex_lock shared_lock(mu_);
+      FreeList& shared = shared_lists_[size_class];
+      shared.blocks.insert(shared.blocks.end(), spilled.begin(),
+                           spilled.end());
+    }
+    check_trim = ++cache->ops_since_trim_check >= kTrimCheckPeriod;
+    if (check_trim) cache->ops_since_trim_check = 0;
+  }
+  if (check_trim) MaybeTrim();
+}
+
+void SizeClassPoolAllocator::MaybeTrim() {
+  if (options_.trim_interval_micros <= 0) return;
+  const int64 now = env_->NowMicros();
+  int64 next = next_trim_micros_.load(std::memory_order_relaxed);
+  if (now < next) return;
+  // Only one of the threads that notice a trim is due performs it.
+  if (!next_trim_micros_.compare_exchange_strong(
+          next, now + options_.trim_interval_micros)) {
+    return;
+  }
+  Trim();
+}
+
+void SizeClassPoolAllocator::Trim() {
+  std::vector<std::shared_ptr<ThreadCache>> live;
+  std::vector<std::shared_ptr<ThreadCache>> exited;
+  {
+    mutex_lock l(mu_);
+    auto it = std::partition(
+        thread_caches_.begin(), thread_caches_.end(),
+        [](const std::shared_ptr<ThreadCache>& cache) {
+          return cache.use_count() > 1;
+        });
+    exited.assign(std::make_move_iterator(it),
+                  std::make_move_iterator(thread_caches_.end()));
+    thread_caches_.erase(it, thread_caches_.end());
+    live = thread_caches_;
+  }
+
+  // Thread caches are locked before mu_ elsewhere, so never hold both here.
+  std::vector<std::vector<void*>> to_free(SizeClassTable().size());
+  for (const auto& cache : exited) {
+    mutex_lock l(cache->mu);
+    for (int c = 0; c < cache->lists.size(); ++c) {
+      TakeOldest(&cache->lists[c], cache->lists[c].blocks.size(), &to_free[c]);
+    }
+  }
+  for (const auto& cache : live) {
+    mutex_lock l(cache->mu);
+    for (int c = 0; c < cache->lists.size(); ++c) {
+      FreeList& list = cache->lists[c];
+      TakeOldest(&list, list.low_water, &to_free[c]);
+      list.low_water = list.blocks.size();
+    }
+  }
+  {
+    mutex_lock l(mu_);
+    for (int c = 0; c < shared_lists_.size(); ++c) {
+      FreeList& list = shared_lists_[c];
+      TakeOldest(&list, list.low_water, &to_free[c]);
+      list.low_water = list.blocks.size();
+    }
+  }
+
+  int64 num_freed = 0;
+  for (int c = 0; c < to_free.size(); ++c) {
+    FreeBlocks(c, to_free[c]);
+    num_freed += to_free[c].size();
+  }
+  VLOG(2) << Name() << ": trimmed " << num_freed << " free blocks from "
+          << live.size() << " threads and " << exited.size()
+          << " exited threads.";
+}
+
+size_t SizeClassPoolAllocator::RequestedSize(const void* ptr) const {
+  CHECK(ptr);
+  return PrefixFor(ptr)->requested_bytes;
+}
+
+size_t SizeClassPoolAllocator::AllocatedSize(const void* ptr) const {
+  CHECK(ptr);
+  const BlockPrefix* prefix = PrefixFor(ptr);
+  return prefix->block_bytes - (static_cast<const char*>(ptr) -
+                                static_cast<const char*>(prefix->block));
+}
+
+absl::optional<AllocatorStats> SizeClassPoolAllocator::GetStats() {
+  AllocatorStats stats;
+  stats.num_allocs = num_allocs_.load(std::memory_order_relaxed);
+  stats.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+  stats.peak_bytes_in_use = peak_bytes_in_use_.load(std::memory_order_relaxed);
+  stats.largest_alloc_size =
+      largest_alloc_size_.load(std::memory_order_relaxed);
+  stats.bytes_reserved = bytes_reserved_.load(std::memory_order_relaxed);
+  stats.peak_bytes_reserved =
+      peak_bytes_reserved_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void SizeClassPoolAllocator::ClearStats() {
+  num_allocs_.store(0, std::memory_order_relaxed);
+  peak_bytes_in_use_.store(bytes_in_use_.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+  largest_alloc_size_.store(0, std::memory_order_relaxed);
+  peak_bytes_reserved_.store(bytes_reserved_.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,164 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_SIZE_CLASS_POOL_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_SIZE_CLASS_POOL_ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A pool of CPU memory blocks binned by size class, with a cache of free
+// blocks per thread.
+//
+// Requests of up to Options::max_pooled_bytes are rounded up to one of a
+// fixed set of size classes (multiples of 64 bytes up to 1KiB, then four
+// classes per power of two up to 1MiB). Freed blocks are kept in a free list
+// of the deallocating thread, so the common pattern of a kernel allocating
+// and freeing same-sized temporaries on one inter-op thread never takes a
+// shared lock. Thread caches exchange blocks with a shared pool in batches.
+// Blocks that stay unused for a full trim interval are returned to the
+// sub-allocator, so the pool shrinks again after a burst of allocations.
+//
+// Every block starts with a 64-byte prefix, so the returned memory is always
+// aligned to Allocator::kAllocatorAlignment and never shares a cache line
+// with another block. Larger requests, and requests for a larger alignment,
+// are forwarded to the sub-allocator.
+class SizeClassPoolAllocator : public Allocator {
+ public:
+  struct Options {
+    // Requests larger than this are not pooled. At most 1MiB.
+    size_t max_pooled_bytes = 1 << 20;
+    // Bytes of free blocks of one size class a thread may cache before half
+    // of them are moved to the shared pool.
+    size_t max_thread_cached_bytes_per_class = 256 << 10;
+    // Free blocks that were not reused for this long are returned to the
+    // sub-allocator. If 0, the pool is only trimmed by explicit calls to
+    // Trim().
+    int64 trim_interval_micros = 10 * 1000 * 1000;
+    // Used to read the time for periodic trimming. If nullptr,
+    // Env::Default() is used.
+    Env* env = nullptr;
+  };
+
+  // Takes ownership of 'sub_allocator'.
+  SizeClassPoolAllocator(SubAllocator* sub_allocator, const Options& options,
+                         string name);
+  ~SizeClassPoolAllocator() override;
+
+  string Name() override { return name_; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+
+  void DeallocateRaw(void* ptr) override;
+
+  bool TracksAllocationSizes() const override { return true; }
+
+  size_t RequestedSize(const void* ptr) const override;
+
+  size_t AllocatedSize(const void* ptr) const override;
+
+  // bytes_reserved is the memory currently held from the sub-allocator,
+  // including free blocks in the pool.
+  absl::optional<AllocatorStats> GetStats() override;
+
+  void ClearStats() override;
+
+  // Returns free blocks that have not been reused since the previous trim to
+  // the sub-allocator, along with all blocks cached by threads that have
+  // exited. Called automatically every Options::trim_interval_micros.
+  void Trim();
+
+  // Returns the size class of a request of 'num_bytes' bytes, or -1 if it is
+  // larger than the largest size class.
+  static int SizeClassForBytes(size_t num_bytes);
+
+  // Returns the usable size of blocks of 'size_class'.
+  static size_t SizeClassBytes(int size_class);
+
+ private:
+  struct FreeList {
+    std::vector<void*> blocks;
+    // Smallest size of 'blocks' since the last trim. That many blocks have
+    // been idle for the whole interval.
+    size_t low_water = 0;
+  };
+
+  struct ThreadCache {
+    mutex mu;
+    std::vector<FreeList> lists GUARDED_BY(mu);
+    // Operations since the last check for a due trim.
+    int64 ops_since_trim_check GUARDED_BY(mu) = 0;
+    // Set when the allocator is destroyed.
+    std::atomic<bool> allocator_destroyed{false};
+  };
+
+  // Returns the calling thread's cache, creating it on first use.
+  ThreadCache* GetThreadCache();
+
+  // Allocates a block of 'size_class' from the sub-allocator.
+  void* NewBlock(int size_class);
+
+  // Returns blocks to the sub-allocator.
+  void FreeBlocks(int size_class, const std::vector<void*>& blocks);
+
+  // Moves 'n' blocks from the front of 'list', which are the least recently
+  // freed ones, to 'out'.
+  static void TakeOldest(FreeList* list, size_t n, std::vector<void*>* out);
+
+  void MaybeTrim();
+
+  size_t ThreadCacheCapacity(int size_class) const;
+
+  void RecordReserved(size_t block_bytes);
+  void RecordAllocation(size_t allocated_bytes);
+
+  const string name_;
+  const Options options_;
+  std::unique_ptr<SubAllocator> sub_allocator_;
+  Env* const env_;
+  // Identifies this allocator in the threads' cache lookup tables. Never
+  // reused, unlike the allocator's address.
+  const uint64 id_;
+
+  mutex mu_;
+  std::vector<FreeList> shared_lists_ GUARDED_BY(mu_);
+  std::vector<std::shared_ptr<ThreadCache>> thread_caches_ GUARDED_BY(mu_);
+
+  std::atomic<int64> next_trim_micros_;
+
+  std::atomic<int64> num_allocs_{0};
+  std::atomic<int64> bytes_in_use_{0};
+  std::atomic<int64> peak_bytes_in_use_{0};
+  std::atomic<int64> largest_alloc_size_{0};
+  std::atomic<int64> bytes_reserved_{0};
+  std::atomic<int64> peak_bytes_reserved_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SizeClassPoolAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_SIZE_CLASS_POOL_ALLOCATOR_H_
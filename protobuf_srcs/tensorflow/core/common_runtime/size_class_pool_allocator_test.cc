@@ -0,0 +1,241 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/size_class_pool_allocator.h"
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/common_runtime/process_state.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+SizeClassPoolAllocator* NewAllocator(
+    const SizeClassPoolAllocator::Options& options) {
+  return new SizeClassPoolAllocator(
+      new BasicCPUAllocator(port::kNUMANoAffinity, {}, {}), options, "test");
+}
+
+SizeClassPoolAllocator::Options NoAutomaticTrim() {
+  SizeClassPoolAllocator::Options options;
+  options.trim_interval_micros = 0;
+  return options;
+}
+
+TEST(SizeClassPoolAllocatorTest, SizeClasses) {
+  EXPECT_EQ(0, SizeClassPoolAllocator::SizeClassForBytes(1));
+  EXPECT_EQ(0, SizeClassPoolAllocator::SizeClassForBytes(64));
+  EXPECT_EQ(1, SizeClassPoolAllocator::SizeClassForBytes(65));
+  EXPECT_EQ(1024, SizeClassPoolAllocator::SizeClassBytes(
+                      SizeClassPoolAllocator::SizeClassForBytes(1000)));
+  EXPECT_EQ(1280, SizeClassPoolAllocator::SizeClassBytes(
+                      SizeClassPoolAllocator::SizeClassForBytes(1025)));
+  EXPECT_EQ(1 << 20, SizeClassPoolAllocator::SizeClassBytes(
+                         SizeClassPoolAllocator::SizeClassForBytes(1 << 20)));
+  EXPECT_EQ(-1, SizeClassPoolAllocator::SizeClassForBytes((1 << 20) + 1));
+  const int num_classes = SizeClassPoolAllocator::SizeClassForBytes(1 << 20);
+  for (int c = 0; c <= num_classes; ++c) {
+    // Every block is a whole number of cache lines.
+    EXPECT_EQ(0, SizeClassPoolAllocator::SizeClassBytes(c) % 64);
+    EXPECT_EQ(c, SizeClassPoolAllocator::SizeClassForBytes(
+                     SizeClassPoolAllocator::SizeClassBytes(c)));
+  }
+}
+
+TEST(SizeClassPoolAllocatorTest, ReusesFreedBlocks) {
+  std::unique_ptr<SizeClassPoolAllocator> a(NewAllocator(NoAutomaticTrim()));
+  void* p1 = a->AllocateRaw(Allocator::kAllocatorAlignment, 1000);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p1) % 64);
+  EXPECT_EQ(1000, a->RequestedSize(p1));
+  EXPECT_EQ(1024, a->AllocatedSize(p1));
+  a->DeallocateRaw(p1);
+  // Same size class, so the block is reused.
+  void* p2 = a->AllocateRaw(Allocator::kAllocatorAlignment, 1010);
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(1010, a->RequestedSize(p2));
+  a->DeallocateRaw(p2);
+
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  EXPECT_EQ(2, stats->num_allocs);
+  EXPECT_EQ(0, stats->bytes_in_use);
+  EXPECT_EQ(1024, stats->peak_bytes_in_use);
+  EXPECT_EQ(64 + 1024, stats->bytes_reserved);
+}
+
+TEST(SizeClassPoolAllocatorTest, LargeAndOveralignedRequestsAreNotPooled) {
+  std::unique_ptr<SizeClassPoolAllocator> a(NewAllocator(NoAutomaticTrim()));
+  void* large = a->AllocateRaw(Allocator::kAllocatorAlignment, 2 << 20);
+  EXPECT_EQ(2 << 20, a->AllocatedSize(large));
+  void* aligned = a->AllocateRaw(4096, 100);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(aligned) % 4096);
+  EXPECT_EQ(100, a->RequestedSize(aligned));
+  a->DeallocateRaw(large);
+  a->DeallocateRaw(aligned);
+  EXPECT_EQ(0, a->GetStats()->bytes_reserved);
+}
+
+TEST(SizeClassPoolAllocatorTest, TrimReleasesIdleBlocks) {
+  std::unique_ptr<SizeClassPoolAllocator> a(NewAllocator(NoAutomaticTrim()));
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 8; ++i) {
+    ptrs.push_back(a->AllocateRaw(Allocator::kAllocatorAlignment, 4096));
+  }
+  for (void* p : ptrs) a->DeallocateRaw(p);
+  const int64 reserved = a->GetStats()->bytes_reserved;
+  EXPECT_EQ(8 * (64 + 4096), reserved);
+
+  // The first trim only starts the interval, since the blocks were in use
+  // before it.
+  a->Trim();
+  EXPECT_EQ(reserved, a->GetStats()->bytes_reserved);
+  // Two of the blocks are reused in the next interval.
+  void* p1 = a->AllocateRaw(Allocator::kAllocatorAlignment, 4096);
+  void* p2 = a->AllocateRaw(Allocator::kAllocatorAlignment, 4096);
+  a->DeallocateRaw(p1);
+  a->DeallocateRaw(p2);
+  a->Trim();
+  EXPECT_EQ(2 * (64 + 4096), a->GetStats()->bytes_reserved);
+  a->Trim();
+  EXPECT_EQ(0, a->GetStats()->bytes_reserved);
+}
+
+TEST(SizeClassPoolAllocatorTest, TrimReleasesBlocksOfExitedThreads) {
+  std::unique_ptr<SizeClassPoolAllocator> a(NewAllocator(NoAutomaticTrim()));
+  {
+    thread::ThreadPool pool(Env::Default(), "test", 1);
+    pool.Schedule([&a]() {
+      a->DeallocateRaw(a->AllocateRaw(Allocator::kAllocatorAlignment, 256));
+    });
+  }
+  EXPECT_EQ(64 + 256, a->GetStats()->bytes_reserved);
+  a->Trim();
+  EXPECT_EQ(0, a->GetStats()->bytes_reserved);
+}
+
+TEST(SizeClassPoolAllocatorTest, ConcurrentAllocations) {
+  SizeClassPoolAllocator::Options options;
+  // Small caches, so that blocks move between threads.
+  options.max_thread_cached_bytes_per_class = 4096;
+  std::unique_ptr<SizeClassPoolAllocator> a(NewAllocator(options));
+  const int kNumThreads = 8;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, t]() {
+        std::vector<char*> ptrs;
+        for (int i = 0; i < 10000; ++i) {
+          char* ptr = static_cast<char*>(
+              a->AllocateRaw(Allocator::kAllocatorAlignment, 64 << (i % 8)));
+          ptr[0] = static_cast<char>(t);
+          ptrs.push_back(ptr);
+          if (ptrs.size() > 32) {
+            for (char* p : ptrs) {
+              EXPECT_EQ(static_cast<char>(t), p[0]);
+              a->DeallocateRaw(p);
+            }
+            ptrs.clear();
+          }
+        }
+        for (char* p : ptrs) a->DeallocateRaw(p);
+      });
+    }
+  }
+  EXPECT_EQ(0, a->GetStats()->bytes_in_use);
+}
+
+// Each thread repeatedly allocates and frees a small working set of
+// tensor-sized buffers.
+static void BM_Allocator(int iters, int num_threads, Allocator* a) {
+  thread::ThreadPool pool(Env::Default(), "test", num_threads);
+  const int iters_per_thread = iters / num_threads;
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int t = 0; t < num_threads; ++t) {
+    pool.Schedule([a, iters_per_thread]() {
+      const std::vector<int> sizes = {256, 4096, 1024, 64, 65536, 512, 128};
+      void* ptrs[4] = {};
+      for (int i = 0; i < iters_per_thread; ++i) {
+        void*& p = ptrs[i % 4];
+        if (p != nullptr) a->DeallocateRaw(p);
+        p = a->AllocateRaw(Allocator::kAllocatorAlignment,
+                           sizes[i % sizes.size()]);
+      }
+      for (void* p : ptrs) {
+        if (p != nullptr) a->DeallocateRaw(p);
+      }
+    });
+  }
+}
+
+static void BM_CPUAllocator(int iters, int num_threads) {
+  testing::StopTiming();
+  BM_Allocator(iters, num_threads, cpu_allocator());
+}
+
+static void BM_SizeClassPoolAllocator(int iters, int num_threads) {
+  testing::StopTiming();
+  std::unique_ptr<SizeClassPoolAllocator> a(
+      NewAllocator(SizeClassPoolAllocator::Options()));
+  BM_Allocator(iters, num_threads, a.get());
+}
+
+BENCHMARK(BM_CPUAllocator)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(BM_SizeClassPoolAllocator)->Arg(1)->Arg(4)->Arg(16);
+
+// A chain of element-wise ops on 'num_elements' floats, each producing a new
+// intermediate tensor. Run with and without
+// TF_CPU_ALLOCATOR_USE_SIZE_CLASS_POOL=1 to compare the throughput and
+// memory held by the CPU device's allocator.
+static void BM_ElementwiseChain(int iters, int num_elements) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor t(DT_FLOAT, TensorShape({num_elements}));
+  t.flat<float>().setRandom();
+  Node* x = test::graph::Constant(g, t);
+  Node* y = x;
+  for (int i = 0; i < 32; ++i) {
+    y = test::graph::Binary(g, i % 2 == 0 ? "Add" : "Mul", y, x);
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * 32 * num_elements *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+  testing::StopTiming();
+
+  Allocator* allocator =
+      ProcessState::singleton()->GetCPUAllocator(port::kNUMANoAffinity);
+  absl::optional<AllocatorStats> stats = allocator->GetStats();
+  if (stats) {
+    testing::SetLabel(strings::StrCat(
+        allocator->Name(), " bytes_reserved: ", stats->bytes_reserved,
+        " peak_bytes_in_use: ", stats->peak_bytes_in_use));
+  } else {
+    testing::SetLabel(allocator->Name());
+  }
+}
+BENCHMARK(BM_ElementwiseChain)->Arg(256)->Arg(4096)->Arg(65536);
+
+}  // namespace
+}  // namespace tensorflow
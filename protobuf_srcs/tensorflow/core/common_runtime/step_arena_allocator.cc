@@ -0,0 +1,275 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+size_t RoundUpToAlignment(size_t num_bytes) {
+  const size_t alignment = Allocator::kAllocatorAlignment;
+  return (num_bytes + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+StepArenaPlan::StepArenaPlan(const std::vector<Allocation>& allocations)
+    : slots_(allocations.size()) {
+  std::vector<int> order;
+  for (int i = 0; i < allocations.size(); ++i) {
+    slots_[i].num_bytes = allocations[i].num_bytes;
+    if (allocations[i].dealloc_time >= 0 && allocations[i].num_bytes > 0) {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&allocations](int a, int b) {
+    if (allocations[a].num_bytes != allocations[b].num_bytes) {
+      return allocations[a].num_bytes > allocations[b].num_bytes;
+    }
+    return allocations[a].alloc_time < allocations[b].alloc_time;
+  });
+
+  auto lifetimes_overlap = [&allocations](int a, int b) {
+    return allocations[a].alloc_time < allocations[b].dealloc_time &&
+           allocations[b].alloc_time < allocations[a].dealloc_time;
+  };
+
+  // Plans are built once per graph, so a quadratic placement is acceptable.
+  std::vector<int> placed;
+  std::vector<int> conflicts;
+  for (int i : order) {
+    conflicts.clear();
+    for (int j : placed) {
+      if (lifetimes_overlap(i, j)) conflicts.push_back(j);
+    }
+    std::sort(conflicts.begin(), conflicts.end(), [this](int a, int b) {
+      return slots_[a].offset < slots_[b].offset;
+    });
+    const size_t size = RoundUpToAlignment(slots_[i].num_bytes);
+    int64 offset = 0;
+    for (int j : conflicts) {
+      if (offset + size <= slots_[j].offset) break;
+      offset = std::max<int64>(
+          offset, slots_[j].offset + RoundUpToAlignment(slots_[j].num_bytes));
+    }
+    slots_[i].offset = offset;
+    arena_bytes_ = std::max<size_t>(arena_bytes_, offset + size);
+    placed.push_back(i);
+  }
+  num_planned_slots_ = placed.size();
+
+  for (int a = 0; a < placed.size(); ++a) {
+    Slot& slot_a = slots_[placed[a]];
+    for (int b = a + 1; b < placed.size(); ++b) {
+      Slot& slot_b = slots_[placed[b]];
+      if (slot_a.offset < slot_b.offset + slot_b.num_bytes &&
+          slot_b.offset < slot_a.offset + slot_a.num_bytes) {
+        slot_a.overlapping.push_back(placed[b]);
+        slot_b.overlapping.push_back(placed[a]);
+      }
+    }
+  }
+}
+
+StepArenaAllocator::StepArenaAllocator(
+    Allocator* base, std::shared_ptr<const StepArenaPlan> plan, char* arena)
+    : base_(base), plan_(std::move(plan)), arena_(arena) {}
+
+StepArenaAllocator::~StepArenaAllocator() {
+  if (arena_ != nullptr) {
+    base_->DeallocateRaw(arena_);
+  }
+}
+
+void StepArenaAllocator::Reset() {
+  DCHECK(live_slots_.empty());
+  ref_ = 1;
+  next_slot_ = 0;
+  slot_live_.assign(plan_ != nullptr ? plan_->num_slots() : 0, false);
+  next_event_ = 0;
+  recorded_.clear();
+  recorded_live_.clear();
+}
+
+void* StepArenaAllocator::AllocateRaw(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  mutex_lock l(mu_);
+  DCHECK_GT(ref_, 0);
+  const int slot = next_slot_++;
+  if (plan_ != nullptr && alignment <= kAllocatorAlignment &&
+      plan_->IsPlanned(slot, num_bytes)) {
+    bool available = true;
+    for (int other : plan_->overlapping(slot)) {
+      if (slot_live_[other]) {
+        available = false;
+        break;
+      }
+    }
+    if (available) {
+      void* ptr = arena_ + plan_->offset(slot);
+      slot_live_[slot] = true;
+      live_slots_[ptr] = slot;
+      ++ref_;
+      pool_->num_arena_allocs_.fetch_add(1, std::memory_order_relaxed);
+      return ptr;
+    }
+  }
+
+  void* ptr = base_->AllocateRaw(alignment, num_bytes, allocation_attr);
+  pool_->num_base_allocs_.fetch_add(1, std::memory_order_relaxed);
+  if (plan_ == nullptr) {
+    DCHECK_EQ(slot, recorded_.size());
+    StepArenaPlan::Allocation allocation;
+    allocation.num_bytes = num_bytes;
+    allocation.alloc_time = next_event_++;
+    if (ptr != nullptr) recorded_live_[ptr] = slot;
+    recorded_.push_back(allocation);
+  }
+  if (ptr != nullptr) ++ref_;
+  return ptr;
+}
+
+void StepArenaAllocator::DeallocateRaw(void* ptr) {
+  bool release;
+  {
+    mutex_lock l(mu_);
+    if (InArena(ptr)) {
+      auto it = live_slots_.find(ptr);
+      DCHECK(it != live_slots_.end());
+      slot_live_[it->second] = false;
+      live_slots_.erase(it);
+    } else {
+      if (plan_ == nullptr) {
+        auto it = recorded_live_.find(ptr);
+        if (it != recorded_live_.end()) {
+          recorded_[it->second].dealloc_time = next_event_++;
+          recorded_live_.erase(it);
+        }
+      }
+      base_->DeallocateRaw(ptr);
+    }
+    release = (--ref_ == 0);
+  }
+  if (release) Release();
+}
+
+void StepArenaAllocator::EndStep() {
+  std::shared_ptr<const StepArenaPlan> plan;
+  {
+    mutex_lock l(mu_);
+    if (plan_ == nullptr) {
+      plan = std::make_shared<const StepArenaPlan>(recorded_);
+      recorded_.clear();
+      recorded_live_.clear();
+    }
+  }
+  // The step's reference is still held, so pool_ cannot be released
+  // concurrently.
+  if (plan != nullptr) {
+    VLOG(1) << "Built step arena plan with " << plan->num_planned_slots()
+            << " of " << plan->num_slots() << " allocations in "
+            << plan->arena_bytes() << " bytes.";
+    pool_->SetPlan(std::move(plan));
+  }
+  bool release;
+  {
+    mutex_lock l(mu_);
+    release = (--ref_ == 0);
+  }
+  if (release) Release();
+}
+
+void StepArenaAllocator::Release() {
+  // Returning this allocator may drop the last reference to the pool, which
+  // in turn may delete this allocator. Do not touch any members afterwards.
+  std::shared_ptr<StepArenaPool> pool = std::move(pool_);
+  pool->Return(this);
+}
+
+StepArenaPool::StepArenaPool(Allocator* base) : base_(base) {}
+
+StepArenaPool::~StepArenaPool() {
+  for (StepArenaAllocator* allocator : free_) {
+    delete allocator;
+  }
+}
+
+StepArenaAllocator* StepArenaPool::Get() {
+  StepArenaAllocator* allocator = nullptr;
+  {
+    mutex_lock l(mu_);
+    if (!free_.empty()) {
+      allocator = free_.back();
+      free_.pop_back();
+    } else if (plan_ == nullptr) {
+      allocator = new StepArenaAllocator(base_, nullptr, nullptr);
+    } else {
+      char* arena = nullptr;
+      if (plan_->arena_bytes() > 0) {
+        arena = static_cast<char*>(base_->AllocateRaw(
+            Allocator::kAllocatorAlignment, plan_->arena_bytes()));
+        num_base_allocs_.fetch_add(1, std::memory_order_relaxed);
+      }
+      // If the arena could not be allocated, all requests fall back to the
+      // underlying allocator.
+      allocator = new StepArenaAllocator(
+          base_, arena != nullptr ? plan_ : nullptr, arena);
+      ++num_arenas_;
+    }
+  }
+  {
+    mutex_lock l(allocator->mu_);
+    allocator->Reset();
+  }
+  allocator->pool_ = shared_from_this();
+  return allocator;
+}
+
+void StepArenaPool::SetPlan(std::shared_ptr<const StepArenaPlan> plan) {
+  mutex_lock l(mu_);
+  if (plan_ == nullptr) {
+    plan_ = std::move(plan);
+  }
+}
+
+void StepArenaPool::Return(StepArenaAllocator* allocator) {
+  {
+    mutex_lock l(mu_);
+    if (allocator->plan_ != nullptr && allocator->plan_ == plan_) {
+      free_.push_back(allocator);
+      return;
+    }
+  }
+  // Recording allocators have no arena to reuse.
+  delete allocator;
+}
+
+StepArenaPool::Stats StepArenaPool::GetStats() {
+  Stats stats;
+  stats.num_arena_allocs = num_arena_allocs_.load(std::memory_order_relaxed);
+  stats.num_base_allocs = num_base_allocs_.load(std::memory_order_relaxed);
+  mutex_lock l(mu_);
+  stats.num_arenas = num_arenas_;
+  stats.arena_bytes = plan_ != nullptr ? plan_->arena_bytes() : 0;
+  return stats;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,219 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A static memory plan for the allocations made during one step of a graph.
+//
+// The plan is built from the sequence of allocations observed during a
+// recording step. Every allocation that was released before the end of that
+// step is assigned a fixed offset in a single arena, such that allocations
+// whose lifetimes overlapped never share bytes. Allocations that were still
+// alive at the end of the step (e.g. fetched outputs or persistent tensors)
+// are left unplanned and are always served by the underlying allocator.
+class StepArenaPlan {
+ public:
+  // An allocation observed during the recording step. Times are positions in
+  // the step's sequence of AllocateRaw/DeallocateRaw events.
+  struct Allocation {
+    size_t num_bytes = 0;
+    int64 alloc_time = 0;
+    // -1 if the allocation was still alive at the end of the step.
+    int64 dealloc_time = -1;
+  };
+
+  // Builds a plan by placing allocations in decreasing order of size at the
+  // lowest offset that does not collide with any already placed allocation
+  // whose lifetime overlaps, similar to TF Lite's ArenaPlanner.
+  explicit StepArenaPlan(const std::vector<Allocation>& allocations);
+
+  // Total size of the arena needed to hold all planned allocations.
+  size_t arena_bytes() const { return arena_bytes_; }
+
+  // Number of allocations in the recorded sequence, planned or not.
+  int num_slots() const { return slots_.size(); }
+
+  // Number of allocations that were assigned an offset in the arena.
+  int num_planned_slots() const { return num_planned_slots_; }
+
+  // Returns true if the i-th allocation of a step can be served from the
+  // arena: it was planned and has the same size as in the recording step.
+  bool IsPlanned(int i, size_t num_bytes) const {
+    return i < slots_.size() && slots_[i].offset >= 0 &&
+           slots_[i].num_bytes == num_bytes;
+  }
+
+  // Byte offset of the i-th allocation in the arena.
+  int64 offset(int i) const { return slots_[i].offset; }
+
+  // Indices of the other planned allocations that share bytes with the i-th
+  // one. They were never alive at the same time in the recording step, but
+  // may be if a later step allocates in a different order.
+  const std::vector<int>& overlapping(int i) const {
+    return slots_[i].overlapping;
+  }
+
+ private:
+  struct Slot {
+    size_t num_bytes = 0;
+    int64 offset = -1;
+    std::vector<int> overlapping;
+  };
+  std::vector<Slot> slots_;
+  size_t arena_bytes_ = 0;
+  int num_planned_slots_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaPlan);
+};
+
+class StepArenaPool;
+
+// An allocator handed to all kernels of one step on one device.
+//
+// Until a plan exists, a StepArenaAllocator forwards all requests to the
+// underlying allocator and records their lifetimes. Once a plan exists, the
+// i-th allocation of the step is served from a preallocated arena at its
+// planned offset, provided it has the recorded size and no overlapping
+// allocation is currently alive. Any other request falls back to the
+// underlying allocator, so a step that diverges from the recorded one (e.g.
+// due to concurrent kernels or different input shapes) is still correct.
+//
+// Tensors allocated from a StepArenaAllocator may outlive the step. The
+// allocator is therefore only returned to its pool, and its arena only
+// reused, once EndStep() has been called and every allocation has been
+// deallocated.
+class StepArenaAllocator : public Allocator {
+ public:
+  string Name() override { return "step_arena"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+  }
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override;
+  void DeallocateRaw(void* ptr) override;
+
+  // Signals that the step using this allocator has completed. No further
+  // calls to AllocateRaw are allowed. If this allocator was recording, the
+  // recorded allocations are turned into a plan for the pool.
+  void EndStep();
+
+ private:
+  friend class StepArenaPool;
+
+  // 'plan' may be nullptr, in which case this allocator records.
+  StepArenaAllocator(Allocator* base, std::shared_ptr<const StepArenaPlan> plan,
+                     char* arena);
+  ~StepArenaAllocator() override;
+
+  // Prepares a pooled allocator for reuse by a new step.
+  void Reset() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Hands this allocator back to its pool. Called once the step has ended
+  // and all allocations are gone.
+  void Release();
+
+  bool InArena(const void* ptr) const {
+    return arena_ != nullptr && ptr >= arena_ &&
+           ptr < arena_ + plan_->arena_bytes();
+  }
+
+  Allocator* const base_;  // not owned.
+  const std::shared_ptr<const StepArenaPlan> plan_;
+  char* const arena_;  // allocated from base_, owned.
+
+  // Set while the allocator is lent out to a step. Holding a reference keeps
+  // the pool alive until this allocator is returned to it.
+  std::shared_ptr<StepArenaPool> pool_;
+
+  mutex mu_;
+  // 1 until EndStep() is called, plus the number of live allocations.
+  int64 ref_ GUARDED_BY(mu_) = 1;
+  // Index of the next allocation in this step.
+  int next_slot_ GUARDED_BY(mu_) = 0;
+  // Live arena allocations, keyed by address. At most one planned slot can be
+  // live at any given address.
+  gtl::FlatMap<const void*, int> live_slots_ GUARDED_BY(mu_);
+  std::vector<bool> slot_live_ GUARDED_BY(mu_);
+
+  // Only used while recording.
+  int64 next_event_ GUARDED_BY(mu_) = 0;
+  std::vector<StepArenaPlan::Allocation> recorded_ GUARDED_BY(mu_);
+  gtl::FlatMap<const void*, int> recorded_live_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocator);
+};
+
+// Owns the StepArenaAllocators of one executor. Each concurrently running
+// step obtains its own allocator, so every in-flight step uses a separate
+// arena. Must be held by a std::shared_ptr.
+class StepArenaPool : public std::enable_shared_from_this<StepArenaPool> {
+ public:
+  // 'base' must outlive the pool and every allocator obtained from it.
+  explicit StepArenaPool(Allocator* base);
+  ~StepArenaPool();
+
+  // Returns an allocator for a new step. The caller must call EndStep() on
+  // it once the step has completed.
+  StepArenaAllocator* Get();
+
+  struct Stats {
+    // Allocations served from an arena.
+    int64 num_arena_allocs = 0;
+    // Allocations forwarded to the underlying allocator, including the
+    // allocation of the arenas themselves.
+    int64 num_base_allocs = 0;
+    // Number of arenas created so far.
+    int64 num_arenas = 0;
+    // Size of each arena, or 0 if no plan has been built yet.
+    int64 arena_bytes = 0;
+  };
+  Stats GetStats();
+
+ private:
+  friend class StepArenaAllocator;
+
+  void SetPlan(std::shared_ptr<const StepArenaPlan> plan);
+  void Return(StepArenaAllocator* allocator);
+
+  Allocator* const base_;  // not owned.
+
+  std::atomic<int64> num_arena_allocs_{0};
+  std::atomic<int64> num_base_allocs_{0};
+
+  mutex mu_;
+  std::shared_ptr<const StepArenaPlan> plan_ GUARDED_BY(mu_);
+  std::vector<StepArenaAllocator*> free_ GUARDED_BY(mu_);
+  int64 num_arenas_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaPool);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
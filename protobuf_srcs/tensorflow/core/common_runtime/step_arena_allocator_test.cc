@@ -0,0 +1,180 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+StepArenaPlan::Allocation MakeAllocation(size_t num_bytes, int64 alloc_time,
+                                         int64 dealloc_time) {
+  StepArenaPlan::Allocation allocation;
+  allocation.num_bytes = num_bytes;
+  allocation.alloc_time = alloc_time;
+  allocation.dealloc_time = dealloc_time;
+  return allocation;
+}
+
+TEST(StepArenaPlanTest, DisjointLifetimesShareMemory) {
+  // a: [0, 2), b: [1, 3), c: [4, 5). c can reuse the memory of a or b.
+  StepArenaPlan plan({MakeAllocation(256, 0, 2), MakeAllocation(128, 1, 3),
+                      MakeAllocation(256, 4, 5)});
+  EXPECT_EQ(3, plan.num_planned_slots());
+  EXPECT_EQ(384, plan.arena_bytes());
+  EXPECT_NE(plan.offset(0), plan.offset(1));
+  EXPECT_EQ(plan.offset(0), plan.offset(2));
+  EXPECT_EQ(std::vector<int>({2}), plan.overlapping(0));
+  EXPECT_TRUE(plan.overlapping(1).empty());
+}
+
+TEST(StepArenaPlanTest, LiveAtEndOfStepIsNotPlanned) {
+  StepArenaPlan plan({MakeAllocation(100, 0, 1), MakeAllocation(100, 2, -1)});
+  EXPECT_EQ(1, plan.num_planned_slots());
+  EXPECT_TRUE(plan.IsPlanned(0, 100));
+  EXPECT_FALSE(plan.IsPlanned(0, 200));
+  EXPECT_FALSE(plan.IsPlanned(1, 100));
+  EXPECT_FALSE(plan.IsPlanned(2, 100));
+  // Sizes are rounded up to the allocator alignment.
+  EXPECT_EQ(128, plan.arena_bytes());
+}
+
+// Runs one step that allocates two overlapping intermediates followed by a
+// third one that can reuse the first.
+void RunStep(Allocator* allocator) {
+  void* a = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 1024);
+  void* b = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 512);
+  allocator->DeallocateRaw(a);
+  void* c = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 1024);
+  allocator->DeallocateRaw(b);
+  allocator->DeallocateRaw(c);
+}
+
+TEST(StepArenaAllocatorTest, RecordThenReplay) {
+  auto pool = std::make_shared<StepArenaPool>(cpu_allocator());
+  StepArenaAllocator* allocator = pool->Get();
+  RunStep(allocator);
+  allocator->EndStep();
+  StepArenaPool::Stats stats = pool->GetStats();
+  EXPECT_EQ(0, stats.num_arena_allocs);
+  EXPECT_EQ(3, stats.num_base_allocs);
+  EXPECT_EQ(1536, stats.arena_bytes);
+
+  for (int i = 0; i < 3; ++i) {
+    allocator = pool->Get();
+    RunStep(allocator);
+    allocator->EndStep();
+  }
+  stats = pool->GetStats();
+  EXPECT_EQ(9, stats.num_arena_allocs);
+  // One additional base allocation for the arena, which is reused.
+  EXPECT_EQ(4, stats.num_base_allocs);
+  EXPECT_EQ(1, stats.num_arenas);
+}
+
+TEST(StepArenaAllocatorTest, DivergingStepFallsBack) {
+  auto pool = std::make_shared<StepArenaPool>(cpu_allocator());
+  StepArenaAllocator* allocator = pool->Get();
+  RunStep(allocator);
+  allocator->EndStep();
+
+  allocator = pool->Get();
+  // Same sizes, but the first allocation is still alive when the third one
+  // is made, so the third one must not reuse its memory.
+  void* a = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 1024);
+  void* b = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 512);
+  void* c = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 1024);
+  EXPECT_NE(a, c);
+  // Different size than recorded.
+  void* d = allocator->AllocateRaw(Allocator::kAllocatorAlignment, 64);
+  allocator->DeallocateRaw(a);
+  allocator->DeallocateRaw(b);
+  allocator->DeallocateRaw(c);
+  allocator->DeallocateRaw(d);
+  allocator->EndStep();
+
+  StepArenaPool::Stats stats = pool->GetStats();
+  EXPECT_EQ(2, stats.num_arena_allocs);
+  EXPECT_EQ(3 + 1 + 2, stats.num_base_allocs);
+}
+
+TEST(StepArenaAllocatorTest, TensorOutlivesStep) {
+  auto pool = std::make_shared<StepArenaPool>(cpu_allocator());
+  StepArenaAllocator* allocator = pool->Get();
+  { Tensor t(allocator, DT_FLOAT, TensorShape({16})); }
+  allocator->EndStep();
+
+  Tensor output;
+  allocator = pool->Get();
+  output = Tensor(allocator, DT_FLOAT, TensorShape({16}));
+  output.flat<float>().setConstant(1.0f);
+  allocator->EndStep();
+
+  // The first arena is still in use by `output`, so a new one is created.
+  allocator = pool->Get();
+  { Tensor t(allocator, DT_FLOAT, TensorShape({16})); }
+  allocator->EndStep();
+  EXPECT_EQ(2, pool->GetStats().num_arenas);
+
+  // Dropping the pool before the tensor is safe.
+  pool.reset();
+  EXPECT_EQ(1.0f, output.flat<float>()(15));
+}
+
+static void BM_StepArenaAllocator(int iters, int num_allocs, bool use_arena) {
+  auto pool = std::make_shared<StepArenaPool>(cpu_allocator());
+  std::vector<void*> ptrs(num_allocs);
+  auto run_step = [&ptrs, num_allocs](Allocator* allocator) {
+    for (int i = 0; i < num_allocs; ++i) {
+      ptrs[i] =
+          allocator->AllocateRaw(Allocator::kAllocatorAlignment, 1024 * i + 1);
+      if (i > 0) allocator->DeallocateRaw(ptrs[i - 1]);
+    }
+    allocator->DeallocateRaw(ptrs[num_allocs - 1]);
+  };
+  for (int iter = 0; iter < iters; ++iter) {
+    if (use_arena) {
+      StepArenaAllocator* allocator = pool->Get();
+      run_step(allocator);
+      allocator->EndStep();
+    } else {
+      run_step(cpu_allocator());
+    }
+  }
+  if (use_arena) {
+    StepArenaPool::Stats stats = pool->GetStats();
+    testing::SetLabel(strings::StrCat("base allocs: ", stats.num_base_allocs,
+                                      " arena allocs: ",
+                                      stats.num_arena_allocs));
+  }
+}
+
+static void BM_CpuAllocatorStep(int iters, int num_allocs) {
+  BM_StepArenaAllocator(iters, num_allocs, /*use_arena=*/false);
+}
+static void BM_StepArenaStep(int iters, int num_allocs) {
+  BM_StepArenaAllocator(iters, num_allocs, /*use_arena=*/true);
+}
+
+BENCHMARK(BM_CpuAllocatorStep)->Arg(16)->Arg(256);
+BENCHMARK(BM_StepArenaStep)->Arg(16)->Arg(256);
+
+}  // namespace
+}  // namespace tensorflow
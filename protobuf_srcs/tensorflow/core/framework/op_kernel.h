@@ -658,6 +658,10 @@ class OpKernelContext {
 
     bool track_allocations = false;
     bool log_memory = false;
+
+    // If not null, serves allocations with default attributes in place of
+    // the device's allocator, e.g. from a preplanned per-step arena.
+    Allocator* step_allocator = nullptr;
     bool record_tensor_accesses = false;
 
     // Array indexed by output number for this node
@@ -48,6 +48,10 @@ class TensorDescription;
 class TensorProto;
 class Var;
 
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 namespace batch_util {
 Status CopyElementToSlice(Tensor element, Tensor* parent, int64 index);
 Status MaybeMoveSliceToElement(Tensor* parent, Tensor* element, int64 index);
@@ -350,14 +354,22 @@ class Tensor {
   /// the state of `*this` is unchanged.
   bool FromProto(const TensorProto& other) TF_MUST_USE_RESULT;
   bool FromProto(Allocator* a, const TensorProto& other) TF_MUST_USE_RESULT;
+  /// As above, but the contents of large tensors are converted in parallel on
+  /// the threads of `pool`, or on the calling thread if `pool` is null.
+  bool FromProto(Allocator* a, const TensorProto& other,
+                 thread::ThreadPool* pool) TF_MUST_USE_RESULT;
 
   /// \brief Fills in `proto` with `*this` tensor's content.
   ///
   /// `AsProtoField()` fills in the repeated field for `proto.dtype()`, while
   /// `AsProtoTensorContent()` encodes the content in `proto.tensor_content()`
-  /// in a compact form.
+  /// in a compact form. If `pool` is not null, the contents of large tensors
+  /// are converted in parallel on its threads.
   void AsProtoField(TensorProto* proto) const;
+  void AsProtoField(TensorProto* proto, thread::ThreadPool* pool) const;
   void AsProtoTensorContent(TensorProto* proto) const;
+  void AsProtoTensorContent(TensorProto* proto,
+                            thread::ThreadPool* pool) const;
 
   /// \brief Return the tensor data as an `Eigen::Tensor` with the type and
   /// sizes of this `Tensor`.
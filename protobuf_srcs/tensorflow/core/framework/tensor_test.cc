@@ -22,8 +22,10 @@ limitations under the License.
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/framework/variant_encode_decode.h"
 #include "tensorflow/core/framework/variant_tensor_data.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/math/math_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -340,6 +342,74 @@ TEST(Tensor_QInt32, Simple) {
   TestCopies<qint32>(t);
 }
 
+// Tensors of more than 1MB are converted to and from protos in parallel when
+// a thread pool is passed, with the same results as on the calling thread.
+template <typename T>
+void TestLargeCopies(int64 num_elements) {
+  Tensor t(DataTypeToEnum<T>::value, TensorShape({num_elements}));
+  auto flat = t.flat<T>();
+  for (int64 i = 0; i < num_elements; ++i) {
+    flat(i) = static_cast<T>(i % 251);
+  }
+  TestCopies<T>(t);
+
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  for (const bool content : {false, true}) {
+    LOG(INFO) << (content ? "AsProtoTensorContent()" : "AsProtoField()")
+              << " with a thread pool";
+    TensorProto proto;
+    TensorProto expected_proto;
+    if (content) {
+      t.AsProtoTensorContent(&proto, &pool);
+      t.AsProtoTensorContent(&expected_proto);
+    } else {
+      t.AsProtoField(&proto, &pool);
+      t.AsProtoField(&expected_proto);
+    }
+    EXPECT_EQ(expected_proto.SerializeAsString(), proto.SerializeAsString());
+    Tensor t2(t.dtype());
+    EXPECT_TRUE(t2.FromProto(cpu_allocator(), proto, &pool));
+    test::ExpectTensorEqual<T>(t, t2);
+  }
+}
+
+TEST(Tensor_Half, Large) { TestLargeCopies<Eigen::half>(1 << 20); }
+
+TEST(Tensor_Bfloat16, Large) { TestLargeCopies<bfloat16>(1 << 20); }
+
+TEST(Tensor_Float, Large) { TestLargeCopies<float>(1 << 19); }
+
+TEST(Tensor_Int64, Large) { TestLargeCopies<int64>(1 << 18); }
+
+TEST(Tensor_Int8, Large) { TestLargeCopies<int8>(1 << 21); }
+
+TEST(Tensor_Complex64, Large) { TestLargeCopies<complex64>(1 << 18); }
+
+TEST(Tensor_String, Large) {
+  Tensor t(DT_STRING, TensorShape({1 << 16}));
+  auto flat = t.flat<tstring>();
+  for (int64 i = 0; i < flat.size(); ++i) {
+    flat(i) = strings::StrCat("value_", i);
+  }
+  TestCopies<tstring>(t);
+}
+
+TEST(Tensor_Half, LargeFromFewerProtoValues) {
+  TensorProto proto;
+  proto.set_dtype(DT_HALF);
+  proto.mutable_tensor_shape()->add_dim()->set_size(1 << 20);
+  proto.add_half_val(Eigen::half(1.0f).x);
+  proto.add_half_val(Eigen::half(2.0f).x);
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  Tensor t;
+  ASSERT_TRUE(t.FromProto(cpu_allocator(), proto, &pool));
+  auto flat = t.flat<Eigen::half>();
+  EXPECT_EQ(Eigen::half(1.0f), flat(0));
+  for (int64 i = 1; i < flat.size(); ++i) {
+    ASSERT_EQ(Eigen::half(2.0f), flat(i)) << i;
+  }
+}
+
 class TensorReshapeTest : public ::testing::Test {
  protected:
   Tensor t;
@@ -1573,5 +1643,97 @@ static void BM_FromProtoCompressedZero(int iters, int size) {
 }
 BENCHMARK(BM_FromProtoCompressedZero)->Range(1, 1 << 20);
 
+// Converts a tensor of "size" elements of type T to a proto with
+// AsProtoField(), or with AsProtoTensorContent() if "content", on the threads
+// of "pool" if it is not null.
+template <typename T>
+static void BM_AsProto(int iters, int size, bool content,
+                       thread::ThreadPool* pool = nullptr) {
+  testing::StopTiming();
+  Tensor a(DataTypeToEnum<T>::value, TensorShape({size}));
+  a.flat<T>().setConstant(static_cast<T>(42));
+  testing::BytesProcessed(static_cast<int64>(iters) * size * sizeof(T));
+  testing::UseRealTime();
+  TensorProto p;
+  testing::StartTiming();
+  while (--iters) {
+    if (content) {
+      a.AsProtoTensorContent(&p, pool);
+    } else {
+      a.AsProtoField(&p, pool);
+    }
+  }
+  testing::StopTiming();
+}
+
+// Converts a proto of "size" elements of type T, from its typed field or
+// from its tensor_content if "content", to a tensor, on the threads of "pool"
+// if it is not null.
+template <typename T>
+static void BM_FromProtoOfType(int iters, int size, bool content,
+                               thread::ThreadPool* pool = nullptr) {
+  testing::StopTiming();
+  Tensor a(DataTypeToEnum<T>::value, TensorShape({size}));
+  a.flat<T>().setConstant(static_cast<T>(42));
+  TensorProto p;
+  if (content) {
+    a.AsProtoTensorContent(&p);
+  } else {
+    a.AsProtoField(&p);
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * size * sizeof(T));
+  testing::UseRealTime();
+  testing::StartTiming();
+  while (--iters) {
+    Tensor b;
+    ASSERT_TRUE(b.FromProto(cpu_allocator(), p, pool));
+  }
+  testing::StopTiming();
+}
+
+#define BM_PROTO_CONVERSION(T, NAME)                                   \
+  static void BM_AsProtoField_##NAME(int iters, int size) {            \
+    BM_AsProto<T>(iters, size, false);                                 \
+  }                                                                    \
+  static void BM_AsProtoTensorContent_##NAME(int iters, int size) {    \
+    BM_AsProto<T>(iters, size, true);                                  \
+  }                                                                    \
+  static void BM_FromProtoField_##NAME(int iters, int size) {          \
+    BM_FromProtoOfType<T>(iters, size, false);                         \
+  }                                                                    \
+  static void BM_FromProtoTensorContent_##NAME(int iters, int size) {  \
+    BM_FromProtoOfType<T>(iters, size, true);                          \
+  }                                                                    \
+  BENCHMARK(BM_AsProtoField_##NAME)->Range(1 << 10, 1 << 22);          \
+  BENCHMARK(BM_AsProtoTensorContent_##NAME)->Range(1 << 10, 1 << 22);  \
+  BENCHMARK(BM_FromProtoField_##NAME)->Range(1 << 10, 1 << 22);        \
+  BENCHMARK(BM_FromProtoTensorContent_##NAME)->Range(1 << 10, 1 << 22);
+
+BM_PROTO_CONVERSION(float, float);
+BM_PROTO_CONVERSION(double, double);
+BM_PROTO_CONVERSION(int32, int32);
+BM_PROTO_CONVERSION(int64, int64);
+BM_PROTO_CONVERSION(int8, int8);
+BM_PROTO_CONVERSION(Eigen::half, half);
+BM_PROTO_CONVERSION(bfloat16, bfloat16);
+
+#undef BM_PROTO_CONVERSION
+
+thread::ThreadPool* BenchmarkThreadPool() {
+  static thread::ThreadPool* pool =
+      new thread::ThreadPool(Env::Default(), "benchmark", 4);
+  return pool;
+}
+
+static void BM_AsProtoFieldParallel_float(int iters, int size) {
+  BM_AsProto<float>(iters, size, false, BenchmarkThreadPool());
+}
+BENCHMARK(BM_AsProtoFieldParallel_float)->Range(1 << 10, 1 << 22);
+
+static void BM_FromProtoFieldParallel_float(int iters, int size) {
+  BM_FromProtoOfType<float>(iters, size, false, BenchmarkThreadPool());
+}
+BENCHMARK(BM_FromProtoFieldParallel_float)->Range(1 << 10, 1 << 22);
+
 }  // namespace
 }  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
 #include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
@@ -51,6 +52,12 @@ namespace grappler {
 //   (1) FusedBatchNorm + <Activation>
 //   (2) FusedBatchNorm + SideInput + <Activation>
 //
+// SparseSegment{Sum,Mean,SqrtN} + ... -> _FusedSparseEmbeddingLookup
+//   (1) Unique + Gather + SparseSegment{Sum,Mean,SqrtN}
+//
+// BatchMatMul + ... -> _FusedMultiHeadAttention
+//   (1) BatchMatMul + <Mul> + <Add> + Softmax + BatchMatMul
+//
 // Both Conv2D and MatMul implemented as Tensor contraction (on CPU), so all the
 // patterns are "ContractionWith...".
 namespace {
@@ -58,6 +65,8 @@ namespace {
 constexpr char kFusedConv2D[] = "_FusedConv2D";
 constexpr char kFusedMatMul[] = "_FusedMatMul";
 constexpr char kFusedBatchNormEx[] = "_FusedBatchNormEx";
+constexpr char kFusedSparseEmbeddingLookup[] = "_FusedSparseEmbeddingLookup";
+constexpr char kFusedMultiHeadAttention[] = "_FusedMultiHeadAttention";
 
 constexpr char kDataFormat[] = "data_format";
 constexpr char kIsTraining[] = "is_training";
@@ -97,6 +106,32 @@ struct FusedBatchNormEx {
   int invalidated = kMissingIndex;
 };
 
+// SparseSegment{Sum,Mean,SqrtN} of the rows gathered for the unique ids.
+struct SparseEmbeddingLookup {
+  SparseEmbeddingLookup() = default;
+  SparseEmbeddingLookup(int unique, int gather, int reduction)
+      : unique(unique), gather(gather), reduction(reduction) {}
+
+  int unique = kMissingIndex;
+  int gather = kMissingIndex;
+  int reduction = kMissingIndex;
+};
+
+// BatchMatMul of the Softmax of the optionally scaled and biased scores of
+// the query and key, BatchMatMul(query, key, adj_y=true), with the value.
+struct MultiHeadAttention {
+  MultiHeadAttention() = default;
+
+  int scores = kMissingIndex;
+  int mul = kMissingIndex;
+  int bias_add = kMissingIndex;
+  int softmax = kMissingIndex;
+  int output = kMissingIndex;
+  // Input of the bias_add that reads the bias.
+  int bias_port = 0;
+  float scale = 1.0f;
+};
+
 // Contraction node followed by a BiasAdd.
 struct ContractionWithBiasAdd {
   ContractionWithBiasAdd() = default;
@@ -845,6 +880,188 @@ bool FindFusedBatchNormEx(const RemapperContext& ctx, int node_index,
   return false;
 }
 
+bool FindSparseEmbeddingLookup(const RemapperContext& ctx, int node_index,
+                               SparseEmbeddingLookup* matched) {
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  if (HasControlFaninOrFanout(*node_view)) return false;
+
+  // Root of the pattern must be a SparseSegment reduction of floats on CPU.
+  const auto* node_def = node_view->node();
+  if (node_def->op() != "SparseSegmentSum" &&
+      node_def->op() != "SparseSegmentMean" &&
+      node_def->op() != "SparseSegmentSqrtN")
+    return false;
+  if (!NodeIsOnCpu(node_def) || !HasDataType(node_def, DT_FLOAT)) return false;
+  if (node_view->NumRegularFanins() != 3) return false;
+
+  // Data of the reduction must be a Gather along the first dimension.
+  const auto& regular_fanin_0 = node_view->GetRegularFanin(0);
+  const auto* gather_node_view = regular_fanin_0.node_view();
+  const auto* gather_node_def = gather_node_view->node();
+  if (regular_fanin_0.index() != 0) return false;
+  if (gather_node_def->op() == "GatherV2") {
+    int batch_dims = 0;
+    if (TryGetNodeAttr(*gather_node_def, "batch_dims", &batch_dims) &&
+        batch_dims != 0)
+      return false;
+    if (gather_node_view->NumRegularFanins() != 3) return false;
+    const auto* axis_node_def =
+        gather_node_view->GetRegularFanin(2).node_view()->node();
+    Tensor axis;
+    if (!IsConstant(*axis_node_def) ||
+        !GetNodeAttr(*axis_node_def, "value", &axis).ok() ||
+        axis.NumElements() != 1)
+      return false;
+    const int64 axis_value = axis.dtype() == DT_INT32
+                                 ? axis.flat<int32>()(0)
+                                 : axis.flat<int64>()(0);
+    if (axis_value != 0) return false;
+  } else if (gather_node_def->op() != "Gather") {
+    return false;
+  }
+  if (!HasDataType(gather_node_def, DT_FLOAT, "Tparams") ||
+      HasControlFaninOrFanout(*gather_node_view) ||
+      !HasAtMostOneFanoutAtPort0(*gather_node_view) ||
+      IsInPreserveSet(ctx, gather_node_def))
+    return false;
+
+  // The gathered rows and the indices of the reduction must be the unique ids
+  // and their positions computed by the same Unique.
+  const auto& gather_regular_fanin_1 = gather_node_view->GetRegularFanin(1);
+  const auto& regular_fanin_1 = node_view->GetRegularFanin(1);
+  const auto* unique_node_view = gather_regular_fanin_1.node_view();
+  const auto* unique_node_def = unique_node_view->node();
+  if (unique_node_def->op() != "Unique" ||
+      gather_regular_fanin_1.index() != 0 ||
+      regular_fanin_1.node_index() != unique_node_view->node_index() ||
+      regular_fanin_1.index() != 1)
+    return false;
+  const DataType ids_dtype = GetDataTypeFromAttr(*unique_node_def, "T");
+  if (ids_dtype != DT_INT32 && ids_dtype != DT_INT64) return false;
+  if (HasControlFaninOrFanout(*unique_node_view) ||
+      unique_node_view->GetRegularFanout(0).size() != 1 ||
+      unique_node_view->GetRegularFanout(1).size() != 1 ||
+      IsInPreserveSet(ctx, unique_node_def))
+    return false;
+
+  // We successfully found a Unique+Gather+SparseSegment{Sum,Mean,SqrtN}.
+  *matched = SparseEmbeddingLookup(unique_node_view->node_index(),
+                                   gather_node_view->node_index(), node_index);
+
+  return true;
+}
+
+bool FindMultiHeadAttention(const RemapperContext& ctx, int node_index,
+                            MultiHeadAttention* matched) {
+  // BatchMatMul of floats on CPU that does not transpose its first input.
+  const auto is_batch_matmul = [](const utils::MutableNodeView& node_view,
+                                  bool adj_y) -> bool {
+    const auto* node_def = node_view.node();
+    if (node_def->op() != "BatchMatMul" && node_def->op() != "BatchMatMulV2")
+      return false;
+    bool node_adj_x = false;
+    bool node_adj_y = false;
+    TryGetNodeAttr(*node_def, "adj_x", &node_adj_x);
+    TryGetNodeAttr(*node_def, "adj_y", &node_adj_y);
+    return !node_adj_x && node_adj_y == adj_y && NodeIsOnCpu(node_def) &&
+           HasDataType(node_def, DT_FLOAT) &&
+           node_view.NumRegularFanins() == 2;
+  };
+  // Node of floats whose output is only used by the next node of the pattern.
+  const auto is_fusible = [&ctx](const utils::MutableNodeView& node_view) {
+    return HasDataType(node_view.node(), DT_FLOAT) &&
+           !HasControlFaninOrFanout(node_view) &&
+           HasAtMostOneFanoutAtPort0(node_view) &&
+           !IsInPreserveSet(ctx, node_view.node());
+  };
+
+  // Root of the pattern must be the product of the probabilities with the
+  // value.
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  if (HasControlFaninOrFanout(*node_view)) return false;
+  if (!is_batch_matmul(*node_view, /*adj_y=*/false)) return false;
+
+  const auto* softmax_node_view = node_view->GetRegularFanin(0).node_view();
+  if (!IsSoftmax(*softmax_node_view->node()) ||
+      !is_fusible(*softmax_node_view))
+    return false;
+
+  // Scores may have a bias added, on either side of the Add.
+  MultiHeadAttention attention;
+  const auto* scores_node_view =
+      softmax_node_view->GetRegularFanin(0).node_view();
+  if (IsAdd(*scores_node_view->node())) {
+    const auto* add_node_view = scores_node_view;
+    if (!is_fusible(*add_node_view) || add_node_view->NumRegularFanins() != 2)
+      return false;
+    // The bias is the input that is not computed from the query and key.
+    const auto* add_fanin_0 = add_node_view->GetRegularFanin(0).node_view();
+    if (IsMul(*add_fanin_0->node()) || is_batch_matmul(*add_fanin_0, true)) {
+      attention.bias_port = 1;
+    }
+    scores_node_view =
+        add_node_view->GetRegularFanin(1 - attention.bias_port).node_view();
+
+    // The bias may broadcast against the batch dimensions of the scores, but
+    // the fused op does not support a bias that broadcasts the scores of a
+    // single query or key into more rows or columns.
+    const auto& props =
+        ctx.graph_properties.GetInputProperties(add_node_view->node()->name());
+    if (props.size() != 2) return false;
+    const auto& bias_shape = props[attention.bias_port].shape();
+    const auto& scores_shape = props[1 - attention.bias_port].shape();
+    if (bias_shape.unknown_rank() || scores_shape.unknown_rank() ||
+        scores_shape.dim_size() < 2)
+      return false;
+    const int bias_rank = bias_shape.dim_size();
+    const int scores_rank = scores_shape.dim_size();
+    for (int i = 1; i <= std::min(bias_rank, 2); ++i) {
+      const int64 bias_dim = bias_shape.dim(bias_rank - i).size();
+      const int64 scores_dim = scores_shape.dim(scores_rank - i).size();
+      if (bias_dim != 1 && scores_dim <= 1 &&
+          (bias_dim != scores_dim || bias_dim == -1))
+        return false;
+    }
+    attention.bias_add = add_node_view->node_index();
+  }
+
+  // Scores may be scaled by a constant scalar, on either side of the Mul.
+  if (IsMul(*scores_node_view->node())) {
+    const auto* mul_node_view = scores_node_view;
+    if (!is_fusible(*mul_node_view) || mul_node_view->NumRegularFanins() != 2)
+      return false;
+    scores_node_view = nullptr;
+    for (int port = 0; port < 2; ++port) {
+      const auto* scale_node_def =
+          mul_node_view->GetRegularFanin(port).node_view()->node();
+      Tensor scale;
+      if (IsConstant(*scale_node_def) &&
+          GetNodeAttr(*scale_node_def, "value", &scale).ok() &&
+          scale.dtype() == DT_FLOAT && scale.NumElements() == 1 &&
+          scale.dims() <= 2) {
+        attention.scale = scale.flat<float>()(0);
+        scores_node_view =
+            mul_node_view->GetRegularFanin(1 - port).node_view();
+        break;
+      }
+    }
+    if (scores_node_view == nullptr) return false;
+    attention.mul = mul_node_view->node_index();
+  }
+
+  if (!is_batch_matmul(*scores_node_view, /*adj_y=*/true) ||
+      !is_fusible(*scores_node_view))
+    return false;
+
+  // We successfully found a BatchMatMul+<Mul>+<Add>+Softmax+BatchMatMul.
+  attention.scores = scores_node_view->node_index();
+  attention.softmax = softmax_node_view->node_index();
+  attention.output = node_index;
+  *matched = attention;
+
+  return true;
+}
+
 void CopyConv2DAttributes(const NodeDef& conv2d, NodeDef* fused_conv2d) {
   DCHECK(IsConv2D(conv2d)) << "Input node must be a Conv2D";
 
@@ -1453,10 +1670,106 @@ Status AddBatchNormNodes(RemapperContext* ctx, const FusedBatchNorm& matched) {
   return mutation->Apply();
 }
 
+Status AddFusedSparseEmbeddingLookupNode(RemapperContext* ctx,
+                                         const SparseEmbeddingLookup& matched,
+                                         std::vector<bool>* invalidated_nodes,
+                                         std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& unique = graph->node(matched.unique);
+  const NodeDef& gather = graph->node(matched.gather);
+  const NodeDef& reduction = graph->node(matched.reduction);
+
+  VLOG(2) << "Fuse Unique and " << gather.op() << " with " << reduction.op()
+          << ": unique=" << unique.name() << " gather=" << gather.name()
+          << " reduction=" << reduction.name();
+
+  NodeDef fused_op;
+  fused_op.set_op(kFusedSparseEmbeddingLookup);
+  fused_op.set_name(reduction.name());
+  fused_op.set_device(reduction.device());
+
+  fused_op.add_input(gather.input(0));     // 0: params
+  fused_op.add_input(unique.input(0));     // 1: ids
+  fused_op.add_input(reduction.input(2));  // 2: segment_ids
+
+  string combiner = "sum";
+  if (reduction.op() == "SparseSegmentMean") {
+    combiner = "mean";
+  } else if (reduction.op() == "SparseSegmentSqrtN") {
+    combiner = "sqrtn";
+  }
+  auto* attrs = fused_op.mutable_attr();
+  (*attrs)["T"] = reduction.attr().at("T");
+  (*attrs)["Tidx"] = unique.attr().at("T");
+  SetAttrValue(0, &(*attrs)["num_weights"]);
+  SetAttrValue(combiner, &(*attrs)["combiner"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.reduction] = true;
+  (*nodes_to_delete)[matched.gather] = true;
+  (*nodes_to_delete)[matched.unique] = true;
+
+  return Status::OK();
+}
+
+Status AddFusedMultiHeadAttentionNode(RemapperContext* ctx,
+                                      const MultiHeadAttention& matched,
+                                      std::vector<bool>* invalidated_nodes,
+                                      std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& scores = graph->node(matched.scores);
+  const NodeDef& output = graph->node(matched.output);
+
+  VLOG(2) << "Fuse multi-head attention: scores=" << scores.name()
+          << " output=" << output.name();
+
+  NodeDef fused_op;
+  fused_op.set_op(kFusedMultiHeadAttention);
+  fused_op.set_name(output.name());
+  fused_op.set_device(output.device());
+
+  fused_op.add_input(scores.input(0));  // 0: query
+  fused_op.add_input(scores.input(1));  // 1: key
+  fused_op.add_input(output.input(1));  // 2: value
+  int num_bias = 0;
+  if (matched.bias_add != kMissingIndex) {
+    const NodeDef& bias_add = graph->node(matched.bias_add);
+    fused_op.add_input(bias_add.input(matched.bias_port));  // 3: bias
+    num_bias = 1;
+  }
+
+  auto* attrs = fused_op.mutable_attr();
+  (*attrs)["T"] = output.attr().at("T");
+  SetAttrValue(num_bias, &(*attrs)["num_bias"]);
+  SetAttrValue(matched.scale, &(*attrs)["scale"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.output] = true;
+  (*nodes_to_delete)[matched.softmax] = true;
+  (*nodes_to_delete)[matched.scores] = true;
+  if (matched.mul != kMissingIndex) (*nodes_to_delete)[matched.mul] = true;
+  if (matched.bias_add != kMissingIndex) {
+    (*nodes_to_delete)[matched.bias_add] = true;
+  }
+
+  return Status::OK();
+}
+
 // Check if a node is a candidate to one of the patterns that require inferred
 // shapes:
 //   (1) Splitting FusedBatchNorm into primitives.
 //   (2) Fusing side input and/or activation into FusedBatchNorm.
+//   (3) Fusing multi-head attention with a bias.
 bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
   // Candidate for a FusedBatchNorm splitting.
   const auto* node_view = ctx.graph_view.GetNode(node_index);
@@ -1502,7 +1815,16 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
     return false;
   };
 
-  return is_batch_norm_candidate() || is_batch_norm_fusion_candidate();
+  // Candidate for a multi-head attention fusion.
+  const auto is_attention_candidate = [&]() -> bool {
+    if (node_def->op() != "BatchMatMul" && node_def->op() != "BatchMatMulV2")
+      return false;
+    if (node_view->NumRegularFanins() < 1) return false;
+    return IsSoftmax(*node_view->GetRegularFanin(0).node_view()->node());
+  };
+
+  return is_batch_norm_candidate() || is_batch_norm_fusion_candidate() ||
+         is_attention_candidate();
 }
 
 }  // namespace
@@ -1620,6 +1942,16 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
 #endif  // !INTEL_MKL
 
+    // Remap Unique+Gather+SparseSegment{Sum,Mean,SqrtN} into the
+    // _FusedSparseEmbeddingLookup.
+    SparseEmbeddingLookup sparse_embedding_lookup;
+    if (allow_non_differentiable_rewrites &&
+        FindSparseEmbeddingLookup(ctx, i, &sparse_embedding_lookup)) {
+      TF_RETURN_IF_ERROR(AddFusedSparseEmbeddingLookupNode(
+          &ctx, sparse_embedding_lookup, &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
+
     // Infer properties lazily in case they are not needed.
     if (!ctx.inferred_graph_properties && RequiresInferredShapes(ctx, i)) {
       const bool assume_valid_feeds = opt_level_ == RewriterConfig::AGGRESSIVE;
@@ -1631,6 +1963,16 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       ctx.inferred_graph_properties = true;
     }
 
+    // Remap BatchMatMul+<Mul>+<Add>+Softmax+BatchMatMul into the
+    // _FusedMultiHeadAttention.
+    MultiHeadAttention multi_head_attention;
+    if (allow_non_differentiable_rewrites &&
+        FindMultiHeadAttention(ctx, i, &multi_head_attention)) {
+      TF_RETURN_IF_ERROR(AddFusedMultiHeadAttentionNode(
+          &ctx, multi_head_attention, &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
+
     // Remap FusedBatchNorm+<SideInput>+<Activation> into the _FusedBatchNormEx.
     FusedBatchNormEx fused_batch_norm_ex;
     if (allow_non_differentiable_rewrites &&
@@ -851,5 +851,178 @@ TEST_F(RemapperTest, FuseConv2DWithSqueezeAndBias) {
   test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
 }
 
+TEST_F(RemapperTest, FuseSparseEmbeddingLookup) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto params = Placeholder(s.WithOpName("params"), DT_FLOAT,
+                            ops::Placeholder::Shape({16, 8}));
+  auto ids = Placeholder(s.WithOpName("ids"), DT_INT64,
+                         ops::Placeholder::Shape({6}));
+  auto segment_ids = ops::Const(s.WithOpName("segment_ids"),
+                                {0, 0, 1, 1, 1, 3}, {6});
+
+  auto unique = ops::Unique(s.WithOpName("unique"), ids);
+  auto axis = ops::Const(s.WithOpName("axis"), 0);
+  auto gather = ops::GatherV2(s.WithOpName("gather"), params, unique.y, axis);
+  auto reduction = ops::SparseSegmentMean(s.WithOpName("reduction"), gather,
+                                          unique.idx, segment_ids);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), reduction);
+
+  auto params_t = GenerateRandomTensor<DT_FLOAT>({16, 8});
+  auto ids_t = test::AsTensor<int64>({3, 15, 3, 0, 7, 15});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"params", params_t}, {"ids", ids_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "unique");
+    EXPECT_NE(node.name(), "gather");
+    if (node.name() == "reduction") {
+      EXPECT_EQ(node.op(), "_FusedSparseEmbeddingLookup");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "params");
+      EXPECT_EQ(node.input(1), "ids");
+      EXPECT_EQ(node.input(2), "segment_ids");
+      EXPECT_EQ(node.attr().at("Tidx").type(), DT_INT64);
+      EXPECT_EQ(node.attr().at("combiner").s(), "mean");
+      EXPECT_EQ(node.attr().at("num_weights").i(), 0);
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
+}
+
+TEST_F(RemapperTest, FuseMultiHeadAttention) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 3, 5, 8}));
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                         ops::Placeholder::Shape({2, 3, 7, 8}));
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 3, 7, 4}));
+  auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT,
+                          ops::Placeholder::Shape({2, 1, 1, 7}));
+  auto scale = ops::Const(s.WithOpName("scale"), 0.35f);
+
+  auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::AdjY(true));
+  auto scaled = ops::Mul(s.WithOpName("scaled"), scores, scale);
+  auto masked = ops::AddV2(s.WithOpName("masked"), mask, scaled);
+  auto probabilities = ops::Softmax(s.WithOpName("probabilities"), masked);
+  auto attention =
+      ops::BatchMatMulV2(s.WithOpName("attention"), probabilities, value);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+  auto query_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 5, 8});
+  auto key_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 7, 8});
+  auto value_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 7, 4});
+  auto mask_t = GenerateRandomTensor<DT_FLOAT>({2, 1, 1, 7});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"query", query_t},
+               {"key", key_t},
+               {"value", value_t},
+               {"mask", mask_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "scores");
+    EXPECT_NE(node.name(), "scaled");
+    EXPECT_NE(node.name(), "masked");
+    EXPECT_NE(node.name(), "probabilities");
+    if (node.name() == "attention") {
+      EXPECT_EQ(node.op(), "_FusedMultiHeadAttention");
+      ASSERT_EQ(node.input_size(), 4);
+      EXPECT_EQ(node.input(0), "query");
+      EXPECT_EQ(node.input(1), "key");
+      EXPECT_EQ(node.input(2), "value");
+      EXPECT_EQ(node.input(3), "mask");
+      EXPECT_EQ(node.attr().at("num_bias").i(), 1);
+      EXPECT_FLOAT_EQ(node.attr().at("scale").f(), 0.35f);
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, DoNotFuseAttentionWithBroadcastingBias) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  // A single query whose scores the bias broadcasts into 5 rows.
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 1, 8}));
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                         ops::Placeholder::Shape({2, 7, 8}));
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 7, 4}));
+  auto bias = Placeholder(s.WithOpName("bias"), DT_FLOAT,
+                          ops::Placeholder::Shape({5, 7}));
+
+  auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::AdjY(true));
+  auto biased = ops::AddV2(s.WithOpName("biased"), scores, bias);
+  auto probabilities = ops::Softmax(s.WithOpName("probabilities"), biased);
+  auto attention =
+      ops::BatchMatMulV2(s.WithOpName("attention"), probabilities, value);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.op(), "_FusedMultiHeadAttention");
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
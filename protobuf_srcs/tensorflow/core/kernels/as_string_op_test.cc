@@ -0,0 +1,106 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class AsStringOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(DataType dtype, int width, const string& fill, int precision) {
+    TF_ASSERT_OK(NodeDefBuilder("as_string", "AsString")
+                     .Input(FakeInput(dtype))
+                     .Attr("width", width)
+                     .Attr("fill", fill)
+                     .Attr("precision", precision)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(AsStringOpTest, Int64) {
+  MakeOp(DT_INT64, -1, "", -1);
+  AddInputFromArray<int64>(TensorShape({4}),
+                           {0, -7, 1234567890123, kint64min});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_STRING, TensorShape({4}));
+  test::FillValues<tstring>(
+      &expected, {"0", "-7", "1234567890123", "-9223372036854775808"});
+  test::ExpectTensorEqual<tstring>(expected, *GetOutput(0));
+}
+
+TEST_F(AsStringOpTest, Int32WithWidth) {
+  MakeOp(DT_INT32, 4, "0", -1);
+  AddInputFromArray<int32>(TensorShape({3}), {5, -12, 123456});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_STRING, TensorShape({3}));
+  test::FillValues<tstring>(&expected, {"0005", "-012", "123456"});
+  test::ExpectTensorEqual<tstring>(expected, *GetOutput(0));
+}
+
+TEST_F(AsStringOpTest, FloatWithPrecision) {
+  MakeOp(DT_FLOAT, -1, "", 2);
+  AddInputFromArray<float>(TensorShape({3}), {0.0f, -1.005f, 1e20f});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_STRING, TensorShape({3}));
+  test::FillValues<tstring>(
+      &expected, {"0.00", "-1.00", "100000002004087734272.00"});
+  test::ExpectTensorEqual<tstring>(expected, *GetOutput(0));
+}
+
+template <typename T>
+static Graph* AsString(int num_values) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DataTypeToEnum<T>::value, TensorShape({num_values}));
+  input.flat<T>().setRandom();
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "AsString")
+                  .Input(test::graph::Constant(g, input))
+                  .Finalize(g, &node));
+  return g;
+}
+
+template <typename T>
+static void BM_AsString(int iters, int num_values) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_values);
+  testing::UseRealTime();
+  Graph* g = AsString<T>(num_values);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_AsStringFloat(int iters, int num_values) {
+  BM_AsString<float>(iters, num_values);
+}
+static void BM_AsStringInt64(int iters, int num_values) {
+  BM_AsString<int64>(iters, num_values);
+}
+
+BENCHMARK(BM_AsStringFloat)->Arg(64)->Arg(4096)->Arg(65536);
+BENCHMARK(BM_AsStringInt64)->Arg(64)->Arg(4096)->Arg(65536);
+
+}  // namespace
+}  // namespace tensorflow
@@ -176,6 +176,11 @@ class BasicBatchScheduler : public BatchScheduler<TaskType> {
     // parameter.
     int max_enqueued_batches = 10;
 
+    // If set, only tasks with the same key are batched together, e.g. tasks
+    // whose bucketed sequence lengths are equal. See
+    // SharedBatchScheduler::QueueOptions::bucket_key_fn.
+    std::function<int64(const TaskType&)> bucket_key_fn;
+
     // The following options are typically only overridden by test code.
 
     // The environment to use.
@@ -231,6 +236,7 @@ Status BasicBatchScheduler<TaskType>::Create(
       options.batch_timeout_micros;
   shared_scheduler_queue_options.max_enqueued_batches =
       options.max_enqueued_batches;
+  shared_scheduler_queue_options.bucket_key_fn = options.bucket_key_fn;
   std::unique_ptr<BatchScheduler<TaskType>> shared_scheduler_queue;
   TF_RETURN_IF_ERROR(shared_scheduler->AddQueue(shared_scheduler_queue_options,
                                                 process_batch_callback,
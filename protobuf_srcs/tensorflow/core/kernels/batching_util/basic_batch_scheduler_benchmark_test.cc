@@ -14,10 +14,14 @@ limitations under the License.
 ==============================================================================*/
 
 // Benchmarks for performance (throughput and latency) of BasicBatchScheduler
-// under various rates of task injection.
+// under various rates of task injection, and for the padding that batches of
+// variable-length tasks need with and without bucketing by length.
 
 #include "tensorflow/core/kernels/batching_util/basic_batch_scheduler.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -387,6 +391,98 @@ BENCHMARK(ThroughputBM_LargeTimeout)
     ->Arg(32)
     ->Arg(64);
 
+// A task with a sequence length, to which a batch pads its tasks.
+class SequenceBatchTask : public BatchTask {
+ public:
+  explicit SequenceBatchTask(int64 length)
+      : start_time_micros_(Env::Default()->NowMicros()), length_(length) {}
+
+  SequenceBatchTask(const SequenceBatchTask&) = delete;
+  SequenceBatchTask& operator=(const SequenceBatchTask&) = delete;
+
+  ~SequenceBatchTask() override = default;
+
+  size_t size() const override { return 1; }
+
+  uint64 start_time_micros() const { return start_time_micros_; }
+
+  int64 length() const { return length_; }
+
+ private:
+  // The time at which the task was created, in microseconds.
+  const uint64 start_time_micros_;
+
+  const int64 length_;
+};
+
+// Injects tasks with uniformly distributed lengths into a BasicBatchScheduler
+// that buckets them by 'bucket_width' (or not at all if it is 0), and reports
+// the share of padding in the padded batches and the mean task latency.
+static void PaddingBM(int iters, int bucket_width) {
+  testing::StopTiming();
+  const int kNumTasksPerIteration = 10 * 1000;
+  const int64 kMaxLength = 128;
+
+  mutex mu;
+  int64 num_values = 0;
+  int64 num_padded_values = 0;
+  uint64 total_latency_micros = 0;
+  auto process_batch_callback =
+      [&](std::unique_ptr<Batch<SequenceBatchTask>> batch) {
+        const uint64 batch_completion_time = Env::Default()->NowMicros();
+        int64 max_length = 0;
+        mutex_lock l(mu);
+        for (int i = 0; i < batch->num_tasks(); ++i) {
+          const SequenceBatchTask& task = batch->task(i);
+          max_length = std::max(max_length, task.length());
+          num_values += task.length();
+          total_latency_micros +=
+              batch_completion_time - task.start_time_micros();
+        }
+        num_padded_values += batch->num_tasks() * max_length;
+      };
+
+  BasicBatchScheduler<SequenceBatchTask>::Options scheduler_options;
+  scheduler_options.max_batch_size = 32;
+  scheduler_options.batch_timeout_micros = 1 * 1000;
+  scheduler_options.num_batch_threads = 4;
+  scheduler_options.max_enqueued_batches = INT_MAX;  // Unbounded queue.
+  if (bucket_width > 0) {
+    scheduler_options.bucket_key_fn =
+        [bucket_width](const SequenceBatchTask& task) {
+          return task.length() / bucket_width;
+        };
+  }
+  std::unique_ptr<BasicBatchScheduler<SequenceBatchTask>> scheduler;
+  TF_CHECK_OK(BasicBatchScheduler<SequenceBatchTask>::Create(
+      scheduler_options, process_batch_callback, &scheduler));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+
+  testing::ItemsProcessed(iters * kNumTasksPerIteration);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < kNumTasksPerIteration; ++j) {
+      auto task = std::unique_ptr<SequenceBatchTask>(
+          new SequenceBatchTask(1 + rnd.Uniform(kMaxLength)));
+      TF_CHECK_OK(scheduler->Schedule(&task));
+    }
+  }
+
+  // Wait for the scheduler to process all tasks.
+  scheduler.reset();
+  testing::StopTiming();
+
+  mutex_lock l(mu);
+  testing::SetLabel(strings::StrCat(
+      "padding: ",
+      100.0 * (num_padded_values - num_values) / num_padded_values,
+      "%, mean latency: ",
+      total_latency_micros / (iters * kNumTasksPerIteration), "us"));
+}
+BENCHMARK(PaddingBM)->Arg(0)->Arg(8)->Arg(32);
+
 static void RunLatencyBenchmark(int64 task_injection_interval_micros,
                                 int64 batch_timeout_micros) {
   BasicBatchScheduler<BenchmarkBatchTask>::Options scheduler_options;
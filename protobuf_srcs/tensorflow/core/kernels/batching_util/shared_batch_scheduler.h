@@ -21,6 +21,7 @@ limitations under the License.
 #include <deque>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -160,6 +161,16 @@ class SharedBatchScheduler
     // See the class documentation above for guidelines on how to tune this
     // parameter.
     size_t max_enqueued_batches = 10;
+
+    // If set, tasks are grouped by the key this function returns for them,
+    // e.g. a bucketed sequence length, and each batch only contains tasks with
+    // the same key. Each key has its own open batch, whose timeout starts when
+    // its first task is added, so that tasks of variable-length models are
+    // only padded to the length of similar tasks. The open batches count
+    // toward 'max_enqueued_batches'.
+    //
+    // If unset, tasks are batched in the order they are submitted.
+    std::function<int64(const TaskType&)> bucket_key_fn;
   };
   Status AddQueue(const QueueOptions& options,
                   std::function<void(std::unique_ptr<Batch<TaskType>>)>
@@ -226,6 +237,11 @@ namespace internal {
 // closed. If the front-most batch is open (i.e. the queue contains only one
 // batch) and has reached the timeout, it is immediately closed and returned;
 // otherwise no batch is returned for the request.
+//
+// If 'options_.bucket_key_fn' is set, submitted tasks are instead added to the
+// open batch of their bucket, which is closed and inserted in front of the
+// back-most batch when it doesn't have room, or when a pull request finds it
+// has reached the timeout. The back-most batch then remains empty.
 template <typename TaskType>
 class Queue {
  public:
@@ -283,10 +299,38 @@ class Queue {
   // fresh open batch behind it.
   void StartNewBatch() EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
-  // Determines whether the open batch residing at the back of 'batches_' is
-  // currently schedulable.
+  // An open batch of tasks with the same bucket key.
+  struct Bucket {
+    std::unique_ptr<Batch<TaskType>> batch;
+
+    // The time at which the first task was added to 'batch'.
+    uint64 start_time_micros;
+  };
+  using BucketMap = std::map<int64, Bucket>;
+
+  // Adds 'task' to the open batch of its bucket, starting a new one if there
+  // is none or it doesn't have room.
+  Status ScheduleInBucket(std::unique_ptr<TaskType>* task)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Closes the open batch of 'bucket', and inserts it in front of the open
+  // batch residing at the back of 'batches_'.
+  void CloseBucket(typename BucketMap::iterator bucket)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Closes the schedulable bucket whose first task was added the earliest.
+  void CloseOldestSchedulableBucket() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Determines whether the open batch residing at the back of 'batches_', or
+  // the open batch of any bucket, is currently schedulable.
   bool IsOpenBatchSchedulable() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Determines whether the open 'batch', whose first task was added at
+  // 'start_time_micros', is currently schedulable.
+  bool IsBatchSchedulable(const Batch<TaskType>& batch,
+                          uint64 start_time_micros) const
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   const typename SharedBatchScheduler<TaskType>::QueueOptions options_;
 
   // The environment to use.
@@ -314,6 +358,9 @@ class Queue {
   // in 'batches_'. Valid iff that batch contains at least one task.
   uint64 open_batch_start_time_micros_ GUARDED_BY(mu_);
 
+  // The open batches by bucket key, if 'options_.bucket_key_fn' is set.
+  BucketMap buckets_ GUARDED_BY(mu_);
+
   // Whether this queue contains a batch that is eligible to be scheduled. Used
   // to keep track of when to call 'schedulable_batch_callback_'.
   bool schedulable_batch_ GUARDED_BY(mu_) = false;
@@ -542,18 +589,23 @@ Status Queue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
 
     DCHECK(!closed_);
 
-    if (batches_.back()->size() + (*task)->size() > options_.max_batch_size) {
-      if (batches_.size() >= options_.max_enqueued_batches) {
-        return errors::Unavailable(
-            "The batch scheduling queue to which this task was submitted is "
-            "full");
+    if (options_.bucket_key_fn) {
+      TF_RETURN_IF_ERROR(ScheduleInBucket(task));
+    } else {
+      if (batches_.back()->size() + (*task)->size() >
+          options_.max_batch_size) {
+        if (batches_.size() >= options_.max_enqueued_batches) {
+          return errors::Unavailable(
+              "The batch scheduling queue to which this task was submitted is "
+              "full");
+        }
+        StartNewBatch();
       }
-      StartNewBatch();
-    }
-    if (batches_.back()->empty()) {
-      open_batch_start_time_micros_ = env_->NowMicros();
+      if (batches_.back()->empty()) {
+        open_batch_start_time_micros_ = env_->NowMicros();
+      }
+      batches_.back()->AddTask(std::move(*task));
     }
-    batches_.back()->AddTask(std::move(*task));
 
     if (!schedulable_batch_) {
       if (batches_.size() > 1 || IsOpenBatchSchedulable()) {
@@ -577,12 +629,25 @@ size_t Queue<TaskType>::NumEnqueuedTasks() const {
   for (const auto& batch : batches_) {
     num_enqueued_tasks += batch->num_tasks();
   }
+  for (const auto& entry : buckets_) {
+    num_enqueued_tasks += entry.second.batch->num_tasks();
+  }
   return num_enqueued_tasks;
 }
 
 template <typename TaskType>
 size_t Queue<TaskType>::SchedulingCapacity() const {
   mutex_lock l(mu_);
+  if (options_.bucket_key_fn) {
+    // The capacity of the open batches assumes tasks fall into their buckets.
+    size_t capacity = (options_.max_enqueued_batches - (batches_.size() - 1) -
+                       buckets_.size()) *
+                      options_.max_batch_size;
+    for (const auto& entry : buckets_) {
+      capacity += options_.max_batch_size - entry.second.batch->size();
+    }
+    return capacity;
+  }
   const int num_new_batches_schedulable =
       options_.max_enqueued_batches - batches_.size();
   const int open_batch_capacity =
@@ -600,9 +665,13 @@ std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
   {
     mutex_lock l(mu_);
 
-    // Consider closing the open batch at this time, to schedule it.
+    // Consider closing an open batch at this time, to schedule it.
     if (batches_.size() == 1 && IsOpenBatchSchedulable()) {
-      StartNewBatch();
+      if (options_.bucket_key_fn) {
+        CloseOldestSchedulableBucket();
+      } else {
+        StartNewBatch();
+      }
     }
 
     if (batches_.size() >= 2) {
@@ -658,7 +727,7 @@ void Queue<TaskType>::CloseAndWaitUntilEmpty() {
 template <typename TaskType>
 bool Queue<TaskType>::IsEmptyInternal() const {
   return num_batches_being_processed_ == 0 && batches_.size() == 1 &&
-         batches_.back()->empty();
+         batches_.back()->empty() && buckets_.empty();
 }
 
 template <typename TaskType>
@@ -667,15 +736,77 @@ void Queue<TaskType>::StartNewBatch() {
   batches_.emplace_back(new Batch<TaskType>);
 }
 
+template <typename TaskType>
+Status Queue<TaskType>::ScheduleInBucket(std::unique_ptr<TaskType>* task) {
+  const int64 bucket_key = options_.bucket_key_fn(**task);
+  auto bucket = buckets_.find(bucket_key);
+  if (bucket == buckets_.end() ||
+      bucket->second.batch->size() + (*task)->size() >
+          options_.max_batch_size) {
+    // The closed batches, and the open batches of the buckets.
+    const size_t num_batches = batches_.size() - 1 + buckets_.size();
+    if (num_batches >= options_.max_enqueued_batches) {
+      return errors::Unavailable(
+          "The batch scheduling queue to which this task was submitted is "
+          "full");
+    }
+    if (bucket != buckets_.end()) {
+      CloseBucket(bucket);
+    }
+    bucket = buckets_
+                 .emplace(bucket_key,
+                          Bucket{std::unique_ptr<Batch<TaskType>>(
+                                     new Batch<TaskType>),
+                                 env_->NowMicros()})
+                 .first;
+  }
+  bucket->second.batch->AddTask(std::move(*task));
+  return Status::OK();
+}
+
+template <typename TaskType>
+void Queue<TaskType>::CloseBucket(typename BucketMap::iterator bucket) {
+  bucket->second.batch->Close();
+  batches_.insert(batches_.end() - 1, std::move(bucket->second.batch));
+  buckets_.erase(bucket);
+}
+
+template <typename TaskType>
+void Queue<TaskType>::CloseOldestSchedulableBucket() {
+  auto oldest = buckets_.end();
+  for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+    if (IsBatchSchedulable(*it->second.batch, it->second.start_time_micros) &&
+        (oldest == buckets_.end() ||
+         it->second.start_time_micros < oldest->second.start_time_micros)) {
+      oldest = it;
+    }
+  }
+  DCHECK(oldest != buckets_.end());
+  CloseBucket(oldest);
+}
+
 template <typename TaskType>
 bool Queue<TaskType>::IsOpenBatchSchedulable() const {
-  Batch<TaskType>* open_batch = batches_.back().get();
-  if (open_batch->empty()) {
+  if (options_.bucket_key_fn) {
+    for (const auto& entry : buckets_) {
+      if (IsBatchSchedulable(*entry.second.batch,
+                             entry.second.start_time_micros)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return IsBatchSchedulable(*batches_.back(), open_batch_start_time_micros_);
+}
+
+template <typename TaskType>
+bool Queue<TaskType>::IsBatchSchedulable(const Batch<TaskType>& batch,
+                                         uint64 start_time_micros) const {
+  if (batch.empty()) {
     return false;
   }
-  return closed_ || open_batch->size() >= options_.max_batch_size ||
-         env_->NowMicros() >=
-             open_batch_start_time_micros_ + options_.batch_timeout_micros;
+  return closed_ || batch.size() >= options_.max_batch_size ||
+         env_->NowMicros() >= start_time_micros + options_.batch_timeout_micros;
 }
 
 template <typename TaskType>
@@ -50,6 +50,45 @@ Status ScheduleTask(size_t task_size, BatchScheduler<FakeTask>* scheduler) {
   return status;
 }
 
+// A unit-size task with a sequence length, to which a batch pads its tasks.
+class FakeSequenceTask : public BatchTask {
+ public:
+  explicit FakeSequenceTask(int64 length) : length_(length) {}
+
+  ~FakeSequenceTask() override = default;
+
+  size_t size() const override { return 1; }
+
+  int64 length() const { return length_; }
+
+ private:
+  const int64 length_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FakeSequenceTask);
+};
+
+// Creates a FakeSequenceTask of length 'length', and calls
+// 'scheduler->Schedule()' on that task. Returns the resulting status.
+Status ScheduleSequenceTask(int64 length,
+                            BatchScheduler<FakeSequenceTask>* scheduler) {
+  std::unique_ptr<FakeSequenceTask> task(new FakeSequenceTask(length));
+  Status status = scheduler->Schedule(&task);
+  CHECK_EQ(status.ok(), task == nullptr);
+  return status;
+}
+
+// Returns the number of padding values 'batch' needs to pad every task to the
+// longest one.
+int64 PaddingSize(const Batch<FakeSequenceTask>& batch) {
+  int64 max_length = 0;
+  int64 total_length = 0;
+  for (int i = 0; i < batch.num_tasks(); ++i) {
+    max_length = std::max(max_length, batch.task(i).length());
+    total_length += batch.task(i).length();
+  }
+  return batch.num_tasks() * max_length - total_length;
+}
+
 // Creates a thread that waits on 'start' and then advances the fake clock in
 // 'env' in a loop until 'stop' is notified. Useful for allowing objects that
 // use the clock to be destroyed.
@@ -591,6 +630,149 @@ TEST(SharedBatchSchedulerTest, QueueDestructorBlocksUntilAllTasksProcessed) {
   stop_teardown.Notify();
 }
 
+TEST(SharedBatchSchedulerTest, BucketsReducePadding) {
+  for (const bool bucket_by_length : {false, true}) {
+    mutex mu;
+    int64 padding_size = 0;
+    auto callback = [&mu, &padding_size](
+                        std::unique_ptr<Batch<FakeSequenceTask>> batch) {
+      ASSERT_TRUE(batch->IsClosed());
+      ASSERT_EQ(2, batch->num_tasks());
+      mutex_lock l(mu);
+      padding_size += PaddingSize(*batch);
+    };
+    {
+      SharedBatchScheduler<FakeSequenceTask>::Options options;
+      options.num_batch_threads = 1;
+      std::shared_ptr<SharedBatchScheduler<FakeSequenceTask>> scheduler;
+      TF_ASSERT_OK(
+          SharedBatchScheduler<FakeSequenceTask>::Create(options, &scheduler));
+      SharedBatchScheduler<FakeSequenceTask>::QueueOptions queue_options;
+      queue_options.max_batch_size = 2;
+      queue_options.batch_timeout_micros = 10 * 1000 * 1000;  // 10 seconds
+      queue_options.max_enqueued_batches = 10;
+      if (bucket_by_length) {
+        queue_options.bucket_key_fn = [](const FakeSequenceTask& task) {
+          return task.length() / 16;
+        };
+      }
+      std::unique_ptr<BatchScheduler<FakeSequenceTask>> queue;
+      TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+
+      // Alternate short and long sequences, so that every batch formed in
+      // arrival order pairs a short sequence with a long one.
+      for (const int64 length : {2, 30, 3, 28, 4, 31, 1, 29}) {
+        TF_ASSERT_OK(ScheduleSequenceTask(length, queue.get()));
+      }
+    }
+    mutex_lock l(mu);
+    if (bucket_by_length) {
+      // The batches are {2, 3}, {30, 28}, {4, 1} and {31, 29}.
+      EXPECT_EQ(8, padding_size);
+    } else {
+      // The batches are {2, 30}, {3, 28}, {4, 31} and {1, 29}.
+      EXPECT_EQ(108, padding_size);
+    }
+  }
+}
+
+TEST(SharedBatchSchedulerTest, ObeysTimeoutPerBucket) {
+  // Set up a fake clock, which only advances when we explicitly tell it to.
+  test_util::FakeClockEnv env(Env::Default());
+  Notification start_teardown, stop_teardown;
+  std::unique_ptr<Thread> teardown_thread =
+      CreateFakeClockAdvancerThread(&env, &start_teardown, &stop_teardown);
+
+  {
+    // The latency of the tasks in each bucket, i.e. the time from their
+    // scheduling until their batch is processed.
+    uint64 schedule_time_micros[2];
+    uint64 latency_micros[2];
+    Notification batch_processed[2];
+    auto callback = [&](std::unique_ptr<Batch<FakeSequenceTask>> batch) {
+      ASSERT_TRUE(batch->IsClosed());
+      ASSERT_EQ(1, batch->num_tasks());
+      const int64 bucket = batch->task(0).length() / 16;
+      latency_micros[bucket] = env.NowMicros() - schedule_time_micros[bucket];
+      batch_processed[bucket].Notify();
+    };
+
+    SharedBatchScheduler<FakeSequenceTask>::Options options;
+    options.num_batch_threads = 1;
+    options.env = &env;
+    std::shared_ptr<SharedBatchScheduler<FakeSequenceTask>> scheduler;
+    TF_ASSERT_OK(
+        SharedBatchScheduler<FakeSequenceTask>::Create(options, &scheduler));
+    SharedBatchScheduler<FakeSequenceTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 4;
+    queue_options.batch_timeout_micros = 10;
+    queue_options.max_enqueued_batches = 2;
+    queue_options.bucket_key_fn = [](const FakeSequenceTask& task) {
+      return task.length() / 16;
+    };
+    std::unique_ptr<BatchScheduler<FakeSequenceTask>> queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+
+    // Start the open batch of each bucket at a different time.
+    schedule_time_micros[0] = env.NowMicros();
+    TF_ASSERT_OK(ScheduleSequenceTask(1, queue.get()));
+    env.AdvanceByMicroseconds(5);
+    schedule_time_micros[1] = env.NowMicros();
+    TF_ASSERT_OK(ScheduleSequenceTask(20, queue.get()));
+
+    // Each batch is processed when its own timeout is hit.
+    env.AdvanceByMicroseconds(4);
+    Env::Default()->SleepForMicroseconds(10 * 1000 /* 10 milliseconds */);
+    EXPECT_FALSE(batch_processed[0].HasBeenNotified());
+    env.AdvanceByMicroseconds(1);
+    batch_processed[0].WaitForNotification();
+    EXPECT_EQ(10, latency_micros[0]);
+
+    env.AdvanceByMicroseconds(4);
+    Env::Default()->SleepForMicroseconds(10 * 1000 /* 10 milliseconds */);
+    EXPECT_FALSE(batch_processed[1].HasBeenNotified());
+    env.AdvanceByMicroseconds(1);
+    batch_processed[1].WaitForNotification();
+    EXPECT_EQ(10, latency_micros[1]);
+
+    start_teardown.Notify();
+  }
+  stop_teardown.Notify();
+}
+
+TEST(SharedBatchSchedulerTest, BucketsCountTowardMaxEnqueuedBatches) {
+  auto callback = [](std::unique_ptr<Batch<FakeSequenceTask>> batch) {};
+
+  SharedBatchScheduler<FakeSequenceTask>::Options options;
+  options.num_batch_threads = 1;
+  std::shared_ptr<SharedBatchScheduler<FakeSequenceTask>> scheduler;
+  TF_ASSERT_OK(
+      SharedBatchScheduler<FakeSequenceTask>::Create(options, &scheduler));
+  SharedBatchScheduler<FakeSequenceTask>::QueueOptions queue_options;
+  queue_options.max_batch_size = 10;
+  queue_options.batch_timeout_micros = 10 * 1000 * 1000;  // 10 seconds
+  queue_options.max_enqueued_batches = 2;
+  queue_options.bucket_key_fn = [](const FakeSequenceTask& task) {
+    return task.length();
+  };
+  std::unique_ptr<BatchScheduler<FakeSequenceTask>> queue;
+  TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+  EXPECT_EQ(20, queue->SchedulingCapacity());
+
+  TF_ASSERT_OK(ScheduleSequenceTask(1, queue.get()));
+  TF_ASSERT_OK(ScheduleSequenceTask(2, queue.get()));
+  EXPECT_EQ(2, queue->NumEnqueuedTasks());
+  EXPECT_EQ(18, queue->SchedulingCapacity());
+
+  // A third bucket doesn't fit, but the open batches still have room.
+  Status status = ScheduleSequenceTask(3, queue.get());
+  ASSERT_FALSE(status.ok());
+  EXPECT_EQ(error::UNAVAILABLE, status.code());
+  TF_ASSERT_OK(ScheduleSequenceTask(1, queue.get()));
+  EXPECT_EQ(3, queue->NumEnqueuedTasks());
+  EXPECT_EQ(17, queue->SchedulingCapacity());
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
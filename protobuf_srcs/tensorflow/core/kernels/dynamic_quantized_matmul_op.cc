@@ -0,0 +1,211 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Implements a float matmul with eight-bit weights, quantizing the rows of
+// the float input on the fly. See the quantize_matmul_weights graph
+// transform.
+
+#define EIGEN_USE_THREADS
+
+#include <cmath>
+#include <vector>
+
+#define GEMMLOWP_ALLOW_SLOW_SCALAR_FALLBACK
+#include "public/gemmlowp.h"
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/quantization_utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// The largest inner dimension for which the products of two eight-bit
+// matrices, and the corrections for their zero points, fit in int32.
+constexpr int64 kMaxDepth = (int64{1} << 31) / (255 * 255);
+
+// The affine mapping of [min, max] to quint8 used by FloatToQuantized, as
+// real = scale * (quantized - zero_point).
+void AffineQuantizationParams(float min, float max, float* scale,
+                              int32* zero_point) {
+  if (max <= min) {
+    *scale = 1.0f;
+    *zero_point = 0;
+    return;
+  }
+  *scale = (max - min) / 255.0f;
+  *zero_point = -static_cast<int32>(std::round(min / *scale));
+}
+
+}  // namespace
+
+class DynamicQuantizedMatMulOp : public OpKernel {
+ public:
+  explicit DynamicQuantizedMatMulOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& a = context->input(0);
+    const Tensor& b = context->input(1);
+    const Tensor& min_b = context->input(2);
+    const Tensor& max_b = context->input(3);
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(a.shape()),
+                errors::InvalidArgument("In[0] is not a matrix"));
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(b.shape()),
+                errors::InvalidArgument("In[1] is not a matrix"));
+    OP_REQUIRES(context, a.dim_size(1) == b.dim_size(0),
+                errors::InvalidArgument("Matrix size-incompatible: In[0]: ",
+                                        a.shape().DebugString(),
+                                        ", In[1]: ", b.shape().DebugString()));
+    const int64 m = a.dim_size(0);
+    const int64 k = a.dim_size(1);
+    const int64 n = b.dim_size(1);
+    // The range of b is either per tensor or per column.
+    OP_REQUIRES(context, min_b.shape() == max_b.shape(),
+                errors::InvalidArgument(
+                    "min_b and max_b must have the same shape, got ",
+                    min_b.shape().DebugString(), " and ",
+                    max_b.shape().DebugString()));
+    OP_REQUIRES(
+        context,
+        TensorShapeUtils::IsScalar(min_b.shape()) ||
+            (TensorShapeUtils::IsVector(min_b.shape()) &&
+             min_b.NumElements() == n),
+        errors::InvalidArgument("min_b must be a scalar or have shape [", n,
+                                "], got ", min_b.shape().DebugString()));
+    OP_REQUIRES(context, k <= kMaxDepth,
+                errors::InvalidArgument("In[0] must have at most ", kMaxDepth,
+                                        " columns, got ", k));
+
+    Tensor* product = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({m, n}), &product));
+    if (m == 0 || n == 0) return;
+    if (k == 0) {
+      product->flat<float>().setZero();
+      return;
+    }
+
+    std::vector<float> b_scale(n);
+    std::vector<int32> b_zero_point(n);
+    const auto min_b_flat = min_b.flat<float>();
+    const auto max_b_flat = max_b.flat<float>();
+    for (int64 j = 0; j < n; ++j) {
+      const int64 r = min_b_flat.size() == 1 ? 0 : j;
+      OP_REQUIRES(context, max_b_flat(r) > min_b_flat(r),
+                  errors::InvalidArgument("max_b must be larger than min_b."));
+      AffineQuantizationParams(min_b_flat(r), max_b_flat(r), &b_scale[j],
+                               &b_zero_point[j]);
+    }
+
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+
+    // Quantizes every row of a with its own range, which includes 0.
+    Tensor a_quantized;
+    OP_REQUIRES_OK(context, context->allocate_temp(
+                                DT_QUINT8, TensorShape({m, k}), &a_quantized));
+    std::vector<float> a_scale(m);
+    std::vector<int32> a_zero_point(m);
+    std::vector<int32> a_row_sums(m);
+    const float* a_data = a.flat<float>().data();
+    uint8* a_quantized_data = &a_quantized.flat<quint8>().data()->value;
+    auto quantize_rows = [&](int64 start, int64 limit) {
+      typedef Eigen::Array<float, Eigen::Dynamic, 1> FloatRow;
+      typedef Eigen::Array<uint8, Eigen::Dynamic, 1> QuantizedRow;
+      for (int64 i = start; i < limit; ++i) {
+        Eigen::Map<const FloatRow> row(a_data + i * k, k);
+        AffineQuantizationParams(std::min(0.0f, row.minCoeff()),
+                                 std::max(0.0f, row.maxCoeff()), &a_scale[i],
+                                 &a_zero_point[i]);
+        Eigen::Map<QuantizedRow> quantized(a_quantized_data + i * k, k);
+        quantized = ((row * (1.0f / a_scale[i])).round() +
+                     static_cast<float>(a_zero_point[i]))
+                        .cwiseMax(0.0f)
+                        .cwiseMin(255.0f)
+                        .cast<uint8>();
+        a_row_sums[i] = quantized.cast<int32>().sum();
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, m, k * 8,
+          quantize_rows);
+
+    const uint8* b_data = &b.flat<quint8>().data()->value;
+    std::vector<int32> b_column_sums(n, 0);
+    auto sum_columns = [&](int64 start, int64 limit) {
+      for (int64 r = 0; r < k; ++r) {
+        const uint8* b_row = b_data + r * n;
+        for (int64 j = start; j < limit; ++j) {
+          b_column_sums[j] += b_row[j];
+        }
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, n, k,
+          sum_columns);
+
+    // Multiplies the quantized values without their zero points, which are
+    // subtracted below since they differ between rows and columns.
+    Tensor accumulators;
+    OP_REQUIRES_OK(context, context->allocate_temp(
+                                DT_INT32, TensorShape({m, n}), &accumulators));
+    int32* accumulator_data = accumulators.flat<int32>().data();
+    {
+      gemmlowp::MatrixMap<const std::uint8_t, gemmlowp::MapOrder::RowMajor>
+          lhs(a_quantized_data, m, k, k);
+      gemmlowp::MatrixMap<const std::uint8_t, gemmlowp::MapOrder::RowMajor>
+          rhs(b_data, k, n, n);
+      gemmlowp::MatrixMap<std::int32_t, gemmlowp::MapOrder::RowMajor> result(
+          accumulator_data, m, n, n);
+      const std::tuple<> empty_pipeline = {};
+      TensorflowGemmContext gemm_context(worker_threads.num_threads,
+                                         worker_threads.workers);
+      gemmlowp::GemmWithOutputPipeline<std::uint8_t, std::int32_t,
+                                       gemmlowp::DefaultL8R8BitDepthParams>(
+          &gemm_context, lhs, rhs, &result, 0, 0, empty_pipeline);
+      // Since gemmlowp uses assembly to write to the output, msan won't
+      // detect the output buffer as written to, so we mark it manually.
+      TF_ANNOTATE_MEMORY_IS_INITIALIZED(accumulator_data,
+                                        m * n * sizeof(int32));
+    }
+
+    // sum((qa - za) * (qb - zb)) =
+    //     sum(qa * qb) - zb * sum(qa) - za * sum(qb) + k * za * zb
+    float* product_data = product->flat<float>().data();
+    auto dequantize_rows = [&](int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const int64 za = a_zero_point[i];
+        const int64 row_sum = a_row_sums[i];
+        const int32* acc = accumulator_data + i * n;
+        float* out = product_data + i * n;
+        for (int64 j = 0; j < n; ++j) {
+          const int64 zb = b_zero_point[j];
+          const int64 dot = acc[j] - zb * row_sum - za * b_column_sums[j] +
+                            k * za * zb;
+          out[j] = a_scale[i] * b_scale[j] * static_cast<float>(dot);
+        }
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, m, n * 6,
+          dequantize_rows);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("DynamicQuantizedMatMul").Device(DEVICE_CPU),
+                        DynamicQuantizedMatMulOp);
+
+}  // namespace tensorflow
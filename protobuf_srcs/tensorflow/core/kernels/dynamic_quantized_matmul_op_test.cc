@@ -0,0 +1,233 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/quantization_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Quantizes every column of the float matrix 'weights' with its own range,
+// like the quantize_matmul_weights graph transform.
+void QuantizeColumns(const Tensor& weights, Tensor* quantized, Tensor* min,
+                     Tensor* max) {
+  const auto w = weights.matrix<float>();
+  const int64 rows = w.dimension(0);
+  const int64 cols = w.dimension(1);
+  *quantized = Tensor(DT_QUINT8, weights.shape());
+  *min = Tensor(DT_FLOAT, TensorShape({cols}));
+  *max = Tensor(DT_FLOAT, TensorShape({cols}));
+  for (int64 j = 0; j < cols; ++j) {
+    float lo = 0.0f;
+    float hi = 0.0f;
+    for (int64 i = 0; i < rows; ++i) {
+      lo = std::min(lo, w(i, j));
+      hi = std::max(hi, w(i, j));
+    }
+    if (lo == hi) hi = lo + 1.0f;
+    min->vec<float>()(j) = lo;
+    max->vec<float>()(j) = hi;
+    for (int64 i = 0; i < rows; ++i) {
+      quantized->matrix<quint8>()(i, j) =
+          FloatToQuantized<quint8>(w(i, j), lo, hi);
+    }
+  }
+}
+
+class DynamicQuantizedMatMulTest : public OpsTestBase {
+ protected:
+  void MakeOp() {
+    TF_ASSERT_OK(NodeDefBuilder("dynamic_quantized_matmul",
+                                "DynamicQuantizedMatMul")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_QUINT8))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Runs the op on 'a' and on 'weights' quantized by column, and returns the
+  // result of the float matmul of 'a' and 'weights' in 'expected'.
+  void RunWithQuantizedWeights(const Tensor& a, const Tensor& weights,
+                               Tensor* expected) {
+    Tensor quantized, min, max;
+    QuantizeColumns(weights, &quantized, &min, &max);
+    MakeOp();
+    AddInputFromArray<float>(a.shape(), a.flat<float>());
+    AddInputFromArray<quint8>(quantized.shape(), quantized.flat<quint8>());
+    AddInputFromArray<float>(min.shape(), min.flat<float>());
+    AddInputFromArray<float>(max.shape(), max.flat<float>());
+    TF_ASSERT_OK(RunOpKernel());
+
+    *expected =
+        Tensor(DT_FLOAT, TensorShape({a.dim_size(0), weights.dim_size(1)}));
+    Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dims;
+    dims[0] = Eigen::IndexPair<Eigen::DenseIndex>(1, 0);
+    expected->matrix<float>() =
+        a.matrix<float>().contract(weights.matrix<float>(), dims);
+  }
+
+  void ExpectNearFloatMatMul(const Tensor& a, const Tensor& weights,
+                             float tolerance) {
+    Tensor expected;
+    RunWithQuantizedWeights(a, weights, &expected);
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), tolerance);
+  }
+
+  // Checks the relative error of a dense layer of BERT-base for a batch of
+  // 128 tokens, with normally distributed activations and weights.
+  void CheckBertDenseLayer(int64 depth, int64 units) {
+    Tensor a(DT_FLOAT, TensorShape({128, depth}));
+    a.flat<float>().setRandom<Eigen::internal::NormalRandomGenerator<float>>();
+    Tensor weights(DT_FLOAT, TensorShape({depth, units}));
+    weights.flat<float>().setRandom<
+        Eigen::internal::NormalRandomGenerator<float>>();
+    weights.flat<float>() = weights.flat<float>() * 0.02f;
+    Tensor expected;
+    RunWithQuantizedWeights(a, weights, &expected);
+    const auto e = expected.flat<float>();
+    const auto output = GetOutput(0)->flat<float>();
+    const float error = std::sqrt((output - e).square().sum()() /
+                                  e.square().sum()());
+    LOG(INFO) << "Relative error of a [128, " << depth << "] x [" << depth
+              << ", " << units << "] matmul: " << error;
+    EXPECT_LT(error, 0.03f);
+  }
+};
+
+TEST_F(DynamicQuantizedMatMulTest, Small) {
+  // Columns of b with positive, negative and mixed values.
+  ExpectNearFloatMatMul(
+      test::AsTensor<float>({1, 2, 3, -4, 5, -6}, TensorShape({2, 3})),
+      test::AsTensor<float>({7, -8, 9, 10, -11, 12, 0.5, -0.5, 0, 0, 0, 1},
+                            TensorShape({3, 4})),
+      0.5);
+}
+
+TEST_F(DynamicQuantizedMatMulTest, ZeroRow) {
+  ExpectNearFloatMatMul(
+      test::AsTensor<float>({0, 0, 1, -1}, TensorShape({2, 2})),
+      test::AsTensor<float>({1, 2, 3, 4}, TensorShape({2, 2})), 0.05);
+}
+
+TEST_F(DynamicQuantizedMatMulTest, PerTensorRange) {
+  MakeOp();
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  // With range [-1, 1], 0 is 128 and 255 is 1.
+  AddInputFromArray<quint8>(TensorShape({2, 2}), {255, 128, 0, 255});
+  AddInputFromArray<float>(TensorShape({}), {-1});
+  AddInputFromArray<float>(TensorShape({}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_FLOAT, TensorShape({1, 2}));
+  test::FillValues<float>(&expected, {-1, 2});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 0.05);
+}
+
+TEST_F(DynamicQuantizedMatMulTest, Errors) {
+  MakeOp();
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  AddInputFromArray<quint8>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({3}), {-1, -1, -1});
+  AddInputFromArray<float>(TensorShape({3}), {1, 1, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+// The attention projections and the two layers of the feed-forward network
+// of BERT-base.
+TEST_F(DynamicQuantizedMatMulTest, BertAttentionProjection) {
+  CheckBertDenseLayer(768, 768);
+}
+
+TEST_F(DynamicQuantizedMatMulTest, BertIntermediate) {
+  CheckBertDenseLayer(768, 3072);
+}
+
+TEST_F(DynamicQuantizedMatMulTest, BertOutput) {
+  CheckBertDenseLayer(3072, 768);
+}
+
+// Multiplies a [tokens, depth] float matrix with a [depth, units] constant,
+// either in float with MatMul or with eight-bit weights.
+static void BM_DenseLayer(int iters, bool quantized, int tokens, int depth,
+                          int units) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor a(DT_FLOAT, TensorShape({tokens, depth}));
+  a.flat<float>().setRandom();
+  Tensor weights(DT_FLOAT, TensorShape({depth, units}));
+  weights.flat<float>().setRandom();
+  Node* a_node = test::graph::Constant(g, a);
+  if (quantized) {
+    Tensor quantized_weights, min, max;
+    QuantizeColumns(weights, &quantized_weights, &min, &max);
+    Node* product;
+    TF_CHECK_OK(NodeBuilder(g->NewName("product"), "DynamicQuantizedMatMul")
+                    .Input(a_node)
+                    .Input(test::graph::Constant(g, quantized_weights))
+                    .Input(test::graph::Constant(g, min))
+                    .Input(test::graph::Constant(g, max))
+                    .Finalize(g, &product));
+  } else {
+    test::graph::Matmul(g, a_node, test::graph::Constant(g, weights), false,
+                        false);
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * tokens * depth * units *
+                          2);
+  testing::SetLabel(strings::StrCat(tokens, "x", depth, "x", units));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_DENSE_LAYER(TOKENS, DEPTH, UNITS)                                 \
+  static void BM_DenseLayerFloat_##TOKENS##_##DEPTH##_##UNITS(int iters) {   \
+    BM_DenseLayer(iters, false, TOKENS, DEPTH, UNITS);                       \
+  }                                                                          \
+  BENCHMARK(BM_DenseLayerFloat_##TOKENS##_##DEPTH##_##UNITS);                \
+  static void BM_DenseLayerQuantized_##TOKENS##_##DEPTH##_##UNITS(           \
+      int iters) {                                                           \
+    BM_DenseLayer(iters, true, TOKENS, DEPTH, UNITS);                        \
+  }                                                                          \
+  BENCHMARK(BM_DenseLayerQuantized_##TOKENS##_##DEPTH##_##UNITS);
+
+// BERT-base for one and for eight sequences of 128 tokens.
+BM_DENSE_LAYER(128, 768, 768);
+BM_DENSE_LAYER(128, 768, 3072);
+BM_DENSE_LAYER(128, 3072, 768);
+BM_DENSE_LAYER(1024, 768, 768);
+BM_DENSE_LAYER(1024, 768, 3072);
+BM_DENSE_LAYER(1024, 3072, 768);
+
+}  // namespace
+}  // namespace tensorflow
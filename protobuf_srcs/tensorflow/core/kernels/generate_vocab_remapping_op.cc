@@ -72,7 +72,11 @@ class GenerateVocabRemappingOp : public OpKernel {
                                 kUnusedLookupDelim,
                                 -1,  // key_index, use the line number.
                                 -2,  // value_index, use the whole line/token.
-                                context->env(), new_vocab_table));
+                                context->env(),
+                                context->device()
+                                    ->tensorflow_cpu_worker_threads()
+                                    ->workers,
+                                new_vocab_table));
     OP_REQUIRES(context,
                 new_vocab_offset_ + num_new_vocab_ <= new_vocab_table->size(),
                 errors::InvalidArgument("lookup table size must be larger than "
@@ -101,7 +105,11 @@ class GenerateVocabRemappingOp : public OpKernel {
                        old_vocab_filename, old_vocab_size_, kUnusedLookupDelim,
                        -2,  // key_index, use the whole line/token.
                        -1,  // value_index, use the line number.
-                       context->env(), old_vocab_table));
+                       context->env(),
+                       context->device()
+                           ->tensorflow_cpu_worker_threads()
+                           ->workers,
+                       old_vocab_table));
 
     // Fill out new_ids = [new_vocab_offset, new_vocab_offset + 1, ...,
     //                     new_vocab_offset + num_new_vocab_]
@@ -0,0 +1,421 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/immutable_lookup_table.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/kernels/memory_region_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/byte_order.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+constexpr char kMagic[8] = {'T', 'F', 'I', 'M', 'H', 'T', '0', '1'};
+
+static_assert(sizeof(ImmutableHashTable::FileHeader) == 64,
+              "FileHeader is part of the file format");
+static_assert(sizeof(ImmutableHashTable::Slot) == 32,
+              "Slot is part of the file format");
+
+Status CheckDataTypes(DataType key_dtype, DataType value_dtype) {
+  if (key_dtype != DT_INT64 && key_dtype != DT_STRING) {
+    return errors::InvalidArgument(
+        "ImmutableHashTable keys must be int64 or string, got ",
+        DataTypeString(key_dtype));
+  }
+  if (value_dtype != DT_INT64 && value_dtype != DT_STRING) {
+    return errors::InvalidArgument(
+        "ImmutableHashTable values must be int64 or string, got ",
+        DataTypeString(value_dtype));
+  }
+  if (!port::kLittleEndian) {
+    return errors::Unimplemented(
+        "ImmutableHashTable is only supported on little-endian hosts");
+  }
+  return Status::OK();
+}
+
+uint64 HashKey(int64 key) {
+  return Hash64(reinterpret_cast<const char*>(&key), sizeof(key));
+}
+
+uint64 HashKey(const tstring& key) { return Hash64(key.data(), key.size()); }
+
+uint32 SlotTag(uint64 hash) { return static_cast<uint32>(hash >> 32) | 1; }
+
+// Mappings of the files loaded by any table in this process, keyed by file
+// name, modification time and size, so that a replaced file is mapped again.
+mutex mappings_mu(LINKER_INITIALIZED);
+
+std::unordered_map<string, std::weak_ptr<ReadOnlyMemoryRegion>>* Mappings()
+    EXCLUSIVE_LOCKS_REQUIRED(mappings_mu) {
+  static auto* mappings =
+      new std::unordered_map<string, std::weak_ptr<ReadOnlyMemoryRegion>>;
+  return mappings;
+}
+
+Status GetMapping(Env* env, const string& filename,
+                  std::shared_ptr<ReadOnlyMemoryRegion>* region) {
+  FileStatistics stat;
+  TF_RETURN_IF_ERROR(env->Stat(filename, &stat));
+  const string key =
+      strings::StrCat(filename, "@", stat.mtime_nsec, ":", stat.length);
+  mutex_lock l(mappings_mu);
+  auto* mappings = Mappings();
+  auto it = mappings->find(key);
+  if (it != mappings->end()) {
+    *region = it->second.lock();
+    if (*region) return Status::OK();
+  }
+  std::unique_ptr<ReadOnlyMemoryRegion> new_region;
+  TF_RETURN_IF_ERROR(
+      NewReadOnlyMemoryRegionOrReadFile(env, filename, &new_region));
+  *region = std::move(new_region);
+  for (auto m = mappings->begin(); m != mappings->end();) {
+    if (m->second.expired()) {
+      m = mappings->erase(m);
+    } else {
+      ++m;
+    }
+  }
+  (*mappings)[key] = *region;
+  return Status::OK();
+}
+
+// Builds the slots and data section of a table file.
+class TableBuilder {
+ public:
+  TableBuilder(DataType key_dtype, DataType value_dtype, int64 num_keys)
+      : key_dtype_(key_dtype), value_dtype_(value_dtype) {
+    uint64 num_slots = 16;
+    // Keep the load factor at or below 3/4.
+    while (num_slots * 3 < static_cast<uint64>(num_keys) * 4) num_slots *= 2;
+    slots_.resize(num_slots);
+  }
+
+  template <typename K, typename V>
+  Status Add(const K& key, const V& value) {
+    const uint64 hash = HashKey(key);
+    const uint32 tag = SlotTag(hash);
+    const uint64 mask = slots_.size() - 1;
+    for (uint64 index = hash & mask;; index = (index + 1) & mask) {
+      ImmutableHashTable::Slot& slot = slots_[index];
+      if (slot.tag == 0) {
+        slot.tag = tag;
+        TF_RETURN_IF_ERROR(Store(key, &slot.key, &slot.key_size));
+        TF_RETURN_IF_ERROR(Store(value, &slot.value, &slot.value_size));
+        ++num_entries_;
+        return Status::OK();
+      }
+      if (slot.tag == tag && Equals(key, slot.key, slot.key_size)) {
+        if (!Equals(value, slot.value, slot.value_size)) {
+          return errors::InvalidArgument("Key ", key,
+                                         " is given different values.");
+        }
+        return Status::OK();
+      }
+    }
+  }
+
+  Status Write(Env* env, const string& filename) const {
+    ImmutableHashTable::FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.key_dtype = key_dtype_;
+    header.value_dtype = value_dtype_;
+    header.num_entries = num_entries_;
+    header.num_slots = slots_.size();
+    header.slots_offset = sizeof(header);
+    header.data_offset =
+        header.slots_offset + slots_.size() * sizeof(ImmutableHashTable::Slot);
+    header.data_size = data_.size();
+
+    // Readers may have mapped an older version of the file, so the new
+    // version is written to a temporary file and renamed. The temporary file
+    // is unique, so that concurrent writers of the same file do not write to
+    // it at once.
+    string tmp_filename = filename;
+    if (!env->CreateUniqueFileName(&tmp_filename, ".tmp")) {
+      return errors::Internal("Failed to create a temporary file name for ",
+                              filename);
+    }
+    Status s = WriteFile(env, header, tmp_filename);
+    if (s.ok()) s = env->RenameFile(tmp_filename, filename);
+    if (!s.ok()) env->DeleteFile(tmp_filename).IgnoreError();
+    return s;
+  }
+
+ private:
+  Status WriteFile(Env* env, const ImmutableHashTable::FileHeader& header,
+                   const string& filename) const {
+    std::unique_ptr<WritableFile> file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(filename, &file));
+    TF_RETURN_IF_ERROR(file->Append(
+        StringPiece(reinterpret_cast<const char*>(&header), sizeof(header))));
+    TF_RETURN_IF_ERROR(file->Append(
+        StringPiece(reinterpret_cast<const char*>(slots_.data()),
+                    slots_.size() * sizeof(ImmutableHashTable::Slot))));
+    TF_RETURN_IF_ERROR(file->Append(data_));
+    return file->Close();
+  }
+
+  Status Store(int64 v, uint64* field, uint32* size) {
+    *field = static_cast<uint64>(v);
+    *size = 0;
+    return Status::OK();
+  }
+
+  Status Store(const tstring& v, uint64* field, uint32* size) {
+    if (v.size() > kuint32max) {
+      return errors::InvalidArgument("String of ", v.size(),
+                                     " bytes is too large");
+    }
+    *field = data_.size();
+    *size = v.size();
+    data_.append(v.data(), v.size());
+    return Status::OK();
+  }
+
+  bool Equals(int64 v, uint64 field, uint32 size) const {
+    return static_cast<uint64>(v) == field;
+  }
+
+  bool Equals(const tstring& v, uint64 field, uint32 size) const {
+    return v.size() == size &&
+           memcmp(data_.data() + field, v.data(), size) == 0;
+  }
+
+  const DataType key_dtype_;
+  const DataType value_dtype_;
+  std::vector<ImmutableHashTable::Slot> slots_;
+  string data_;
+  uint64 num_entries_ = 0;
+};
+
+template <typename K, typename V>
+Status AddEntries(const Tensor& keys, const Tensor& values,
+                  TableBuilder* builder) {
+  const auto key_values = keys.flat<K>();
+  const auto value_values = values.flat<V>();
+  for (int64 i = 0; i < key_values.size(); ++i) {
+    TF_RETURN_IF_ERROR(builder->Add(key_values(i), value_values(i)));
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+Status WriteImmutableHashTable(Env* env, const string& filename,
+                               const Tensor& keys, const Tensor& values) {
+  TF_RETURN_IF_ERROR(CheckDataTypes(keys.dtype(), values.dtype()));
+  if (keys.NumElements() != values.NumElements()) {
+    return errors::InvalidArgument("Got ", keys.NumElements(), " keys but ",
+                                   values.NumElements(), " values");
+  }
+  TableBuilder builder(keys.dtype(), values.dtype(), keys.NumElements());
+  if (keys.dtype() == DT_INT64) {
+    if (values.dtype() == DT_INT64) {
+      TF_RETURN_IF_ERROR((AddEntries<int64, int64>(keys, values, &builder)));
+    } else {
+      TF_RETURN_IF_ERROR((AddEntries<int64, tstring>(keys, values, &builder)));
+    }
+  } else {
+    if (values.dtype() == DT_INT64) {
+      TF_RETURN_IF_ERROR((AddEntries<tstring, int64>(keys, values, &builder)));
+    } else {
+      TF_RETURN_IF_ERROR(
+          (AddEntries<tstring, tstring>(keys, values, &builder)));
+    }
+  }
+  return builder.Write(env, filename);
+}
+
+ImmutableHashTable::ImmutableHashTable(OpKernelContext* ctx, OpKernel* kernel) {
+  OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "key_dtype", &key_dtype_));
+  OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "value_dtype", &value_dtype_));
+  OP_REQUIRES_OK(ctx, CheckDataTypes(key_dtype_, value_dtype_));
+}
+
+Status ImmutableHashTable::Load(Env* env, const string& filename) {
+  TF_RETURN_IF_ERROR(CheckDataTypes(key_dtype_, value_dtype_));
+  mutex_lock l(mu_);
+  if (loaded_.load(std::memory_order_relaxed)) {
+    if (filename == filename_) return Status::OK();
+    return errors::FailedPrecondition(
+        "ImmutableHashTable is already loaded from ", filename_,
+        ", cannot load ", filename);
+  }
+  std::shared_ptr<ReadOnlyMemoryRegion> region;
+  TF_RETURN_IF_ERROR(GetMapping(env, filename, &region));
+
+  const char* base = static_cast<const char*>(region->data());
+  const uint64 length = region->length();
+  FileHeader header;
+  if (length < sizeof(header)) {
+    return errors::DataLoss("ImmutableHashTable file ", filename,
+                            " is truncated");
+  }
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return errors::DataLoss(filename, " is not an ImmutableHashTable file");
+  }
+  if (header.key_dtype != key_dtype_ || header.value_dtype != value_dtype_) {
+    return errors::InvalidArgument(
+        "ImmutableHashTable file ", filename, " maps ",
+        DataTypeString(static_cast<DataType>(header.key_dtype)), " to ",
+        DataTypeString(static_cast<DataType>(header.value_dtype)),
+        ", expected ", DataTypeString(key_dtype_), " to ",
+        DataTypeString(value_dtype_));
+  }
+  const uint64 num_slots = header.num_slots;
+  if (num_slots == 0 || (num_slots & (num_slots - 1)) != 0 ||
+      header.num_entries >= num_slots || header.slots_offset % 8 != 0 ||
+      header.slots_offset > length ||
+      num_slots > (length - header.slots_offset) / sizeof(Slot) ||
+      header.data_offset > length ||
+      header.data_size > length - header.data_offset) {
+    return errors::DataLoss("ImmutableHashTable file ", filename,
+                            " is corrupted");
+  }
+  region_ = std::move(region);
+  slots_ = reinterpret_cast<const Slot*>(base + header.slots_offset);
+  data_ = base + header.data_offset;
+  data_size_ = header.data_size;
+  num_slots_ = num_slots;
+  num_entries_ = header.num_entries;
+  filename_ = filename;
+  loaded_.store(true, std::memory_order_release);
+  return Status::OK();
+}
+
+const ImmutableHashTable::Slot* ImmutableHashTable::FindSlot(
+    uint64 hash, const char* key_data, size_t key_size, int64 int_key) const {
+  const uint32 tag = SlotTag(hash);
+  const uint64 mask = num_slots_ - 1;
+  uint64 index = hash & mask;
+  // The table is never full, but a corrupted file might be.
+  for (uint64 probe = 0; probe < num_slots_; ++probe) {
+    const Slot& slot = slots_[index];
+    if (slot.tag == 0) return nullptr;
+    if (slot.tag == tag) {
+      if (key_data == nullptr) {
+        if (static_cast<int64>(slot.key) == int_key) return &slot;
+      } else if (slot.key_size == key_size && slot.key <= data_size_ &&
+                 key_size <= data_size_ - slot.key &&
+                 memcmp(data_ + slot.key, key_data, key_size) == 0) {
+        return &slot;
+      }
+    }
+    index = (index + 1) & mask;
+  }
+  return nullptr;
+}
+
+Status ImmutableHashTable::ReadValue(const Slot& slot, int64* value) const {
+  *value = static_cast<int64>(slot.value);
+  return Status::OK();
+}
+
+Status ImmutableHashTable::ReadValue(const Slot& slot, tstring* value) const {
+  if (slot.value > data_size_ || slot.value_size > data_size_ - slot.value) {
+    return errors::DataLoss("ImmutableHashTable value is out of bounds");
+  }
+  value->assign(data_ + slot.value, slot.value_size);
+  return Status::OK();
+}
+
+template <typename V>
+Status ImmutableHashTable::FindWithValueType(
+    const Tensor& keys, Tensor* values, const Tensor& default_value) const {
+  const V& default_val = default_value.flat<V>()(0);
+  auto value_values = values->flat<V>();
+  const int64 num_keys = keys.NumElements();
+  for (int64 i = 0; i < num_keys; ++i) {
+    const Slot* slot;
+    if (key_dtype_ == DT_STRING) {
+      const tstring& key = keys.flat<tstring>()(i);
+      slot = FindSlot(HashKey(key), key.data(), key.size(), 0);
+    } else {
+      const int64 key = keys.flat<int64>()(i);
+      slot = FindSlot(HashKey(key), nullptr, 0, key);
+    }
+    if (slot == nullptr) {
+      value_values(i) = default_val;
+    } else {
+      TF_RETURN_IF_ERROR(ReadValue(*slot, &value_values(i)));
+    }
+  }
+  return Status::OK();
+}
+
+Status ImmutableHashTable::Find(OpKernelContext* ctx, const Tensor& keys,
+                                Tensor* values, const Tensor& default_value) {
+  if (!loaded_.load(std::memory_order_acquire)) {
+    return errors::FailedPrecondition(
+        "ImmutableHashTable is not loaded, run "
+        "InitializeImmutableHashTableFromFile.");
+  }
+  if (value_dtype_ == DT_INT64) {
+    return FindWithValueType<int64>(keys, values, default_value);
+  }
+  return FindWithValueType<tstring>(keys, values, default_value);
+}
+
+Status ImmutableHashTable::ExportValues(OpKernelContext* ctx) {
+  const int64 size =
+      loaded_.load(std::memory_order_acquire) ? num_entries_ : 0;
+  Tensor* keys;
+  Tensor* values;
+  TF_RETURN_IF_ERROR(
+      ctx->allocate_output("keys", TensorShape({size}), &keys));
+  TF_RETURN_IF_ERROR(
+      ctx->allocate_output("values", TensorShape({size}), &values));
+  int64 i = 0;
+  for (uint64 index = 0; index < num_slots_ && i < size; ++index) {
+    const Slot& slot = slots_[index];
+    if (slot.tag == 0) continue;
+    if (key_dtype_ == DT_STRING) {
+      if (slot.key > data_size_ || slot.key_size > data_size_ - slot.key) {
+        return errors::DataLoss("ImmutableHashTable key is out of bounds");
+      }
+      keys->flat<tstring>()(i).assign(data_ + slot.key, slot.key_size);
+    } else {
+      keys->flat<int64>()(i) = static_cast<int64>(slot.key);
+    }
+    if (value_dtype_ == DT_STRING) {
+      TF_RETURN_IF_ERROR(ReadValue(slot, &values->flat<tstring>()(i)));
+    } else {
+      TF_RETURN_IF_ERROR(ReadValue(slot, &values->flat<int64>()(i)));
+    }
+    ++i;
+  }
+  return Status::OK();
+}
+
+int64 ImmutableHashTable::MemoryUsed() const {
+  return loaded_.load(std::memory_order_acquire) ? region_->length() : 0;
+}
+
+}  // namespace lookup
+}  // namespace tensorflow
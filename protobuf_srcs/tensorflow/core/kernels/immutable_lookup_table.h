@@ -0,0 +1,168 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_IMMUTABLE_LOOKUP_TABLE_H_
+#define TENSORFLOW_CORE_KERNELS_IMMUTABLE_LOOKUP_TABLE_H_
+
+#include <atomic>
+#include <memory>
+
+#include "tensorflow/core/framework/lookup_interface.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// Writes the entries given by the 1-D 'keys' and 'values' tensors to
+// 'filename' as an immutable hash table, which can be loaded with
+// ImmutableHashTable. Keys must be int64 or string, values int64 or string.
+// Repeated keys must have the same value. The file is written under a unique
+// temporary name and renamed, so concurrent writers do not interfere.
+//
+// The file consists of a 64-byte header, an open-addressing array of 32-byte
+// slots whose size is a power of two, and a data section holding the bytes
+// of all string keys and values. A lookup hashes the key with Hash64() and
+// probes the slots linearly from the hash modulo the number of slots. All
+// integers are little-endian.
+Status WriteImmutableHashTable(Env* env, const string& filename,
+                               const Tensor& keys, const Tensor& values);
+
+// A read-only lookup table backed by a memory-mapped file written by
+// WriteImmutableHashTable(). The table is empty until it is loaded by the
+// InitializeImmutableHashTableFromFile op, whose filename input is typically
+// an asset of a SavedModel.
+//
+// Loading the table only maps the file, so it takes constant time and pages
+// are read on demand by lookups. Tables loaded from the same unmodified file
+// share one mapping within the process, for example across model versions,
+// and the page cache is shared with other processes mapping the file.
+class ImmutableHashTable : public LookupInterface {
+ public:
+  // Creates a table of the "key_dtype" and "value_dtype" attrs of 'kernel'.
+  // Errors are reported through 'ctx'.
+  ImmutableHashTable(OpKernelContext* ctx, OpKernel* kernel);
+
+  ImmutableHashTable(DataType key_dtype, DataType value_dtype)
+      : key_dtype_(key_dtype), value_dtype_(value_dtype) {}
+
+  // Maps 'filename'. Fails if the file is malformed or its key and value
+  // types differ from the types of this table. Loading a table again is a
+  // no-op if it is from the same file, and fails otherwise.
+  Status Load(Env* env, const string& filename);
+
+  Status Find(OpKernelContext* ctx, const Tensor& keys, Tensor* values,
+              const Tensor& default_value) override;
+
+  Status Insert(OpKernelContext* ctx, const Tensor& keys,
+                const Tensor& values) override {
+    return errors::Unimplemented("ImmutableHashTable does not support Insert");
+  }
+
+  Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
+    return errors::Unimplemented("ImmutableHashTable does not support Remove");
+  }
+
+  Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
+                      const Tensor& values) override {
+    return errors::Unimplemented(
+        "ImmutableHashTable does not support ImportValues");
+  }
+
+  Status ExportValues(OpKernelContext* ctx) override;
+
+  size_t size() const override {
+    return loaded_.load(std::memory_order_acquire) ? num_entries_ : 0;
+  }
+
+  DataType key_dtype() const override { return key_dtype_; }
+
+  DataType value_dtype() const override { return value_dtype_; }
+
+  TensorShape key_shape() const override { return TensorShape(); }
+
+  TensorShape value_shape() const override { return TensorShape(); }
+
+  // The size of the mapping. Its pages are backed by the file and may be
+  // shared with other tables and processes.
+  int64 MemoryUsed() const override;
+
+  // File layout, see WriteImmutableHashTable().
+  struct FileHeader {
+    char magic[8];
+    uint32 key_dtype;
+    uint32 value_dtype;
+    uint64 num_entries;
+    uint64 num_slots;
+    uint64 slots_offset;
+    uint64 data_offset;
+    uint64 data_size;
+    uint64 reserved;
+  };
+
+  struct Slot {
+    // The int64 key or value, or the offset of its bytes in the data section.
+    uint64 key;
+    uint64 value;
+    // The length of a string key or value.
+    uint32 key_size;
+    uint32 value_size;
+    // The high 32 bits of the hash of the key with the lowest bit set, or 0
+    // for an empty slot.
+    uint32 tag;
+    uint32 reserved;
+  };
+
+ private:
+  // Returns the slot holding 'key', or nullptr.
+  const Slot* FindSlot(uint64 hash, const char* key_data, size_t key_size,
+                       int64 int_key) const;
+
+  template <typename V>
+  Status FindWithValueType(const Tensor& keys, Tensor* values,
+                           const Tensor& default_value) const;
+
+  // Reads the value of 'slot'.
+  Status ReadValue(const Slot& slot, int64* value) const;
+  Status ReadValue(const Slot& slot, tstring* value) const;
+
+  DataType key_dtype_;
+  DataType value_dtype_;
+
+  mutex mu_;
+  string filename_ GUARDED_BY(mu_);
+  // Set once the fields below are, which are not modified afterwards.
+  std::atomic<bool> loaded_{false};
+  std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const Slot* slots_ = nullptr;
+  const char* data_ = nullptr;
+  uint64 data_size_ = 0;
+  uint64 num_slots_ = 0;
+  uint64 num_entries_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ImmutableHashTable);
+};
+
+}  // namespace lookup
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_IMMUTABLE_LOOKUP_TABLE_H_
@@ -0,0 +1,287 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/immutable_lookup_table.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/lookup_table_op.h"
+#include "tensorflow/core/kernels/lookup_util.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+string TablePath(const string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+template <class K, class V>
+Status WriteTable(const string& path, const std::vector<K>& keys,
+                  const std::vector<V>& values) {
+  return WriteImmutableHashTable(Env::Default(), path, test::AsTensor<K>(keys),
+                                 test::AsTensor<V>(values));
+}
+
+template <class K, class V>
+std::vector<V> Find(LookupInterface* table, const std::vector<K>& keys,
+                    V default_value) {
+  Tensor keys_tensor = test::AsTensor<K>(keys);
+  Tensor values_tensor(DataTypeToEnum<V>::v(),
+                       TensorShape({static_cast<int64>(keys.size())}));
+  TF_CHECK_OK(table->Find(nullptr, keys_tensor, &values_tensor,
+                          test::AsScalar<V>(default_value)));
+  auto flat = values_tensor.flat<V>();
+  return std::vector<V>(flat.data(), flat.data() + flat.size());
+}
+
+TEST(ImmutableHashTableTest, StringToInt) {
+  const string path = TablePath("string_to_int.tfht");
+  TF_ASSERT_OK(WriteTable<tstring, int64>(
+      path, {"brain", "", "salad", "brain"}, {0, 1, 2, 0}));
+  auto* table = new ImmutableHashTable(DT_STRING, DT_INT64);
+  core::ScopedUnref unref(table);
+  TF_ASSERT_OK(table->Load(Env::Default(), path));
+  // Repeated keys are stored once.
+  EXPECT_EQ(3, table->size());
+  EXPECT_EQ(std::vector<int64>({2, 1, -1, 0}),
+            Find<tstring, int64>(table, {"salad", "", "surgery", "brain"}, -1));
+  EXPECT_TRUE(errors::IsUnimplemented(table->Insert(
+      nullptr, test::AsTensor<tstring>({"x"}), test::AsTensor<int64>({1}))));
+}
+
+TEST(ImmutableHashTableTest, IntToString) {
+  const string path = TablePath("int_to_string.tfht");
+  std::vector<int64> keys;
+  std::vector<tstring> values;
+  for (int64 i = 0; i < 10000; ++i) {
+    keys.push_back(i * 7919 - 5000);
+    values.push_back(strings::StrCat("value_", i));
+  }
+  TF_ASSERT_OK(WriteTable(path, keys, values));
+  auto* table = new ImmutableHashTable(DT_INT64, DT_STRING);
+  core::ScopedUnref unref(table);
+  TF_ASSERT_OK(table->Load(Env::Default(), path));
+  EXPECT_EQ(10000, table->size());
+  EXPECT_EQ(std::vector<tstring>({"value_0", "value_9999", "?", "value_42"}),
+            Find<int64, tstring>(
+                table, {-5000, 9999 * 7919 - 5000, 1, 42 * 7919 - 5000},
+                "?"));
+}
+
+TEST(ImmutableHashTableTest, ReloadsRewrittenFile) {
+  const string path = TablePath("rewritten.tfht");
+  TF_ASSERT_OK(WriteTable<int64, int64>(path, {1}, {10}));
+  auto* old_table = new ImmutableHashTable(DT_INT64, DT_INT64);
+  core::ScopedUnref unref_old_table(old_table);
+  TF_ASSERT_OK(old_table->Load(Env::Default(), path));
+
+  // The rewritten file has a different size, so it is not mistaken for the
+  // mapping held by 'old_table'.
+  std::vector<int64> keys;
+  for (int64 i = 0; i < 100; ++i) keys.push_back(i);
+  TF_ASSERT_OK(WriteTable(path, keys, keys));
+  auto* new_table = new ImmutableHashTable(DT_INT64, DT_INT64);
+  core::ScopedUnref unref_new_table(new_table);
+  TF_ASSERT_OK(new_table->Load(Env::Default(), path));
+  EXPECT_EQ(std::vector<int64>({10, -1}),
+            Find<int64, int64>(old_table, {1, 2}, -1));
+  EXPECT_EQ(std::vector<int64>({1, 2}),
+            Find<int64, int64>(new_table, {1, 2}, -1));
+}
+
+TEST(ImmutableHashTableTest, LoadsOnce) {
+  const string path = TablePath("once.tfht");
+  const string other_path = TablePath("once_other.tfht");
+  TF_ASSERT_OK(WriteTable<int64, int64>(path, {1}, {10}));
+  TF_ASSERT_OK(WriteTable<int64, int64>(other_path, {1}, {20}));
+
+  auto* table = new ImmutableHashTable(DT_INT64, DT_INT64);
+  core::ScopedUnref unref(table);
+  Tensor values(DT_INT64, TensorShape({1}));
+  Status s = table->Find(nullptr, test::AsTensor<int64>({1}), &values,
+                         test::AsScalar<int64>(-1));
+  EXPECT_TRUE(errors::IsFailedPrecondition(s)) << s;
+  EXPECT_EQ(0, table->size());
+
+  TF_ASSERT_OK(table->Load(Env::Default(), path));
+  TF_ASSERT_OK(table->Load(Env::Default(), path));
+  s = table->Load(Env::Default(), other_path);
+  EXPECT_TRUE(errors::IsFailedPrecondition(s)) << s;
+  EXPECT_EQ(std::vector<int64>({10}), Find<int64, int64>(table, {1}, -1));
+}
+
+TEST(ImmutableHashTableTest, ConcurrentWriters) {
+  const string path = TablePath("concurrent.tfht");
+  {
+    thread::ThreadPool pool(Env::Default(), "writers", 4);
+    for (int64 i = 0; i < 8; ++i) {
+      pool.Schedule([&path, i]() {
+        std::vector<int64> keys;
+        for (int64 key = 0; key < 1000; ++key) keys.push_back(key);
+        TF_EXPECT_OK(WriteTable(path, keys, std::vector<int64>(1000, i)));
+      });
+    }
+  }
+  auto* table = new ImmutableHashTable(DT_INT64, DT_INT64);
+  core::ScopedUnref unref(table);
+  TF_ASSERT_OK(table->Load(Env::Default(), path));
+  EXPECT_EQ(1000, table->size());
+  const std::vector<int64> values = Find<int64, int64>(table, {0, 999}, -1);
+  EXPECT_EQ(values[0], values[1]);
+
+  std::vector<string> leftovers;
+  TF_ASSERT_OK(Env::Default()->GetMatchingPaths(
+      strings::StrCat(path, "*.tmp"), &leftovers));
+  EXPECT_TRUE(leftovers.empty());
+}
+
+TEST(ImmutableHashTableTest, Errors) {
+  const string path = TablePath("errors.tfht");
+  Status s = WriteTable<tstring, int64>(path, {"a", "b", "a"}, {0, 1, 2});
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  s = WriteTable<tstring, float>(path, {"a"}, {0.5});
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+
+  TF_ASSERT_OK(WriteTable<tstring, int64>(path, {"a", "b"}, {0, 1}));
+  auto* int_table = new ImmutableHashTable(DT_INT64, DT_INT64);
+  core::ScopedUnref unref_int_table(int_table);
+  s = int_table->Load(Env::Default(), path);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  const string truncated_path = TablePath("truncated.tfht");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), truncated_path,
+                                 contents.substr(0, contents.size() - 1)));
+  auto* table = new ImmutableHashTable(DT_STRING, DT_INT64);
+  core::ScopedUnref unref(table);
+  s = table->Load(Env::Default(), truncated_path);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+
+  const string vocab_path = TablePath("vocab.txt");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), vocab_path,
+                                 string(1000, 'x')));
+  s = table->Load(Env::Default(), vocab_path);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+}
+
+const int64 kBenchmarkEntries = 1000000;
+
+tstring MakeKey(int64 i) { return strings::StrCat("token_", i); }
+
+// Writes a vocabulary of kBenchmarkEntries words both as a text file and as an
+// immutable hash table.
+void WriteBenchmarkVocab(string* text_path, string* table_path) {
+  *text_path = TablePath("vocab_bm.txt");
+  *table_path = TablePath("vocab_bm.tfht");
+  string contents;
+  Tensor keys(DT_STRING, TensorShape({kBenchmarkEntries}));
+  Tensor values(DT_INT64, TensorShape({kBenchmarkEntries}));
+  for (int64 i = 0; i < kBenchmarkEntries; ++i) {
+    keys.flat<tstring>()(i) = MakeKey(i);
+    values.flat<int64>()(i) = i;
+    strings::StrAppend(&contents, MakeKey(i), "\n");
+  }
+  TF_CHECK_OK(WriteStringToFile(Env::Default(), *text_path, contents));
+  TF_CHECK_OK(
+      WriteImmutableHashTable(Env::Default(), *table_path, keys, values));
+}
+
+// Loads a vocabulary from a text file into a HashTable, as done by the
+// InitializeTableFromTextFile op. The label reports the memory used per
+// entry.
+static void BM_LoadVocabFromTextFile(int iters) {
+  testing::StopTiming();
+  string text_path, table_path;
+  WriteBenchmarkVocab(&text_path, &table_path);
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkEntries);
+  int64 memory_used = 0;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    auto* table = new HashTable<tstring, int64>(nullptr, nullptr);
+    TF_CHECK_OK(InitializeTableFromTextFile(
+        text_path, kBenchmarkEntries, '\t', -2 /*key_index*/,
+        -1 /*value_index*/, Env::Default(), nullptr, table));
+    memory_used = table->MemoryUsed();
+    table->Unref();
+  }
+  testing::StopTiming();
+  testing::SetLabel(
+      strings::StrCat("bytes/entry: ", memory_used / kBenchmarkEntries));
+}
+BENCHMARK(BM_LoadVocabFromTextFile);
+
+// Loads the same vocabulary as an ImmutableHashTable. A new table is loaded
+// in every iteration while the previous one is still alive, like a new model
+// version, so the mapping is shared. The memory used is backed by the file.
+static void BM_LoadVocabImmutable(int iters) {
+  testing::StopTiming();
+  string text_path, table_path;
+  WriteBenchmarkVocab(&text_path, &table_path);
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkEntries);
+  auto* previous = new ImmutableHashTable(DT_STRING, DT_INT64);
+  TF_CHECK_OK(previous->Load(Env::Default(), table_path));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    auto* table = new ImmutableHashTable(DT_STRING, DT_INT64);
+    TF_CHECK_OK(table->Load(Env::Default(), table_path));
+    previous->Unref();
+    previous = table;
+  }
+  testing::StopTiming();
+  testing::SetLabel(strings::StrCat(
+      "bytes/entry: ", previous->MemoryUsed() / kBenchmarkEntries));
+  previous->Unref();
+}
+BENCHMARK(BM_LoadVocabImmutable);
+
+// Looks up batches of 1024 keys, half of which are in the vocabulary.
+static void BM_ImmutableHashTableFind(int iters) {
+  testing::StopTiming();
+  string text_path, table_path;
+  WriteBenchmarkVocab(&text_path, &table_path);
+  auto* table = new ImmutableHashTable(DT_STRING, DT_INT64);
+  core::ScopedUnref unref(table);
+  TF_CHECK_OK(table->Load(Env::Default(), table_path));
+  const int kBatchSize = 1024;
+  Tensor batch(DT_STRING, TensorShape({kBatchSize}));
+  for (int i = 0; i < kBatchSize; ++i) {
+    batch.flat<tstring>()(i) =
+        MakeKey((i * 104729) % (2 * kBenchmarkEntries));
+  }
+  Tensor result(DT_INT64, TensorShape({kBatchSize}));
+  const Tensor default_value = test::AsScalar<int64>(-1);
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBatchSize);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(table->Find(nullptr, batch, &result, default_value));
+  }
+}
+BENCHMARK(BM_ImmutableHashTableFind);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
@@ -0,0 +1,513 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/ivf_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <utility>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/memory_region_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/byte_order.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kMagic[8] = {'T', 'F', 'I', 'V', 'F', 'I', '0', '1'};
+
+static_assert(sizeof(IvfIndex::FileHeader) == 64,
+              "FileHeader is part of the file format");
+
+// Limits that keep the size of every section of a file below 2^63 bytes.
+constexpr uint64 kMaxDimension = 1 << 16;
+constexpr uint64 kMaxVectors = 1ULL << 40;
+
+// Number of rows assigned to centroids by a single matrix product.
+constexpr int64 kAssignBlockSize = 256;
+
+// Number of vectors written to a file by a single Append().
+constexpr int64 kWriteBlockSize = 4096;
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<const Eigen::VectorXf> ConstVectorMap;
+
+// A score and the id of the scored vector.
+typedef std::pair<float, int64> ScoredId;
+
+// Orders by decreasing score, then by increasing id.
+bool Closer(const ScoredId& a, const ScoredId& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+// Offsets of the sections of an index file, see WriteIvfIndex().
+struct Layout {
+  Layout(uint64 dimension, uint64 num_lists, uint64 num_vectors) {
+    uint64 offset = sizeof(IvfIndex::FileHeader);
+    centroids = offset;
+    offset += RoundUp(num_lists * dimension * sizeof(float));
+    list_begin = offset;
+    offset += (num_lists + 1) * sizeof(uint64);
+    ids = offset;
+    offset += num_vectors * sizeof(int64);
+    squared_norms = offset;
+    offset += RoundUp(num_vectors * sizeof(float));
+    vectors = offset;
+    offset += num_vectors * dimension * sizeof(float);
+    size = offset;
+  }
+
+  static uint64 RoundUp(uint64 n) { return (n + 7) / 8 * 8; }
+
+  uint64 centroids;
+  uint64 list_begin;
+  uint64 ids;
+  uint64 squared_norms;
+  uint64 vectors;
+  uint64 size;
+};
+
+// Runs 'fn' over [0, total) on 'workers', or inline if 'workers' is null.
+void ParallelFor(thread::ThreadPool* workers, int64 total, int64 cost_per_unit,
+                 const std::function<void(int64, int64)>& fn) {
+  if (workers == nullptr) {
+    fn(0, total);
+  } else {
+    Shard(workers->NumThreads(), workers, total, cost_per_unit, fn);
+  }
+}
+
+// Sets 'assignment' to the index of the closest of the 'centroids' to each
+// of the 'num_rows' rows.
+void AssignToCentroids(const float* rows, int64 num_rows,
+                       const Matrix& centroids, IvfMetric metric,
+                       thread::ThreadPool* workers,
+                       std::vector<int64>* assignment) {
+  const int64 dimension = centroids.cols();
+  // The centroid c closest to x in euclidean distance maximizes
+  // <x, c> - |c|^2 / 2.
+  Eigen::VectorXf bias = Eigen::VectorXf::Zero(centroids.rows());
+  if (metric == IvfMetric::kSquaredL2) {
+    bias = -0.5f * centroids.rowwise().squaredNorm();
+  }
+  assignment->resize(num_rows);
+  const int64 num_blocks = (num_rows + kAssignBlockSize - 1) / kAssignBlockSize;
+  ParallelFor(workers, num_blocks,
+              kAssignBlockSize * centroids.rows() * dimension * 2,
+              [&](int64 start, int64 limit) {
+                for (int64 b = start; b < limit; ++b) {
+                  const int64 begin = b * kAssignBlockSize;
+                  const int64 n = std::min(kAssignBlockSize, num_rows - begin);
+                  ConstMatrixMap block(rows + begin * dimension, n, dimension);
+                  Matrix scores = block * centroids.transpose();
+                  scores.rowwise() += bias.transpose();
+                  for (int64 i = 0; i < n; ++i) {
+                    Eigen::Index best;
+                    scores.row(i).maxCoeff(&best);
+                    (*assignment)[begin + i] = best;
+                  }
+                }
+              });
+}
+
+// Appends zeros to 'file' up to a multiple of 8 bytes after 'size' bytes.
+Status Pad(WritableFile* file, uint64 size) {
+  static const char kZeros[8] = {};
+  return file->Append(StringPiece(kZeros, Layout::RoundUp(size) - size));
+}
+
+template <typename T>
+Status Append(WritableFile* file, const T* data, uint64 n) {
+  return file->Append(
+      StringPiece(reinterpret_cast<const char*>(data), n * sizeof(T)));
+}
+
+// The parts of a loaded index read by a search.
+struct IndexView {
+  IvfMetric metric;
+  int64 dimension;
+  const uint64* list_begin;
+  const int64* ids;
+  const float* squared_norms;
+  const float* vectors;
+};
+
+// Appends the (at most) 'k' vectors of 'list' closest to 'query' to 'top_k'.
+void SearchList(const IndexView& index, const float* query,
+                float query_squared_norm, int64 list, int k,
+                std::vector<ScoredId>* top_k) {
+  const uint64 begin = index.list_begin[list];
+  const int64 n = index.list_begin[list + 1] - begin;
+  if (n == 0 || k == 0) return;
+  ConstMatrixMap vectors(index.vectors + begin * index.dimension, n,
+                         index.dimension);
+  Eigen::VectorXf scores = vectors * ConstVectorMap(query, index.dimension);
+  if (index.metric == IvfMetric::kSquaredL2) {
+    // -|q - v|^2 = 2 <q, v> - |v|^2 - |q|^2.
+    scores = (2.0f * scores.array() -
+              ConstVectorMap(index.squared_norms + begin, n).array() -
+              query_squared_norm)
+                 .matrix();
+  }
+  std::vector<ScoredId> candidates(n);
+  for (int64 i = 0; i < n; ++i) {
+    candidates[i] = ScoredId(scores[i], index.ids[begin + i]);
+  }
+  if (n > k) {
+    std::nth_element(candidates.begin(), candidates.begin() + k,
+                     candidates.end(), Closer);
+    candidates.resize(k);
+  }
+  top_k->insert(top_k->end(), candidates.begin(), candidates.end());
+}
+
+}  // namespace
+
+Status ParseIvfMetric(const string& name, IvfMetric* metric) {
+  if (name == "dot_product") {
+    *metric = IvfMetric::kDotProduct;
+  } else if (name == "squared_l2") {
+    *metric = IvfMetric::kSquaredL2;
+  } else {
+    return errors::InvalidArgument("Unknown metric: ", name);
+  }
+  return Status::OK();
+}
+
+Status WriteIvfIndex(Env* env, const string& filename,
+                     const Tensor& embeddings, const Tensor& ids,
+                     const IvfIndexOptions& options,
+                     thread::ThreadPool* workers) {
+  if (!port::kLittleEndian) {
+    return errors::Unimplemented(
+        "IvfIndex is only supported on little-endian hosts");
+  }
+  if (embeddings.dtype() != DT_FLOAT ||
+      !TensorShapeUtils::IsMatrix(embeddings.shape())) {
+    return errors::InvalidArgument(
+        "embeddings must be a float matrix, got ",
+        DataTypeString(embeddings.dtype()), " ",
+        embeddings.shape().DebugString());
+  }
+  const int64 num_vectors = embeddings.dim_size(0);
+  const int64 dimension = embeddings.dim_size(1);
+  if (ids.dtype() != DT_INT64 || !TensorShapeUtils::IsVector(ids.shape()) ||
+      ids.NumElements() != num_vectors) {
+    return errors::InvalidArgument(
+        "ids must be an int64 vector with one id per row of embeddings, got ",
+        DataTypeString(ids.dtype()), " ", ids.shape().DebugString());
+  }
+  if (dimension == 0 || dimension > kMaxDimension) {
+    return errors::InvalidArgument("embeddings must have between 1 and ",
+                                   kMaxDimension, " columns, got ", dimension);
+  }
+  if (num_vectors > kMaxVectors) {
+    return errors::InvalidArgument("Too many embeddings: ", num_vectors);
+  }
+  const int64 num_lists = options.num_lists;
+  if (num_lists < 1 || num_lists > num_vectors) {
+    return errors::InvalidArgument("num_lists must be in [1, ", num_vectors,
+                                   "], got ", num_lists);
+  }
+  if (options.num_iterations < 0 || options.max_samples_per_list < 1) {
+    return errors::InvalidArgument(
+        "num_iterations must be >= 0 and max_samples_per_list >= 1, got ",
+        options.num_iterations, " and ", options.max_samples_per_list);
+  }
+  const float* data = embeddings.flat<float>().data();
+  const ConstMatrixMap rows(data, num_vectors, dimension);
+
+  // Trains k-means on a random sample of the rows, starting from the first
+  // rows of the sample.
+  const int64 num_samples =
+      std::min(num_vectors, num_lists * options.max_samples_per_list);
+  std::vector<int64> sample(num_vectors);
+  std::iota(sample.begin(), sample.end(), 0);
+  std::mt19937_64 rng(options.seed);
+  for (int64 i = 0; i < num_samples; ++i) {
+    std::uniform_int_distribution<int64> uniform(i, num_vectors - 1);
+    std::swap(sample[i], sample[uniform(rng)]);
+  }
+  Matrix samples(num_samples, dimension);
+  for (int64 i = 0; i < num_samples; ++i) {
+    samples.row(i) = rows.row(sample[i]);
+  }
+  sample = std::vector<int64>();
+  Matrix centroids = samples.topRows(num_lists);
+  std::vector<int64> assignment;
+  for (int iteration = 0; iteration < options.num_iterations; ++iteration) {
+    AssignToCentroids(samples.data(), num_samples, centroids, options.metric,
+                      workers, &assignment);
+    Matrix sums = Matrix::Zero(num_lists, dimension);
+    std::vector<int64> counts(num_lists, 0);
+    for (int64 i = 0; i < num_samples; ++i) {
+      sums.row(assignment[i]) += samples.row(i);
+      ++counts[assignment[i]];
+    }
+    // The centroids of empty lists are kept.
+    for (int64 c = 0; c < num_lists; ++c) {
+      if (counts[c] > 0) {
+        centroids.row(c) = sums.row(c) / static_cast<float>(counts[c]);
+      }
+    }
+  }
+
+  // Groups all rows by their closest centroid.
+  AssignToCentroids(data, num_vectors, centroids, options.metric, workers,
+                    &assignment);
+  std::vector<uint64> list_begin(num_lists + 1, 0);
+  for (int64 i = 0; i < num_vectors; ++i) ++list_begin[assignment[i] + 1];
+  std::partial_sum(list_begin.begin(), list_begin.end(), list_begin.begin());
+  std::vector<uint64> next(list_begin.begin(), list_begin.end() - 1);
+  std::vector<int64> order(num_vectors);
+  for (int64 i = 0; i < num_vectors; ++i) order[next[assignment[i]]++] = i;
+  std::vector<int64> sorted_ids(num_vectors);
+  std::vector<float> squared_norms(num_vectors);
+  const auto id_values = ids.flat<int64>();
+  for (int64 i = 0; i < num_vectors; ++i) {
+    sorted_ids[i] = id_values(order[i]);
+    squared_norms[i] = rows.row(order[i]).squaredNorm();
+  }
+
+  IvfIndex::FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.metric = static_cast<uint32>(options.metric);
+  header.dimension = dimension;
+  header.num_lists = num_lists;
+  header.num_vectors = num_vectors;
+
+  // Readers may have mapped an older version of the file, so the new
+  // version is written to a unique temporary file and renamed.
+  string tmp_filename = filename;
+  if (!env->CreateUniqueFileName(&tmp_filename, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file name for ",
+                            filename);
+  }
+  auto write_file = [&]() -> Status {
+    std::unique_ptr<WritableFile> file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(tmp_filename, &file));
+    TF_RETURN_IF_ERROR(Append(file.get(), &header, 1));
+    TF_RETURN_IF_ERROR(
+        Append(file.get(), centroids.data(), num_lists * dimension));
+    TF_RETURN_IF_ERROR(Pad(file.get(), num_lists * dimension * sizeof(float)));
+    TF_RETURN_IF_ERROR(Append(file.get(), list_begin.data(), num_lists + 1));
+    TF_RETURN_IF_ERROR(Append(file.get(), sorted_ids.data(), num_vectors));
+    TF_RETURN_IF_ERROR(Append(file.get(), squared_norms.data(), num_vectors));
+    TF_RETURN_IF_ERROR(Pad(file.get(), num_vectors * sizeof(float)));
+    std::vector<float> block;
+    for (int64 begin = 0; begin < num_vectors; begin += kWriteBlockSize) {
+      const int64 end = std::min(begin + kWriteBlockSize, num_vectors);
+      block.resize((end - begin) * dimension);
+      for (int64 i = begin; i < end; ++i) {
+        memcpy(&block[(i - begin) * dimension], data + order[i] * dimension,
+               dimension * sizeof(float));
+      }
+      TF_RETURN_IF_ERROR(Append(file.get(), block.data(), block.size()));
+    }
+    return file->Close();
+  };
+  Status s = write_file();
+  if (s.ok()) s = env->RenameFile(tmp_filename, filename);
+  if (!s.ok()) env->DeleteFile(tmp_filename).IgnoreError();
+  return s;
+}
+
+Status IvfIndex::Load(Env* env, const string& filename) {
+  mutex_lock l(mu_);
+  if (region_ != nullptr) {
+    if (filename == filename_) return Status::OK();
+    return errors::FailedPrecondition("IvfIndex was already loaded from ",
+                                      filename_, ", cannot load ", filename);
+  }
+  if (!port::kLittleEndian) {
+    return errors::Unimplemented(
+        "IvfIndex is only supported on little-endian hosts");
+  }
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  TF_RETURN_IF_ERROR(NewReadOnlyMemoryRegionOrReadFile(env, filename, &region));
+
+  const char* base = static_cast<const char*>(region->data());
+  const uint64 length = region->length();
+  FileHeader header;
+  if (length < sizeof(header)) {
+    return errors::DataLoss("IvfIndex file ", filename, " is truncated");
+  }
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return errors::DataLoss(filename, " is not an IvfIndex file");
+  }
+  if (header.metric > static_cast<uint32>(IvfMetric::kSquaredL2) ||
+      header.dimension == 0 || header.dimension > kMaxDimension ||
+      header.num_lists == 0 || header.num_vectors > kMaxVectors ||
+      header.num_lists > header.num_vectors) {
+    return errors::DataLoss("IvfIndex file ", filename, " is corrupted");
+  }
+  const Layout layout(header.dimension, header.num_lists, header.num_vectors);
+  if (length != layout.size) {
+    return errors::DataLoss("IvfIndex file ", filename, " has ", length,
+                            " bytes, expected ", layout.size);
+  }
+  const uint64* list_begin =
+      reinterpret_cast<const uint64*>(base + layout.list_begin);
+  bool valid_lists = list_begin[0] == 0 &&
+                     list_begin[header.num_lists] == header.num_vectors;
+  for (uint64 i = 0; valid_lists && i < header.num_lists; ++i) {
+    valid_lists = list_begin[i] <= list_begin[i + 1];
+  }
+  if (!valid_lists) {
+    return errors::DataLoss("IvfIndex file ", filename, " is corrupted");
+  }
+
+  filename_ = filename;
+  metric_ = static_cast<IvfMetric>(header.metric);
+  dimension_ = header.dimension;
+  num_lists_ = header.num_lists;
+  num_vectors_ = header.num_vectors;
+  centroids_ = reinterpret_cast<const float*>(base + layout.centroids);
+  list_begin_ = list_begin;
+  ids_ = reinterpret_cast<const int64*>(base + layout.ids);
+  squared_norms_ = reinterpret_cast<const float*>(base + layout.squared_norms);
+  vectors_ = reinterpret_cast<const float*>(base + layout.vectors);
+  centroid_squared_norms_.resize(num_lists_);
+  Eigen::Map<Eigen::VectorXf>(centroid_squared_norms_.data(), num_lists_) =
+      ConstMatrixMap(centroids_, num_lists_, dimension_)
+          .rowwise()
+          .squaredNorm();
+  region_ = std::move(region);
+  return Status::OK();
+}
+
+Status IvfIndex::Search(const DeviceBase::CpuWorkerThreads& worker_threads,
+                        const float* queries, int64 num_queries, int k,
+                        int num_probes, float* scores, int64* ids) const {
+  tf_shared_lock l(mu_);
+  if (region_ == nullptr) {
+    return errors::FailedPrecondition("IvfIndex is not loaded.");
+  }
+  if (k < 0 || num_probes < 1) {
+    return errors::InvalidArgument(
+        "k must be >= 0 and num_probes >= 1, got ", k, " and ", num_probes);
+  }
+  if (num_queries == 0 || k == 0) return Status::OK();
+
+  const int64 dimension = dimension_;
+  const int64 num_lists = num_lists_;
+  const int64 probes = std::min<int64>(num_probes, num_lists);
+  const IndexView index{metric_, dimension_,     list_begin_,
+                        ids_,    squared_norms_, vectors_};
+  const ConstMatrixMap centroids(centroids_, num_lists, dimension);
+  const ConstVectorMap centroid_squared_norms(centroid_squared_norms_.data(),
+                                              num_lists);
+
+  // Finds the lists with the closest centroids to each query.
+  std::vector<int64> probed(num_queries * probes);
+  std::vector<float> query_squared_norms(num_queries);
+  auto select_lists = [&](int64 start, int64 limit) {
+    std::vector<ScoredId> list_scores(num_lists);
+    for (int64 q = start; q < limit; ++q) {
+      const ConstVectorMap query(queries + q * dimension, dimension);
+      query_squared_norms[q] = query.squaredNorm();
+      Eigen::VectorXf s = centroids * query;
+      if (index.metric == IvfMetric::kSquaredL2) {
+        s -= 0.5f * centroid_squared_norms;
+      }
+      for (int64 c = 0; c < num_lists; ++c) list_scores[c] = ScoredId(s[c], c);
+      std::partial_sort(list_scores.begin(), list_scores.begin() + probes,
+                        list_scores.end(), Closer);
+      for (int64 p = 0; p < probes; ++p) {
+        probed[q * probes + p] = list_scores[p].second;
+      }
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers, num_queries,
+        num_lists * (dimension * 2 + 10), select_lists);
+
+  // Searches the probed lists of all queries in parallel, which keeps all
+  // threads busy even for a single query.
+  std::vector<std::vector<ScoredId>> candidates(num_queries * probes);
+  auto search_lists = [&](int64 start, int64 limit) {
+    for (int64 i = start; i < limit; ++i) {
+      const int64 q = i / probes;
+      SearchList(index, queries + q * dimension, query_squared_norms[q],
+                 probed[i], k, &candidates[i]);
+    }
+  };
+  const int64 average_list_size = num_vectors_ / num_lists + 1;
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_queries * probes, average_list_size * (dimension * 2 + 10),
+        search_lists);
+
+  auto merge = [&](int64 start, int64 limit) {
+    std::vector<ScoredId> top_k;
+    for (int64 q = start; q < limit; ++q) {
+      top_k.clear();
+      for (int64 i = q * probes; i < (q + 1) * probes; ++i) {
+        top_k.insert(top_k.end(), candidates[i].begin(), candidates[i].end());
+      }
+      const int64 n = std::min<int64>(k, top_k.size());
+      std::partial_sort(top_k.begin(), top_k.begin() + n, top_k.end(), Closer);
+      for (int64 i = 0; i < k; ++i) {
+        if (i < n) {
+          scores[q * k + i] = top_k[i].first;
+          ids[q * k + i] = top_k[i].second;
+        } else {
+          scores[q * k + i] = std::numeric_limits<float>::lowest();
+          ids[q * k + i] = -1;
+        }
+      }
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers, num_queries,
+        probes * k * 20, merge);
+  return Status::OK();
+}
+
+bool IvfIndex::is_loaded() const {
+  tf_shared_lock l(mu_);
+  return region_ != nullptr;
+}
+
+int64 IvfIndex::dimension() const {
+  tf_shared_lock l(mu_);
+  return dimension_;
+}
+
+int64 IvfIndex::size() const {
+  tf_shared_lock l(mu_);
+  return num_vectors_;
+}
+
+string IvfIndex::DebugString() const {
+  tf_shared_lock l(mu_);
+  return strings::StrCat("IvfIndex(", filename_, ")");
+}
+
+int64 IvfIndex::MemoryUsed() const {
+  tf_shared_lock l(mu_);
+  return region_ == nullptr ? 0 : region_->length();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,137 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_IVF_INDEX_H_
+#define TENSORFLOW_CORE_KERNELS_IVF_INDEX_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// How the similarity of a query and an indexed vector is scored. Larger
+// scores are closer.
+enum class IvfMetric {
+  // The inner product of the query and the vector.
+  kDotProduct = 0,
+  // The negative squared euclidean distance between the query and the vector.
+  kSquaredL2 = 1,
+};
+
+// Parses "dot_product" or "squared_l2".
+Status ParseIvfMetric(const string& name, IvfMetric* metric);
+
+struct IvfIndexOptions {
+  IvfMetric metric = IvfMetric::kDotProduct;
+  // Number of inverted lists, i.e. of k-means clusters.
+  int64 num_lists = 1024;
+  // Number of iterations of k-means.
+  int num_iterations = 10;
+  // At most this many vectors per list are sampled to train k-means.
+  int64 max_samples_per_list = 256;
+  // Seed of the sampling and of the initial centroids.
+  int64 seed = 0;
+};
+
+// Writes an inverted file index of the rows of the 2-D float 'embeddings'
+// tensor, identified by the 1-D int64 'ids' tensor, to 'filename'. The rows
+// are clustered by k-means into 'options.num_lists' lists, each scored by its
+// centroid. 'workers' parallelizes the clustering and may be null.
+//
+// The file consists of a 64-byte header followed by the centroids, the
+// offset of every list in the arrays of ids and vectors, the ids, the
+// squared norms and the vectors, each grouped by list and aligned to 8
+// bytes. All numbers are little-endian.
+Status WriteIvfIndex(Env* env, const string& filename,
+                     const Tensor& embeddings, const Tensor& ids,
+                     const IvfIndexOptions& options,
+                     thread::ThreadPool* workers);
+
+// A read-only approximate nearest neighbor index loaded from a file written
+// by WriteIvfIndex(), held in a ResourceMgr.
+//
+// A search scores the query against all centroids, and then exhaustively
+// against the vectors of the 'num_probes' lists with the closest centroids.
+// Scores are computed as matrix-vector products by Eigen, which vectorizes
+// them, and queries and lists are searched in parallel.
+class IvfIndex : public ResourceBase {
+ public:
+  IvfIndex() = default;
+
+  // Maps 'filename'. Fails if the file is malformed, or if the index was
+  // already loaded from a different file.
+  Status Load(Env* env, const string& filename) LOCKS_EXCLUDED(mu_);
+
+  // Finds the 'k' vectors closest to each row of the [num_queries,
+  // dimension()] 'queries', storing their scores in decreasing order and
+  // their ids in the [num_queries, k] 'scores' and 'ids'. Missing results,
+  // when the probed lists have fewer than 'k' vectors, have id -1 and the
+  // lowest float score.
+  Status Search(const DeviceBase::CpuWorkerThreads& worker_threads,
+                const float* queries, int64 num_queries, int k, int num_probes,
+                float* scores, int64* ids) const LOCKS_EXCLUDED(mu_);
+
+  bool is_loaded() const LOCKS_EXCLUDED(mu_);
+  int64 dimension() const LOCKS_EXCLUDED(mu_);
+  int64 size() const LOCKS_EXCLUDED(mu_);
+
+  string DebugString() const override;
+
+  // The size of the mapping. Its pages are backed by the file.
+  int64 MemoryUsed() const override;
+
+  // File layout, see WriteIvfIndex().
+  struct FileHeader {
+    char magic[8];
+    uint32 metric;
+    uint32 dimension;
+    uint64 num_lists;
+    uint64 num_vectors;
+    uint64 reserved[4];
+  };
+
+ private:
+  mutable mutex mu_;
+  string filename_ GUARDED_BY(mu_);
+  std::unique_ptr<ReadOnlyMemoryRegion> region_ GUARDED_BY(mu_);
+  IvfMetric metric_ GUARDED_BY(mu_) = IvfMetric::kDotProduct;
+  int64 dimension_ GUARDED_BY(mu_) = 0;
+  int64 num_lists_ GUARDED_BY(mu_) = 0;
+  int64 num_vectors_ GUARDED_BY(mu_) = 0;
+  const float* centroids_ GUARDED_BY(mu_) = nullptr;
+  const uint64* list_begin_ GUARDED_BY(mu_) = nullptr;
+  const int64* ids_ GUARDED_BY(mu_) = nullptr;
+  const float* squared_norms_ GUARDED_BY(mu_) = nullptr;
+  const float* vectors_ GUARDED_BY(mu_) = nullptr;
+  std::vector<float> centroid_squared_norms_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(IvfIndex);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_IVF_INDEX_H_
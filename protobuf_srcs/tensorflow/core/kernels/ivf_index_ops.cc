@@ -0,0 +1,172 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/lookup_ops.cc.
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/ivf_index.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+// Produces a handle to an IvfIndex in the ResourceMgr of the device, named
+// by the "shared_name" attr or else by the node name.
+class IvfIndexOp : public OpKernel {
+ public:
+  explicit IvfIndexOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("container", &container_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("shared_name", &name_));
+    if (name_.empty()) name_ = name();
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    mutex_lock l(mu_);
+    if (!handle_.IsInitialized()) {
+      AllocatorAttributes attr;
+      attr.set_on_host(true);
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_RESOURCE, TensorShape({}),
+                                             &handle_, attr));
+      handle_.scalar<ResourceHandle>()() =
+          MakeResourceHandle<IvfIndex>(ctx, container_, name_);
+    }
+    ctx->set_output(0, handle_);
+  }
+
+  bool IsExpensive() override { return false; }
+
+ private:
+  string container_;
+  string name_;
+  mutex mu_;
+  Tensor handle_ GUARDED_BY(mu_);
+};
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndex").Device(DEVICE_CPU), IvfIndexOp);
+
+// Loads an IvfIndex from a file, typically an asset of a SavedModel.
+class InitializeIvfIndexFromFileOp : public OpKernel {
+ public:
+  explicit InitializeIvfIndexFromFileOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& filename = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(filename.shape()),
+                errors::InvalidArgument("filename must be a scalar, got shape ",
+                                        filename.shape().DebugString()));
+    core::RefCountPtr<IvfIndex> index;
+    OP_REQUIRES_OK(ctx, LookupOrCreateResource<IvfIndex>(
+                            ctx, HandleFromInput(ctx, 0), &index,
+                            [](IvfIndex** index) {
+                              *index = new IvfIndex;
+                              return Status::OK();
+                            }));
+    OP_REQUIRES_OK(ctx, index->Load(ctx->env(), filename.scalar<tstring>()()));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("InitializeIvfIndexFromFile").Device(DEVICE_CPU),
+                        InitializeIvfIndexFromFileOp);
+
+class IvfIndexSearchOp : public OpKernel {
+ public:
+  explicit IvfIndexSearchOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_probes", &num_probes_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    core::RefCountPtr<IvfIndex> index;
+    OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &index));
+    OP_REQUIRES(ctx, index->is_loaded(),
+                errors::FailedPrecondition(
+                    "IvfIndex ", index->DebugString(),
+                    " is not initialized, run InitializeIvfIndexFromFile."));
+
+    const Tensor& queries = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(queries.shape()),
+                errors::InvalidArgument("queries must be a matrix, got shape ",
+                                        queries.shape().DebugString()));
+    OP_REQUIRES(ctx, queries.dim_size(1) == index->dimension(),
+                errors::InvalidArgument("queries must have ",
+                                        index->dimension(), " columns, got ",
+                                        queries.dim_size(1)));
+    const Tensor& k_in = ctx->input(2);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(k_in.shape()),
+                errors::InvalidArgument("k must be scalar, got shape ",
+                                        k_in.shape().DebugString()));
+    const int k = k_in.scalar<int32>()();
+    OP_REQUIRES(ctx, k >= 0, errors::InvalidArgument("Need k >= 0, got ", k));
+
+    const int64 num_queries = queries.dim_size(0);
+    Tensor* scores = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({num_queries, k}),
+                                             &scores));
+    Tensor* ids = nullptr;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_output(1, TensorShape({num_queries, k}), &ids));
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    OP_REQUIRES_OK(ctx, index->Search(worker_threads,
+                                      queries.flat<float>().data(), num_queries,
+                                      k, num_probes_,
+                                      scores->flat<float>().data(),
+                                      ids->flat<int64>().data()));
+  }
+
+ private:
+  int num_probes_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexSearch").Device(DEVICE_CPU),
+                        IvfIndexSearchOp);
+
+// Builds an index of embeddings that can be loaded by
+// InitializeIvfIndexFromFile.
+class WriteIvfIndexOp : public OpKernel {
+ public:
+  explicit WriteIvfIndexOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_lists", &options_.num_lists));
+    string metric;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("metric", &metric));
+    OP_REQUIRES_OK(ctx, ParseIvfMetric(metric, &options_.metric));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("num_iterations", &options_.num_iterations));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("seed", &options_.seed));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& filename = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(filename.shape()),
+                errors::InvalidArgument("filename must be a scalar, got shape ",
+                                        filename.shape().DebugString()));
+    thread::ThreadPool* workers =
+        ctx->device()->tensorflow_cpu_worker_threads()->workers;
+    OP_REQUIRES_OK(ctx, WriteIvfIndex(ctx->env(), filename.scalar<tstring>()(),
+                                      ctx->input(1), ctx->input(2), options_,
+                                      workers));
+  }
+
+ private:
+  IvfIndexOptions options_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("WriteIvfIndex").Device(DEVICE_CPU),
+                        WriteIvfIndexOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,380 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/ivf_index.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+string IndexPath(const string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+class IvfIndexTest : public ::testing::Test {
+ protected:
+  IvfIndexTest() : pool_(Env::Default(), "ivf_index_test", 4) {
+    worker_threads_.num_threads = 4;
+    worker_threads_.workers = &pool_;
+  }
+
+  // Searches 'index' for the 'k' nearest neighbors of each row of 'queries'.
+  void Search(const IvfIndex& index, const Tensor& queries, int k,
+              int num_probes, std::vector<float>* scores,
+              std::vector<int64>* ids) {
+    const int64 num_queries = queries.dim_size(0);
+    scores->resize(num_queries * k);
+    ids->resize(num_queries * k);
+    TF_ASSERT_OK(index.Search(worker_threads_, queries.flat<float>().data(),
+                              num_queries, k, num_probes, scores->data(),
+                              ids->data()));
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+// 8 points on the axes of the plane, with ids 100 to 107.
+Tensor AxisPoints() {
+  return test::AsTensor<float>({1, 0, 2, 0, -1, 0, -2, 0,  //
+                                0, 1, 0, 2, 0, -1, 0, -2},
+                               TensorShape({8, 2}));
+}
+
+Tensor AxisIds() {
+  return test::AsTensor<int64>({100, 101, 102, 103, 104, 105, 106, 107});
+}
+
+TEST_F(IvfIndexTest, DotProductProbingAllLists) {
+  const string path = IndexPath("dot_product.tfivf");
+  IvfIndexOptions options;
+  options.num_lists = 4;
+  TF_ASSERT_OK(WriteIvfIndex(Env::Default(), path, AxisPoints(), AxisIds(),
+                             options, &pool_));
+  IvfIndex* index = new IvfIndex;
+  core::ScopedUnref unref(index);
+  TF_ASSERT_OK(index->Load(Env::Default(), path));
+  EXPECT_EQ(2, index->dimension());
+  EXPECT_EQ(8, index->size());
+
+  std::vector<float> scores;
+  std::vector<int64> ids;
+  Search(*index, test::AsTensor<float>({1, 0, 0, -1}, TensorShape({2, 2})), 3,
+         4, &scores, &ids);
+  EXPECT_EQ(std::vector<float>({2, 1, 0, 2, 1, 0}), scores);
+  EXPECT_EQ(101, ids[0]);
+  EXPECT_EQ(100, ids[1]);
+  EXPECT_EQ(107, ids[3]);
+  EXPECT_EQ(106, ids[4]);
+}
+
+TEST_F(IvfIndexTest, SquaredL2ProbingAllLists) {
+  const string path = IndexPath("squared_l2.tfivf");
+  IvfIndexOptions options;
+  options.metric = IvfMetric::kSquaredL2;
+  options.num_lists = 3;
+  TF_ASSERT_OK(WriteIvfIndex(Env::Default(), path, AxisPoints(), AxisIds(),
+                             options, nullptr));
+  IvfIndex* index = new IvfIndex;
+  core::ScopedUnref unref(index);
+  TF_ASSERT_OK(index->Load(Env::Default(), path));
+
+  std::vector<float> scores;
+  std::vector<int64> ids;
+  Search(*index, test::AsTensor<float>({-1.75, 0}, TensorShape({1, 2})), 2, 3,
+         &scores, &ids);
+  EXPECT_EQ(std::vector<int64>({103, 102}), ids);
+  ASSERT_EQ(2, scores.size());
+  EXPECT_NEAR(-0.0625, scores[0], 1e-5);
+  EXPECT_NEAR(-0.5625, scores[1], 1e-5);
+}
+
+TEST_F(IvfIndexTest, MissingResults) {
+  const string path = IndexPath("missing.tfivf");
+  IvfIndexOptions options;
+  options.num_lists = 1;
+  TF_ASSERT_OK(WriteIvfIndex(Env::Default(), path,
+                             test::AsTensor<float>({1, 2}, TensorShape({2, 1})),
+                             test::AsTensor<int64>({7, 8}), options, &pool_));
+  IvfIndex* index = new IvfIndex;
+  core::ScopedUnref unref(index);
+  TF_ASSERT_OK(index->Load(Env::Default(), path));
+
+  std::vector<float> scores;
+  std::vector<int64> ids;
+  Search(*index, test::AsTensor<float>({1}, TensorShape({1, 1})), 3, 8, &scores,
+         &ids);
+  EXPECT_EQ(std::vector<int64>({8, 7, -1}), ids);
+  EXPECT_EQ(std::vector<float>({2, 1, std::numeric_limits<float>::lowest()}),
+            scores);
+}
+
+TEST_F(IvfIndexTest, Reload) {
+  const string path = IndexPath("reload.tfivf");
+  const string other_path = IndexPath("reload_other.tfivf");
+  IvfIndexOptions options;
+  options.num_lists = 2;
+  TF_ASSERT_OK(WriteIvfIndex(Env::Default(), path, AxisPoints(), AxisIds(),
+                             options, &pool_));
+  TF_ASSERT_OK(WriteIvfIndex(Env::Default(), other_path, AxisPoints(),
+                             AxisIds(), options, &pool_));
+  IvfIndex* index = new IvfIndex;
+  core::ScopedUnref unref(index);
+  EXPECT_FALSE(index->is_loaded());
+  TF_ASSERT_OK(index->Load(Env::Default(), path));
+  EXPECT_TRUE(index->is_loaded());
+  TF_EXPECT_OK(index->Load(Env::Default(), path));
+  Status s = index->Load(Env::Default(), other_path);
+  EXPECT_TRUE(errors::IsFailedPrecondition(s)) << s;
+}
+
+TEST_F(IvfIndexTest, ConcurrentWriters) {
+  const string path = IndexPath("concurrent.tfivf");
+  IvfIndexOptions options;
+  options.num_lists = 2;
+  {
+    thread::ThreadPool writers(Env::Default(), "writers", 4);
+    for (int i = 0; i < 8; ++i) {
+      writers.Schedule([&path, &options]() {
+        TF_EXPECT_OK(WriteIvfIndex(Env::Default(), path, AxisPoints(),
+                                   AxisIds(), options, nullptr));
+      });
+    }
+  }
+  IvfIndex* index = new IvfIndex;
+  core::ScopedUnref unref(index);
+  TF_ASSERT_OK(index->Load(Env::Default(), path));
+  EXPECT_EQ(8, index->size());
+
+  std::vector<string> leftovers;
+  TF_ASSERT_OK(Env::Default()->GetMatchingPaths(
+      strings::StrCat(path, "*.tmp"), &leftovers));
+  EXPECT_TRUE(leftovers.empty());
+}
+
+TEST_F(IvfIndexTest, Errors) {
+  const string path = IndexPath("errors.tfivf");
+  IvfIndexOptions options;
+  options.num_lists = 9;
+  Status s = WriteIvfIndex(Env::Default(), path, AxisPoints(), AxisIds(),
+                           options, &pool_);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  options.num_lists = 2;
+  s = WriteIvfIndex(Env::Default(), path, AxisPoints(),
+                    test::AsTensor<int64>({1, 2}), options, &pool_);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+
+  IvfIndex* unloaded = new IvfIndex;
+  core::ScopedUnref unref_unloaded(unloaded);
+  std::vector<float> scores(1);
+  std::vector<int64> ids(1);
+  s = unloaded->Search(worker_threads_, scores.data(), 1, 1, 1, scores.data(),
+                       ids.data());
+  EXPECT_TRUE(errors::IsFailedPrecondition(s)) << s;
+
+  TF_ASSERT_OK(WriteIvfIndex(Env::Default(), path, AxisPoints(), AxisIds(),
+                             options, &pool_));
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  const string truncated_path = IndexPath("truncated.tfivf");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), truncated_path,
+                                 contents.substr(0, contents.size() - 1)));
+  IvfIndex* truncated = new IvfIndex;
+  core::ScopedUnref unref_truncated(truncated);
+  s = truncated->Load(Env::Default(), truncated_path);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+
+  // Makes the offset of the last list point past the vectors.
+  const string corrupted_path = IndexPath("corrupted.tfivf");
+  string corrupted = contents;
+  const size_t list_end_offset = sizeof(IvfIndex::FileHeader) +
+                                 2 * 2 * sizeof(float) + 2 * sizeof(uint64);
+  corrupted[list_end_offset] = 100;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), corrupted_path, corrupted));
+  IvfIndex* corrupted_index = new IvfIndex;
+  core::ScopedUnref unref_corrupted_index(corrupted_index);
+  s = corrupted_index->Load(Env::Default(), corrupted_path);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+
+  const string text_path = IndexPath("embeddings.txt");
+  TF_ASSERT_OK(
+      WriteStringToFile(Env::Default(), text_path, string(1000, 'x')));
+  IvfIndex* text = new IvfIndex;
+  core::ScopedUnref unref_text(text);
+  s = text->Load(Env::Default(), text_path);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+}
+
+const int64 kBenchmarkVectors = 1000 * 1000;
+const int64 kBenchmarkDimension = 64;
+const int64 kBenchmarkLists = 1024;
+const int kBenchmarkQueries = 256;
+const int kBenchmarkK = 10;
+
+// Makes kBenchmarkVectors embeddings drawn around 4096 random centers, and
+// kBenchmarkQueries queries drawn around the same centers.
+void MakeBenchmarkData(Tensor* embeddings, Tensor* queries) {
+  std::mt19937 rng(42);
+  std::normal_distribution<float> normal;
+  const int kNumCenters = 4096;
+  std::vector<float> centers(kNumCenters * kBenchmarkDimension);
+  for (float& x : centers) x = normal(rng);
+  auto fill = [&](int64 num_rows, Tensor* t) {
+    *t = Tensor(DT_FLOAT, TensorShape({num_rows, kBenchmarkDimension}));
+    auto matrix = t->matrix<float>();
+    for (int64 i = 0; i < num_rows; ++i) {
+      const float* center =
+          centers.data() + (rng() % kNumCenters) * kBenchmarkDimension;
+      for (int64 j = 0; j < kBenchmarkDimension; ++j) {
+        matrix(i, j) = center[j] + 0.5f * normal(rng);
+      }
+    }
+  };
+  fill(kBenchmarkVectors, embeddings);
+  fill(kBenchmarkQueries, queries);
+}
+
+// The exact kBenchmarkK nearest neighbors of every query, by dot product.
+std::vector<int64> BruteForceNeighbors(const Tensor& embeddings,
+                                       const Tensor& queries) {
+  auto e = embeddings.matrix<float>();
+  auto q = queries.matrix<float>();
+  std::vector<int64> neighbors;
+  std::vector<std::pair<float, int64>> scored(kBenchmarkVectors);
+  for (int i = 0; i < kBenchmarkQueries; ++i) {
+    for (int64 v = 0; v < kBenchmarkVectors; ++v) {
+      float score = 0;
+      for (int64 j = 0; j < kBenchmarkDimension; ++j) {
+        score += q(i, j) * e(v, j);
+      }
+      scored[v] = {-score, v};
+    }
+    std::partial_sort(scored.begin(), scored.begin() + kBenchmarkK,
+                      scored.end());
+    for (int j = 0; j < kBenchmarkK; ++j) {
+      neighbors.push_back(scored[j].second);
+    }
+  }
+  return neighbors;
+}
+
+struct BenchmarkIndex {
+  Tensor embeddings;
+  Tensor queries;
+  // Never unreffed, as the benchmark index lives as long as the process.
+  IvfIndex* index = new IvfIndex;
+  std::vector<int64> exact_neighbors;
+};
+
+// Builds the benchmark index once, since k-means over a million vectors is
+// much slower than any search.
+BenchmarkIndex* GetBenchmarkIndex() {
+  static BenchmarkIndex* benchmark_index = [] {
+    auto* b = new BenchmarkIndex;
+    MakeBenchmarkData(&b->embeddings, &b->queries);
+    Tensor ids(DT_INT64, TensorShape({kBenchmarkVectors}));
+    for (int64 i = 0; i < kBenchmarkVectors; ++i) ids.flat<int64>()(i) = i;
+    const string path = IndexPath("benchmark.tfivf");
+    IvfIndexOptions options;
+    options.num_lists = kBenchmarkLists;
+    thread::ThreadPool pool(Env::Default(), "ivf_index_benchmark",
+                            port::MaxParallelism());
+    TF_CHECK_OK(WriteIvfIndex(Env::Default(), path, b->embeddings, ids,
+                              options, &pool));
+    TF_CHECK_OK(b->index->Load(Env::Default(), path));
+    b->exact_neighbors = BruteForceNeighbors(b->embeddings, b->queries);
+    return b;
+  }();
+  return benchmark_index;
+}
+
+// Searches kBenchmarkQueries queries probing 'num_probes' of the
+// kBenchmarkLists lists. The label reports recall@10 against an exhaustive
+// search.
+static void BM_IvfIndexSearch(int iters, int num_probes) {
+  testing::StopTiming();
+  BenchmarkIndex* b = GetBenchmarkIndex();
+  thread::ThreadPool pool(Env::Default(), "ivf_index_benchmark",
+                          port::MaxParallelism());
+  DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = port::MaxParallelism();
+  worker_threads.workers = &pool;
+  std::vector<float> scores(kBenchmarkQueries * kBenchmarkK);
+  std::vector<int64> ids(kBenchmarkQueries * kBenchmarkK);
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkQueries);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(b->index->Search(worker_threads,
+                                 b->queries.flat<float>().data(),
+                                 kBenchmarkQueries, kBenchmarkK, num_probes,
+                                 scores.data(), ids.data()));
+  }
+  testing::StopTiming();
+  int64 found = 0;
+  for (int q = 0; q < kBenchmarkQueries; ++q) {
+    const auto begin = b->exact_neighbors.begin() + q * kBenchmarkK;
+    for (int j = 0; j < kBenchmarkK; ++j) {
+      found += std::count(begin, begin + kBenchmarkK, ids[q * kBenchmarkK + j]);
+    }
+  }
+  testing::SetLabel(strings::StrCat(
+      "recall@10: ",
+      static_cast<double>(found) / (kBenchmarkQueries * kBenchmarkK)));
+}
+BENCHMARK(BM_IvfIndexSearch)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+// The exhaustive search of the same queries as MatMul + TopKV2, for
+// comparison with BM_IvfIndexSearch.
+static void BM_BruteForceSearch(int iters) {
+  testing::StopTiming();
+  BenchmarkIndex* b = GetBenchmarkIndex();
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* scores = test::graph::Matmul(
+      g, test::graph::Constant(g, b->queries),
+      test::graph::Constant(g, b->embeddings), false, true);
+  Node* top_k;
+  TF_CHECK_OK(NodeBuilder(g->NewName("top_k"), "TopKV2")
+                  .Input(scores)
+                  .Input(test::graph::Constant(
+                      g, test::AsScalar<int32>(kBenchmarkK)))
+                  .Finalize(g, &top_k));
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkQueries);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+BENCHMARK(BM_BruteForceSearch);
+
+}  // namespace
+}  // namespace tensorflow
@@ -17,14 +17,17 @@ limitations under the License.
 #define TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_INIT_OP_H_
 
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 namespace lookup {
 
 // Helper function to initialize an InitializableLookupTable from a text file.
+// If 'thread_pool' is not null, it is used to parse the lines in parallel.
 Status InitializeTableFromTextFile(const string& filename, int64 vocab_size,
                                    char delimiter, int32 key_index,
                                    int32 value_index, Env* env,
+                                   thread::ThreadPool* thread_pool,
                                    InitializableLookupTable* table);
 
 }  // namespace lookup
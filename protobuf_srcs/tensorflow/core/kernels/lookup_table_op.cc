@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/kernels/immutable_lookup_table.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
@@ -997,6 +998,81 @@ REGISTER_KERNEL(tstring, tstring);
 
 #undef REGISTER_KERNEL
 
+// Register the ImmutableHashTable op.
+#define REGISTER_KERNEL(key_dtype, value_dtype)                     \
+  REGISTER_KERNEL_BUILDER(                                          \
+      Name("ImmutableHashTable")                                    \
+          .Device(DEVICE_CPU)                                       \
+          .TypeConstraint<key_dtype>("key_dtype")                   \
+          .TypeConstraint<value_dtype>("value_dtype"),              \
+      LookupTableOp<lookup::ImmutableHashTable, key_dtype, value_dtype>)
+
+REGISTER_KERNEL(int64, int64);
+REGISTER_KERNEL(int64, tstring);
+REGISTER_KERNEL(tstring, int64);
+REGISTER_KERNEL(tstring, tstring);
+
+#undef REGISTER_KERNEL
+
+// Op that writes keys and values to a file that can be loaded by the
+// ImmutableHashTable op.
+class WriteImmutableHashTableOp : public OpKernel {
+ public:
+  explicit WriteImmutableHashTableOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& filename = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(filename.shape()),
+                errors::InvalidArgument("filename must be a scalar, got shape ",
+                                        filename.shape().DebugString()));
+    const Tensor& keys = ctx->input(1);
+    const Tensor& values = ctx->input(2);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(keys.shape()),
+                errors::InvalidArgument("keys must be a vector, got shape ",
+                                        keys.shape().DebugString()));
+    OP_REQUIRES(ctx, keys.shape() == values.shape(),
+                errors::InvalidArgument(
+                    "keys and values must have the same shape, got ",
+                    keys.shape().DebugString(), " and ",
+                    values.shape().DebugString()));
+    OP_REQUIRES_OK(ctx, lookup::WriteImmutableHashTable(
+                            ctx->env(), filename.scalar<tstring>()(), keys,
+                            values));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("WriteImmutableHashTable").Device(DEVICE_CPU),
+                        WriteImmutableHashTableOp);
+
+// Op that loads an ImmutableHashTable from a file, typically an asset of a
+// SavedModel.
+class InitializeImmutableHashTableFromFileOp : public OpKernel {
+ public:
+  explicit InitializeImmutableHashTableFromFileOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& filename = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(filename.shape()),
+                errors::InvalidArgument("filename must be a scalar, got shape ",
+                                        filename.shape().DebugString()));
+    lookup::LookupInterface* table;
+    OP_REQUIRES_OK(ctx, GetLookupTable("table_handle", ctx, &table));
+    core::ScopedUnref unref_me(table);
+    auto* immutable_table = dynamic_cast<lookup::ImmutableHashTable*>(table);
+    OP_REQUIRES(ctx, immutable_table != nullptr,
+                errors::InvalidArgument("Table ", table->DebugString(),
+                                        " is not an ImmutableHashTable"));
+    OP_REQUIRES_OK(ctx, immutable_table->Load(ctx->env(),
+                                              filename.scalar<tstring>()()));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("InitializeImmutableHashTableFromFile").Device(DEVICE_CPU),
+    InitializeImmutableHashTableFromFileOp);
+
 // Register the MutableHashTable op.
 #define REGISTER_KERNEL(key_dtype, value_dtype)                                \
   REGISTER_KERNEL_BUILDER(                                                     \
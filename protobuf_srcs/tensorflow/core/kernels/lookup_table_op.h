@@ -16,6 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 #define TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -148,7 +156,124 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
   return value;
 }
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// Copies strings into large contiguous blocks, which are freed all at once
+// with the arena.
+class StringArena {
+ public:
+  StringArena() {}
+
+  // Returns a copy of 's' that lives as long as the arena.
+  absl::string_view Copy(absl::string_view s) {
+    if (s.empty()) return absl::string_view();
+    if (s.size() > remaining_) {
+      const size_t block_bytes = std::max(kBlockBytes, s.size());
+      blocks_.emplace_back(new char[block_bytes]);
+      next_ = blocks_.back().get();
+      remaining_ = block_bytes;
+      bytes_allocated_ += block_bytes;
+    }
+    memcpy(next_, s.data(), s.size());
+    absl::string_view copy(next_, s.size());
+    next_ += s.size();
+    remaining_ -= s.size();
+    return copy;
+  }
+
+  int64 MemoryUsed() const { return bytes_allocated_; }
+
+ private:
+  static constexpr size_t kBlockBytes = 64 << 10;
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* next_ = nullptr;
+  size_t remaining_ = 0;
+  int64 bytes_allocated_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StringArena);
+};
+
+// The entries of a HashTable, in a flat open-addressing hash map. A lookup
+// compares the control bytes of a whole group of slots with one SIMD
+// instruction and then touches only the matching slots, instead of following
+// a chain of separately allocated nodes as in std::unordered_map.
+template <class K, class V>
+class HashTableEntries {
+ public:
+  // The type of the keys passed to ForEach().
+  using KeyType = K;
+
+  void Reserve(size_t n) { map_.reserve(n); }
+
+  // Inserts 'value' for 'key' unless 'key' is present, and returns the value
+  // in the table.
+  const V& LookupOrInsert(const K& key, const V& value) {
+    return map_.emplace(key, value).first->second;
+  }
+
+  // Returns nullptr if 'key' is not present.
+  const V* Find(const K& key) const {
+    auto it = map_.find(key);
+    return it == map_.end() ? nullptr : &it->second;
+  }
+
+  size_t size() const { return map_.size(); }
+
+  // Calls f(key, value) for every entry.
+  template <class F>
+  void ForEach(F f) const {
+    for (const auto& kv : map_) f(kv.first, kv.second);
+  }
+
+  // One slot and one control byte per bucket.
+  int64 MemoryUsed() const {
+    return map_.capacity() * (sizeof(typename Map::value_type) + 1);
+  }
+
+ private:
+  using Map = absl::flat_hash_map<K, V>;
+  Map map_;
+};
+
+// String keys are copied into an arena, so that a slot holds only a
+// string_view and the key bytes of all entries are contiguous in memory.
+template <class V>
+class HashTableEntries<tstring, V> {
+ public:
+  using KeyType = absl::string_view;
+
+  void Reserve(size_t n) { map_.reserve(n); }
+
+  const V& LookupOrInsert(const tstring& key, const V& value) {
+    const absl::string_view key_view(key.data(), key.size());
+    auto it = map_.find(key_view);
+    if (it != map_.end()) return it->second;
+    return map_.emplace(arena_.Copy(key_view), value).first->second;
+  }
+
+  const V* Find(const tstring& key) const {
+    auto it = map_.find(absl::string_view(key.data(), key.size()));
+    return it == map_.end() ? nullptr : &it->second;
+  }
+
+  size_t size() const { return map_.size(); }
+
+  template <class F>
+  void ForEach(F f) const {
+    for (const auto& kv : map_) f(kv.first, kv.second);
+  }
+
+  int64 MemoryUsed() const {
+    return map_.capacity() * (sizeof(typename Map::value_type) + 1) +
+           arena_.MemoryUsed();
+  }
+
+ private:
+  using Map = absl::flat_hash_map<absl::string_view, V>;
+  Map map_;
+  StringArena arena_;
+};
+
+// Lookup table that wraps a flat hash map, where the key and value data type
 // is specified.
 //
 // This table is recommended for any variations to key values.
@@ -159,8 +284,8 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
 // Sample use case:
 //
 // HashTable<int64, int64> table;  // int64 -> int64.
-// table.Prepare(10); // Prepare the underlying data structure, the number of
-//                    // elements is required by interface, but not used.
+// table.Prepare(10); // Prepare the underlying data structure, reserving space
+//                    // for the given number of elements.
 // // Populate the table, elements could be added in one or multiple calls.
 // table.Insert(key_tensor, value_tensor); // Populate the table.
 // ...
@@ -168,6 +293,8 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
 //
 // table.Find(in_t, &out_t, default_t)
 //
+// Once initialized, the table is never modified, so concurrent lookups do not
+// take any lock.
 template <class K, class V>
 class HashTable : public InitializableLookupTable {
  public:
@@ -199,10 +326,14 @@ class HashTable : public InitializableLookupTable {
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
     int64 i = 0;
-    for (auto it = table_->begin(); it != table_->end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
-    }
+    table_->ForEach(
+        [&keys_data, &values_data, &i](
+            const typename HashTableEntries<K, V>::KeyType& key,
+            const V& value) {
+          keys_data(i) = key;
+          values_data(i) = value;
+          ++i;
+        });
     return Status::OK();
   }
 
@@ -211,14 +342,14 @@ class HashTable : public InitializableLookupTable {
   DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
 
  protected:
-  Status DoPrepare(size_t unused) override {
+  Status DoPrepare(size_t expected_num_elements) override {
     if (is_initialized_) {
       return errors::Aborted("HashTable already initialized.");
     }
     if (!table_) {
-      table_ = std::unique_ptr<std::unordered_map<K, V>>(
-          new std::unordered_map<K, V>());
+      table_ = absl::make_unique<HashTableEntries<K, V>>();
     }
+    table_->Reserve(expected_num_elements);
     return Status::OK();
   };
 
@@ -237,7 +368,7 @@ class HashTable : public InitializableLookupTable {
     for (int64 i = 0; i < key_values.size(); ++i) {
       const K key = SubtleMustCopyIfIntegral(key_values(i));
       const V value = SubtleMustCopyIfIntegral(value_values(i));
-      const V& previous_value = gtl::LookupOrInsert(table_.get(), key, value);
+      const V& previous_value = table_->LookupOrInsert(key, value);
       if (previous_value != value) {
         return errors::FailedPrecondition(
             "HashTable has different value for same key. Key ", key, " has ",
@@ -254,23 +385,22 @@ class HashTable : public InitializableLookupTable {
     auto value_values = value->flat<V>();
 
     for (int64 i = 0; i < key_values.size(); ++i) {
-      value_values(i) = gtl::FindWithDefault(
-          *table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
+      const V* found = table_->Find(SubtleMustCopyIfIntegral(key_values(i)));
+      value_values(i) = found != nullptr ? *found : default_val;
     }
     return Status::OK();
   }
 
   int64 MemoryUsed() const override {
     if (table_) {
-      const int64 num_elements = table_->size();
-      return num_elements * (sizeof(K) + sizeof(V));
+      return table_->MemoryUsed();
     } else {
       return 0;
     }
   }
 
  private:
-  std::unique_ptr<std::unordered_map<K, V>> table_;
+  std::unique_ptr<HashTableEntries<K, V>> table_;
 };
 
 }  // namespace lookup
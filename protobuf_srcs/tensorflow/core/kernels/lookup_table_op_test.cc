@@ -0,0 +1,251 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/lookup_table_op.h"
+
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/kernels/lookup_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+template <class K, class V>
+Status InitializeTable(const std::vector<K>& keys, const std::vector<V>& values,
+                       HashTable<K, V>* table) {
+  Tensor keys_tensor = test::AsTensor<K>(keys);
+  Tensor values_tensor = test::AsTensor<V>(values);
+  KeyValueTensorIterator iter(&keys_tensor, &values_tensor);
+  return table->Initialize(iter);
+}
+
+template <class K, class V>
+std::vector<V> Find(HashTable<K, V>* table, const std::vector<K>& keys,
+                    V default_value) {
+  Tensor keys_tensor = test::AsTensor<K>(keys);
+  Tensor values_tensor(DataTypeToEnum<V>::v(),
+                       TensorShape({static_cast<int64>(keys.size())}));
+  TF_CHECK_OK(table->Find(nullptr, keys_tensor, &values_tensor,
+                          test::AsScalar<V>(default_value)));
+  auto flat = values_tensor.flat<V>();
+  return std::vector<V>(flat.data(), flat.data() + flat.size());
+}
+
+TEST(HashTableTest, IntegerKeys) {
+  auto* table = new HashTable<int64, int64>(nullptr, nullptr);
+  core::ScopedUnref unref(table);
+  TF_ASSERT_OK(InitializeTable<int64, int64>({1, 2, -3}, {10, 20, 30}, table));
+  EXPECT_EQ(3, table->size());
+  EXPECT_EQ(std::vector<int64>({20, -1, 30, 10}),
+            Find<int64, int64>(table, {2, 4, -3, 1}, -1));
+}
+
+TEST(HashTableTest, StringKeys) {
+  auto* table = new HashTable<tstring, int64>(nullptr, nullptr);
+  core::ScopedUnref unref(table);
+  // A key larger than an arena block.
+  const tstring long_key(string(100 << 10, 'x'));
+  TF_ASSERT_OK(InitializeTable<tstring, int64>(
+      {"brain", "", long_key, "salad"}, {0, 1, 2, 3}, table));
+  EXPECT_EQ(4, table->size());
+  EXPECT_EQ(std::vector<int64>({3, 1, -1, 2, 0}),
+            Find<tstring, int64>(table,
+                                 {"salad", "", "surgery", long_key, "brain"},
+                                 -1));
+  // The keys are stored in the arena, in addition to one slot per entry.
+  EXPECT_GT(table->MemoryUsed(), static_cast<int64>(long_key.size()) + 10);
+}
+
+TEST(HashTableTest, ConflictingValues) {
+  auto* table = new HashTable<tstring, int64>(nullptr, nullptr);
+  core::ScopedUnref unref(table);
+  Status s = InitializeTable<tstring, int64>({"a", "b", "a"}, {0, 1, 2}, table);
+  EXPECT_TRUE(errors::IsFailedPrecondition(s)) << s;
+  EXPECT_FALSE(table->is_initialized());
+}
+
+TEST(HashTableTest, ConcurrentFind) {
+  auto* table = new HashTable<int64, int64>(nullptr, nullptr);
+  core::ScopedUnref unref(table);
+  std::vector<int64> keys;
+  std::vector<int64> values;
+  for (int64 i = 0; i < 10000; ++i) {
+    keys.push_back(i);
+    values.push_back(2 * i);
+  }
+  TF_ASSERT_OK(InitializeTable(keys, values, table));
+  {
+    thread::ThreadPool pool(Env::Default(), "test", 8);
+    for (int t = 0; t < 8; ++t) {
+      pool.Schedule([table, &keys, &values]() {
+        EXPECT_EQ(values, Find<int64, int64>(table, keys, -1));
+      });
+    }
+  }
+}
+
+string WriteVocabFile(const string& name, int64 num_lines) {
+  string contents;
+  for (int64 i = 0; i < num_lines; ++i) {
+    strings::StrAppend(&contents, "word", i, "\t", i * 3, "\n");
+  }
+  const string path = io::JoinPath(testing::TmpDir(), name);
+  TF_CHECK_OK(WriteStringToFile(Env::Default(), path, contents));
+  return path;
+}
+
+TEST(HashTableTest, InitializeFromTextFile) {
+  // Spans several batches of lines.
+  const int64 kNumLines = 40000;
+  const string path = WriteVocabFile("vocab_40000.txt", kNumLines);
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  const std::vector<thread::ThreadPool*> thread_pools = {&pool, nullptr};
+  for (thread::ThreadPool* thread_pool : thread_pools) {
+    auto* word_to_id = new HashTable<tstring, int64>(nullptr, nullptr);
+    core::ScopedUnref unref_word_to_id(word_to_id);
+    TF_ASSERT_OK(InitializeTableFromTextFile(
+        path, -1 /*vocab_size*/, '\t', 0 /*key_index*/, 1 /*value_index*/,
+        Env::Default(), thread_pool, word_to_id));
+    EXPECT_EQ(kNumLines, word_to_id->size());
+    EXPECT_EQ(std::vector<int64>({0, 3 * 12345, 3 * 39999, -1}),
+              Find<tstring, int64>(
+                  word_to_id, {"word0", "word12345", "word39999", "word40000"},
+                  -1));
+
+    auto* line_to_word = new HashTable<int64, tstring>(nullptr, nullptr);
+    core::ScopedUnref unref_line_to_word(line_to_word);
+    TF_ASSERT_OK(InitializeTableFromTextFile(
+        path, -1 /*vocab_size*/, '\t', -1 /*key_index*/, 0 /*value_index*/,
+        Env::Default(), thread_pool, line_to_word));
+    EXPECT_EQ(std::vector<tstring>({"word20000", "?"}),
+              Find<int64, tstring>(line_to_word, {20000, kNumLines}, "?"));
+  }
+}
+
+TEST(HashTableTest, InitializeFromTextFileErrors) {
+  const string path = WriteVocabFile("vocab_20000.txt", 20000);
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+
+  auto* table = new HashTable<tstring, int64>(nullptr, nullptr);
+  core::ScopedUnref unref(table);
+  Status s = InitializeTableFromTextFile(path, 30000 /*vocab_size*/, '\t', 0,
+                                         1, Env::Default(), &pool, table);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(
+      absl::StrContains(s.error_message(), "expected 30000 but got 20000"))
+      << s;
+
+  // Only the first lines are used if the file is longer than vocab_size.
+  TF_ASSERT_OK(InitializeTableFromTextFile(path, 17000 /*vocab_size*/, '\t', 0,
+                                           1, Env::Default(), &pool, table));
+  EXPECT_EQ(17000, table->size());
+
+  // The first column is not a number.
+  auto* int_table = new HashTable<int64, int64>(nullptr, nullptr);
+  core::ScopedUnref unref_int_table(int_table);
+  s = InitializeTableFromTextFile(path, -1, '\t', 0, 1, Env::Default(), &pool,
+                                  int_table);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(absl::StrContains(s.error_message(), "line 0 is not a valid"))
+      << s;
+}
+
+template <class K>
+K MakeKey(int64 i);
+
+template <>
+int64 MakeKey<int64>(int64 i) {
+  return i * 7919;
+}
+
+template <>
+tstring MakeKey<tstring>(int64 i) {
+  return strings::StrCat("token_", i);
+}
+
+// Looks up batches of 1024 keys, half of which are in a table of
+// 'num_entries' entries. Reports the memory used per entry.
+template <class K>
+void BM_HashTableFind(int iters, int num_entries) {
+  testing::StopTiming();
+  auto* table = new HashTable<K, int64>(nullptr, nullptr);
+  core::ScopedUnref unref(table);
+  std::vector<K> keys;
+  std::vector<int64> values;
+  for (int64 i = 0; i < num_entries; ++i) {
+    keys.push_back(MakeKey<K>(i));
+    values.push_back(i);
+  }
+  TF_CHECK_OK(InitializeTable(keys, values, table));
+
+  const int kBatchSize = 1024;
+  Tensor batch(DataTypeToEnum<K>::v(), TensorShape({kBatchSize}));
+  for (int i = 0; i < kBatchSize; ++i) {
+    batch.flat<K>()(i) = MakeKey<K>((i * 104729) % (2 * num_entries));
+  }
+  Tensor result(DT_INT64, TensorShape({kBatchSize}));
+  const Tensor default_value = test::AsScalar<int64>(-1);
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBatchSize);
+  testing::SetLabel(strings::StrCat(
+      "bytes/entry: ", table->MemoryUsed() / std::max(1, num_entries)));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(table->Find(nullptr, batch, &result, default_value));
+  }
+}
+
+static void BM_HashTableFindInt64(int iters, int num_entries) {
+  BM_HashTableFind<int64>(iters, num_entries);
+}
+static void BM_HashTableFindString(int iters, int num_entries) {
+  BM_HashTableFind<tstring>(iters, num_entries);
+}
+BENCHMARK(BM_HashTableFindInt64)->Arg(1000)->Arg(100000)->Arg(10000000);
+BENCHMARK(BM_HashTableFindString)->Arg(1000)->Arg(100000)->Arg(10000000);
+
+static void BM_InitializeTableFromTextFile(int iters, int num_threads) {
+  testing::StopTiming();
+  const int64 kNumLines = 1000000;
+  const string path = WriteVocabFile("vocab_bm.txt", kNumLines);
+  std::unique_ptr<thread::ThreadPool> pool;
+  if (num_threads > 0) {
+    pool.reset(new thread::ThreadPool(Env::Default(), "test", num_threads));
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumLines);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    auto* table = new HashTable<tstring, int64>(nullptr, nullptr);
+    TF_CHECK_OK(InitializeTableFromTextFile(path, kNumLines, '\t', 0, 1,
+                                            Env::Default(), pool.get(), table));
+    table->Unref();
+  }
+}
+BENCHMARK(BM_InitializeTableFromTextFile)->Arg(0)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
@@ -15,10 +15,15 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/lookup_util.h"
 
+#include <vector>
+
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
@@ -48,9 +53,11 @@ Status GetNumLinesInTextFile(Env* env, const string& vocab_file,
   return Status::OK();
 }
 
-// Iterator that reads a text file. Each iteration process one line, it parses
-// the line and populates the keys and values tensors used for initialization
-// with a single key and corresponding value.
+// Iterator that reads a text file. Each iteration processes a batch of up to
+// kLinesPerBatch lines: it parses the lines and populates the keys and values
+// tensors used for initialization with one key and corresponding value per
+// line. If a thread pool is given, the lines of a batch are parsed in
+// parallel.
 //
 // What information of the line to populate the key or values is specified by
 // providing key_index and value_index.
@@ -72,17 +79,21 @@ class TextFileLineIterator
   // - Index -1 means the line number stored in int64.
   // - Index >= 0 represent index (starting at zero) of the split line based on
   //   delimiter.
+  //
+  // 'thread_pool' may be nullptr, in which case lines are parsed on the
+  // calling thread.
   Status Init(const string& filename, int64 vocab_size, char delimiter,
               DataType key_dtype, int64 key_index, DataType value_dtype,
-              int64 value_index, Env* env) {
+              int64 value_index, Env* env, thread::ThreadPool* thread_pool) {
     filename_ = filename;
     vocab_size_ = vocab_size;
     delimiter_ = delimiter;
-    key_ = Tensor(key_dtype, TensorShape({}));
-    value_ = Tensor(value_dtype, TensorShape({}));
+    key_dtype_ = key_dtype;
+    value_dtype_ = value_dtype;
     key_index_ = key_index;
     value_index_ = value_index;
     env_ = env;
+    thread_pool_ = thread_pool;
 
     status_ = env->NewRandomAccessFile(filename_, &file_);
     if (!status_.ok()) return status_;
@@ -90,6 +101,7 @@ class TextFileLineIterator
     input_buffer_.reset(new io::InputBuffer(file_.get(), kInputBufferSize));
     valid_ = true;
     next_id_ = 0;
+    end_status_ = Status::OK();
     ignore_split_ = std::max(key_index_, value_index_) < 0;
     Next();
     return status_;
@@ -97,60 +109,59 @@ class TextFileLineIterator
 
   void Next() override {
     if (!valid_) return;
-
-    string line;
-    status_ = input_buffer_->ReadLine(&line);
-    if (!status_.ok()) {
-      if (errors::IsOutOfRange(status_) && vocab_size_ != -1 &&
-          next_id_ != vocab_size_) {
-        status_ = errors::InvalidArgument("Invalid vocab_size in ", filename_,
-                                          ": expected ", vocab_size_,
-                                          " but got ", next_id_);
-      }
-      valid_ = false;
-      return;
-    }
-    if (vocab_size_ != -1 && next_id_ >= vocab_size_) {
-      LOG(WARNING) << "Truncated " << filename_ << " before its end at "
-                   << vocab_size_ << " records.";
-      LOG(WARNING) << "next_id_  : " << next_id_;
-      status_ = errors::OutOfRange("Finished reading ", vocab_size_,
-                                   " of lines from ", filename_);
-      valid_ = false;
-      return;
-    }
-    if (line.empty()) {
-      status_ = errors::InvalidArgument("Invalid content in ", filename_,
-                                        ": empty line found at position ",
-                                        input_buffer_->Tell(), ".");
+    if (!end_status_.ok()) {
+      // The previous batch ended with the last line.
+      status_ = end_status_;
       valid_ = false;
       return;
     }
 
-    std::vector<string> tokens;
-    if (!ignore_split_) {
-      tokens = str_util::Split(line, delimiter_);
-      if (std::max(key_index_, value_index_) >= tokens.size()) {
-        status_ = errors::InvalidArgument(
-            "Invalid number of columns in ", filename_, " line ", next_id_,
-            " (", line, ") : expected ", std::max(key_index_, value_index_),
-            " got ", tokens.size());
+    lines_.clear();
+    string line;
+    while (lines_.size() < kLinesPerBatch) {
+      const int64 line_id = next_id_ + lines_.size();
+      Status s = input_buffer_->ReadLine(&line);
+      if (!s.ok()) {
+        if (errors::IsOutOfRange(s) && vocab_size_ != -1 &&
+            line_id != vocab_size_) {
+          status_ = errors::InvalidArgument("Invalid vocab_size in ",
+                                            filename_, ": expected ",
+                                            vocab_size_, " but got ", line_id);
+          valid_ = false;
+          return;
+        }
+        end_status_ = s;
+        break;
+      }
+      if (vocab_size_ != -1 && line_id >= vocab_size_) {
+        LOG(WARNING) << "Truncated " << filename_ << " before its end at "
+                     << vocab_size_ << " records.";
+        LOG(WARNING) << "next_id_  : " << line_id;
+        end_status_ = errors::OutOfRange("Finished reading ", vocab_size_,
+                                         " of lines from ", filename_);
+        break;
+      }
+      if (line.empty()) {
+        status_ = errors::InvalidArgument("Invalid content in ", filename_,
+                                          ": empty line found at position ",
+                                          input_buffer_->Tell(), ".");
         valid_ = false;
         return;
       }
+      lines_.push_back(std::move(line));
     }
-    status_ = SetValue(line, tokens, key_index_, &key_);
-    if (!status_.ok()) {
+    if (lines_.empty()) {
+      status_ = end_status_;
       valid_ = false;
       return;
     }
-    status_ = SetValue(line, tokens, value_index_, &value_);
+
+    status_ = ParseLines();
     if (!status_.ok()) {
       valid_ = false;
       return;
     }
-
-    next_id_++;
+    next_id_ += lines_.size();
   }
 
   bool Valid() const override { return valid_; }
@@ -175,73 +186,125 @@ class TextFileLineIterator
   }
 
  private:
+  static const size_t kLinesPerBatch = 16 * 1024;
+
   Tensor key_;
   Tensor value_;
   bool valid_;  // true if the iterator points to an existing range.
+  DataType key_dtype_;
+  DataType value_dtype_;
   int64 key_index_;
   int64 value_index_;
   Env* env_;
+  thread::ThreadPool* thread_pool_;
   int64 next_id_;
   int64 vocab_size_;
   string filename_;
   char delimiter_;
   Status status_;
+  // Set once the last line was read, to the status the iterator ends with.
+  Status end_status_;
   bool ignore_split_;
+  std::vector<string> lines_;  // the lines of the current batch
   std::unique_ptr<RandomAccessFile> file_;  // must outlive input_buffer_
   std::unique_ptr<io::InputBuffer> input_buffer_;
 
-  // Set the corresponding value from line or tokens based on 'index' into the
-  // tensor 't'. The value is transformed to the given data type 'dtype'.
-  Status SetValue(const string& line, const std::vector<string>& tokens,
-                  int64 index, Tensor* tensor) {
+  // Parses lines_ into key_ and value_. Returns the error of the first line
+  // that failed to parse, if any.
+  Status ParseLines() {
+    const int64 num_lines = lines_.size();
+    key_ = Tensor(key_dtype_, TensorShape({num_lines}));
+    value_ = Tensor(value_dtype_, TensorShape({num_lines}));
+    std::vector<Status> line_status(num_lines);
+    auto parse = [this, &line_status](int64 begin, int64 end) {
+      std::vector<absl::string_view> tokens;
+      for (int64 i = begin; i < end; ++i) {
+        const string& line = lines_[i];
+        const int64 line_id = next_id_ + i;
+        if (!ignore_split_) {
+          std::vector<absl::string_view> split =
+              absl::StrSplit(line, delimiter_);
+          tokens.swap(split);
+          if (std::max(key_index_, value_index_) >= tokens.size()) {
+            line_status[i] = errors::InvalidArgument(
+                "Invalid number of columns in ", filename_, " line ", line_id,
+                " (", line, ") : expected ", std::max(key_index_, value_index_),
+                " got ", tokens.size());
+            continue;
+          }
+        }
+        line_status[i] =
+            SetValue(line, tokens, key_index_, line_id, i, &key_);
+        if (line_status[i].ok()) {
+          line_status[i] =
+              SetValue(line, tokens, value_index_, line_id, i, &value_);
+        }
+      }
+    };
+    if (thread_pool_ != nullptr) {
+      // Splitting and parsing a line takes on the order of a microsecond.
+      const int64 kCostPerLine = 1000;
+      Shard(thread_pool_->NumThreads(), thread_pool_, num_lines, kCostPerLine,
+            parse);
+    } else {
+      parse(0, num_lines);
+    }
+    for (const Status& s : line_status) {
+      TF_RETURN_IF_ERROR(s);
+    }
+    return Status::OK();
+  }
+
+  // Set the corresponding value from line or tokens based on 'index' into
+  // element 'i' of the tensor 't'. The value is transformed to the given data
+  // type 'dtype'. Safe to call concurrently for different elements.
+  Status SetValue(const string& line,
+                  const std::vector<absl::string_view>& tokens, int64 index,
+                  int64 line_id, int64 i, Tensor* tensor) const {
     if (index == kLineNumber) {
-      tensor->flat<int64>()(0) = next_id_;
+      tensor->flat<int64>()(i) = line_id;
       return Status::OK();
     }
-    const string& token = (index == kWholeLine) ? line : tokens[index];
+    const absl::string_view token =
+        (index == kWholeLine) ? absl::string_view(line) : tokens[index];
     const DataType& dtype = tensor->dtype();
     switch (dtype) {
       case DT_INT32: {
         int32 value;
-        if (!strings::safe_strto32(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
+        if (!strings::safe_strto32(token, &value)) {
+          return errors::InvalidArgument("Field ", token, " in line ", line_id,
                                          " is not a valid int32.");
         }
-        tensor->flat<int32>()(0) = value;
+        tensor->flat<int32>()(i) = value;
       } break;
       case DT_INT64: {
         int64 value;
-        if (!strings::safe_strto64(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
+        if (!strings::safe_strto64(token, &value)) {
+          return errors::InvalidArgument("Field ", token, " in line ", line_id,
                                          " is not a valid int64.");
         }
-        tensor->flat<int64>()(0) = value;
+        tensor->flat<int64>()(i) = value;
       } break;
       case DT_FLOAT: {
         float value;
-        if (!strings::safe_strtof(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
+        if (!strings::safe_strtof(token, &value)) {
+          return errors::InvalidArgument("Field ", token, " in line ", line_id,
                                          " is not a valid float.");
         }
-        tensor->flat<float>()(0) = value;
+        tensor->flat<float>()(i) = value;
       } break;
       case DT_DOUBLE: {
         double value;
-        if (!strings::safe_strtod(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
+        if (!strings::safe_strtod(token, &value)) {
+          return errors::InvalidArgument("Field ", token, " in line ", line_id,
                                          " is not a valid double.");
         }
-        tensor->flat<double>()(0) = value;
+        tensor->flat<double>()(i) = value;
       } break;
       case DT_STRING:
-        tensor->flat<tstring>()(0) = token;
+        tensor->flat<tstring>()(i) = token;
         break;
       default:
-        valid_ = false;
         return errors::InvalidArgument("Data type ", DataTypeString(dtype),
                                        " not supported.");
     }
@@ -339,6 +402,7 @@ Status CheckTableDataTypes(const LookupInterface& table, DataType key_dtype,
 Status InitializeTableFromTextFile(const string& filename, int64 vocab_size,
                                    char delimiter, int32 key_index,
                                    int32 value_index, Env* env,
+                                   thread::ThreadPool* thread_pool,
                                    InitializableLookupTable* table) {
   if (key_index == kLineNumber && table->key_dtype() != DT_INT64) {
     return errors::InvalidArgument(
@@ -366,7 +430,8 @@ Status InitializeTableFromTextFile(const string& filename, int64 vocab_size,
 
   TextFileLineIterator iter;
   TF_RETURN_IF_ERROR(iter.Init(filename, vocab_size, delimiter, key_dtype,
-                               key_index, value_dtype, value_index, env));
+                               key_index, value_dtype, value_index, env,
+                               thread_pool));
   // For initialization from files, ignore if the table is already
   // initialized. The table shared name should contain the filename to
   // avoid trying to initialize the same table from the same file at the same
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 namespace lookup {
@@ -41,9 +42,12 @@ Status GetInitializableLookupTable(const string& input_name,
 Status CheckTableDataTypes(const LookupInterface& table, DataType key_dtype,
                            DataType value_dtype, const string& table_name);
 
+// Initializes 'table' from the lines of a text file. If 'thread_pool' is not
+// null, it is used to parse the lines in parallel.
 Status InitializeTableFromTextFile(const string& filename, int64 vocab_size,
                                    char delimiter, int32 key_index,
                                    int32 value_index, Env* env,
+                                   thread::ThreadPool* thread_pool,
                                    InitializableLookupTable* table);
 
 }  // namespace lookup
@@ -0,0 +1,35 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/memory_region_util.h"
+
+#include <utility>
+
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+
+Status NewReadOnlyMemoryRegionOrReadFile(
+    Env* env, const string& filename,
+    std::unique_ptr<ReadOnlyMemoryRegion>* region) {
+  Status s = env->NewReadOnlyMemoryRegionFromFile(filename, region);
+  if (!errors::IsUnimplemented(s)) return s;
+  string contents;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, filename, &contents));
+  region->reset(new StringMemoryRegion(std::move(contents)));
+  return Status::OK();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,49 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_MEMORY_REGION_UTIL_H_
+#define TENSORFLOW_CORE_KERNELS_MEMORY_REGION_UTIL_H_
+
+#include <memory>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Holds a file that was read into memory, for file systems that do not
+// support memory mapping.
+class StringMemoryRegion : public ReadOnlyMemoryRegion {
+ public:
+  explicit StringMemoryRegion(string contents)
+      : contents_(std::move(contents)) {}
+  const void* data() override { return contents_.data(); }
+  uint64 length() override { return contents_.size(); }
+
+ private:
+  const string contents_;
+};
+
+// Sets 'region' to the contents of 'filename', which are memory mapped unless
+// the file system does not support it, in which case they are read.
+Status NewReadOnlyMemoryRegionOrReadFile(
+    Env* env, const string& filename,
+    std::unique_ptr<ReadOnlyMemoryRegion>* region);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_MEMORY_REGION_UTIL_H_
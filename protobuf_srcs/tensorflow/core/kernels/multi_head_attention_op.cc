@@ -0,0 +1,303 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Implements _FusedMultiHeadAttention, which computes
+// softmax(scale * query * key^T + bias) * value without materializing the
+// scores of all queries and keys. See the remapper, which rewrites the
+// unfused BatchMatMul + Mul + Add + Softmax + BatchMatMul into this op.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// The number of queries and keys in a tile of the scores. A tile of 64 x 256
+// float scores, and the rows of the output it updates, stay in L2 while the
+// tile is normalized and multiplied with the values.
+constexpr int64 kQueryBlockSize = 64;
+constexpr int64 kKeyBlockSize = 256;
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    RowMajorMatrix;
+typedef Eigen::Map<const RowMajorMatrix> ConstMatrixMap;
+typedef Eigen::Map<RowMajorMatrix> MatrixMap;
+
+// Returns the batch dimensions of 'shape', which are all but the last two
+// dimensions of a tensor of rank at least 2, and none otherwise.
+gtl::InlinedVector<int64, 4> BatchDims(const TensorShape& shape) {
+  gtl::InlinedVector<int64, 4> dims;
+  for (int i = 0; i + 2 < shape.dims(); ++i) {
+    dims.push_back(shape.dim_size(i));
+  }
+  return dims;
+}
+
+// Broadcasts the batch dimensions of 'inputs' against each other like
+// BatchMatMulV2. Returns the broadcast batch dimensions in 'batch_dims', and
+// for every input the offsets of its matrices, in matrices, for every matrix
+// of the broadcast batch in 'offsets'.
+Status BroadcastBatchDims(
+    const std::vector<gtl::InlinedVector<int64, 4>>& inputs,
+    gtl::InlinedVector<int64, 4>* batch_dims,
+    std::vector<std::vector<int64>>* offsets) {
+  size_t rank = 0;
+  for (const auto& dims : inputs) rank = std::max(rank, dims.size());
+  // Left pads the batch dimensions of every input with ones.
+  std::vector<gtl::InlinedVector<int64, 4>> padded;
+  batch_dims->assign(rank, 1);
+  for (const auto& dims : inputs) {
+    padded.emplace_back(rank - dims.size(), 1);
+    padded.back().insert(padded.back().end(), dims.begin(), dims.end());
+    for (size_t i = 0; i < rank; ++i) {
+      const int64 dim = padded.back()[i];
+      if (dim == 1) continue;
+      if ((*batch_dims)[i] != 1 && (*batch_dims)[i] != dim) {
+        return errors::InvalidArgument(
+            "Incompatible batch dimensions at dimension ", i, ": ",
+            (*batch_dims)[i], " vs. ", dim);
+      }
+      (*batch_dims)[i] = dim;
+    }
+  }
+
+  int64 num_batches = 1;
+  for (const int64 dim : *batch_dims) num_batches *= dim;
+  offsets->assign(inputs.size(), std::vector<int64>(num_batches));
+  for (size_t j = 0; j < inputs.size(); ++j) {
+    // The strides of the input in matrices, which are 0 in the broadcast
+    // dimensions.
+    gtl::InlinedVector<int64, 4> strides(rank, 0);
+    int64 stride = 1;
+    for (int i = static_cast<int>(rank) - 1; i >= 0; --i) {
+      if (padded[j][i] != 1) strides[i] = stride;
+      stride *= padded[j][i];
+    }
+    for (int64 b = 0; b < num_batches; ++b) {
+      int64 remainder = b;
+      int64 offset = 0;
+      for (int i = static_cast<int>(rank) - 1; i >= 0; --i) {
+        offset += (remainder % (*batch_dims)[i]) * strides[i];
+        remainder /= (*batch_dims)[i];
+      }
+      (*offsets)[j][b] = offset;
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+class FusedMultiHeadAttentionOp : public OpKernel {
+ public:
+  explicit FusedMultiHeadAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_bias", &num_bias_));
+    OP_REQUIRES(context, num_bias_ <= 1,
+                errors::InvalidArgument("num_bias must be 0 or 1, got ",
+                                        num_bias_));
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& query = context->input(0);
+    const Tensor& key = context->input(1);
+    const Tensor& value = context->input(2);
+    for (int i = 0; i < 3; ++i) {
+      OP_REQUIRES(context, context->input(i).dims() >= 2,
+                  errors::InvalidArgument("In[", i,
+                                          "] must have rank at least 2, got ",
+                                          context->input(i).dims()));
+    }
+    const int64 num_queries = query.dim_size(query.dims() - 2);
+    const int64 depth = query.dim_size(query.dims() - 1);
+    const int64 num_keys = key.dim_size(key.dims() - 2);
+    const int64 value_depth = value.dim_size(value.dims() - 1);
+    OP_REQUIRES(
+        context, key.dim_size(key.dims() - 1) == depth,
+        errors::InvalidArgument("query and key must have the same depth: ",
+                                query.shape().DebugString(), " vs. ",
+                                key.shape().DebugString()));
+    OP_REQUIRES(context, value.dim_size(value.dims() - 2) == num_keys,
+                errors::InvalidArgument(
+                    "key and value must have the same number of rows: ",
+                    key.shape().DebugString(), " vs. ",
+                    value.shape().DebugString()));
+
+    std::vector<gtl::InlinedVector<int64, 4>> input_batch_dims = {
+        BatchDims(query.shape()), BatchDims(key.shape()),
+        BatchDims(value.shape())};
+    // The bias broadcasts into the [num_queries, num_keys] scores, so it is
+    // read at bias[(batch offset) + i * row_stride + j * column_stride].
+    const Tensor* bias = nullptr;
+    int64 bias_row_stride = 0;
+    int64 bias_column_stride = 0;
+    if (num_bias_ == 1) {
+      bias = &context->input(3);
+      const int rank = bias->dims();
+      const int64 rows = rank >= 2 ? bias->dim_size(rank - 2) : 1;
+      const int64 columns = rank >= 1 ? bias->dim_size(rank - 1) : 1;
+      OP_REQUIRES(context,
+                  (rows == 1 || rows == num_queries) &&
+                      (columns == 1 || columns == num_keys),
+                  errors::InvalidArgument(
+                      "bias must broadcast to the scores of shape [",
+                      num_queries, ", ", num_keys, "], got ",
+                      bias->shape().DebugString()));
+      bias_row_stride = rows == 1 ? 0 : columns;
+      bias_column_stride = columns == 1 ? 0 : 1;
+      input_batch_dims.push_back(BatchDims(bias->shape()));
+    }
+
+    gtl::InlinedVector<int64, 4> batch_dims;
+    std::vector<std::vector<int64>> offsets;
+    OP_REQUIRES_OK(context,
+                   BroadcastBatchDims(input_batch_dims, &batch_dims, &offsets));
+
+    TensorShape output_shape;
+    for (const int64 dim : batch_dims) output_shape.AddDim(dim);
+    output_shape.AddDim(num_queries);
+    output_shape.AddDim(value_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+    // The softmax over no keys is empty, and so is its product with value.
+    if (num_keys == 0) {
+      output->flat<float>().setZero();
+      return;
+    }
+
+    const float* query_data = query.flat<float>().data();
+    const float* key_data = key.flat<float>().data();
+    const float* value_data = value.flat<float>().data();
+    const float* bias_data =
+        bias != nullptr ? bias->flat<float>().data() : nullptr;
+    const int64 bias_matrix_size =
+        bias != nullptr && bias->dims() >= 2
+            ? bias->dim_size(bias->dims() - 2) *
+                  bias->dim_size(bias->dims() - 1)
+            : 0;
+    float* output_data = output->flat<float>().data();
+    const float scale = scale_;
+
+    const int64 num_batches = offsets[0].size();
+    const int64 num_query_blocks =
+        (num_queries + kQueryBlockSize - 1) / kQueryBlockSize;
+
+    // Computes a block of queries of one matrix of the batch at a time. The
+    // keys are visited in blocks, and the softmax is computed online: the
+    // output rows accumulate exp(scores - row_max) * value, and are rescaled
+    // whenever a block raises the maximum score of their row.
+    auto compute_blocks = [&](int64 start, int64 limit) {
+      RowMajorMatrix scores(kQueryBlockSize, kKeyBlockSize);
+      Eigen::ArrayXf row_max(kQueryBlockSize);
+      Eigen::ArrayXf row_sum(kQueryBlockSize);
+      for (int64 block = start; block < limit; ++block) {
+        const int64 b = block / num_query_blocks;
+        const int64 first_query = (block % num_query_blocks) * kQueryBlockSize;
+        const int64 rows =
+            std::min(kQueryBlockSize, num_queries - first_query);
+
+        ConstMatrixMap q(
+            query_data + (offsets[0][b] * num_queries + first_query) * depth,
+            rows, depth);
+        const float* k = key_data + offsets[1][b] * num_keys * depth;
+        const float* v = value_data + offsets[2][b] * num_keys * value_depth;
+        MatrixMap out(
+            output_data + (b * num_queries + first_query) * value_depth, rows,
+            value_depth);
+        const float* bias_block =
+            bias_data != nullptr
+                ? bias_data + offsets[3][b] * bias_matrix_size +
+                      first_query * bias_row_stride
+                : nullptr;
+
+        out.setZero();
+        row_max.head(rows).setConstant(-std::numeric_limits<float>::infinity());
+        row_sum.head(rows).setZero();
+        for (int64 first_key = 0; first_key < num_keys;
+             first_key += kKeyBlockSize) {
+          const int64 columns = std::min(kKeyBlockSize, num_keys - first_key);
+          auto s = scores.topLeftCorner(rows, columns);
+          s.noalias() =
+              scale * q *
+              ConstMatrixMap(k + first_key * depth, columns, depth).transpose();
+          if (bias_block != nullptr) {
+            for (int64 i = 0; i < rows; ++i) {
+              const float* bias_row = bias_block + i * bias_row_stride +
+                                      first_key * bias_column_stride;
+              if (bias_column_stride == 0) {
+                s.row(i).array() += bias_row[0];
+              } else {
+                s.row(i) += Eigen::Map<const Eigen::RowVectorXf>(bias_row,
+                                                                 columns);
+              }
+            }
+          }
+          for (int64 i = 0; i < rows; ++i) {
+            const float new_max = std::max(row_max(i), s.row(i).maxCoeff());
+            // Every score of the row so far is -inf, so nothing accumulates.
+            if (new_max == -std::numeric_limits<float>::infinity()) {
+              s.row(i).setZero();
+              continue;
+            }
+            const float correction = std::exp(row_max(i) - new_max);
+            s.row(i) = (s.row(i).array() - new_max).exp().matrix();
+            row_sum(i) = row_sum(i) * correction + s.row(i).sum();
+            out.row(i) *= correction;
+            row_max(i) = new_max;
+          }
+          out.noalias() +=
+              s * ConstMatrixMap(v + first_key * value_depth, columns,
+                                 value_depth);
+        }
+        // Like Softmax, rows whose scores are all -inf divide 0 by 0.
+        out.array().colwise() /= row_sum.head(rows);
+      }
+    };
+
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const int64 cost_per_block =
+        kQueryBlockSize * num_keys * (2 * depth + 2 * value_depth + 10);
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          num_batches * num_query_blocks, cost_per_block, compute_blocks);
+  }
+
+ private:
+  int num_bias_;
+  float scale_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("_FusedMultiHeadAttention")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        FusedMultiHeadAttentionOp);
+
+}  // namespace tensorflow
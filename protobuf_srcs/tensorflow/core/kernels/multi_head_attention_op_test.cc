@@ -0,0 +1,270 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+Tensor RandomTensor(const TensorShape& shape) {
+  Tensor tensor(DT_FLOAT, shape);
+  tensor.flat<float>().setRandom();
+  return tensor;
+}
+
+// Computes softmax(scale * query * key^T + bias) * value for rank 4 inputs
+// whose batch dimensions broadcast, and a rank 4 bias, if any.
+Tensor ReferenceAttention(const Tensor& query, const Tensor& key,
+                          const Tensor& value, const Tensor* bias,
+                          float scale) {
+  const auto q = query.tensor<float, 4>();
+  const auto k = key.tensor<float, 4>();
+  const auto v = value.tensor<float, 4>();
+  const int64 dim0 = std::max({query.dim_size(0), key.dim_size(0),
+                               value.dim_size(0),
+                               bias ? bias->dim_size(0) : 1});
+  const int64 dim1 = std::max({query.dim_size(1), key.dim_size(1),
+                               value.dim_size(1),
+                               bias ? bias->dim_size(1) : 1});
+  const int64 num_queries = query.dim_size(2);
+  const int64 num_keys = key.dim_size(2);
+  const int64 depth = query.dim_size(3);
+  const int64 value_depth = value.dim_size(3);
+  // Returns index 'i' of a dimension of size 'size', which may broadcast.
+  auto at = [](int64 size, int64 i) { return size == 1 ? 0 : i; };
+
+  Tensor output(DT_FLOAT,
+                TensorShape({dim0, dim1, num_queries, value_depth}));
+  auto out = output.tensor<float, 4>();
+  std::vector<float> scores(num_keys);
+  for (int64 a = 0; a < dim0; ++a) {
+    for (int64 b = 0; b < dim1; ++b) {
+      const int64 qa = at(q.dimension(0), a), qb = at(q.dimension(1), b);
+      const int64 ka = at(k.dimension(0), a), kb = at(k.dimension(1), b);
+      const int64 va = at(v.dimension(0), a), vb = at(v.dimension(1), b);
+      for (int64 i = 0; i < num_queries; ++i) {
+        float max_score = -std::numeric_limits<float>::infinity();
+        for (int64 j = 0; j < num_keys; ++j) {
+          float score = 0;
+          for (int64 d = 0; d < depth; ++d) {
+            score += q(qa, qb, i, d) * k(ka, kb, j, d);
+          }
+          score *= scale;
+          if (bias != nullptr) {
+            const auto bias_t = bias->tensor<float, 4>();
+            score += bias_t(at(bias_t.dimension(0), a),
+                            at(bias_t.dimension(1), b),
+                            at(bias_t.dimension(2), i),
+                            at(bias_t.dimension(3), j));
+          }
+          scores[j] = score;
+          max_score = std::max(max_score, score);
+        }
+        float sum = 0;
+        for (int64 j = 0; j < num_keys; ++j) {
+          scores[j] = std::exp(scores[j] - max_score);
+          sum += scores[j];
+        }
+        for (int64 d = 0; d < value_depth; ++d) {
+          float result = 0;
+          for (int64 j = 0; j < num_keys; ++j) {
+            result += scores[j] * v(va, vb, j, d);
+          }
+          out(a, b, i, d) = result / sum;
+        }
+      }
+    }
+  }
+  return output;
+}
+
+class FusedMultiHeadAttentionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int num_bias, float scale) {
+    TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedMultiHeadAttention")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(num_bias, DT_FLOAT))
+                     .Attr("num_bias", num_bias)
+                     .Attr("scale", scale)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void AddInput(const Tensor& tensor) {
+    AddInputFromArray<float>(tensor.shape(), tensor.flat<float>());
+  }
+
+  // Runs the op on rank 4 inputs and compares it with the reference. The op
+  // is given 'op_bias', if any, which must have the values of 'bias'.
+  void RunAndCompare(const Tensor& query, const Tensor& key,
+                     const Tensor& value, const Tensor* bias,
+                     const Tensor* op_bias, float scale) {
+    MakeOp(bias != nullptr ? 1 : 0, scale);
+    AddInput(query);
+    AddInput(key);
+    AddInput(value);
+    if (bias != nullptr) AddInput(*op_bias);
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorNear<float>(
+        ReferenceAttention(query, key, value, bias, scale), *GetOutput(0),
+        1e-5);
+  }
+};
+
+TEST_F(FusedMultiHeadAttentionOpTest, Small) {
+  const Tensor query = RandomTensor(TensorShape({2, 3, 5, 8}));
+  const Tensor key = RandomTensor(TensorShape({2, 3, 7, 8}));
+  const Tensor value = RandomTensor(TensorShape({2, 3, 7, 4}));
+  RunAndCompare(query, key, value, nullptr, nullptr, 0.35f);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, SpansBlocks) {
+  // More queries and keys than fit in one tile of the scores, and scores
+  // large enough for later blocks to raise the maximum of their rows.
+  const Tensor query = RandomTensor(TensorShape({1, 2, 70, 16}));
+  const Tensor key = RandomTensor(TensorShape({1, 2, 600, 16}));
+  const Tensor value = RandomTensor(TensorShape({1, 2, 600, 8}));
+  Tensor bias(DT_FLOAT, TensorShape({1, 1, 1, 600}));
+  test::FillFn<float>(&bias, [](int i) { return i % 3 == 0 ? 0 : -10000; });
+  RunAndCompare(query, key, value, &bias, &bias, 4.0f);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, BroadcastsBatch) {
+  const Tensor query = RandomTensor(TensorShape({2, 3, 4, 8}));
+  const Tensor key = RandomTensor(TensorShape({1, 3, 6, 8}));
+  const Tensor value = RandomTensor(TensorShape({2, 1, 6, 5}));
+  const Tensor bias = RandomTensor(TensorShape({2, 1, 4, 6}));
+  RunAndCompare(query, key, value, &bias, &bias, 1.0f);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, LowRankBias) {
+  const Tensor query = RandomTensor(TensorShape({1, 2, 3, 4}));
+  const Tensor key = RandomTensor(TensorShape({1, 2, 5, 4}));
+  const Tensor value = RandomTensor(TensorShape({1, 2, 5, 4}));
+  const Tensor bias = RandomTensor(TensorShape({5}));
+  Tensor reference_bias(DT_FLOAT, TensorShape({1, 1, 1, 5}));
+  CHECK(reference_bias.CopyFrom(bias, reference_bias.shape()));
+  RunAndCompare(query, key, value, &reference_bias, &bias, 0.5f);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, MaskedBlock) {
+  // Every key of the first block is masked.
+  const Tensor query = RandomTensor(TensorShape({1, 1, 2, 4}));
+  const Tensor key = RandomTensor(TensorShape({1, 1, 300, 4}));
+  const Tensor value = RandomTensor(TensorShape({1, 1, 300, 3}));
+  Tensor bias(DT_FLOAT, TensorShape({1, 1, 1, 300}));
+  test::FillFn<float>(&bias, [](int i) {
+    return i < 256 ? -std::numeric_limits<float>::infinity() : 0.0f;
+  });
+  RunAndCompare(query, key, value, &bias, &bias, 1.0f);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, Errors) {
+  MakeOp(0, 1.0f);
+  AddInput(RandomTensor(TensorShape({1, 2, 4})));
+  AddInput(RandomTensor(TensorShape({1, 3, 5})));
+  AddInput(RandomTensor(TensorShape({1, 3, 4})));
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, IncompatibleBias) {
+  MakeOp(1, 1.0f);
+  AddInput(RandomTensor(TensorShape({1, 2, 4})));
+  AddInput(RandomTensor(TensorShape({1, 3, 4})));
+  AddInput(RandomTensor(TensorShape({1, 3, 4})));
+  AddInput(RandomTensor(TensorShape({1, 2, 2})));
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+// Self-attention of 'batch' sequences of 'seq_len' tokens with 12 heads of
+// depth 64, like BERT-base, and a mask of the padded keys of every sequence.
+// Either runs the fused op, or the BatchMatMul + Mul + AddV2 + Softmax +
+// BatchMatMul that the remapper rewrites into it.
+static void BM_Attention(int iters, bool fused, int batch, int seq_len) {
+  testing::StopTiming();
+  constexpr int kNumHeads = 12;
+  constexpr int kDepth = 64;
+  const float scale = 1.0f / std::sqrt(static_cast<float>(kDepth));
+  Graph* g = new Graph(OpRegistry::Global());
+  const TensorShape shape({batch, kNumHeads, seq_len, kDepth});
+  Node* query = test::graph::Constant(g, RandomTensor(shape));
+  Node* key = test::graph::Constant(g, RandomTensor(shape));
+  Node* value = test::graph::Constant(g, RandomTensor(shape));
+  Node* mask = test::graph::Constant(
+      g, RandomTensor(TensorShape({batch, 1, 1, seq_len})));
+  if (fused) {
+    Node* output;
+    TF_CHECK_OK(NodeBuilder(g->NewName("attention"), "_FusedMultiHeadAttention")
+                    .Input(query)
+                    .Input(key)
+                    .Input(value)
+                    .Input(std::vector<NodeBuilder::NodeOut>{mask})
+                    .Attr("num_bias", 1)
+                    .Attr("scale", scale)
+                    .Finalize(g, &output));
+  } else {
+    Node* scores = test::graph::BatchMatmul(g, query, key, false, true);
+    Node* scale_node = test::graph::Constant(g, test::AsScalar(scale));
+    scores = test::graph::Binary(g, "Mul", scores, scale_node);
+    scores = test::graph::Binary(g, "AddV2", scores, mask);
+    Node* probabilities = test::graph::Unary(g, "Softmax", scores);
+    test::graph::BatchMatmul(g, probabilities, value, false, false);
+  }
+  // The two matmuls dominate the cost.
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch * kNumHeads *
+                          seq_len * seq_len * kDepth * 4);
+  testing::SetLabel(strings::StrCat(batch, "x", seq_len));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_ATTENTION(BATCH, SEQ_LEN)                                      \
+  static void BM_AttentionUnfused_##BATCH##_##SEQ_LEN(int iters) {        \
+    BM_Attention(iters, false, BATCH, SEQ_LEN);                           \
+  }                                                                       \
+  BENCHMARK(BM_AttentionUnfused_##BATCH##_##SEQ_LEN);                     \
+  static void BM_AttentionFused_##BATCH##_##SEQ_LEN(int iters) {          \
+    BM_Attention(iters, true, BATCH, SEQ_LEN);                            \
+  }                                                                       \
+  BENCHMARK(BM_AttentionFused_##BATCH##_##SEQ_LEN);
+
+BM_ATTENTION(8, 128);
+BM_ATTENTION(8, 512);
+BM_ATTENTION(1, 2048);
+BM_ATTENTION(1, 4096);
+
+}  // namespace
+}  // namespace tensorflow
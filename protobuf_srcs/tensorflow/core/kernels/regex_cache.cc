@@ -0,0 +1,95 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/regex_cache.h"
+
+#include "tensorflow/core/kernels/string_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+
+namespace {
+
+// The number of programs in the process-wide cache.
+constexpr size_t kGlobalCapacity = 256;
+
+// Returns the key of `pattern` compiled with `options`. The parse flags cover
+// all options except the ones below, and the pattern comes last, so that
+// distinct patterns and options have distinct keys.
+string CacheKey(const string& pattern, const RE2::Options& options) {
+  return strings::StrCat(options.ParseFlags(), ",", options.longest_match(),
+                         ",", options.max_mem(), ":", pattern);
+}
+
+}  // namespace
+
+RegexCache::RegexCache(size_t capacity) : capacity_(capacity) {}
+
+RegexCache* RegexCache::Global() {
+  static RegexCache* cache = new RegexCache(kGlobalCapacity);
+  return cache;
+}
+
+Status RegexCache::Lookup(const string& pattern, const RE2::Options& options,
+                          std::shared_ptr<const RE2>* re) {
+  const string key = CacheKey(pattern, options);
+  {
+    mutex_lock l(mu_);
+    auto it = entries_by_key_.find(key);
+    if (it != entries_by_key_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      *re = it->second->second;
+      return Status::OK();
+    }
+  }
+
+  // Compiles without holding the lock, so that lookups of other patterns are
+  // not blocked. Invalid patterns are not cached.
+  auto compiled = std::make_shared<const RE2>(pattern, options);
+  if (!compiled->ok()) {
+    return errors::InvalidArgument("Invalid pattern: ", pattern,
+                                   ", error: ", compiled->error());
+  }
+
+  mutex_lock l(mu_);
+  auto it = entries_by_key_.find(key);
+  if (it != entries_by_key_.end()) {
+    // Another thread compiled the same pattern meanwhile.
+    entries_.splice(entries_.begin(), entries_, it->second);
+    *re = it->second->second;
+    return Status::OK();
+  }
+  entries_.emplace_front(key, compiled);
+  entries_by_key_[key] = entries_.begin();
+  if (entries_.size() > capacity_) {
+    entries_by_key_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  *re = std::move(compiled);
+  return Status::OK();
+}
+
+size_t RegexCache::size() const {
+  mutex_lock l(mu_);
+  return entries_.size();
+}
+
+int64 RegexCostPerElement(const Tensor& strings) {
+  return StringCostPerElement(strings.flat<tstring>(), /*cost_per_string=*/100,
+                              /*cost_per_byte=*/10);
+}
+
+}  // namespace tensorflow
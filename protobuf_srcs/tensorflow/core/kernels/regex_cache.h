@@ -0,0 +1,77 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_REGEX_CACHE_H_
+#define TENSORFLOW_CORE_KERNELS_REGEX_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "re2/re2.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A bounded cache of compiled RE2 programs, keyed by pattern and options, for
+// kernels whose patterns are inputs rather than attrs. When the cache is full,
+// the least recently used program is evicted. Thread-safe.
+//
+// The cache is shared by all the kernels of the process, so that a pattern fed
+// to many graphs or ops is only compiled once. A compiled RE2 program is itself
+// thread-safe, so callers may run one over many strings at once: they shard
+// large batches across the intra-op threads, at RegexCostPerElement per string.
+class RegexCache {
+ public:
+  explicit RegexCache(size_t capacity);
+
+  // Returns the process-wide cache.
+  static RegexCache* Global();
+
+  // Sets `*re` to `pattern` compiled with `options`, compiling it unless it is
+  // cached. Returns an InvalidArgument error if the pattern does not compile.
+  Status Lookup(const string& pattern, const RE2::Options& options,
+                std::shared_ptr<const RE2>* re);
+
+  // Returns the number of cached programs.
+  size_t size() const;
+
+ private:
+  using Entry = std::pair<string, std::shared_ptr<const RE2>>;
+
+  const size_t capacity_;
+
+  mutable mutex mu_;
+
+  // The cached programs by key, most recently used first.
+  std::list<Entry> entries_ GUARDED_BY(mu_);
+  std::unordered_map<string, std::list<Entry>::iterator> entries_by_key_
+      GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RegexCache);
+};
+
+// Returns the estimated cost of running a compiled program over one of the
+// strings of `strings`, for sharding them across threads.
+int64 RegexCostPerElement(const Tensor& strings);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_REGEX_CACHE_H_
@@ -0,0 +1,73 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/regex_cache.h"
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(RegexCacheTest, ReusesCompiledPatterns) {
+  RegexCache cache(2);
+  std::shared_ptr<const RE2> first, second;
+  TF_ASSERT_OK(cache.Lookup("a+b", RE2::Options(), &first));
+  TF_ASSERT_OK(cache.Lookup("a+b", RE2::Options(), &second));
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_TRUE(RE2::FullMatch("aab", *first));
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST(RegexCacheTest, KeysByOptions) {
+  RegexCache cache(2);
+  RE2::Options case_insensitive;
+  case_insensitive.set_case_sensitive(false);
+  std::shared_ptr<const RE2> sensitive, insensitive;
+  TF_ASSERT_OK(cache.Lookup("ab", RE2::Options(), &sensitive));
+  TF_ASSERT_OK(cache.Lookup("ab", case_insensitive, &insensitive));
+  EXPECT_NE(sensitive.get(), insensitive.get());
+  EXPECT_FALSE(RE2::FullMatch("AB", *sensitive));
+  EXPECT_TRUE(RE2::FullMatch("AB", *insensitive));
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(RegexCacheTest, EvictsLeastRecentlyUsed) {
+  RegexCache cache(2);
+  std::shared_ptr<const RE2> a, b, a_again, c, b_again, c_again;
+  TF_ASSERT_OK(cache.Lookup("a", RE2::Options(), &a));
+  TF_ASSERT_OK(cache.Lookup("b", RE2::Options(), &b));
+  TF_ASSERT_OK(cache.Lookup("a", RE2::Options(), &a_again));
+  TF_ASSERT_OK(cache.Lookup("c", RE2::Options(), &c));
+  EXPECT_EQ(2, cache.size());
+
+  // "b" was evicted, but the program handed out earlier is still usable.
+  EXPECT_TRUE(RE2::FullMatch("b", *b));
+  TF_ASSERT_OK(cache.Lookup("b", RE2::Options(), &b_again));
+  EXPECT_NE(b.get(), b_again.get());
+  TF_ASSERT_OK(cache.Lookup("c", RE2::Options(), &c_again));
+  EXPECT_EQ(c.get(), c_again.get());
+}
+
+TEST(RegexCacheTest, InvalidPattern) {
+  RegexCache cache(2);
+  std::shared_ptr<const RE2> re;
+  const Status status = cache.Lookup("(a", RE2::Options(), &re);
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+  EXPECT_EQ(0, cache.size());
+}
+
+}  // namespace
+}  // namespace tensorflow
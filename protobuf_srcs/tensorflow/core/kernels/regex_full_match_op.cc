@@ -18,12 +18,35 @@ limitations under the License.
 #include "re2/re2.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/regex_cache.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/util/ptr_util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Sets `output_tensor` to whether each string of `input_tensor` fully matches
+// `match`.
+void FullMatch(OpKernelContext* ctx, const RE2& match,
+               const Tensor& input_tensor, Tensor* output_tensor) {
+  const auto input = input_tensor.flat<tstring>();
+  auto output = output_tensor->flat<bool>();
+  auto full_match = [&input, &output, &match](int64 start, int64 end) {
+    for (int64 i = start; i < end; ++i) {
+      output(i) = RE2::FullMatch(input(i), match);
+    }
+  };
+  // Sharded because RE2 programs are thread-safe; see RegexCache.
+  auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+  Shard(worker_threads.num_threads, worker_threads.workers, input.size(),
+        RegexCostPerElement(input_tensor), full_match);
+}
+
+}  // namespace
+
 class RegexFullMatchOp : public OpKernel {
  public:
   explicit RegexFullMatchOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
@@ -31,7 +54,6 @@ class RegexFullMatchOp : public OpKernel {
   void Compute(OpKernelContext* ctx) override {
     const Tensor* input_tensor;
     OP_REQUIRES_OK(ctx, ctx->input("input", &input_tensor));
-    const auto& input_flat = input_tensor->flat<tstring>();
 
     const Tensor* pattern_tensor;
     OP_REQUIRES_OK(ctx, ctx->input("pattern", &pattern_tensor));
@@ -39,18 +61,14 @@ class RegexFullMatchOp : public OpKernel {
                 errors::InvalidArgument("Pattern must be scalar, but received ",
                                         pattern_tensor->shape().DebugString()));
     const string pattern = pattern_tensor->flat<tstring>()(0);
-    const RE2 match(pattern);
-    OP_REQUIRES(ctx, match.ok(),
-                errors::InvalidArgument("Invalid pattern: ", pattern,
-                                        ", error: ", match.error()));
+    std::shared_ptr<const RE2> match;
+    OP_REQUIRES_OK(ctx, RegexCache::Global()->Lookup(
+                            pattern, RE2::Options(), &match));
 
     Tensor* output_tensor = nullptr;
     OP_REQUIRES_OK(ctx, ctx->allocate_output("output", input_tensor->shape(),
                                              &output_tensor));
-    auto output_flat = output_tensor->flat<bool>();
-    for (size_t i = 0; i < input_flat.size(); ++i) {
-      output_flat(i) = RE2::FullMatch(input_flat(i), match);
-    }
+    FullMatch(ctx, *match, *input_tensor, output_tensor);
   }
 };
 
@@ -71,15 +89,11 @@ class StaticRegexFullMatchOp : public OpKernel {
   void Compute(OpKernelContext* ctx) override {
     const Tensor* input_tensor;
     OP_REQUIRES_OK(ctx, ctx->input("input", &input_tensor));
-    const auto& input_flat = input_tensor->flat<tstring>();
 
     Tensor* output_tensor = nullptr;
     OP_REQUIRES_OK(ctx, ctx->allocate_output("output", input_tensor->shape(),
                                              &output_tensor));
-    auto output_flat = output_tensor->flat<bool>();
-    for (size_t i = 0; i < input_flat.size(); ++i) {
-      output_flat(i) = RE2::FullMatch(input_flat(i), *re_);
-    }
+    FullMatch(ctx, *re_, *input_tensor, output_tensor);
   }
 
  private:
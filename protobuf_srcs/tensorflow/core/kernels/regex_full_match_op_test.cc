@@ -0,0 +1,98 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+class RegexFullMatchOpTest : public OpsTestBase {};
+
+TEST_F(RegexFullMatchOpTest, MatchesLargeBatch) {
+  TF_ASSERT_OK(NodeDefBuilder("regex_full_match_op", "RegexFullMatch")
+                   .Input(FakeInput(DT_STRING))
+                   .Input(FakeInput(DT_STRING))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  // Enough strings to be split across threads.
+  const int kBatchSize = 10000;
+  AddInput<tstring>(TensorShape({kBatchSize}), [](int i) -> tstring {
+    return i % 3 == 0 ? "abc" : "xyz";
+  });
+  AddInputFromArray<tstring>(TensorShape({}), {"a.c"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(DT_BOOL, TensorShape({kBatchSize}));
+  test::FillFn<bool>(&expected, [](int i) { return i % 3 == 0; });
+  test::ExpectTensorEqual<bool>(expected, *GetOutput(0));
+}
+
+TEST_F(RegexFullMatchOpTest, InvalidPattern) {
+  TF_ASSERT_OK(NodeDefBuilder("regex_full_match_op", "RegexFullMatch")
+                   .Input(FakeInput(DT_STRING))
+                   .Input(FakeInput(DT_STRING))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<tstring>(TensorShape({1}), {"abc"});
+  AddInputFromArray<tstring>(TensorShape({}), {"(a"});
+  const Status status = RunOpKernel();
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+  EXPECT_TRUE(absl::StrContains(status.error_message(), "Invalid pattern"));
+}
+
+Graph* SetupRegexFullMatchGraph(int batch_size, const string& input_pattern) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_STRING, TensorShape({batch_size}));
+  auto input_flat = input.flat<tstring>();
+  for (int i = 0; i < batch_size; ++i) {
+    input_flat(i) = strings::StrCat("user_", i, "@example.com");
+  }
+  Tensor pattern(DT_STRING, TensorShape({}));
+  pattern.flat<tstring>().setConstant(input_pattern);
+
+  TF_CHECK_OK(NodeBuilder("regex_full_match_op", "RegexFullMatch")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, pattern))
+                  .Finalize(g, nullptr /* node */));
+  return g;
+}
+
+void BM_RegexFullMatch(int iters, int batch_size) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size);
+  testing::UseRealTime();
+  Graph* g = SetupRegexFullMatchGraph(batch_size, "[a-z_0-9]+@[a-z]+\\.com");
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_RegexFullMatch)
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(4096)
+    ->Arg(65536);
+
+}  // end namespace tensorflow
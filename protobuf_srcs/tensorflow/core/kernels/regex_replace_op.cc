@@ -18,9 +18,11 @@ limitations under the License.
 #include "re2/re2.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/regex_cache.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/util/ptr_util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
@@ -47,17 +49,24 @@ Status InternalCompute(const RE2& match, const string& rewrite,
     output_tensor->flat<tstring>() = input_tensor->flat<tstring>();
   }
   auto output_flat = output_tensor->flat<tstring>();
-  for (size_t i = 0; i < output_flat.size(); ++i) {
-    // TODO(dero): Mitigate copy; Global and GlobalReplace below currently only
-    // accept std::string.
-    string buf = output_flat(i);
-    if (replace_global) {
-      RE2::GlobalReplace(&buf, match, rewrite);
-    } else {
-      RE2::Replace(&buf, match, rewrite);
+  auto replace = [&output_flat, &match, &rewrite, replace_global](int64 start,
+                                                                   int64 end) {
+    for (int64 i = start; i < end; ++i) {
+      // TODO(dero): Mitigate copy; Global and GlobalReplace below currently
+      // only accept std::string.
+      string buf = output_flat(i);
+      if (replace_global) {
+        RE2::GlobalReplace(&buf, match, rewrite);
+      } else {
+        RE2::Replace(&buf, match, rewrite);
+      }
+      output_flat(i) = std::move(buf);
     }
-    output_flat(i) = std::move(buf);
-  }
+  };
+  // Sharded because RE2 programs are thread-safe; see RegexCache.
+  auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+  Shard(worker_threads.num_threads, worker_threads.workers, output_flat.size(),
+        RegexCostPerElement(*output_tensor), replace);
   return Status::OK();
 }
 }  // namespace
@@ -75,10 +84,9 @@ class RegexReplaceOp : public OpKernel {
                 errors::InvalidArgument("Pattern must be scalar, but received ",
                                         pattern_tensor->shape().DebugString()));
     const string& pattern = pattern_tensor->scalar<tstring>()();
-    const RE2 match(pattern);
-    OP_REQUIRES(ctx, match.ok(),
-                errors::InvalidArgument("Invalid pattern: ", pattern,
-                                        ", error: ", match.error()));
+    std::shared_ptr<const RE2> match;
+    OP_REQUIRES_OK(ctx, RegexCache::Global()->Lookup(
+                            pattern, RE2::Options(), &match));
 
     const Tensor* rewrite_tensor;
     OP_REQUIRES_OK(ctx, ctx->input("rewrite", &rewrite_tensor));
@@ -86,7 +94,8 @@ class RegexReplaceOp : public OpKernel {
                 errors::InvalidArgument("Rewrite must be scalar, but received ",
                                         rewrite_tensor->shape().DebugString()));
     const string& rewrite = rewrite_tensor->scalar<tstring>()();
-    OP_REQUIRES_OK(ctx, InternalCompute(match, rewrite, replace_global_, ctx));
+    OP_REQUIRES_OK(ctx,
+                   InternalCompute(*match, rewrite, replace_global_, ctx));
   }
 
  private:
@@ -101,7 +101,9 @@ BENCHMARK(BM_RegexReplace)
     ->Arg(32)
     ->Arg(64)
     ->Arg(128)
-    ->Arg(256);
+    ->Arg(256)
+    ->Arg(4096)
+    ->Arg(65536);
 
 Graph* SetupStaticGraph(const Tensor& input, const string& input_pattern,
                         const string& rewrite) {
@@ -132,6 +134,8 @@ BENCHMARK(BM_StaticRegexReplace)
     ->Arg(32)
     ->Arg(64)
     ->Arg(128)
-    ->Arg(256);
+    ->Arg(256)
+    ->Arg(4096)
+    ->Arg(65536);
 
 }  // end namespace tensorflow
@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/util/work_sharder.h"
@@ -163,6 +164,55 @@ class OutputUpdater {
   Tensor* values_out_;
 };
 
+// ProductIterator generates cartesian products based on indices.
+template <typename InternalType>
+class ProductIterator {
+ public:
+  explicit ProductIterator(
+      const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
+          columns,
+      int64 batch_index)
+      : columns_(columns), batch_index_(batch_index) {
+    next_permutation_.resize(columns_.size(), 0);
+    // Sets has_next_ to false if any feature column has 0 features.
+    has_next_ = true;
+    for (int i = 0; i < columns_.size(); i++) {
+      if (columns_[i]->FeatureCount(batch_index_) == 0) {
+        has_next_ = false;
+        break;
+      }
+    }
+  }
+
+  std::vector<int> Next() {
+    std::vector<int> permutation(next_permutation_);
+
+    // Generates next permutation, if available.
+    bool carry = true;
+    for (int i = next_permutation_.size() - 1; i >= 0; i--) {
+      if (carry) {
+        next_permutation_[i] = next_permutation_[i] + 1;
+      }
+      if (next_permutation_[i] == columns_[i]->FeatureCount(batch_index_)) {
+        next_permutation_[i] = 0;
+      } else {
+        carry = false;
+        break;
+      }
+    }
+    has_next_ = !carry;
+    return permutation;
+  }
+
+  bool HasNext() { return has_next_; }
+
+ private:
+  bool has_next_;
+  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
+  const int64 batch_index_;
+  std::vector<int> next_permutation_;
+};
+
 // Generates the sparse crosses as concatenation of strings.
 template <typename InternalType>
 class StringCrosser {
@@ -185,6 +235,19 @@ class StringCrosser {
     return absl::StrJoin(cross_vec, k_feature_separator);
   }
 
+  // Updates the output with all the crosses of the specified batch.
+  template <typename Updater>
+  void Cross(const int64 batch_index, const Updater& updater) const {
+    ProductIterator<InternalType> product_iterator(columns_, batch_index);
+    int64 cross_count = 0;
+    while (product_iterator.HasNext()) {
+      const auto permutation = product_iterator.Next();
+      updater.Update(batch_index, cross_count,
+                     Generate(batch_index, permutation));
+      cross_count++;
+    }
+  }
+
  private:
   const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
 };
@@ -205,7 +268,49 @@ class HashCrosser {
       uint64 hash_i = columns_[i]->Feature(batch_index, permutation[i]);
       hashed_output = FingerprintCat64(hashed_output, hash_i);
     }
-    // The return value is int64 based on the number of buckets.
+    return ToBucket(hashed_output);
+  }
+
+  // Updates the output with all the crosses of the specified batch, in the
+  // order of ProductIterator. Consecutive crosses share all but their last
+  // features, so the concatenated fingerprint of the features they share is
+  // only computed once.
+  template <typename Updater>
+  void Cross(const int64 batch_index, const Updater& updater) const {
+    const int num_columns = columns_.size();
+    gtl::InlinedVector<int64, 8> feature_counts(num_columns);
+    for (int i = 0; i < num_columns; ++i) {
+      feature_counts[i] = columns_[i]->FeatureCount(batch_index);
+      // If one column is missing any feature, there won't be any cross.
+      if (feature_counts[i] == 0) return;
+    }
+    gtl::InlinedVector<int64, 8> permutation(num_columns, 0);
+    // The concatenated fingerprint of the first i features is prefix_hashes[i].
+    gtl::InlinedVector<uint64, 8> prefix_hashes(num_columns + 1);
+    prefix_hashes[0] = hash_key_;
+    int first_changed_column = 0;
+    for (int64 cross_count = 0;; ++cross_count) {
+      for (int i = first_changed_column; i < num_columns; ++i) {
+        const uint64 hash_i = columns_[i]->Feature(batch_index, permutation[i]);
+        prefix_hashes[i + 1] = FingerprintCat64(prefix_hashes[i], hash_i);
+      }
+      updater.Update(batch_index, cross_count,
+                     ToBucket(prefix_hashes[num_columns]));
+
+      // Advances the last column fastest, carrying over to the ones before.
+      int i = num_columns - 1;
+      while (i >= 0 && ++permutation[i] == feature_counts[i]) {
+        permutation[i] = 0;
+        --i;
+      }
+      if (i < 0) break;
+      first_changed_column = i;
+    }
+  }
+
+ private:
+  // The return value is int64 based on the number of buckets.
+  int64 ToBucket(const uint64 hashed_output) const {
     if (num_buckets_ > 0) {
       return hashed_output % num_buckets_;
     } else {
@@ -214,61 +319,11 @@ class HashCrosser {
     }
   }
 
- private:
   const std::vector<std::unique_ptr<ColumnInterface<int64>>>& columns_;
   const int64 num_buckets_;
   const uint64 hash_key_;
 };
 
-// ProductIterator generates cartesian products based on indices.
-template <typename InternalType>
-class ProductIterator {
- public:
-  explicit ProductIterator(
-      const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
-          columns,
-      int64 batch_index)
-      : columns_(columns), batch_index_(batch_index) {
-    next_permutation_.resize(columns_.size(), 0);
-    // Sets has_next_ to false if any feature column has 0 features.
-    has_next_ = true;
-    for (int i = 0; i < columns_.size(); i++) {
-      if (columns_[i]->FeatureCount(batch_index_) == 0) {
-        has_next_ = false;
-        break;
-      }
-    }
-  }
-
-  std::vector<int> Next() {
-    std::vector<int> permutation(next_permutation_);
-
-    // Generates next permutation, if available.
-    bool carry = true;
-    for (int i = next_permutation_.size() - 1; i >= 0; i--) {
-      if (carry) {
-        next_permutation_[i] = next_permutation_[i] + 1;
-      }
-      if (next_permutation_[i] == columns_[i]->FeatureCount(batch_index_)) {
-        next_permutation_[i] = 0;
-      } else {
-        carry = false;
-        break;
-      }
-    }
-    has_next_ = !carry;
-    return permutation;
-  }
-
-  bool HasNext() { return has_next_; }
-
- private:
-  bool has_next_;
-  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
-  const int64 batch_index_;
-  std::vector<int> next_permutation_;
-};
-
 template <bool HASHED_OUTPUT, typename InternalType>
 struct CrossTraits;
 
@@ -311,9 +366,23 @@ class SparseCrossOp : public OpKernel {
     ValidateInput(context, indices_list_in, values_list_in, shapes_list_in,
                   dense_list_in);
 
+    // The columns refer to these tensors. When crosses are hashed, each string
+    // feature is fingerprinted once here, rather than once per cross.
+    std::vector<Tensor> values_in(values_list_in.begin(),
+                                  values_list_in.end());
+    std::vector<Tensor> dense_in(dense_list_in.begin(), dense_list_in.end());
+    if (HASHED_OUTPUT) {
+      for (Tensor& tensor : values_in) {
+        OP_REQUIRES_OK(context, FingerprintStrings(context, &tensor));
+      }
+      for (Tensor& tensor : dense_in) {
+        OP_REQUIRES_OK(context, FingerprintStrings(context, &tensor));
+      }
+    }
+
     std::vector<std::unique_ptr<ColumnInterface<InternalType>>> columns =
-        GenerateColumnsFromInput(indices_list_in, values_list_in,
-                                 shapes_list_in, dense_list_in);
+        GenerateColumnsFromInput(indices_list_in, values_in, shapes_list_in,
+                                 dense_in);
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
         columns, num_buckets_, hash_key_);
@@ -327,15 +396,9 @@ class SparseCrossOp : public OpKernel {
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Updater updater(
         output_start_indices, indices_out, values_out);
-    auto do_work = [&columns, crosser, updater](int64 begin, int64 end) {
+    auto do_work = [crosser, updater](int64 begin, int64 end) {
       for (int b = begin; b < end; b++) {
-        ProductIterator<InternalType> product_iterator(columns, b);
-        int64 cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count, crosser.Generate(b, permutation));
-          cross_count++;
-        }
+        crosser.Cross(b, updater);
       }
     };
 
@@ -428,8 +491,9 @@ class SparseCrossOp : public OpKernel {
   }
 
   // Calculate the batch size from either the shapes input or the dense input.
+  template <typename DenseList>
   int64 CalculateBatchSize(const OpInputList& shapes_list_in,
-                           const OpInputList& dense_list_in) {
+                           const DenseList& dense_list_in) {
     if (shapes_list_in.size() > 0) {
       return shapes_list_in[0].vec<int64>()(0);
     }
@@ -441,12 +505,34 @@ class SparseCrossOp : public OpKernel {
     return 0;
   }
 
+  // Replaces a string tensor by the Fingerprint64 of its strings, computed in
+  // parallel on the intra-op threads. Leaves other tensors unchanged.
+  Status FingerprintStrings(OpKernelContext* context, Tensor* tensor) {
+    if (tensor->dtype() != DT_STRING) return Status::OK();
+    Tensor fingerprints;
+    TF_RETURN_IF_ERROR(
+        context->allocate_temp(DT_INT64, tensor->shape(), &fingerprints));
+    const auto strings = tensor->flat<tstring>();
+    auto fingerprints_flat = fingerprints.flat<int64>();
+    auto fingerprint = [&strings, &fingerprints_flat](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        fingerprints_flat(i) = Fingerprint64(strings(i));
+      }
+    };
+    auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int kCostPerUnit = 100;
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          strings.size(), kCostPerUnit, fingerprint);
+    *tensor = fingerprints;
+    return Status::OK();
+  }
+
   // Generate the columns given the sparse and dense inputs.
   std::vector<std::unique_ptr<ColumnInterface<InternalType>>>
   GenerateColumnsFromInput(const OpInputList& indices_list_in,
-                           const OpInputList& values_list_in,
+                           const std::vector<Tensor>& values_list_in,
                            const OpInputList& shapes_list_in,
-                           const OpInputList& dense_list_in) {
+                           const std::vector<Tensor>& dense_list_in) {
     std::vector<std::unique_ptr<ColumnInterface<InternalType>>> columns;
     const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
     const int64 number_of_columns = shapes_list_in.size();
@@ -0,0 +1,167 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int64 kHashKey = 956888297470;
+
+class SparseCrossOpTest : public OpsTestBase {
+ protected:
+  // Makes a hashed SparseCross over one sparse string column and two dense
+  // columns, of int64 and string.
+  void MakeHashedOp(int64 num_buckets) {
+    TF_ASSERT_OK(NodeDefBuilder("sparse_cross", "SparseCross")
+                     .Input(FakeInput(1, DT_INT64))
+                     .Input(FakeInput({DT_STRING}))
+                     .Input(FakeInput(1, DT_INT64))
+                     .Input(FakeInput({DT_INT64, DT_STRING}))
+                     .Attr("hashed_output", true)
+                     .Attr("num_buckets", num_buckets)
+                     .Attr("hash_key", kHashKey)
+                     .Attr("out_type", DT_INT64)
+                     .Attr("internal_type", DT_INT64)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(SparseCrossOpTest, HashedCrossMatchesFingerprints) {
+  MakeHashedOp(0);
+  // The sparse column has two features in the first batch and one in the
+  // second.
+  AddInputFromArray<int64>(TensorShape({3, 2}), {0, 0, 0, 1, 1, 0});
+  AddInputFromArray<tstring>(TensorShape({3}), {"a", "b", "c"});
+  AddInputFromArray<int64>(TensorShape({2}), {2, 2});
+  AddInputFromArray<int64>(TensorShape({2, 2}), {3, 4, 5, 6});
+  AddInputFromArray<tstring>(TensorShape({2, 3}),
+                             {"d", "e", "f", "g", "h", "i"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const std::vector<std::vector<tstring>> sparse = {{"a", "b"}, {"c"}};
+  const std::vector<std::vector<int64>> dense_int = {{3, 4}, {5, 6}};
+  const std::vector<std::vector<tstring>> dense_string = {{"d", "e", "f"},
+                                                          {"g", "h", "i"}};
+  std::vector<int64> expected_indices;
+  std::vector<int64> expected_values;
+  for (int64 b = 0; b < 2; ++b) {
+    int64 cross_count = 0;
+    for (const tstring& s : sparse[b]) {
+      for (const int64 i : dense_int[b]) {
+        for (const tstring& d : dense_string[b]) {
+          uint64 hash = FingerprintCat64(kHashKey, Fingerprint64(s));
+          hash = FingerprintCat64(hash, i);
+          hash = FingerprintCat64(hash, Fingerprint64(d));
+          expected_indices.push_back(b);
+          expected_indices.push_back(cross_count++);
+          expected_values.push_back(hash %
+                                    std::numeric_limits<int64>::max());
+        }
+      }
+    }
+  }
+
+  Tensor indices(DT_INT64, TensorShape({18, 2}));
+  test::FillValues<int64>(&indices, expected_indices);
+  test::ExpectTensorEqual<int64>(indices, *GetOutput(0));
+  Tensor values(DT_INT64, TensorShape({18}));
+  test::FillValues<int64>(&values, expected_values);
+  test::ExpectTensorEqual<int64>(values, *GetOutput(1));
+  Tensor shape(DT_INT64, TensorShape({2}));
+  test::FillValues<int64>(&shape, {2, 12});
+  test::ExpectTensorEqual<int64>(shape, *GetOutput(2));
+}
+
+TEST_F(SparseCrossOpTest, HashedCrossWithMissingFeature) {
+  MakeHashedOp(100);
+  // The second batch has no sparse feature, so no cross.
+  AddInputFromArray<int64>(TensorShape({1, 2}), {0, 0});
+  AddInputFromArray<tstring>(TensorShape({1}), {"a"});
+  AddInputFromArray<int64>(TensorShape({2}), {2, 1});
+  AddInputFromArray<int64>(TensorShape({2, 1}), {3, 4});
+  AddInputFromArray<tstring>(TensorShape({2, 1}), {"d", "e"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  uint64 hash = FingerprintCat64(kHashKey, Fingerprint64("a"));
+  hash = FingerprintCat64(hash, 3);
+  hash = FingerprintCat64(hash, Fingerprint64("d"));
+  Tensor indices(DT_INT64, TensorShape({1, 2}));
+  test::FillValues<int64>(&indices, {0, 0});
+  test::ExpectTensorEqual<int64>(indices, *GetOutput(0));
+  Tensor values(DT_INT64, TensorShape({1}));
+  test::FillValues<int64>(&values, {static_cast<int64>(hash % 100)});
+  test::ExpectTensorEqual<int64>(values, *GetOutput(1));
+}
+
+// Crosses 'num_columns' dense string columns of 'num_features' features.
+static Graph* SparseCrossHashed(int batch_size, int num_columns,
+                                int num_features) {
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<NodeBuilder::NodeOut> dense_inputs;
+  for (int c = 0; c < num_columns; ++c) {
+    Tensor dense(DT_STRING, TensorShape({batch_size, num_features}));
+    auto dense_flat = dense.flat<tstring>();
+    for (int64 i = 0; i < dense_flat.size(); ++i) {
+      dense_flat(i) = strings::StrCat("column_", c, "_feature_", i);
+    }
+    dense_inputs.emplace_back(test::graph::Constant(g, dense));
+  }
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "SparseCross")
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Input(dense_inputs)
+                  .Attr("N", 0)
+                  .Attr("sparse_types", DataTypeVector())
+                  .Attr("hashed_output", true)
+                  .Attr("num_buckets", 1 << 20)
+                  .Attr("hash_key", kHashKey)
+                  .Attr("out_type", DT_INT64)
+                  .Attr("internal_type", DT_INT64)
+                  .Finalize(g, &node));
+  return g;
+}
+
+static void BM_SparseCrossHashed(int iters, int batch_size) {
+  testing::StopTiming();
+  constexpr int kNumColumns = 3;
+  constexpr int kNumFeatures = 4;
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size);
+  testing::UseRealTime();
+  Graph* g = SparseCrossHashed(batch_size, kNumColumns, kNumFeatures);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_SparseCrossHashed)->Arg(64)->Arg(1024)->Arg(16384);
+
+}  // namespace
+}  // namespace tensorflow
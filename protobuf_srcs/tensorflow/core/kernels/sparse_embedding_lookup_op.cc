@@ -0,0 +1,206 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// CPU kernel of _FusedSparseEmbeddingLookup, created by the remapper from
+// Unique + Gather + SparseSegment{Sum,Mean,SqrtN}. The rows of the embedding
+// are accumulated directly into the output, without materializing the unique
+// ids or the gathered rows.
+
+#define EIGEN_USE_THREADS
+
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Number of ids ahead of the current one whose rows are prefetched.
+constexpr int kPrefetchDistance = 4;
+
+enum class Combiner { kSum, kMean, kSqrtN };
+
+}  // namespace
+
+template <typename T, typename Tidx>
+class FusedSparseEmbeddingLookupOp : public OpKernel {
+ public:
+  explicit FusedSparseEmbeddingLookupOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    if (combiner == "sum") {
+      combiner_ = Combiner::kSum;
+    } else if (combiner == "mean") {
+      combiner_ = Combiner::kMean;
+    } else if (combiner == "sqrtn") {
+      combiner_ = Combiner::kSqrtN;
+    } else {
+      OP_REQUIRES(context, false,
+                  errors::InvalidArgument("Unsupported combiner: ", combiner));
+    }
+    int num_weights;
+    OP_REQUIRES_OK(context, context->GetAttr("num_weights", &num_weights));
+    OP_REQUIRES(context, num_weights <= 1,
+                errors::InvalidArgument("num_weights must be 0 or 1, got ",
+                                        num_weights));
+    has_weights_ = num_weights == 1;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& segment_ids = context->input(2);
+
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+                errors::InvalidArgument("params must be at least 1-D, got ",
+                                        params.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                errors::InvalidArgument("segment_ids should be a vector."));
+    const int64 num_ids = ids.NumElements();
+    OP_REQUIRES(context, num_ids == segment_ids.NumElements(),
+                errors::InvalidArgument(
+                    "segment_ids and ids should have same size."));
+    const T* weights = nullptr;
+    if (has_weights_) {
+      const Tensor& weights_tensor = context->input(3);
+      OP_REQUIRES(context, weights_tensor.shape() == ids.shape(),
+                  errors::InvalidArgument(
+                      "weights and ids should have same shape, got ",
+                      weights_tensor.shape().DebugString(), " and ",
+                      ids.shape().DebugString()));
+      weights = weights_tensor.flat<T>().data();
+    }
+
+    const auto params_flat = params.flat_outer_dims<T>();
+    const int64 num_rows = params_flat.dimension(0);
+    const int64 row_size = params_flat.dimension(1);
+    const auto ids_vec = ids.vec<Tidx>();
+    const auto segment_vec = segment_ids.vec<int32>();
+
+    // Validates all ids and segment ids before the rows are accumulated in
+    // parallel, and finds the first id of every segment.
+    for (int64 i = 0; i < num_ids; ++i) {
+      const Tidx id = internal::SubtleMustCopy(ids_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(id, num_rows),
+                  errors::InvalidArgument("Bad: ids[", i, "] == ", id,
+                                          " out of range [0, ", num_rows,
+                                          ")"));
+    }
+    const int64 num_segments =
+        num_ids > 0 ? internal::SubtleMustCopy(segment_vec(num_ids - 1)) + 1
+                    : 0;
+    OP_REQUIRES(context, num_ids == 0 || segment_vec(0) >= 0,
+                errors::InvalidArgument("segment ids must be >= 0"));
+    std::vector<int64> segment_begin(num_segments + 1);
+    int64 i = 0;
+    for (int64 s = 0; s < num_segments; ++s) {
+      segment_begin[s] = i;
+      while (i < num_ids && internal::SubtleMustCopy(segment_vec(i)) == s) {
+        ++i;
+      }
+      OP_REQUIRES(context,
+                  i == num_ids || internal::SubtleMustCopy(segment_vec(i)) > s,
+                  errors::InvalidArgument("segment ids are not increasing"));
+    }
+    OP_REQUIRES(context, i == num_ids,
+                errors::InvalidArgument("segment ids are not increasing"));
+    segment_begin[num_segments] = num_ids;
+
+    TensorShape output_shape = params.shape();
+    output_shape.set_dim(0, num_segments);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (num_segments == 0 || row_size == 0) return;
+
+    const T* params_data = params_flat.data();
+    T* output_data = output->flat<T>().data();
+    const int64 row_bytes = row_size * sizeof(T);
+    auto combine_segments = [&](int64 start, int64 limit) {
+      typedef Eigen::Array<T, Eigen::Dynamic, 1> Row;
+      for (int64 s = start; s < limit; ++s) {
+        // Eigen vectorizes the accumulation of the rows.
+        Eigen::Map<Row> out(output_data + s * row_size, row_size);
+        out.setZero();
+        T weight_sum = 0;
+        T weight_square_sum = 0;
+        const int64 end = segment_begin[s + 1];
+        for (int64 j = segment_begin[s]; j < end; ++j) {
+          if (j + kPrefetchDistance < end) {
+            const char* next = reinterpret_cast<const char*>(
+                params_data + ids_vec(j + kPrefetchDistance) * row_size);
+            for (int64 offset = 0; offset < row_bytes; offset += 64) {
+              port::prefetch<port::PREFETCH_HINT_T0>(next + offset);
+            }
+          }
+          Eigen::Map<const Row> row(params_data + ids_vec(j) * row_size,
+                                    row_size);
+          if (weights == nullptr) {
+            out += row;
+          } else {
+            out += weights[j] * row;
+            weight_sum += weights[j];
+            weight_square_sum += weights[j] * weights[j];
+          }
+        }
+        if (weights == nullptr) {
+          weight_sum = end - segment_begin[s];
+          weight_square_sum = weight_sum;
+        }
+        if (combiner_ == Combiner::kMean && weight_sum > 0) {
+          out /= weight_sum;
+        } else if (combiner_ == Combiner::kSqrtN && weight_square_sum > 0) {
+          out /= std::sqrt(weight_square_sum);
+        }
+      }
+    };
+    // Cycles to accumulate the rows of an average segment.
+    const int64 cost_per_segment =
+        (num_ids / num_segments + 1) * (row_size + kPrefetchDistance) * 2;
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, num_segments,
+          cost_per_segment, combine_segments);
+  }
+
+ private:
+  Combiner combiner_;
+  bool has_weights_;
+};
+
+#define REGISTER_KERNELS(T, Tidx)                                \
+  REGISTER_KERNEL_BUILDER(Name("_FusedSparseEmbeddingLookup")    \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<T>("T")            \
+                              .TypeConstraint<Tidx>("Tidx"),     \
+                          FusedSparseEmbeddingLookupOp<T, Tidx>);
+
+REGISTER_KERNELS(float, int32);
+REGISTER_KERNELS(float, int64);
+
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
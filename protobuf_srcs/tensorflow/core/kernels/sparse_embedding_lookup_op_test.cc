@@ -0,0 +1,200 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedSparseEmbeddingLookupOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& combiner, int num_weights) {
+    TF_ASSERT_OK(
+        NodeDefBuilder("fused_sparse_embedding_lookup",
+                       "_FusedSparseEmbeddingLookup")
+            .Input(FakeInput(DT_FLOAT))
+            .Input(FakeInput(DT_INT64))
+            .Input(FakeInput(DT_INT32))
+            .Input(FakeInput(num_weights, DT_FLOAT))
+            .Attr("combiner", combiner)
+            .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    // 4 rows of 2 elements.
+    AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+    // Segment 1 is empty.
+    AddInputFromArray<int64>(TensorShape({5}), {0, 2, 2, 3, 1});
+    AddInputFromArray<int32>(TensorShape({5}), {0, 0, 0, 2, 3});
+  }
+};
+
+TEST_F(FusedSparseEmbeddingLookupOpTest, Sum) {
+  MakeOp("sum", 0);
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {11, 14, 0, 0, 7, 8, 3, 4});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedSparseEmbeddingLookupOpTest, Mean) {
+  MakeOp("mean", 0);
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {11.0 / 3, 14.0 / 3, 0, 0, 7, 8, 3, 4});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedSparseEmbeddingLookupOpTest, WeightedSqrtN) {
+  MakeOp("sqrtn", 1);
+  AddInputFromArray<float>(TensorShape({5}), {1, 2, 0, 3, 4});
+  TF_ASSERT_OK(RunOpKernel());
+  const float norm = std::sqrt(5.0f);
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {11 / norm, 14 / norm, 0, 0, 7, 8, 3, 4});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedSparseEmbeddingLookupOpTest, OutOfRangeId) {
+  TF_ASSERT_OK(NodeDefBuilder("fused_sparse_embedding_lookup",
+                              "_FusedSparseEmbeddingLookup")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_INT64))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(0, DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<int64>(TensorShape({2}), {0, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(FusedSparseEmbeddingLookupOpTest, UnsortedSegments) {
+  TF_ASSERT_OK(NodeDefBuilder("fused_sparse_embedding_lookup",
+                              "_FusedSparseEmbeddingLookup")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_INT64))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(0, DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<int64>(TensorShape({3}), {0, 1, 0});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 5, 2});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+// Looks up 'ids_per_segment' ids with a Zipf-like distribution for each of
+// 1024 segments in a table of 'num_rows' rows of 64 floats, either with the
+// fused kernel or with Unique + GatherV2 + SparseSegmentSum.
+static void BM_SparseEmbeddingLookup(int iters, bool fused, int num_rows,
+                                     int ids_per_segment) {
+  testing::StopTiming();
+  const int kNumSegments = 1024;
+  const int kRowSize = 64;
+  const int num_ids = kNumSegments * ids_per_segment;
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor params(DT_FLOAT, TensorShape({num_rows, kRowSize}));
+  params.flat<float>().setRandom();
+  Tensor ids(DT_INT64, TensorShape({num_ids}));
+  Tensor segment_ids(DT_INT32, TensorShape({num_ids}));
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  const double log_num_rows = std::log(static_cast<double>(num_rows));
+  for (int i = 0; i < num_ids; ++i) {
+    const int64 rank =
+        static_cast<int64>(std::exp(uniform(rng) * log_num_rows));
+    ids.flat<int64>()(i) = (rank * 7919) % num_rows;
+    segment_ids.flat<int32>()(i) = i / ids_per_segment;
+  }
+
+  Node* params_node = test::graph::Constant(g, params);
+  Node* ids_node = test::graph::Constant(g, ids);
+  Node* segment_ids_node = test::graph::Constant(g, segment_ids);
+  Node* lookup;
+  if (fused) {
+    TF_CHECK_OK(
+        NodeBuilder(g->NewName("lookup"), "_FusedSparseEmbeddingLookup")
+            .Input(params_node)
+            .Input(ids_node)
+            .Input(segment_ids_node)
+            .Input(std::vector<NodeBuilder::NodeOut>())
+            .Attr("combiner", "sum")
+            .Finalize(g, &lookup));
+  } else {
+    Node* unique;
+    TF_CHECK_OK(NodeBuilder(g->NewName("unique"), "Unique")
+                    .Input(ids_node)
+                    .Attr("out_idx", DT_INT32)
+                    .Finalize(g, &unique));
+    Node* gather;
+    TF_CHECK_OK(NodeBuilder(g->NewName("gather"), "GatherV2")
+                    .Input(params_node)
+                    .Input(unique, 0)
+                    .Input(test::graph::Constant(g, test::AsScalar<int32>(0)))
+                    .Finalize(g, &gather));
+    TF_CHECK_OK(NodeBuilder(g->NewName("lookup"), "SparseSegmentSum")
+                    .Input(gather)
+                    .Input(unique, 1)
+                    .Input(segment_ids_node)
+                    .Finalize(g, &lookup));
+  }
+
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_ids);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_SparseEmbeddingLookupUnfused(int iters, int num_rows,
+                                            int ids_per_segment) {
+  BM_SparseEmbeddingLookup(iters, false, num_rows, ids_per_segment);
+}
+
+static void BM_SparseEmbeddingLookupFused(int iters, int num_rows,
+                                          int ids_per_segment) {
+  BM_SparseEmbeddingLookup(iters, true, num_rows, ids_per_segment);
+}
+
+BENCHMARK(BM_SparseEmbeddingLookupUnfused)
+    ->ArgPair(100 * 1000, 8)
+    ->ArgPair(100 * 1000, 64)
+    ->ArgPair(1000 * 1000, 8)
+    ->ArgPair(1000 * 1000, 64);
+BENCHMARK(BM_SparseEmbeddingLookupFused)
+    ->ArgPair(100 * 1000, 8)
+    ->ArgPair(100 * 1000, 64)
+    ->ArgPair(1000 * 1000, 8)
+    ->ArgPair(1000 * 1000, 64);
+
+}  // namespace
+}  // namespace tensorflow
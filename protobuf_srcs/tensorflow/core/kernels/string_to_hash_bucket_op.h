@@ -20,12 +20,40 @@ limitations under the License.
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/string_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+// Sets each element of `output` to the bucket of the hash that `hash_fn`
+// returns for the corresponding string of `input`, hashing the strings in
+// parallel on the intra-op threads.
+template <typename HashFn>
+void HashStringsToBuckets(OpKernelContext* context,
+                          TTypes<tstring>::ConstFlat input, int64 num_buckets,
+                          HashFn hash_fn, TTypes<int64>::Flat output) {
+  const int64 cost_per_unit = StringCostPerElement(
+      input, /*cost_per_string=*/50, /*cost_per_byte=*/2);
+
+  auto hash_to_buckets = [&input, &output, &hash_fn, num_buckets](int64 start,
+                                                                  int64 end) {
+    for (int64 i = start; i < end; ++i) {
+      const uint64 input_hash = hash_fn(input(i));
+      const uint64 bucket_id = input_hash % num_buckets;
+      // The number of buckets is always in the positive range of int64 so is
+      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
+      // safe.
+      output(i) = static_cast<int64>(bucket_id);
+    }
+  };
+  auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, input.size(),
+        cost_per_unit, hash_to_buckets);
+}
+
 template <uint64 hash(StringPiece)>
 class StringToHashBucketOp : public OpKernel {
  public:
@@ -42,17 +70,10 @@ class StringToHashBucketOp : public OpKernel {
     OP_REQUIRES_OK(context,
                    context->allocate_output("output", input_tensor->shape(),
                                             &output_tensor));
-    auto output_flat = output_tensor->flat<int64>();
-
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    HashStringsToBuckets(
+        context, input_flat, num_buckets_,
+        [](const tstring& input) { return hash(input); },
+        output_tensor->flat<int64>());
   }
 
  private:
@@ -84,17 +105,10 @@ class StringToKeyedHashBucketOp : public OpKernel {
     OP_REQUIRES_OK(context,
                    context->allocate_output("output", input_tensor->shape(),
                                             &output_tensor));
-    auto output_flat = output_tensor->flat<int64>();
-
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(key_, input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    HashStringsToBuckets(
+        context, input_flat, num_buckets_,
+        [this](const tstring& input) { return hash(key_, input); },
+        output_tensor->flat<int64>());
   }
 
  private:
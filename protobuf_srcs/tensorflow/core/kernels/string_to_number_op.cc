@@ -16,6 +16,7 @@ limitations under the License.
 // See docs in ../ops/parse_ops.cc.
 
 #include <errno.h>
+#include <algorithm>
 #include <string>
 
 #include "tensorflow/core/framework/kernel_def_builder.h"
@@ -24,6 +25,8 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -48,13 +51,29 @@ class StringToNumberOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<OutputType>();
 
-    for (int i = 0; i < input_flat.size(); ++i) {
-      OP_REQUIRES(
-          context,
-          strings::SafeStringToNumeric<OutputType>(input_flat(i),
-                                                   &output_flat(i)),
-          errors::InvalidArgument(kErrorMessage, input_flat(i).c_str()));
-    }
+    // The strings are parsed in parallel. The error reports the first string
+    // that could not be converted, whichever shard finds it.
+    mutex mu;
+    int64 first_error = input_flat.size();
+    auto parse = [&input_flat, &output_flat, &mu, &first_error](int64 start,
+                                                                int64 end) {
+      for (int64 i = start; i < end; ++i) {
+        if (!strings::SafeStringToNumeric<OutputType>(input_flat(i),
+                                                      &output_flat(i))) {
+          mutex_lock l(mu);
+          first_error = std::min(first_error, i);
+          return;
+        }
+      }
+    };
+    // Parsing a number costs a few hundred cycles.
+    const int64 kCostPerUnit = 200;
+    auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          input_flat.size(), kCostPerUnit, parse);
+    OP_REQUIRES(context, first_error == input_flat.size(),
+                errors::InvalidArgument(kErrorMessage,
+                                        input_flat(first_error).c_str()));
   }
 };
 
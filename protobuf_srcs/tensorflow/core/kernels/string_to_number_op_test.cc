@@ -0,0 +1,88 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class StringToNumberOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(DataType out_type) {
+    TF_ASSERT_OK(NodeDefBuilder("string_to_number", "StringToNumber")
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("out_type", out_type)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(StringToNumberOpTest, ParsesFloats) {
+  MakeOp(DT_FLOAT);
+  AddInputFromArray<tstring>(TensorShape({2, 2}),
+                             {"0", "-1.5", "3e2", " 0.25"});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {0.0f, -1.5f, 300.0f, 0.25f});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(StringToNumberOpTest, ReportsFirstInvalidString) {
+  MakeOp(DT_INT32);
+  AddInputFromArray<tstring>(TensorShape({4}), {"1", "two", "3", "four"});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s));
+  EXPECT_TRUE(str_util::StrContains(s.error_message(), "string: two")) << s;
+}
+
+static Graph* StringToNumber(int num_strings, DataType out_type) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_STRING, TensorShape({num_strings}));
+  auto input_flat = input.flat<tstring>();
+  for (int i = 0; i < num_strings; ++i) {
+    input_flat(i) = strings::StrCat(i * 7 - num_strings, ".", i % 1000);
+  }
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "StringToNumber")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("out_type", out_type)
+                  .Finalize(g, &node));
+  return g;
+}
+
+static void BM_StringToNumber(int iters, int num_strings) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_strings);
+  testing::UseRealTime();
+  Graph* g = StringToNumber(num_strings, DT_FLOAT);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_StringToNumber)->Arg(64)->Arg(4096)->Arg(65536);
+
+}  // namespace
+}  // namespace tensorflow
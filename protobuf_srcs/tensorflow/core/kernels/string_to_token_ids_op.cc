@@ -0,0 +1,195 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/string_ops.cc.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "tensorflow/core/framework/lookup_interface.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/lookup_util.h"
+#include "tensorflow/core/kernels/string_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Lower-cases, splits and joins the n-grams of every string in a single pass,
+// then looks all the n-grams up in the vocabulary table at once. This matches
+// StringLower, StringSplitV2, StringNGrams and LookupTableFindV2 run one after
+// the other, without their intermediate string tensors.
+class StringToTokenIdsOp : public OpKernel {
+ public:
+  explicit StringToTokenIdsOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("lower", &lower_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sep", &sep_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("ngram_widths", &ngram_widths_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("ngram_separator", &ngram_separator_));
+    for (const int width : ngram_widths_) {
+      OP_REQUIRES(ctx, width > 0,
+                  errors::InvalidArgument("ngram_widths must be positive, got ",
+                                          width));
+    }
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::LookupInterface* table;
+    OP_REQUIRES_OK(ctx, lookup::GetLookupTable("table_handle", ctx, &table));
+    core::ScopedUnref unref_me(table);
+    OP_REQUIRES_OK(ctx, lookup::CheckTableDataTypes(*table, DT_STRING,
+                                                    DT_INT64, "table_handle"));
+
+    const Tensor& input_tensor = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(input_tensor.shape()),
+                errors::InvalidArgument("input must be a vector, got shape: ",
+                                        input_tensor.shape().DebugString()));
+    const Tensor& default_value = ctx->input(2);
+    const auto input = input_tensor.vec<tstring>();
+    const int64 batch_size = input.size();
+
+    Tensor* row_splits_tensor;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output("row_splits",
+                                             TensorShape({batch_size + 1}),
+                                             &row_splits_tensor));
+    auto row_splits = row_splits_tensor->vec<int64>();
+
+    const int64 cost_per_unit = StringCostPerElement(
+        input_tensor.flat<tstring>(), /*cost_per_string=*/100,
+        /*cost_per_byte=*/10);
+    auto* worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+
+    // Counts the n-grams of every string first, so that they can then be
+    // written in place in parallel.
+    row_splits(0) = 0;
+    auto count_ngrams = [this, &input, &row_splits](int64 start, int64 end) {
+      string lowered;
+      std::vector<StringPiece> tokens;
+      for (int64 i = start; i < end; ++i) {
+        Tokenize(input(i), &lowered, &tokens);
+        row_splits(i + 1) = NumNgrams(tokens.size());
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          cost_per_unit, count_ngrams);
+    for (int64 i = 0; i < batch_size; ++i) {
+      row_splits(i + 1) += row_splits(i);
+    }
+
+    const int64 num_ngrams = row_splits(batch_size);
+    Tensor ngrams_tensor;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_STRING, TensorShape({num_ngrams}),
+                                           &ngrams_tensor));
+    auto ngrams = ngrams_tensor.vec<tstring>();
+    auto write_ngrams = [this, &input, &row_splits, &ngrams](int64 start,
+                                                             int64 end) {
+      string lowered;
+      std::vector<StringPiece> tokens;
+      for (int64 i = start; i < end; ++i) {
+        Tokenize(input(i), &lowered, &tokens);
+        WriteNgrams(tokens, ngrams.data() + row_splits(i));
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          cost_per_unit, write_ngrams);
+
+    OP_REQUIRES_OK(ctx,
+                   table->CheckFindArguments(ngrams_tensor, default_value));
+    Tensor* token_ids;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            "token_ids", ngrams_tensor.shape(), &token_ids));
+    OP_REQUIRES_OK(ctx,
+                   table->Find(ctx, ngrams_tensor, token_ids, default_value));
+  }
+
+ private:
+  // Splits 'input' like StringSplitV2, after lower-casing it into 'lowered'
+  // if needed. The tokens refer to 'input' or 'lowered'.
+  void Tokenize(const tstring& input, string* lowered,
+                std::vector<StringPiece>* tokens) const {
+    StringPiece text(input);
+    if (lower_) {
+      lowered->assign(input.data(), input.size());
+      absl::AsciiStrToLower(lowered);
+      text = *lowered;
+    }
+    tokens->clear();
+    if (sep_.empty()) {
+      // Runs of whitespace separate the tokens, and there is no empty token.
+      StringPiece token;
+      str_util::RemoveLeadingWhitespace(&text);
+      while (str_util::ConsumeNonWhitespace(&text, &token)) {
+        tokens->push_back(token);
+        str_util::RemoveLeadingWhitespace(&text);
+      }
+      return;
+    }
+    auto p = std::search(text.begin(), text.end(), sep_.begin(), sep_.end());
+    while (p != text.end()) {
+      const StringPiece token = text.substr(0, p - text.begin());
+      tokens->push_back(token);
+      text.remove_prefix(token.size() + sep_.size());
+      p = std::search(text.begin(), text.end(), sep_.begin(), sep_.end());
+    }
+    tokens->push_back(text);
+  }
+
+  int64 NumNgrams(int64 num_tokens) const {
+    int64 num_ngrams = 0;
+    for (const int width : ngram_widths_) {
+      num_ngrams += std::max<int64>(0, num_tokens - width + 1);
+    }
+    return num_ngrams;
+  }
+
+  // Writes the n-grams of 'tokens' in the order of StringNGrams: all the
+  // n-grams of the first width, then of the second, and so on.
+  void WriteNgrams(const std::vector<StringPiece>& tokens,
+                   tstring* output) const {
+    const int64 num_tokens = tokens.size();
+    for (const int width : ngram_widths_) {
+      for (int64 start = 0; start + width <= num_tokens; ++start) {
+        size_t size = (width - 1) * ngram_separator_.size();
+        for (int64 n = start; n < start + width; ++n) {
+          size += tokens[n].size();
+        }
+        output->reserve(size);
+        output->append(tokens[start].data(), tokens[start].size());
+        for (int64 n = start + 1; n < start + width; ++n) {
+          output->append(ngram_separator_.data(), ngram_separator_.size());
+          output->append(tokens[n].data(), tokens[n].size());
+        }
+        ++output;
+      }
+    }
+  }
+
+  bool lower_;
+  string sep_;
+  std::vector<int> ngram_widths_;
+  string ngram_separator_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("StringToTokenIds").Device(DEVICE_CPU),
+                        StringToTokenIdsOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,268 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/kernels/lookup_table_op.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+using VocabTable = lookup::HashTable<tstring, int64>;
+
+const std::vector<tstring>& Vocab() {
+  static const auto* vocab = new std::vector<tstring>(
+      {"the", "quick", "brown", "fox", "the quick", "quick brown", "a,b", ""});
+  return *vocab;
+}
+
+VocabTable* MakeVocabTable() {
+  auto* table = new VocabTable(nullptr, nullptr);
+  Tensor keys = test::AsTensor<tstring>(Vocab());
+  Tensor values(DT_INT64, keys.shape());
+  test::FillIota<int64>(&values, 0);
+  lookup::KeyValueTensorIterator iter(&keys, &values);
+  TF_CHECK_OK(table->Initialize(iter));
+  return table;
+}
+
+class StringToTokenIdsOpTest : public OpsTestBase {
+ protected:
+  // Runs the kernel of the current node_def() on 'inputs', with the vocab
+  // table as the input at 'table_index', and returns copies of its outputs.
+  std::vector<Tensor> Run(const std::vector<Tensor>& inputs, int table_index) {
+    TF_CHECK_OK(InitOp());
+    inputs_.clear();
+    const int num_inputs = inputs.size();
+    for (int i = 0; i <= num_inputs; ++i) {
+      if (i == table_index) {
+        AddResourceInput("", strings::StrCat("vocab_", num_tables_++),
+                         MakeVocabTable());
+      }
+      if (i < num_inputs) {
+        Tensor* input = AddInput(inputs[i].dtype(), inputs[i].shape());
+        *input = inputs[i];
+      }
+    }
+    TF_CHECK_OK(RunOpKernel());
+    std::vector<Tensor> outputs;
+    for (int i = 0; i < context_->num_outputs(); ++i) {
+      outputs.push_back(*GetOutput(i));
+    }
+    return outputs;
+  }
+
+  // Runs StringToTokenIds and returns its ids and row splits.
+  std::vector<Tensor> RunFused(const Tensor& input, const string& sep,
+                               const std::vector<int>& ngram_widths) {
+    TF_CHECK_OK(NodeDefBuilder("fused", "StringToTokenIds")
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(DT_RESOURCE))
+                    .Input(FakeInput(DT_INT64))
+                    .Attr("sep", sep)
+                    .Attr("ngram_widths", ngram_widths)
+                    .Finalize(node_def()));
+    return Run({input, test::AsScalar<int64>(-1)}, 1);
+  }
+
+  // Runs StringLower, StringSplitV2, StringNGrams and LookupTableFindV2 and
+  // returns the ids and row splits.
+  std::vector<Tensor> RunUnfused(const Tensor& input, const string& sep,
+                                 const std::vector<int>& ngram_widths) {
+    TF_CHECK_OK(NodeDefBuilder("lower", "StringLower")
+                    .Input(FakeInput(DT_STRING))
+                    .Finalize(node_def()));
+    const Tensor lowered = Run({input}, -1)[0];
+
+    TF_CHECK_OK(NodeDefBuilder("split", "StringSplitV2")
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(DT_STRING))
+                    .Finalize(node_def()));
+    const std::vector<Tensor> split =
+        Run({lowered, test::AsScalar<tstring>(sep)}, -1);
+    // Converts the indices of the sparse tokens to row splits.
+    Tensor splits(DT_INT64, TensorShape({input.NumElements() + 1}));
+    auto splits_vec = splits.vec<int64>();
+    splits_vec.setZero();
+    const auto indices = split[0].matrix<int64>();
+    for (int64 i = 0; i < indices.dimension(0); ++i) {
+      ++splits_vec(indices(i, 0) + 1);
+    }
+    for (int64 i = 1; i < splits_vec.size(); ++i) {
+      splits_vec(i) += splits_vec(i - 1);
+    }
+
+    TF_CHECK_OK(NodeDefBuilder("ngrams", "StringNGrams")
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(DT_INT64))
+                    .Attr("separator", " ")
+                    .Attr("ngram_widths", ngram_widths)
+                    .Attr("left_pad", "")
+                    .Attr("right_pad", "")
+                    .Attr("pad_width", 0)
+                    .Attr("preserve_short_sequences", false)
+                    .Finalize(node_def()));
+    const std::vector<Tensor> ngrams = Run({split[1], splits}, -1);
+
+    TF_CHECK_OK(NodeDefBuilder("find", "LookupTableFindV2")
+                    .Input(FakeInput(DT_RESOURCE))
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(DT_INT64))
+                    .Finalize(node_def()));
+    const Tensor ids = Run({ngrams[0], test::AsScalar<int64>(-1)}, 0)[0];
+    return {ids, ngrams[1]};
+  }
+
+  void ExpectSameAsUnfused(const std::vector<tstring>& texts,
+                           const string& sep,
+                           const std::vector<int>& ngram_widths) {
+    const Tensor input = test::AsTensor<tstring>(texts);
+    const std::vector<Tensor> fused = RunFused(input, sep, ngram_widths);
+    const std::vector<Tensor> unfused = RunUnfused(input, sep, ngram_widths);
+    test::ExpectTensorEqual<int64>(unfused[0], fused[0]);
+    test::ExpectTensorEqual<int64>(unfused[1], fused[1]);
+  }
+
+  int num_tables_ = 0;
+};
+
+TEST_F(StringToTokenIdsOpTest, Whitespace) {
+  const std::vector<Tensor> outputs =
+      RunFused(test::AsTensor<tstring>({"The  Quick fox\t", "", " dog the"}),
+               "", {1});
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0, 1, 3, -1, 0}),
+                                 outputs[0]);
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0, 3, 3, 5}),
+                                 outputs[1]);
+}
+
+TEST_F(StringToTokenIdsOpTest, SameAsUnfusedWithWhitespace) {
+  ExpectSameAsUnfused({"The  Quick brown fox\t", "", "  ", "fox", "a,b c"},
+                      "", {1, 2});
+}
+
+TEST_F(StringToTokenIdsOpTest, SameAsUnfusedWithSeparator) {
+  ExpectSameAsUnfused({"the,quick,,brown", "", "A,B", ",fox,"}, ",", {1});
+}
+
+TEST_F(StringToTokenIdsOpTest, SameAsUnfusedWithLongNgrams) {
+  ExpectSameAsUnfused({"the quick brown fox", "the quick", "fox"}, "",
+                      {3, 1, 2});
+}
+
+// Tokenizes 'batch_size' texts of 32 words, either with StringToTokenIds or
+// with StringLower, StringSplitV2 and LookupTableFindV2. The vocab table is
+// filled by the init graph.
+void TokenIdsGraphs(int batch_size, bool fused, Graph** init, Graph** g) {
+  const int kNumWords = 32;
+  std::vector<tstring> words;
+  for (int i = 0; i < 1000; ++i) {
+    words.push_back(strings::StrCat("word", i));
+  }
+  *init = new Graph(OpRegistry::Global());
+  auto table_node = [](Graph* graph) {
+    Node* table;
+    TF_CHECK_OK(NodeBuilder(graph->NewName("table"), "HashTableV2")
+                    .Attr("shared_name", "vocab")
+                    .Attr("key_dtype", DT_STRING)
+                    .Attr("value_dtype", DT_INT64)
+                    .Finalize(graph, &table));
+    return table;
+  };
+  Tensor values(DT_INT64, TensorShape({static_cast<int64>(words.size())}));
+  test::FillIota<int64>(&values, 0);
+  Node* initialize;
+  TF_CHECK_OK(
+      NodeBuilder((*init)->NewName("initialize"), "InitializeTableV2")
+          .Input(table_node(*init))
+          .Input(test::graph::Constant(*init, test::AsTensor<tstring>(words)))
+          .Input(test::graph::Constant(*init, values))
+          .Finalize(*init, &initialize));
+
+  *g = new Graph(OpRegistry::Global());
+  Tensor input(DT_STRING, TensorShape({batch_size}));
+  auto input_vec = input.vec<tstring>();
+  for (int i = 0; i < batch_size; ++i) {
+    string text;
+    for (int w = 0; w < kNumWords; ++w) {
+      // Some of the words are not in the vocab.
+      strings::StrAppend(&text, w > 0 ? " " : "", "Word",
+                         (i * 31 + w * 17) % 1200);
+    }
+    input_vec(i) = text;
+  }
+  Node* texts = test::graph::Constant(*g, input);
+  Node* default_value = test::graph::Constant(*g, test::AsScalar<int64>(-1));
+  Node* ids;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder((*g)->NewName("ids"), "StringToTokenIds")
+                    .Input(texts)
+                    .Input(table_node(*g))
+                    .Input(default_value)
+                    .Finalize(*g, &ids));
+    return;
+  }
+  Node* lower;
+  TF_CHECK_OK(NodeBuilder((*g)->NewName("lower"), "StringLower")
+                  .Input(texts)
+                  .Finalize(*g, &lower));
+  Node* split;
+  TF_CHECK_OK(
+      NodeBuilder((*g)->NewName("split"), "StringSplitV2")
+          .Input(lower)
+          .Input(test::graph::Constant(*g, test::AsScalar<tstring>("")))
+          .Finalize(*g, &split));
+  TF_CHECK_OK(NodeBuilder((*g)->NewName("ids"), "LookupTableFindV2")
+                  .Input(table_node(*g))
+                  .Input(split, 1)
+                  .Input(default_value)
+                  .Finalize(*g, &ids));
+}
+
+static void BM_StringToTokenIds(int iters, int batch_size, bool fused) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size);
+  testing::UseRealTime();
+  Graph* init;
+  Graph* g;
+  TokenIdsGraphs(batch_size, fused, &init, &g);
+  testing::StartTiming();
+  test::Benchmark("cpu", g, nullptr, init).Run(iters);
+}
+
+static void BM_StringToTokenIdsFused(int iters, int batch_size) {
+  BM_StringToTokenIds(iters, batch_size, true);
+}
+static void BM_StringToTokenIdsUnfused(int iters, int batch_size) {
+  BM_StringToTokenIds(iters, batch_size, false);
+}
+
+BENCHMARK(BM_StringToTokenIdsFused)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BM_StringToTokenIdsUnfused)->Arg(16)->Arg(256)->Arg(4096);
+
+}  // namespace
+}  // namespace tensorflow
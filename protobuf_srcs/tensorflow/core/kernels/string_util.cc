@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/string_util.h"
 
+#include <algorithm>
+
 #include "tensorflow/core/lib/core/errors.h"
 
 namespace tensorflow {
@@ -61,4 +63,17 @@ int32 UTF8StrLen(const string& str) {
   return result;
 }
 
+int64 StringCostPerElement(TTypes<tstring>::ConstFlat strings,
+                           int64 cost_per_string, int64 cost_per_byte) {
+  const int64 kMaxSampledStrings = 256;
+  const int64 num_sampled =
+      std::min<int64>(strings.size(), kMaxSampledStrings);
+  if (num_sampled == 0) return cost_per_string;
+  int64 num_bytes = 0;
+  for (int64 i = 0; i < num_sampled; ++i) {
+    num_bytes += strings(i).size();
+  }
+  return cost_per_string + cost_per_byte * num_bytes / num_sampled;
+}
+
 }  // namespace tensorflow
@@ -15,7 +15,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_STRING_UTIL_H_
 #define TENSORFLOW_CORE_KERNELS_STRING_UTIL_H_
 
+#include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
 
@@ -82,6 +84,12 @@ bool BackNUTF8CharPositions(const StringPiece in,
   return utf8_chars_counted == num_utf8_chars_to_shift;
 }
 
+// Returns the estimated cost of processing one of `strings`, for sharding them
+// across threads: `cost_per_string` plus `cost_per_byte` times their mean
+// length, which is estimated from the first strings.
+int64 StringCostPerElement(TTypes<tstring>::ConstFlat strings,
+                           int64 cost_per_string, int64 cost_per_byte);
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_KERNELS_STRING_UTIL_H_
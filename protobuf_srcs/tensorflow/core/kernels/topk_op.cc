@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/topk_op.h"
 
 #include <algorithm>
+#include <memory>
 #include <numeric>
 #include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
@@ -97,6 +98,70 @@ class TopK : public OpKernel {
   bool sorted_;
 };
 
+namespace {
+
+// Rows with at least this many columns are split into blocks that are
+// selected in parallel when there are fewer rows than threads.
+constexpr int64 kMinParallelTopKCols = 1 << 16;
+
+// Minimum number of columns in a block of a row selected in parallel.
+constexpr int64 kMinTopKBlockSize = 1 << 14;
+
+// Number of elements compared with the threshold of the TopN at once.
+constexpr int kTopKChunkSize = 16;
+
+// Orders the positions of a row by decreasing value, breaking ties by
+// increasing position.
+template <typename T>
+struct StableTopKComparator {
+  explicit StableTopKComparator(const T* data) : data(data) {}
+
+  bool operator()(const int32 a, const int32 b) const {
+    if (data[b] < data[a]) {
+      return true;
+    } else if (data[b] > data[a]) {
+      return false;
+    } else {
+      return a < b;
+    }
+  }
+
+  const T* data;
+};
+
+// Pushes the positions [begin, end) of 'data' into 'filter', which orders
+// positions with StableTopKComparator. Once the filter is full, a position
+// can only enter it if its value is larger than the value at the bottom of
+// the filter, since positions are pushed in increasing order. Most values
+// are below this threshold for k << end - begin, so they are compared with
+// it in branch-free chunks that the compiler vectorizes.
+template <typename T, typename Filter>
+void PushTopK(const T* data, int32 begin, int32 end, Filter* filter) {
+  int32 c = begin;
+  for (; c < end && filter->size() < filter->limit(); ++c) {
+    filter->push(c);
+  }
+  if (c == end) return;
+  T threshold = data[filter->peek_bottom()];
+  const auto push = [data, filter, &threshold](const int32 i) {
+    if (data[i] > threshold) {
+      filter->push(i);
+      threshold = data[filter->peek_bottom()];
+    }
+  };
+  for (; c + kTopKChunkSize <= end; c += kTopKChunkSize) {
+    int any_above = 0;
+    for (int j = 0; j < kTopKChunkSize; ++j) {
+      any_above |= static_cast<int>(data[c + j] > threshold);
+    }
+    if (!any_above) continue;
+    for (int j = 0; j < kTopKChunkSize; ++j) push(c + j);
+  }
+  for (; c < end; ++c) push(c);
+}
+
+}  // namespace
+
 namespace functor {
 
 template <typename T>
@@ -136,18 +201,23 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    if (k < num_cols && num_cols >= kMinParallelTopKCols &&
+        num_rows < worker_threads.num_threads) {
+      const int64 num_blocks = std::min<int64>(
+          (2 * worker_threads.num_threads + num_rows - 1) / num_rows,
+          num_cols / std::max<int64>(kMinTopKBlockSize, 4 * k));
+      if (num_blocks > 1) {
+        ParallelTopK(worker_threads, k, input, num_rows, num_cols, num_blocks,
+                     values, indices);
+        return Status::OK();
+      }
+    }
+
     auto SortIndices = [&](int start_batch, int limit_batch) {
       for (int32 b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
-        const auto stable_comp = [input_data](const int32 a, const int32 b) {
-          if (input_data[b] < input_data[a]) {
-            return true;
-          } else if (input_data[b] > input_data[a]) {
-            return false;
-          } else {
-            return a < b;
-          }
-        };
+        const StableTopKComparator<T> stable_comp(input_data);
         const auto comp = [input_data](const int32 a, const int32 b) {
           return input_data[b] < input_data[a];
         };
@@ -180,11 +250,9 @@ struct TopKFunctor<CPUDevice, T> {
           }
         } else {
           // Use the TopN heap object to sort.
-          gtl::TopN<int32, decltype(stable_comp)> filter(k, stable_comp);
+          gtl::TopN<int32, StableTopKComparator<T>> filter(k, stable_comp);
           filter.reserve(num_cols);
-          for (int32 c = 0; c < num_cols; ++c) {
-            filter.push(c);
-          }
+          PushTopK(input_data, 0, num_cols, &filter);
 
           int32 i = 0;
           if (sorted) {
@@ -221,12 +289,60 @@ struct TopKFunctor<CPUDevice, T> {
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
     return Status::OK();
   }
+
+ private:
+  // Selects the top k of rows that are too wide to be processed by a single
+  // thread: every row is split into 'num_blocks' blocks whose top k are
+  // selected in parallel, and the top k of every row is then selected from
+  // the candidates of its blocks. The results are always sorted.
+  static void ParallelTopK(
+      const DeviceBase::CpuWorkerThreads& worker_threads, int k,
+      const typename TTypes<T, 2>::ConstTensor& input, const int64 num_rows,
+      const int64 num_cols, const int64 num_blocks,
+      typename TTypes<T, 2>::Tensor values,
+      typename TTypes<int, 2>::Tensor indices) {
+    typedef gtl::TopN<int32, StableTopKComparator<T>> Filter;
+    const int64 block_size = (num_cols + num_blocks - 1) / num_blocks;
+    std::vector<std::unique_ptr<std::vector<int32>>> candidates(num_rows *
+                                                                num_blocks);
+    auto SelectBlocks = [&](int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const int64 b = i / num_blocks;
+        const int64 begin = (i % num_blocks) * block_size;
+        const int64 end = std::min(begin + block_size, num_cols);
+        const T* input_data = &input(b, 0);
+        Filter filter(k, StableTopKComparator<T>(input_data));
+        PushTopK(input_data, begin, end, &filter);
+        candidates[i].reset(filter.ExtractUnsorted());
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          num_rows * num_blocks, 10 * block_size, SelectBlocks);
+
+    auto MergeBlocks = [&](int64 start, int64 limit) {
+      for (int64 b = start; b < limit; ++b) {
+        const T* input_data = &input(b, 0);
+        Filter filter(k, StableTopKComparator<T>(input_data));
+        for (int64 i = b * num_blocks; i < (b + 1) * num_blocks; ++i) {
+          for (const int32 c : *candidates[i]) filter.push(c);
+        }
+        std::unique_ptr<std::vector<int32>> top_k(filter.Extract());
+        for (int i = 0; i < k; ++i) {
+          indices(b, i) = (*top_k)[i];
+          values(b, i) = input_data[(*top_k)[i]];
+        }
+      }
+    };
+    const int64 merge_cost = static_cast<int64>(
+        20 * num_blocks * k * Eigen::numext::log2(static_cast<float>(k + 1)));
+    Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+          merge_cost, MergeBlocks);
+  }
 };
 
 }  // namespace functor
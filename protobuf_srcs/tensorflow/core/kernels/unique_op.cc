@@ -13,10 +13,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include "tensorflow/core/kernels/unique_op.h"
+
 #include <functional>
-#include <unordered_map>
+#include <type_traits>
 #include <utility>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -24,15 +28,26 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+// Inputs with at least this many elements are deduplicated by multiple
+// threads.
+constexpr int64 kMinParallelUniqueSize = 64 * 1024;
+
 template <typename T, typename TIndex>
 class UniqueOp : public OpKernel {
  public:
-  explicit UniqueOp(OpKernelConstruction* context) : OpKernel(context) {}
+  explicit UniqueOp(OpKernelConstruction* context) : OpKernel(context) {
+    // Sorting instead of hashing integer elements can be faster for inputs
+    // with many distinct elements, where the hash maps do not fit in cache.
+    OP_REQUIRES_OK(context,
+                   ReadBoolFromEnvVar("TF_UNIQUE_SORT_INTEGER_KEYS", false,
+                                      &sort_integer_keys_));
+  }
 
   void Compute(OpKernelContext* context) override {
     const Tensor& input = context->input(0);
@@ -106,17 +121,21 @@ class UniqueOp : public OpKernel {
       auto Tin = input.flat<T>();
       const int64 N = static_cast<int64>(Tin.size());
 
-      std::unordered_map<T, TIndex> uniq;
-      uniq.reserve(2 * N);
-      for (Eigen::Index i = 0, j = 0; i < N; ++i) {
-        auto it = uniq.insert(std::make_pair(Tin(i), j));
-        idx_vec(i) = it.first->second;
-        if (it.second) {
-          ++j;
-        }
+      std::vector<int64> first;
+      const DeviceBase::CpuWorkerThreads& worker_threads =
+          *context->device()->tensorflow_cpu_worker_threads();
+      if (std::is_integral<T>::value && sort_integer_keys_) {
+        unique_op::UniqueWithSort(Tin.data(), N, idx_vec.data(), &first);
+      } else if (N >= kMinParallelUniqueSize &&
+                 worker_threads.num_threads > 1) {
+        unique_op::UniqueWithPartitions(
+            Tin.data(), N, worker_threads.num_threads, worker_threads.workers,
+            idx_vec.data(), &first);
+      } else {
+        unique_op::UniqueWithHashMap(Tin.data(), N, idx_vec.data(), &first);
       }
 
-      uniq_size = static_cast<int64>(uniq.size());
+      uniq_size = static_cast<int64>(first.size());
       TensorShape output_shape(input.shape());
       output_shape.set_dim(axis, uniq_size);
       Tensor* output = nullptr;
@@ -124,8 +143,8 @@ class UniqueOp : public OpKernel {
                      context->allocate_output(0, output_shape, &output));
       auto Tout = output->flat<T>();
 
-      for (auto it : uniq) {
-        Tout(it.second) = it.first;
+      for (int64 j = 0; j < uniq_size; ++j) {
+        Tout(j) = Tin(first[j]);
       }
     } else {
       // General implementation when unique is run over multiple elements.
@@ -138,7 +157,8 @@ class UniqueOp : public OpKernel {
             h = Hash64Combine(h, hash<T>{}(Tin(i, key, j)));
           }
         }
-        return h;
+        // Mixes the low bits, which are used to find the slot.
+        return absl::Hash<size_t>()(h);
       };
 
       auto equal_to_fn = [&Tin](const Eigen::Index& lhs,
@@ -153,7 +173,8 @@ class UniqueOp : public OpKernel {
         return true;
       };
 
-      std::unordered_map<int64, int64, decltype(hash_fn), decltype(equal_to_fn)>
+      absl::flat_hash_map<int64, int64, decltype(hash_fn),
+                          decltype(equal_to_fn)>
           uniq(0, hash_fn, equal_to_fn);
 
       uniq.reserve(2 * Tin.dimension(1));
@@ -192,6 +213,9 @@ class UniqueOp : public OpKernel {
       }
     }
   }
+
+ private:
+  bool sort_integer_keys_;
 };
 
 #define REGISTER_UNIQUE(type)                                    \
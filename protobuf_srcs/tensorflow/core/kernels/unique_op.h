@@ -0,0 +1,247 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_UNIQUE_OP_H_
+#define TENSORFLOW_CORE_KERNELS_UNIQUE_OP_H_
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+// Implementations of the 1-D case of the Unique ops. Each of them sets idx[i]
+// to the id of in[i], where ids are assigned in order of first occurrence,
+// and stores the position of the first occurrence of each id in 'first'. All
+// of them produce the same result.
+
+namespace tensorflow {
+namespace unique_op {
+
+// The hash map key of an element of type T. Strings are referenced rather
+// than copied.
+template <typename T>
+struct MapKey {
+  typedef T Type;
+  static const T& Make(const T& t) { return t; }
+
+  // std::hash is the identity for integers, so its result is mixed before
+  // it is used by the open-addressing map, which takes the slot from the low
+  // bits and the partition below from the high bits. Using std::hash keeps
+  // the existing behavior for floating point keys, where 0.0 == -0.0.
+  struct Hash {
+    size_t operator()(const T& t) const {
+      return absl::Hash<size_t>()(std::hash<T>()(t));
+    }
+  };
+};
+
+template <>
+struct MapKey<tstring> {
+  typedef absl::string_view Type;
+  static absl::string_view Make(const tstring& t) {
+    return absl::string_view(t.data(), t.size());
+  }
+  typedef absl::Hash<absl::string_view> Hash;
+};
+
+template <typename T, typename TIndex>
+using Map = absl::flat_hash_map<typename MapKey<T>::Type, TIndex,
+                                typename MapKey<T>::Hash>;
+
+// Single-threaded implementation using an open-addressing hash map.
+template <typename T, typename TIndex>
+void UniqueWithHashMap(const T* in, int64 n, TIndex* idx,
+                       std::vector<int64>* first) {
+  Map<T, TIndex> uniq;
+  uniq.reserve(n);
+  first->clear();
+  for (int64 i = 0; i < n; ++i) {
+    auto it = uniq.insert(std::make_pair(MapKey<T>::Make(in[i]),
+                                         static_cast<TIndex>(first->size())));
+    idx[i] = it.first->second;
+    if (it.second) first->push_back(i);
+  }
+}
+
+// Multithreaded implementation for large inputs. The positions of the input
+// are partitioned by the high bits of the hash of their element, keeping
+// them in ascending order within each partition, and each partition is
+// deduplicated by a separate hash map. Finally the ids local to each
+// partition are renumbered in order of first occurrence.
+template <typename T, typename TIndex>
+void UniqueWithPartitions(const T* in, int64 n, int num_threads,
+                          thread::ThreadPool* workers, TIndex* idx,
+                          std::vector<int64>* first) {
+  typedef typename MapKey<T>::Hash Hash;
+  int partition_bits = 0;
+  while ((1 << partition_bits) < 4 * num_threads && partition_bits < 8) {
+    ++partition_bits;
+  }
+  const int num_partitions = 1 << partition_bits;
+  const int shift = 64 - partition_bits;
+  const int64 num_blocks = std::min<int64>(4 * num_threads, n);
+  auto block_begin = [n, num_blocks](int64 b) { return b * n / num_blocks; };
+  // Cycles per element of a pass over the input, as an estimate for Shard().
+  const int64 block_cost = 50 * (n / num_blocks + 1);
+
+  // Partition of every element, and number of elements per block and
+  // partition.
+  std::vector<uint8> partition(n);
+  std::vector<int64> offsets(num_blocks * num_partitions, 0);
+  Shard(num_threads, workers, num_blocks, block_cost,
+        [&](int64 start, int64 limit) {
+          for (int64 b = start; b < limit; ++b) {
+            int64* counts = &offsets[b * num_partitions];
+            for (int64 i = block_begin(b); i < block_begin(b + 1); ++i) {
+              const uint64 h = Hash()(MapKey<T>::Make(in[i]));
+              partition[i] = static_cast<uint8>(h >> shift);
+              ++counts[partition[i]];
+            }
+          }
+        });
+
+  // Turns the counts into the offset of every block in every partition.
+  std::vector<int64> partition_begin(num_partitions + 1);
+  int64 offset = 0;
+  for (int p = 0; p < num_partitions; ++p) {
+    partition_begin[p] = offset;
+    for (int64 b = 0; b < num_blocks; ++b) {
+      const int64 count = offsets[b * num_partitions + p];
+      offsets[b * num_partitions + p] = offset;
+      offset += count;
+    }
+  }
+  partition_begin[num_partitions] = offset;
+
+  std::vector<int64> positions(n);
+  Shard(num_threads, workers, num_blocks, block_cost,
+        [&](int64 start, int64 limit) {
+          for (int64 b = start; b < limit; ++b) {
+            int64* next = &offsets[b * num_partitions];
+            for (int64 i = block_begin(b); i < block_begin(b + 1); ++i) {
+              positions[next[partition[i]]++] = i;
+            }
+          }
+        });
+
+  // Deduplicates every partition, storing the local ids in 'idx' and marking
+  // first occurrences.
+  std::vector<uint8> is_first(n, 0);
+  std::vector<std::vector<TIndex>> global_ids(num_partitions);
+  const int64 partition_cost = 100 * (n / num_partitions + 1);
+  Shard(num_threads, workers, num_partitions, partition_cost,
+        [&](int64 start, int64 limit) {
+          for (int64 p = start; p < limit; ++p) {
+            Map<T, TIndex> uniq;
+            uniq.reserve(partition_begin[p + 1] - partition_begin[p]);
+            for (int64 j = partition_begin[p]; j < partition_begin[p + 1];
+                 ++j) {
+              const int64 i = positions[j];
+              auto it = uniq.insert(std::make_pair(
+                  MapKey<T>::Make(in[i]), static_cast<TIndex>(uniq.size())));
+              idx[i] = it.first->second;
+              if (it.second) is_first[i] = 1;
+            }
+            global_ids[p].resize(uniq.size());
+          }
+        });
+
+  // Numbers the first occurrences in order, which requires the number of
+  // first occurrences in the preceding blocks.
+  std::vector<int64> first_begin(num_blocks + 1, 0);
+  Shard(num_threads, workers, num_blocks, block_cost,
+        [&](int64 start, int64 limit) {
+          for (int64 b = start; b < limit; ++b) {
+            int64 count = 0;
+            for (int64 i = block_begin(b); i < block_begin(b + 1); ++i) {
+              count += is_first[i];
+            }
+            first_begin[b + 1] = count;
+          }
+        });
+  for (int64 b = 0; b < num_blocks; ++b) {
+    first_begin[b + 1] += first_begin[b];
+  }
+  first->resize(first_begin[num_blocks]);
+  Shard(num_threads, workers, num_blocks, block_cost,
+        [&](int64 start, int64 limit) {
+          for (int64 b = start; b < limit; ++b) {
+            int64 id = first_begin[b];
+            for (int64 i = block_begin(b); i < block_begin(b + 1); ++i) {
+              if (is_first[i]) {
+                global_ids[partition[i]][idx[i]] = static_cast<TIndex>(id);
+                (*first)[id] = i;
+                ++id;
+              }
+            }
+          }
+        });
+  Shard(num_threads, workers, num_blocks, block_cost,
+        [&](int64 start, int64 limit) {
+          for (int64 b = start; b < limit; ++b) {
+            for (int64 i = block_begin(b); i < block_begin(b + 1); ++i) {
+              idx[i] = global_ids[partition[i]][idx[i]];
+            }
+          }
+        });
+}
+
+// Implementation that sorts the elements along with their positions and
+// assigns ids to the runs of equal elements. It accesses memory
+// sequentially, unlike the hash maps, which is faster for some inputs with
+// many distinct integer elements. Must not be used with floating point
+// elements, since NaN breaks the ordering.
+template <typename T, typename TIndex>
+void UniqueWithSort(const T* in, int64 n, TIndex* idx,
+                    std::vector<int64>* first) {
+  std::vector<std::pair<T, int64>> sorted(n);
+  for (int64 i = 0; i < n; ++i) sorted[i] = std::make_pair(in[i], i);
+  std::sort(sorted.begin(), sorted.end());
+
+  // Numbers the runs in sorted order, in 'idx', and marks the first
+  // position of every run, which is the first element of the run.
+  std::vector<uint8> is_first(n, 0);
+  TIndex num_runs = 0;
+  for (int64 j = 0; j < n; ++j) {
+    if (j == 0 || sorted[j].first != sorted[j - 1].first) {
+      is_first[sorted[j].second] = 1;
+      ++num_runs;
+    }
+    idx[sorted[j].second] = num_runs - 1;
+  }
+
+  // Renumbers the runs in order of first occurrence.
+  std::vector<TIndex> ids(num_runs);
+  first->clear();
+  for (int64 i = 0; i < n; ++i) {
+    if (is_first[i]) {
+      ids[idx[i]] = static_cast<TIndex>(first->size());
+      first->push_back(i);
+    }
+  }
+  for (int64 i = 0; i < n; ++i) idx[i] = ids[idx[i]];
+}
+
+}  // namespace unique_op
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_UNIQUE_OP_H_
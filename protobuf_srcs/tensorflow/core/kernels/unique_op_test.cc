@@ -13,8 +13,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cmath>
 #include <functional>
 #include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -25,7 +29,10 @@ limitations under the License.
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/kernels/unique_op.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -35,6 +42,78 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+// Ids with a Zipf-like distribution over 'vocab_size' ids, as seen by
+// embedding lookups: the id of rank r has a probability of roughly 1/r. The
+// ids are spread over a large range.
+std::vector<int64> ZipfIds(int64 n, int64 vocab_size) {
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  const double log_vocab_size = std::log(static_cast<double>(vocab_size));
+  std::vector<int64> ids(n);
+  for (int64 i = 0; i < n; ++i) {
+    const int64 rank =
+        static_cast<int64>(std::exp(uniform(rng) * log_vocab_size));
+    ids[i] = (rank * 1000003) % (int64{1} << 40);
+  }
+  return ids;
+}
+
+// Checks that 'idx' and 'first' are the result of Unique on 'in'.
+template <typename T, typename TIndex>
+void ExpectUnique(const std::vector<T>& in, const std::vector<TIndex>& idx,
+                  const std::vector<int64>& first) {
+  std::unordered_map<T, TIndex> expected_ids;
+  std::vector<int64> expected_first;
+  for (int64 i = 0; i < static_cast<int64>(in.size()); ++i) {
+    auto it = expected_ids.emplace(in[i], expected_first.size());
+    if (it.second) expected_first.push_back(i);
+    ASSERT_EQ(it.first->second, idx[i]) << "at " << i;
+  }
+  EXPECT_EQ(expected_first, first);
+}
+
+template <typename T>
+void ExpectImplementationsAgree(const std::vector<T>& in, bool sort) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  std::vector<int32> idx(in.size());
+  std::vector<int64> first;
+  unique_op::UniqueWithHashMap(in.data(), in.size(), idx.data(), &first);
+  ExpectUnique(in, idx, first);
+  unique_op::UniqueWithPartitions(in.data(), in.size(), 4, &pool, idx.data(),
+                                  &first);
+  ExpectUnique(in, idx, first);
+  if (sort) {
+    unique_op::UniqueWithSort(in.data(), in.size(), idx.data(), &first);
+    ExpectUnique(in, idx, first);
+  }
+}
+
+TEST(UniqueImplTest, Int64) {
+  ExpectImplementationsAgree<int64>({5, -1, 5, 7, -1, 0}, true);
+  ExpectImplementationsAgree(ZipfIds(100000, 1000000), true);
+  std::vector<int64> all_distinct(70000);
+  for (int64 i = 0; i < 70000; ++i) all_distinct[i] = -i;
+  ExpectImplementationsAgree(all_distinct, true);
+}
+
+TEST(UniqueImplTest, String) {
+  std::vector<tstring> in;
+  for (int64 id : ZipfIds(50000, 10000)) {
+    in.push_back(strings::StrCat("token_", id));
+  }
+  ExpectImplementationsAgree(in, false);
+}
+
+TEST(UniqueImplTest, Float) {
+  // 0.0 and -0.0 are equal, and are deduplicated.
+  std::vector<float> in = {1.5, 0.0, -0.0, 1.5, 2.0};
+  ExpectImplementationsAgree(in, false);
+  std::vector<int32> idx(in.size());
+  std::vector<int64> first;
+  unique_op::UniqueWithHashMap(in.data(), in.size(), idx.data(), &first);
+  EXPECT_EQ(std::vector<int32>({0, 1, 1, 0, 2}), idx);
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -138,6 +217,71 @@ static void BM_Unique_STRING(int iters, int dim) {
   test::Benchmark("cpu", g).Run(iters);
 }
 
+// Unique on 'dim' ids with a Zipf-like distribution over 'vocab_size' ids.
+static void BM_Unique_INT64_Zipf(int iters, int dim, int vocab_size) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const std::vector<int64> ids = ZipfIds(dim, vocab_size);
+  Tensor input(DT_INT64, TensorShape({dim}));
+  std::copy(ids.begin(), ids.end(), input.flat<int64>().data());
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+
+  testing::ItemsProcessed(static_cast<int64>(iters) * dim);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_Unique_INT64_Zipf)
+    ->ArgPair(16 * 1024, 1000 * 1000)
+    ->ArgPair(1024 * 1024, 100 * 1000)
+    ->ArgPair(1024 * 1024, 10 * 1000 * 1000)
+    ->ArgPair(1024 * 1024, 1000 * 1000 * 1000);
+
+// Compares the implementations on 1M ids with a Zipf-like distribution over
+// 'vocab_size' ids. 'impl' is 0 for the hash map, 1 for the partitioned hash
+// maps with 8 threads and 2 for sorting.
+static void BM_UniqueImpl(int iters, int impl, int vocab_size) {
+  testing::StopTiming();
+  const int64 kNumIds = 1024 * 1024;
+  const std::vector<int64> ids = ZipfIds(kNumIds, vocab_size);
+  thread::ThreadPool pool(Env::Default(), "test", 8);
+  std::vector<int32> idx(kNumIds);
+  std::vector<int64> first;
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumIds);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (impl == 0) {
+      unique_op::UniqueWithHashMap(ids.data(), kNumIds, idx.data(), &first);
+    } else if (impl == 1) {
+      unique_op::UniqueWithPartitions(ids.data(), kNumIds, 8, &pool,
+                                      idx.data(), &first);
+    } else {
+      unique_op::UniqueWithSort(ids.data(), kNumIds, idx.data(), &first);
+    }
+  }
+  testing::StopTiming();
+  testing::SetLabel(strings::StrCat("unique: ", first.size()));
+}
+
+BENCHMARK(BM_UniqueImpl)
+    ->ArgPair(0, 100 * 1000)
+    ->ArgPair(1, 100 * 1000)
+    ->ArgPair(2, 100 * 1000)
+    ->ArgPair(0, 10 * 1000 * 1000)
+    ->ArgPair(1, 10 * 1000 * 1000)
+    ->ArgPair(2, 10 * 1000 * 1000)
+    ->ArgPair(0, 1000 * 1000 * 1000)
+    ->ArgPair(1, 1000 * 1000 * 1000)
+    ->ArgPair(2, 1000 * 1000 * 1000);
+
 BENCHMARK(BM_Unique_INT32)
     ->ArgPair(32, 1024 * 1024)
     ->ArgPair(256, 1024 * 1024)
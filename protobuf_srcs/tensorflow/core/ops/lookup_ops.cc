@@ -353,6 +353,42 @@ REGISTER_OP("HashTableV2")
     .SetIsStateful()
     .SetShapeFn(ScalarOutput);
 
+REGISTER_OP("ImmutableHashTable")
+    .Output("table_handle: resource")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("use_node_name_sharing: bool = false")
+    .Attr("key_dtype: type")
+    .Attr("value_dtype: type")
+    .SetIsStateful()
+    .SetShapeFn(ScalarOutput);
+
+REGISTER_OP("WriteImmutableHashTable")
+    .Input("filename: string")
+    .Input("keys: Tin")
+    .Input("values: Tout")
+    .Attr("Tin: type")
+    .Attr("Tout: type")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      TF_RETURN_IF_ERROR(c->Merge(c->input(1), c->input(2), &unused));
+      return Status::OK();
+    });
+
+REGISTER_OP("InitializeImmutableHashTableFromFile")
+    .Input("table_handle: resource")
+    .Input("filename: string")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &handle));
+      return Status::OK();
+    });
+
 REGISTER_OP("MutableHashTable")
     .Output("table_handle: Ref(string)")
     .Attr("container: string = ''")
@@ -505,4 +541,65 @@ REGISTER_OP("InitializeTableFromTextFileV2")
       return Status::OK();
     });
 
+REGISTER_OP("IvfIndex")
+    .Output("index_handle: resource")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .SetIsStateful()
+    .SetShapeFn(ScalarOutput);
+
+REGISTER_OP("InitializeIvfIndexFromFile")
+    .Input("index_handle: resource")
+    .Input("filename: string")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &handle));
+      return Status::OK();
+    });
+
+REGISTER_OP("IvfIndexSearch")
+    .Input("index_handle: resource")
+    .Input("queries: float")
+    .Input("k: int32")
+    .Output("scores: float")
+    .Output("ids: int64")
+    .Attr("num_probes: int >= 1 = 8")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      ShapeHandle queries;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &queries));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      DimensionHandle k;
+      TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(2, &k));
+      ShapeHandle output = c->Matrix(c->Dim(queries, 0), k);
+      c->set_output(0, output);
+      c->set_output(1, output);
+      return Status::OK();
+    });
+
+REGISTER_OP("WriteIvfIndex")
+    .Input("filename: string")
+    .Input("embeddings: float")
+    .Input("ids: int64")
+    .Attr("num_lists: int >= 1")
+    .Attr("metric: {'dot_product', 'squared_l2'} = 'dot_product'")
+    .Attr("num_iterations: int >= 0 = 10")
+    .Attr("seed: int = 0")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      ShapeHandle embeddings;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &embeddings));
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &ids));
+      DimensionHandle num_ids;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(embeddings, 0), c->Dim(ids, 0), &num_ids));
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
@@ -1373,6 +1373,41 @@ REGISTER_OP("SparseSegmentSqrtNGrad")
     .Attr("Tidx: {int32, int64} = DT_INT32")
     .SetShapeFn(SparseSegmentReductionGradShapeFn);
 
+REGISTER_OP("_FusedSparseEmbeddingLookup")
+    .Input("params: T")
+    .Input("ids: Tidx")
+    .Input("segment_ids: int32")
+    .Input("weights: num_weights * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("num_weights: int >= 0 = 0")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .SetShapeFn([](InferenceContext* c) {
+      TF_RETURN_IF_ERROR(SparseSegmentReductionShapeFn(c));
+      int num_weights;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_weights", &num_weights));
+      if (num_weights > 1) {
+        return errors::InvalidArgument("num_weights must be 0 or 1, got ",
+                                       num_weights);
+      }
+      if (num_weights == 1) {
+        ShapeHandle unused;
+        TF_RETURN_IF_ERROR(c->Merge(c->input(1), c->input(3), &unused));
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Gathers the rows of `params` given by `ids` and combines the rows of every
+segment, like SparseSegmentSum, SparseSegmentMean or SparseSegmentSqrtN with
+`params` as data and `ids` as indices. If `weights` is given, each row is
+scaled by its weight, and the mean and sqrtn combiners divide by the sum and
+the square root of the sum of squares of the weights of the segment.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: Tidx")
@@ -1685,6 +1720,30 @@ REGISTER_OP("QuantizedMatMul")
       return Status::OK();
     });
 
+REGISTER_OP("DynamicQuantizedMatMul")
+    .Input("a: float")
+    .Input("b: quint8")
+    .Input("min_b: float")
+    .Input("max_b: float")
+    .Output("product: float")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle a;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &a));
+      ShapeHandle b;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &b));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(a, 1), c->Dim(b, 0), &unused));
+      ShapeHandle range;
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(2), 1, &range));
+      TF_RETURN_IF_ERROR(c->Merge(range, c->input(3), &range));
+      if (c->RankKnown(range) && c->Rank(range) == 1) {
+        TF_RETURN_IF_ERROR(
+            c->Merge(c->Dim(range, 0), c->Dim(b, 1), &unused));
+      }
+      c->set_output(0, c->Matrix(c->Dim(a, 0), c->Dim(b, 1)));
+      return Status::OK();
+    });
+
 // Note: This op is not commutative w.r.t. to all its inputs.
 REGISTER_OP("QuantizedMul")
     .Input("x: T1")
@@ -1165,6 +1165,62 @@ REGISTER_OP("LogSoftmax")
 
 // --------------------------------------------------------------------------
 
+// Computes softmax(scale * query * key^T + bias) * value over the last two
+// dimensions, broadcasting the batch dimensions like BatchMatMulV2.
+REGISTER_OP("_FusedMultiHeadAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("bias: num_bias * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_bias: int >= 0 = 0")
+    .Attr("scale: float = 1.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query, key, value;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 2, &query));
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(1), 2, &key));
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(2), 2, &value));
+      if (!c->RankKnown(query) || !c->RankKnown(key) ||
+          !c->RankKnown(value)) {
+        c->set_output(0, c->UnknownShape());
+        return Status::OK();
+      }
+
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(query, -1), c->Dim(key, -1), &unused));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(key, -2), c->Dim(value, -2), &unused));
+
+      ShapeHandle batch, other_batch;
+      TF_RETURN_IF_ERROR(c->Subshape(query, 0, -2, &batch));
+      for (int i = 1; i < c->num_inputs(); ++i) {
+        ShapeHandle input = c->input(i);
+        if (!c->RankKnown(input)) {
+          c->set_output(0, c->UnknownShape());
+          return Status::OK();
+        }
+        // A bias of rank at most 2 only broadcasts into the scores.
+        if (c->Rank(input) < 2) continue;
+        TF_RETURN_IF_ERROR(c->Subshape(input, 0, -2, &other_batch));
+        TF_RETURN_IF_ERROR(BroadcastBinaryOpOutputShapeFnHelper(
+            c, batch, other_batch, true, &batch));
+      }
+
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          batch, c->Matrix(c->Dim(query, -2), c->Dim(value, -1)), &output));
+      c->set_output(0, output);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
+// --------------------------------------------------------------------------
+
 REGISTER_OP("SoftmaxCrossEntropyWithLogits")
     .Input("features: T")
     .Input("labels: T")
@@ -389,4 +389,26 @@ REGISTER_OP("StringNGrams")
       return Status::OK();
     });
 
+REGISTER_OP("StringToTokenIds")
+    .Input("input: string")
+    .Input("table_handle: resource")
+    .Input("default_value: int64")
+    .Output("token_ids: int64")
+    .Output("row_splits: int64")
+    .Attr("lower: bool = true")
+    .Attr("sep: string = ''")
+    .Attr("ngram_widths: list(int) >= 1 = [1]")
+    .Attr("ngram_separator: string = ' '")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &input));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      DimensionHandle num_splits;
+      TF_RETURN_IF_ERROR(c->Add(c->Dim(input, 0), 1, &num_splits));
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, c->Vector(num_splits));
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
@@ -165,6 +165,26 @@ class TopKTest(test.TestCase):
       values = -np.sort(-inputs, axis=1)[:, :k]
       self._validateTopK(inputs, k, values, indices)
 
+  def _testWideRowTopK(self,
+                       dtype,
+                       k,
+                       sorted=True):  # pylint: disable=redefined-builtin
+    # Rows this wide are split into blocks that are selected in parallel.
+    b = 2
+    n = 300000
+    inputs = np.random.permutation(
+        np.linspace(0, 100, b * n, dtype=dtype)).reshape(b, n)
+    indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+    values = -np.sort(-inputs, axis=1)[:, :k]
+    self._validateTopK(inputs, k, values, indices, sorted=sorted)
+
+  def testWideRowTopK(self):
+    for k in [2, 100, 1000]:
+      self._testWideRowTopK(np.float32, k)
+      self._testWideRowTopK(np.float64, k, sorted=False)
+    # Lots of repeated integers, so that blocks have ties on their boundaries.
+    self._testWideRowTopK(np.int32, 1000)
+
   def testTopAll(self):
     inputs = [[0.1, 0.3, 0.2, 0.4], [0.1, 0.3, 0.3, 0.2]]
     self._validateTopK(inputs, 4, [[0.4, 0.3, 0.2, 0.1], [0.3, 0.3, 0.2, 0.1]],
@@ -0,0 +1,176 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/quantization_utils.h"
+#include "tensorflow/tools/graph_transforms/transform_utils.h"
+
+namespace tensorflow {
+namespace graph_transforms {
+
+namespace {
+
+// Quantizes every column of the float matrix 'weights', or of its transpose,
+// to eight bits with its own range, which includes 0.
+void QuantizeColumns(const Tensor& weights, bool transpose,
+                     Tensor* quantized, Tensor* min, Tensor* max) {
+  const auto w = weights.matrix<float>();
+  const int64 rows = transpose ? w.dimension(1) : w.dimension(0);
+  const int64 cols = transpose ? w.dimension(0) : w.dimension(1);
+  auto value = [&](int64 i, int64 j) {
+    return transpose ? w(j, i) : w(i, j);
+  };
+  *quantized = Tensor(DT_QUINT8, TensorShape({rows, cols}));
+  *min = Tensor(DT_FLOAT, TensorShape({cols}));
+  *max = Tensor(DT_FLOAT, TensorShape({cols}));
+  auto q = quantized->matrix<quint8>();
+  for (int64 j = 0; j < cols; ++j) {
+    float col_min = 0.0f;
+    float col_max = 0.0f;
+    for (int64 i = 0; i < rows; ++i) {
+      col_min = std::min(col_min, value(i, j));
+      col_max = std::max(col_max, value(i, j));
+    }
+    // An all-zero column still needs a non-empty range.
+    if (col_min == col_max) col_max = col_min + 1.0f;
+    min->vec<float>()(j) = col_min;
+    max->vec<float>()(j) = col_max;
+    for (int64 i = 0; i < rows; ++i) {
+      q(i, j) = FloatToQuantized<quint8>(value(i, j), col_min, col_max);
+    }
+  }
+}
+
+}  // namespace
+
+// Replaces float MatMuls with large constant weights by
+// DynamicQuantizedMatMul, which multiplies with eight-bit weights and
+// quantizes the other input on the fly. The weights are quantized by output
+// column, and replaced in the graph when no other node uses them.
+Status QuantizeMatMulWeights(const GraphDef& input_graph_def,
+                             const TransformFuncContext& context,
+                             GraphDef* output_graph_def) {
+  int32 minimum_size;
+  TF_RETURN_IF_ERROR(
+      context.GetOneInt32Parameter("minimum_size", 1024, &minimum_size));
+
+  std::map<string, const NodeDef*> node_map;
+  MapNamesToNodes(input_graph_def, &node_map);
+
+  // The names of the quantized weights, by the name of the float weights and
+  // whether they are transposed.
+  std::map<std::pair<string, bool>, string> quantized_weights;
+  std::set<string> replaced_weights;
+  output_graph_def->Clear();
+  for (const NodeDef& node : input_graph_def.node()) {
+    auto bool_attr = [&node](const string& name) {
+      return node.attr().count(name) && node.attr().at(name).b();
+    };
+    const bool transpose_b = bool_attr("transpose_b");
+    const NodeDef* weights_node = nullptr;
+    if (node.op() == "MatMul" && node.input_size() >= 2 &&
+        node.attr().count("T") && node.attr().at("T").type() == DT_FLOAT &&
+        !bool_attr("transpose_a")) {
+      string prefix, weights_name, suffix;
+      NodeNamePartsFromInput(node.input(1), &prefix, &weights_name, &suffix);
+      if (prefix.empty() && suffix.empty() && node_map.count(weights_name)) {
+        weights_node = node_map.at(weights_name);
+      }
+    }
+    Tensor weights;
+    if (weights_node != nullptr && weights_node->op() == "Const" &&
+        weights_node->attr().count("dtype") &&
+        weights_node->attr().at("dtype").type() == DT_FLOAT) {
+      weights = GetNodeTensorAttr(*weights_node, "value");
+    }
+    if (!weights.IsInitialized() ||
+        !TensorShapeUtils::IsMatrix(weights.shape()) ||
+        weights.NumElements() < minimum_size) {
+      *output_graph_def->mutable_node()->Add() = node;
+      continue;
+    }
+
+    const std::pair<string, bool> key(weights_node->name(), transpose_b);
+    if (!quantized_weights.count(key)) {
+      const string name =
+          weights_node->name() + (transpose_b ? "_transposed" : "");
+      Tensor quantized, min, max;
+      QuantizeColumns(weights, transpose_b, &quantized, &min, &max);
+
+      NodeDef* quantized_node = output_graph_def->mutable_node()->Add();
+      quantized_node->set_op("Const");
+      quantized_node->set_name(name + "_quantized_const");
+      SetNodeAttr("dtype", DT_QUINT8, quantized_node);
+      SetNodeTensorAttr<float>("value", quantized, quantized_node);
+
+      NodeDef* min_node = output_graph_def->mutable_node()->Add();
+      min_node->set_op("Const");
+      min_node->set_name(name + "_quantized_min");
+      SetNodeAttr("dtype", DT_FLOAT, min_node);
+      SetNodeTensorAttr<float>("value", min, min_node);
+
+      NodeDef* max_node = output_graph_def->mutable_node()->Add();
+      max_node->set_op("Const");
+      max_node->set_name(name + "_quantized_max");
+      SetNodeAttr("dtype", DT_FLOAT, max_node);
+      SetNodeTensorAttr<float>("value", max, max_node);
+
+      quantized_weights[key] = name;
+      replaced_weights.insert(weights_node->name());
+    }
+    const string& name = quantized_weights[key];
+
+    NodeDef* matmul_node = output_graph_def->mutable_node()->Add();
+    matmul_node->set_op("DynamicQuantizedMatMul");
+    matmul_node->set_name(node.name());
+    matmul_node->set_device(node.device());
+    AddNodeInput(node.input(0), matmul_node);
+    AddNodeInput(name + "_quantized_const", matmul_node);
+    AddNodeInput(name + "_quantized_min", matmul_node);
+    AddNodeInput(name + "_quantized_max", matmul_node);
+    // Keeps the control dependencies.
+    for (int i = 2; i < node.input_size(); ++i) {
+      AddNodeInput(node.input(i), matmul_node);
+    }
+  }
+
+  // Removes the float weights that are no longer used.
+  std::set<string> used_nodes;
+  for (const string& output : context.output_names) {
+    used_nodes.insert(NodeNameFromInput(output));
+  }
+  for (const NodeDef& node : output_graph_def->node()) {
+    for (const string& input : node.input()) {
+      used_nodes.insert(NodeNameFromInput(input));
+    }
+  }
+  GraphDef replaced_graph_def;
+  for (const NodeDef& node : output_graph_def->node()) {
+    if (replaced_weights.count(node.name()) && !used_nodes.count(node.name())) {
+      continue;
+    }
+    *replaced_graph_def.mutable_node()->Add() = node;
+  }
+  *replaced_graph_def.mutable_versions() = input_graph_def.versions();
+  *replaced_graph_def.mutable_library() = input_graph_def.library();
+  *output_graph_def = replaced_graph_def;
+  return Status::OK();
+}
+
+REGISTER_GRAPH_TRANSFORM("quantize_matmul_weights", QuantizeMatMulWeights);
+
+}  // namespace graph_transforms
+}  // namespace tensorflow
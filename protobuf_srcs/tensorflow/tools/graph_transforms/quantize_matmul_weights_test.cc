@@ -0,0 +1,133 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/math_ops.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/tools/graph_transforms/transform_utils.h"
+
+namespace tensorflow {
+namespace graph_transforms {
+
+// Declare here, so we don't need a public header.
+Status QuantizeMatMulWeights(const GraphDef& input_graph_def,
+                             const TransformFuncContext& context,
+                             GraphDef* output_graph_def);
+
+class QuantizeMatMulWeightsTest : public ::testing::Test {
+ protected:
+  // Builds output = MatMul(input, weights) + MatMul(input, weights^T) with
+  // [4, 8] inputs and [8, 8] weights, and 'extra' = Identity(weights).
+  void BuildGraphDef(bool with_extra_use, GraphDef* graph_def) {
+    auto root = tensorflow::Scope::DisabledShapeInferenceScope();
+    Tensor input_data(DT_FLOAT, TensorShape({4, 8}));
+    test::FillFn<float>(&input_data,
+                        [](int i) { return (i % 7) * 0.5f - 1.5f; });
+    Output input =
+        ops::Const(root.WithOpName("input"), Input::Initializer(input_data));
+    Tensor weights_data(DT_FLOAT, TensorShape({8, 8}));
+    test::FillFn<float>(&weights_data,
+                        [](int i) { return (i % 11) * 0.1f - 0.3f; });
+    Output weights = ops::Const(root.WithOpName("weights"),
+                                Input::Initializer(weights_data));
+    Output matmul = ops::MatMul(root.WithOpName("matmul"), input, weights);
+    Output matmul_transposed =
+        ops::MatMul(root.WithOpName("matmul_transposed"), input, weights,
+                    ops::MatMul::TransposeB(true));
+    ops::Add(root.WithOpName("output"), matmul, matmul_transposed);
+    if (with_extra_use) {
+      ops::Identity(root.WithOpName("extra"), weights);
+    }
+    TF_ASSERT_OK(root.ToGraphDef(graph_def));
+  }
+
+  void RunGraph(const GraphDef& graph_def, Tensor* output) {
+    std::unique_ptr<Session> session(NewSession(SessionOptions()));
+    TF_ASSERT_OK(session->Create(graph_def));
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {"output"}, {}, &outputs));
+    *output = outputs[0];
+  }
+};
+
+TEST_F(QuantizeMatMulWeightsTest, QuantizesMatMuls) {
+  GraphDef original_graph_def;
+  BuildGraphDef(false, &original_graph_def);
+  TransformFuncContext context;
+  context.output_names = {"output"};
+  context.params["minimum_size"] = {"16"};
+  GraphDef quantized_graph_def;
+  TF_ASSERT_OK(QuantizeMatMulWeights(original_graph_def, context,
+                                     &quantized_graph_def));
+
+  std::map<string, const NodeDef*> node_lookup;
+  MapNamesToNodes(quantized_graph_def, &node_lookup);
+  ASSERT_EQ(1, node_lookup.count("matmul"));
+  EXPECT_EQ("DynamicQuantizedMatMul", node_lookup.at("matmul")->op());
+  EXPECT_EQ("weights_quantized_const", node_lookup.at("matmul")->input(1));
+  ASSERT_EQ(1, node_lookup.count("matmul_transposed"));
+  EXPECT_EQ("weights_transposed_quantized_const",
+            node_lookup.at("matmul_transposed")->input(1));
+  EXPECT_EQ(DT_QUINT8, node_lookup.at("weights_quantized_const")
+                           ->attr()
+                           .at("dtype")
+                           .type());
+  // The float weights are removed.
+  EXPECT_EQ(0, node_lookup.count("weights"));
+
+  Tensor original_output, quantized_output;
+  RunGraph(original_graph_def, &original_output);
+  RunGraph(quantized_graph_def, &quantized_output);
+  test::ExpectTensorNear<float>(original_output, quantized_output, 0.1);
+}
+
+TEST_F(QuantizeMatMulWeightsTest, KeepsSharedWeights) {
+  GraphDef original_graph_def;
+  BuildGraphDef(true, &original_graph_def);
+  TransformFuncContext context;
+  context.output_names = {"output", "extra"};
+  context.params["minimum_size"] = {"16"};
+  GraphDef quantized_graph_def;
+  TF_ASSERT_OK(QuantizeMatMulWeights(original_graph_def, context,
+                                     &quantized_graph_def));
+
+  std::map<string, const NodeDef*> node_lookup;
+  MapNamesToNodes(quantized_graph_def, &node_lookup);
+  EXPECT_EQ("DynamicQuantizedMatMul", node_lookup.at("matmul")->op());
+  ASSERT_EQ(1, node_lookup.count("weights"));
+  EXPECT_EQ("Const", node_lookup.at("weights")->op());
+}
+
+TEST_F(QuantizeMatMulWeightsTest, SkipsSmallWeights) {
+  GraphDef original_graph_def;
+  BuildGraphDef(false, &original_graph_def);
+  TransformFuncContext context;
+  context.output_names = {"output"};
+  GraphDef quantized_graph_def;
+  TF_ASSERT_OK(QuantizeMatMulWeights(original_graph_def, context,
+                                     &quantized_graph_def));
+
+  std::map<string, const NodeDef*> node_lookup;
+  MapNamesToNodes(quantized_graph_def, &node_lookup);
+  EXPECT_EQ("MatMul", node_lookup.at("matmul")->op());
+  EXPECT_EQ(1, node_lookup.count("weights"));
+}
+
+}  // namespace graph_transforms
+}  // namespace tensorflow
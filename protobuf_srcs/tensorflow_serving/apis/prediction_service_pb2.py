@@ -38,15 +38,16 @@ from tensorflow_serving.apis import get_model_metadata_pb2 as tensorflow__servin
 from tensorflow_serving.apis import inference_pb2 as tensorflow__serving_dot_apis_dot_inference__pb2
 from tensorflow_serving.apis import predict_pb2 as tensorflow__serving_dot_apis_dot_predict__pb2
 from tensorflow_serving.apis import regression_pb2 as tensorflow__serving_dot_apis_dot_regression__pb2
+from tensorflow_serving.apis import shared_memory_pb2 as tensorflow__serving_dot_apis_dot_shared__memory__pb2
 
 
 DESCRIPTOR = _descriptor.FileDescriptor(
   name='tensorflow_serving/apis/prediction_service.proto',
   package='tensorflow.serving',
   syntax='proto3',
-  serialized_pb=_b('\n0tensorflow_serving/apis/prediction_service.proto\x12\x12tensorflow.serving\x1a,tensorflow_serving/apis/classification.proto\x1a\x30tensorflow_serving/apis/get_model_metadata.proto\x1a\'tensorflow_serving/apis/inference.proto\x1a%tensorflow_serving/apis/predict.proto\x1a(tensorflow_serving/apis/regression.proto2\xfc\x03\n\x11PredictionService\x12\x61\n\x08\x43lassify\x12).tensorflow.serving.ClassificationRequest\x1a*.tensorflow.serving.ClassificationResponse\x12X\n\x07Regress\x12%.tensorflow.serving.RegressionRequest\x1a&.tensorflow.serving.RegressionResponse\x12R\n\x07Predict\x12\".tensorflow.serving.PredictRequest\x1a#.tensorflow.serving.PredictResponse\x12g\n\x0eMultiInference\x12).tensorflow.serving.MultiInferenceRequest\x1a*.tensorflow.serving.MultiInferenceResponse\x12m\n\x10GetModelMetadata\x12+.tensorflow.serving.GetModelMetadataRequest\x1a,.tensorflow.serving.GetModelMetadataResponseB\x03\xf8\x01\x01\x62\x06proto3')
+  serialized_pb=_b('\n0tensorflow_serving/apis/prediction_service.proto\x12\x12tensorflow.serving\x1a,tensorflow_serving/apis/classification.proto\x1a\x30tensorflow_serving/apis/get_model_metadata.proto\x1a\'tensorflow_serving/apis/inference.proto\x1a%tensorflow_serving/apis/predict.proto\x1a(tensorflow_serving/apis/regression.proto\x1a+tensorflow_serving/apis/shared_memory.proto2\xe2\x06\n\x11PredictionService\x12\x61\n\x08\x43lassify\x12).tensorflow.serving.ClassificationRequest\x1a*.tensorflow.serving.ClassificationResponse\x12X\n\x07Regress\x12%.tensorflow.serving.RegressionRequest\x1a&.tensorflow.serving.RegressionResponse\x12R\n\x07Predict\x12\".tensorflow.serving.PredictRequest\x1a#.tensorflow.serving.PredictResponse\x12h\n\rPredictStream\x12(.tensorflow.serving.PredictStreamRequest\x1a).tensorflow.serving.PredictStreamResponse(\x01\x30\x01\x12g\n\x0eMultiInference\x12).tensorflow.serving.MultiInferenceRequest\x1a*.tensorflow.serving.MultiInferenceResponse\x12m\n\x10GetModelMetadata\x12+.tensorflow.serving.GetModelMetadataRequest\x1a,.tensorflow.serving.GetModelMetadataResponse\x12y\n\x14RegisterSharedMemory\x12/.tensorflow.serving.RegisterSharedMemoryRequest\x1a\x30.tensorflow.serving.RegisterSharedMemoryResponse\x12\x7f\n\x16UnregisterSharedMemory\x12\x31.tensorflow.serving.UnregisterSharedMemoryRequest\x1a\x32.tensorflow.serving.UnregisterSharedMemoryResponseB\x03\xf8\x01\x01\x62\x06proto3')
   ,
-  dependencies=[tensorflow__serving_dot_apis_dot_classification__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_get__model__metadata__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_inference__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_predict__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_regression__pb2.DESCRIPTOR,])
+  dependencies=[tensorflow__serving_dot_apis_dot_classification__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_get__model__metadata__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_inference__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_predict__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_regression__pb2.DESCRIPTOR,tensorflow__serving_dot_apis_dot_shared__memory__pb2.DESCRIPTOR,])
 
 
 
@@ -62,8 +63,8 @@ _PREDICTIONSERVICE = _descriptor.ServiceDescriptor(
   file=DESCRIPTOR,
   index=0,
   options=None,
-  serialized_start=291,
-  serialized_end=799,
+  serialized_start=336,
+  serialized_end=1202,
   methods=[
   _descriptor.MethodDescriptor(
     name='Classify',
@@ -92,10 +93,19 @@ _PREDICTIONSERVICE = _descriptor.ServiceDescriptor(
     output_type=tensorflow__serving_dot_apis_dot_predict__pb2._PREDICTRESPONSE,
     options=None,
   ),
+  _descriptor.MethodDescriptor(
+    name='PredictStream',
+    full_name='tensorflow.serving.PredictionService.PredictStream',
+    index=3,
+    containing_service=None,
+    input_type=tensorflow__serving_dot_apis_dot_predict__pb2._PREDICTSTREAMREQUEST,
+    output_type=tensorflow__serving_dot_apis_dot_predict__pb2._PREDICTSTREAMRESPONSE,
+    options=None,
+  ),
   _descriptor.MethodDescriptor(
     name='MultiInference',
     full_name='tensorflow.serving.PredictionService.MultiInference',
-    index=3,
+    index=4,
     containing_service=None,
     input_type=tensorflow__serving_dot_apis_dot_inference__pb2._MULTIINFERENCEREQUEST,
     output_type=tensorflow__serving_dot_apis_dot_inference__pb2._MULTIINFERENCERESPONSE,
@@ -104,12 +114,30 @@ _PREDICTIONSERVICE = _descriptor.ServiceDescriptor(
   _descriptor.MethodDescriptor(
     name='GetModelMetadata',
     full_name='tensorflow.serving.PredictionService.GetModelMetadata',
-    index=4,
+    index=5,
     containing_service=None,
     input_type=tensorflow__serving_dot_apis_dot_get__model__metadata__pb2._GETMODELMETADATAREQUEST,
     output_type=tensorflow__serving_dot_apis_dot_get__model__metadata__pb2._GETMODELMETADATARESPONSE,
     options=None,
   ),
+  _descriptor.MethodDescriptor(
+    name='RegisterSharedMemory',
+    full_name='tensorflow.serving.PredictionService.RegisterSharedMemory',
+    index=6,
+    containing_service=None,
+    input_type=tensorflow__serving_dot_apis_dot_shared__memory__pb2._REGISTERSHAREDMEMORYREQUEST,
+    output_type=tensorflow__serving_dot_apis_dot_shared__memory__pb2._REGISTERSHAREDMEMORYRESPONSE,
+    options=None,
+  ),
+  _descriptor.MethodDescriptor(
+    name='UnregisterSharedMemory',
+    full_name='tensorflow.serving.PredictionService.UnregisterSharedMemory',
+    index=7,
+    containing_service=None,
+    input_type=tensorflow__serving_dot_apis_dot_shared__memory__pb2._UNREGISTERSHAREDMEMORYREQUEST,
+    output_type=tensorflow__serving_dot_apis_dot_shared__memory__pb2._UNREGISTERSHAREDMEMORYRESPONSE,
+    options=None,
+  ),
 ])
 _sym_db.RegisterServiceDescriptor(_PREDICTIONSERVICE)
 
@@ -23,6 +23,7 @@ from tensorflow_serving.apis import get_model_metadata_pb2 as tensorflow__servin
 from tensorflow_serving.apis import inference_pb2 as tensorflow__serving_dot_apis_dot_inference__pb2
 from tensorflow_serving.apis import predict_pb2 as tensorflow__serving_dot_apis_dot_predict__pb2
 from tensorflow_serving.apis import regression_pb2 as tensorflow__serving_dot_apis_dot_regression__pb2
+from tensorflow_serving.apis import shared_memory_pb2 as tensorflow__serving_dot_apis_dot_shared__memory__pb2
 
 
 class PredictionServiceStub(object):
@@ -52,6 +53,11 @@ class PredictionServiceStub(object):
         request_serializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictRequest.SerializeToString,
         response_deserializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictResponse.FromString,
         )
+    self.PredictStream = channel.stream_stream(
+        '/tensorflow.serving.PredictionService/PredictStream',
+        request_serializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictStreamRequest.SerializeToString,
+        response_deserializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictStreamResponse.FromString,
+        )
     self.MultiInference = channel.unary_unary(
         '/tensorflow.serving.PredictionService/MultiInference',
         request_serializer=tensorflow__serving_dot_apis_dot_inference__pb2.MultiInferenceRequest.SerializeToString,
@@ -62,6 +68,16 @@ class PredictionServiceStub(object):
         request_serializer=tensorflow__serving_dot_apis_dot_get__model__metadata__pb2.GetModelMetadataRequest.SerializeToString,
         response_deserializer=tensorflow__serving_dot_apis_dot_get__model__metadata__pb2.GetModelMetadataResponse.FromString,
         )
+    self.RegisterSharedMemory = channel.unary_unary(
+        '/tensorflow.serving.PredictionService/RegisterSharedMemory',
+        request_serializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.RegisterSharedMemoryRequest.SerializeToString,
+        response_deserializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.RegisterSharedMemoryResponse.FromString,
+        )
+    self.UnregisterSharedMemory = channel.unary_unary(
+        '/tensorflow.serving.PredictionService/UnregisterSharedMemory',
+        request_serializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.UnregisterSharedMemoryRequest.SerializeToString,
+        response_deserializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.UnregisterSharedMemoryResponse.FromString,
+        )
 
 
 class PredictionServiceServicer(object):
@@ -91,6 +107,15 @@ class PredictionServiceServicer(object):
     context.set_details('Method not implemented!')
     raise NotImplementedError('Method not implemented!')
 
+  def PredictStream(self, request_iterator, context):
+    """PredictStream -- runs the requests sent on the stream as they arrive, so
+    that they can be batched together, and sends their responses as they
+    complete.
+    """
+    context.set_code(grpc.StatusCode.UNIMPLEMENTED)
+    context.set_details('Method not implemented!')
+    raise NotImplementedError('Method not implemented!')
+
   def MultiInference(self, request, context):
     """MultiInference API for multi-headed models.
     """
@@ -105,6 +130,22 @@ class PredictionServiceServicer(object):
     context.set_details('Method not implemented!')
     raise NotImplementedError('Method not implemented!')
 
+  def RegisterSharedMemory(self, request, context):
+    """RegisterSharedMemory -- maps a shared memory region of a client on the
+    same host, for the tensors of its Predict requests to be read from and
+    written to instead of being serialized.
+    """
+    context.set_code(grpc.StatusCode.UNIMPLEMENTED)
+    context.set_details('Method not implemented!')
+    raise NotImplementedError('Method not implemented!')
+
+  def UnregisterSharedMemory(self, request, context):
+    """UnregisterSharedMemory -- unmaps regions mapped by RegisterSharedMemory.
+    """
+    context.set_code(grpc.StatusCode.UNIMPLEMENTED)
+    context.set_details('Method not implemented!')
+    raise NotImplementedError('Method not implemented!')
+
 
 def add_PredictionServiceServicer_to_server(servicer, server):
   rpc_method_handlers = {
@@ -123,6 +164,11 @@ def add_PredictionServiceServicer_to_server(servicer, server):
           request_deserializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictRequest.FromString,
           response_serializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictResponse.SerializeToString,
       ),
+      'PredictStream': grpc.stream_stream_rpc_method_handler(
+          servicer.PredictStream,
+          request_deserializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictStreamRequest.FromString,
+          response_serializer=tensorflow__serving_dot_apis_dot_predict__pb2.PredictStreamResponse.SerializeToString,
+      ),
       'MultiInference': grpc.unary_unary_rpc_method_handler(
           servicer.MultiInference,
           request_deserializer=tensorflow__serving_dot_apis_dot_inference__pb2.MultiInferenceRequest.FromString,
@@ -133,6 +179,16 @@ def add_PredictionServiceServicer_to_server(servicer, server):
           request_deserializer=tensorflow__serving_dot_apis_dot_get__model__metadata__pb2.GetModelMetadataRequest.FromString,
           response_serializer=tensorflow__serving_dot_apis_dot_get__model__metadata__pb2.GetModelMetadataResponse.SerializeToString,
       ),
+      'RegisterSharedMemory': grpc.unary_unary_rpc_method_handler(
+          servicer.RegisterSharedMemory,
+          request_deserializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.RegisterSharedMemoryRequest.FromString,
+          response_serializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.RegisterSharedMemoryResponse.SerializeToString,
+      ),
+      'UnregisterSharedMemory': grpc.unary_unary_rpc_method_handler(
+          servicer.UnregisterSharedMemory,
+          request_deserializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.UnregisterSharedMemoryRequest.FromString,
+          response_serializer=tensorflow__serving_dot_apis_dot_shared__memory__pb2.UnregisterSharedMemoryResponse.SerializeToString,
+      ),
   }
   generic_handler = grpc.method_handlers_generic_handler(
       'tensorflow.serving.PredictionService', rpc_method_handlers)
@@ -17,6 +17,10 @@ limitations under the License.
 
 #include <stddef.h>
 
+#include <algorithm>
+#include <map>
+#include <set>
+
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_util.h"
@@ -38,6 +42,16 @@ namespace serving {
 
 namespace {
 
+auto* ragged_value_count = monitoring::Counter<1>::New(
+    "/tensorflow/serving/batching_session/ragged_values",
+    "The number of values of the ragged inputs of batches.", "tensor");
+
+auto* padded_ragged_value_count = monitoring::Counter<1>::New(
+    "/tensorflow/serving/batching_session/padded_ragged_values",
+    "The number of values the ragged inputs of batches would have if every "
+    "row were padded to the longest one.",
+    "tensor");
+
 string TensorSignatureDebugString(const TensorSignature& signature) {
   return strings::StrCat("{input_tensors: <",
                          str_util::Join(signature.input_tensors, ", "),
@@ -110,19 +124,59 @@ bool AreShapesEqualExceptZeroDim(const TensorShape& shape1,
   return true;
 }
 
+// Returns the tensor named 'tensor_name' in 'inputs', or nullptr if there is
+// none.
+const Tensor* FindInputTensor(
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    const string& tensor_name) {
+  for (const auto& entry : inputs) {
+    if (entry.first == tensor_name) return &entry.second;
+  }
+  return nullptr;
+}
+
+// Returns true if 'tensor_info' is a RaggedTensor with one ragged dimension.
+// The components of a RaggedTensor are its flat values followed by the row
+// splits of each ragged dimension.
+bool IsRaggedInputWithOneRaggedDimension(const TensorInfo& tensor_info) {
+  return tensor_info.has_composite_tensor() &&
+         tensor_info.composite_tensor().type_spec().type_spec_class() ==
+             TypeSpecProto::RAGGED_TENSOR_SPEC &&
+         tensor_info.composite_tensor().components_size() == 2;
+}
+
 }  // namespace
 
+namespace internal {
+
+monitoring::Counter<1>* GetRaggedValueCount() { return ragged_value_count; }
+
+monitoring::Counter<1>* GetPaddedRaggedValueCount() {
+  return padded_ragged_value_count;
+}
+
+}  // namespace internal
+
 TensorSignature TensorSignatureFromSignatureDef(
-    const SignatureDef& signature_def) {
-  return TensorSignatureFromSignatureDefs({signature_def});
+    const SignatureDef& signature_def, bool batch_ragged_inputs) {
+  return TensorSignatureFromSignatureDefs({signature_def},
+                                          batch_ragged_inputs);
 }
 
 TensorSignature TensorSignatureFromSignatureDefs(
-    const std::vector<SignatureDef>& signature_defs) {
+    const std::vector<SignatureDef>& signature_defs, bool batch_ragged_inputs) {
   TensorSignature tensor_signature;
   for (const SignatureDef& signature_def : signature_defs) {
     for (const auto& entry : signature_def.inputs()) {
       const TensorInfo& tensor_info = entry.second;
+      if (batch_ragged_inputs &&
+          IsRaggedInputWithOneRaggedDimension(tensor_info)) {
+        for (const TensorInfo& component :
+             tensor_info.composite_tensor().components()) {
+          tensor_signature.input_tensors.insert(component.name());
+        }
+        continue;
+      }
       tensor_signature.input_tensors.insert(tensor_info.name());
     }
     for (const auto& entry : signature_def.outputs()) {
@@ -133,6 +187,25 @@ TensorSignature TensorSignatureFromSignatureDefs(
   return tensor_signature;
 }
 
+std::vector<RaggedTensorNames> RaggedInputsFromSignatureDefs(
+    const std::vector<SignatureDef>& signature_defs) {
+  std::vector<RaggedTensorNames> ragged_inputs;
+  std::set<string> values_tensors;
+  for (const SignatureDef& signature_def : signature_defs) {
+    for (const auto& entry : signature_def.inputs()) {
+      const TensorInfo& tensor_info = entry.second;
+      if (!IsRaggedInputWithOneRaggedDimension(tensor_info)) continue;
+      const TensorInfo::CompositeTensor& composite_tensor =
+          tensor_info.composite_tensor();
+      const string& values_tensor = composite_tensor.components(0).name();
+      if (!values_tensors.insert(values_tensor).second) continue;
+      ragged_inputs.push_back(
+          {values_tensor, composite_tensor.components(1).name()});
+    }
+  }
+  return ragged_inputs;
+}
+
 // A session that performs batching on top of a wrapped session. See the
 // documentation in batching_session.h for details and constraints.
 class BatchingSession : public ServingSession {
@@ -179,7 +252,8 @@ class BatchingSession : public ServingSession {
   // Computes the size of an input tensor list for batching purposes, by
   // analyzing the 0th dimension size of each of the tensors. All tensors in the
   // list must have the same 0th dimension size to be batchable. If the sizes
-  // are not all identical, returns an error.
+  // are not all identical, returns an error. The size of a ragged input is its
+  // number of rows; its values may have any 0th dimension size.
   Status ComputeInputSize(const std::vector<std::pair<string, Tensor>>& inputs,
                           size_t* size) const;
 
@@ -210,6 +284,11 @@ class BatchingSession : public ServingSession {
 
   const BatchingSessionOptions options_;
 
+  // The row splits of each ragged input by the name of its values tensor, and
+  // the values by the name of the row splits tensor.
+  std::map<string, string> ragged_row_splits_;
+  std::map<string, string> ragged_values_;
+
   std::unique_ptr<Session> wrapped_;
   std::unordered_map<TensorSignature,
                      std::unique_ptr<BatchScheduler<BatchingSessionTask>>,
@@ -316,7 +395,13 @@ Status BatchingSession::ListDevices(std::vector<DeviceAttributes>* response) {
 }
 
 BatchingSession::BatchingSession(const BatchingSessionOptions& options)
-    : options_(options) {}
+    : options_(options) {
+  for (const RaggedTensorNames& ragged_input : options_.ragged_inputs) {
+    ragged_row_splits_[ragged_input.values_tensor] =
+        ragged_input.row_splits_tensor;
+    ragged_values_[ragged_input.row_splits_tensor] = ragged_input.values_tensor;
+  }
+}
 
 Status BatchingSession::ComputeInputSize(
     const std::vector<std::pair<string, Tensor>>& inputs, size_t* size) const {
@@ -327,6 +412,7 @@ Status BatchingSession::ComputeInputSize(
 
   bool first = true;
   for (const auto& entry : inputs) {
+    const string& tensor_name = entry.first;
     const Tensor& tensor = entry.second;
 
     if (tensor.shape().dims() == 0) {
@@ -334,7 +420,30 @@ Status BatchingSession::ComputeInputSize(
           "Batching session Run() input tensors must have at least one "
           "dimension");
     }
-    const size_t this_size = tensor.shape().dim_size(0);
+    size_t this_size = tensor.shape().dim_size(0);
+
+    // The values of a ragged input are counted through its row splits.
+    auto row_splits = ragged_row_splits_.find(tensor_name);
+    if (row_splits != ragged_row_splits_.end()) {
+      if (FindInputTensor(inputs, row_splits->second) == nullptr) {
+        return errors::InvalidArgument(
+            "Batching session Run() ragged input values '", tensor_name,
+            "' must be fed with their row splits '", row_splits->second, "'");
+      }
+      continue;
+    }
+    auto values = ragged_values_.find(tensor_name);
+    if (values != ragged_values_.end()) {
+      const Tensor* values_tensor = FindInputTensor(inputs, values->second);
+      if (values_tensor == nullptr || values_tensor->dims() == 0) {
+        return errors::InvalidArgument(
+            "Batching session Run() ragged input row splits '", tensor_name,
+            "' must be fed with their values '", values->second, "'");
+      }
+      TF_RETURN_IF_ERROR(
+          ValidateRowSplits(tensor, values_tensor->shape().dim_size(0)));
+      this_size = tensor.shape().dim_size(0) - 1;
+    }
 
     if (first) {
       *size = this_size;
@@ -395,6 +504,11 @@ Status BatchingSession::MergeInputTensors(
       const Tensor& tensor = entry.second;
 
       std::vector<Tensor>& tensor_vec = tensors_to_merge[tensor_name];
+      // Row splits are merged below, with empty rows for padding.
+      if (ragged_values_.count(tensor_name) > 0) {
+        tensor_vec.push_back(tensor);
+        continue;
+      }
       Tensor optionally_padded_tensor;
       if (options_.pad_variable_length_inputs) {
         TF_RETURN_IF_ERROR(AddPadding(tensor, (*max_dim_sizes)[tensor_name],
@@ -417,7 +531,9 @@ Status BatchingSession::MergeInputTensors(
         }
       }
       tensor_vec.push_back(optionally_padded_tensor);
-      if (i == batch.num_tasks() - 1 && padding_size > 0) {
+      // The values of the padding rows of a ragged input are empty.
+      if (i == batch.num_tasks() - 1 && padding_size > 0 &&
+          ragged_row_splits_.count(tensor_name) == 0) {
         // This is the last task. Insert padding.
         //
         // Use the first row of this task's tensor as the padding data. (We know
@@ -447,6 +563,28 @@ Status BatchingSession::MergeInputTensors(
       return errors::Internal(
           "One or more tasks does not conform to batch signature");
     }
+    auto values = ragged_values_.find(tensor_name);
+    if (values != ragged_values_.end()) {
+      Tensor merged_row_splits;
+      TF_RETURN_IF_ERROR(
+          MergeRowSplits(tensors->second, padding_size, &merged_row_splits));
+      merged_inputs->push_back({tensor_name, merged_row_splits});
+
+      // Compares the values with those of padding every row to the longest.
+      int64 num_values = 0;
+      for (const Tensor& values_tensor : tensors_to_merge[values->second]) {
+        num_values += values_tensor.shape().dim_size(0);
+      }
+      int64 max_row_length = 0;
+      for (const Tensor& row_splits : tensors->second) {
+        max_row_length = std::max(max_row_length, MaxRowLength(row_splits));
+      }
+      ragged_value_count->GetCell(values->second)->IncrementBy(num_values);
+      padded_ragged_value_count->GetCell(values->second)
+          ->IncrementBy((batch.size() + padding_size) * max_row_length);
+      continue;
+    }
+
     Tensor concated;
     const Status concat_status = tensor::Concat(tensors->second, &concated);
     DCHECK(concat_status.ok()) << concat_status.ToString();
@@ -28,6 +28,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/batching_util/basic_batch_scheduler.h"
 #include "tensorflow/core/kernels/batching_util/batch_scheduler.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/public/session.h"
 
@@ -52,9 +53,13 @@ struct TensorSignature {
   std::set<string> output_tensors;
 };
 
-// Constructs a TensorSignature for a given SignatureDef.
+// Constructs a TensorSignature for a given SignatureDef. If
+// 'batch_ragged_inputs' is true, the RaggedTensor inputs with one ragged
+// dimension (see RaggedInputsFromSignatureDefs()) are fed as their component
+// tensors; it should match whether BatchingSessionOptions::ragged_inputs is
+// set.
 TensorSignature TensorSignatureFromSignatureDef(
-    const SignatureDef& signature_def);
+    const SignatureDef& signature_def, bool batch_ragged_inputs = false);
 
 // Constructs a TensorSignature for a given set of SignatureDefs. The resulting
 // TensorSignature represents the Session::Run() arguments that would be used
@@ -67,6 +72,20 @@ TensorSignature TensorSignatureFromSignatureDef(
 // both 'predicted_label' and 'confidence_score' as output, in a single Run()
 // invocation.
 TensorSignature TensorSignatureFromSignatureDefs(
+    const std::vector<SignatureDef>& signature_defs,
+    bool batch_ragged_inputs = false);
+
+// The names of the tensors fed to Run() for a RaggedTensor with one ragged
+// dimension: its flat values and its row splits.
+struct RaggedTensorNames {
+  string values_tensor;
+  string row_splits_tensor;
+};
+
+// Returns the component names of the RaggedTensor inputs with one ragged
+// dimension of the given SignatureDefs, for use in
+// BatchingSessionOptions::ragged_inputs.
+std::vector<RaggedTensorNames> RaggedInputsFromSignatureDefs(
     const std::vector<SignatureDef>& signature_defs);
 
 // A signature paired with a lambda to create a batch scheduler for Run() calls
@@ -130,6 +149,26 @@ struct BatchingSessionOptions {
   // (modulo zeroth dimension) and this option is set to false,
   // then error Status will be returned.
   bool pad_variable_length_inputs = false;
+
+  // The inputs that are fed as the flat values and row splits of a RaggedTensor
+  // with one ragged dimension (see RaggedInputsFromSignatureDefs()).
+  //
+  // The batch size of a ragged input is its number of rows, i.e. the size of
+  // its row splits minus one, which must equal the 0th-dimension size of the
+  // other inputs. Tasks are merged by concatenating their values and their
+  // offset row splits, so that variable-length inputs are batched without
+  // padding them to the longest one. Padding for 'allowed_batch_sizes' adds
+  // empty rows, and 'pad_variable_length_inputs' only pads the dimensions of
+  // the values after the zeroth one. Output tensors are split along their
+  // zeroth dimension, with one entry per row.
+  //
+  // For example, tasks with values [a, b, c] and row splits [0, 1, 3], and
+  // with values [d] and row splits [0, 1], are merged into values
+  // [a, b, c, d] and row splits [0, 1, 3, 4].
+  //
+  // The number of values that padding would have added instead is exported
+  // in the /tensorflow/serving/batching_session/padded_ragged_values metric.
+  std::vector<RaggedTensorNames> ragged_inputs;
 };
 
 // Wraps a session in a new session that automatically batches Run() calls.
@@ -211,6 +250,15 @@ struct BatchingSessionTask : public BatchTask {
   RunMetadata* run_metadata;
 };
 
+namespace internal {
+
+// The number of values of the ragged inputs of batches, and the number they
+// would have if every row were padded to the longest one, by values tensor.
+monitoring::Counter<1>* GetRaggedValueCount();
+monitoring::Counter<1>* GetPaddedRaggedValueCount();
+
+}  // namespace internal
+
 }  // namespace serving
 }  // namespace tensorflow
 
@@ -21,11 +21,14 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow_serving/servables/tensorflow/serving_session.h"
@@ -35,7 +38,10 @@ namespace tensorflow {
 namespace serving {
 namespace {
 
+using ::testing::AnyOf;
+using ::testing::Contains;
 using ::testing::HasSubstr;
+using ::testing::Not;
 using ::testing::UnorderedElementsAre;
 
 // A wrapper around a Session that captures the batch size.
@@ -79,6 +85,80 @@ class BatchSizeCapturingSession : public ServingSession {
   TF_DISALLOW_COPY_AND_ASSIGN(BatchSizeCapturingSession);
 };
 
+// A session that sums each row of the ragged input given by "values" and
+// "row_splits" into "sums", and captures the row splits it was run with.
+class RowSumSession : public ServingSession {
+ public:
+  RowSumSession() = default;
+  ~RowSumSession() override = default;
+
+  Status Run(const std::vector<std::pair<string, Tensor>>& inputs,
+             const std::vector<string>& output_tensor_names,
+             const std::vector<string>& target_node_names,
+             std::vector<Tensor>* outputs) override {
+    RunMetadata run_metadata;
+    return Run(RunOptions(), inputs, output_tensor_names, target_node_names,
+               outputs, &run_metadata);
+  }
+
+  Status Run(const RunOptions& run_options,
+             const std::vector<std::pair<string, Tensor>>& inputs,
+             const std::vector<string>& output_tensor_names,
+             const std::vector<string>& target_node_names,
+             std::vector<Tensor>* outputs, RunMetadata* run_metadata) override {
+    Tensor values, row_splits;
+    for (const auto& input : inputs) {
+      if (input.first == "values") values = input.second;
+      if (input.first == "row_splits") row_splits = input.second;
+    }
+    const auto splits = row_splits.vec<int64>();
+    Tensor sums(DT_FLOAT, TensorShape({splits.size() - 1}));
+    for (int64 i = 0; i + 1 < splits.size(); ++i) {
+      float sum = 0;
+      for (int64 j = splits(i); j < splits(i + 1); ++j) {
+        sum += values.vec<float>()(j);
+      }
+      sums.vec<float>()(i) = sum;
+    }
+    outputs->push_back(sums);
+    mutex_lock l(mu_);
+    latest_row_splits_ = row_splits;
+    return Status::OK();
+  }
+
+  Status ListDevices(std::vector<DeviceAttributes>* response) override {
+    return errors::Unimplemented("not supported in this test");
+  }
+
+  Tensor latest_row_splits() {
+    mutex_lock l(mu_);
+    return latest_row_splits_;
+  }
+
+ private:
+  mutex mu_;
+
+  // The row splits most recently submitted to Run().
+  Tensor latest_row_splits_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RowSumSession);
+};
+
+// Sums the rows of a ragged input with 'session', and expects 'expected_sums'.
+void TestRowSumRequest(const std::vector<float>& values,
+                       const std::vector<int64>& row_splits,
+                       const std::vector<float>& expected_sums,
+                       Session* session) {
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run(
+      {{"values", test::AsTensor<float>(values)},
+       {"row_splits", test::AsTensor<int64>(row_splits)}},
+      {"sums"}, {} /* target nodes */, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(test::AsTensor<float>(expected_sums),
+                                 outputs[0]);
+}
+
 // Creates a (non-batching) session with the half-plus-two model loaded.
 std::unique_ptr<Session> CreateHalfPlusTwoSession() {
   tensorflow::SessionOptions session_options;
@@ -180,6 +260,54 @@ TEST(BatchingSessionTest, TensorSignatureFromSignatureDefs) {
               UnorderedElementsAre("y0", "y1", "y3"));
 }
 
+// Adds a RaggedTensor input named 'name' with the given component names to
+// 'signature_def'.
+void AddRaggedInput(const string& name, const string& values_tensor,
+                    const string& row_splits_tensor,
+                    SignatureDef* signature_def) {
+  TensorInfo input;
+  TensorInfo::CompositeTensor* composite_tensor =
+      input.mutable_composite_tensor();
+  composite_tensor->mutable_type_spec()->set_type_spec_class(
+      TypeSpecProto::RAGGED_TENSOR_SPEC);
+  composite_tensor->add_components()->set_name(values_tensor);
+  composite_tensor->add_components()->set_name(row_splits_tensor);
+  (*signature_def->mutable_inputs())[name] = input;
+}
+
+TEST(BatchingSessionTest, TensorSignatureFromSignatureDefWithRaggedInput) {
+  SignatureDef signature_def = CreateSignatureDef({{"x0"}, {"y0"}});
+  AddRaggedInput("x1", "values", "row_splits", &signature_def);
+  const TensorSignature tensor_signature = TensorSignatureFromSignatureDef(
+      signature_def, /*batch_ragged_inputs=*/true);
+  EXPECT_THAT(tensor_signature.input_tensors,
+              UnorderedElementsAre("x0", "values", "row_splits"));
+  EXPECT_THAT(tensor_signature.output_tensors, UnorderedElementsAre("y0"));
+}
+
+TEST(BatchingSessionTest,
+     TensorSignatureFromSignatureDefWithRaggedInputNotBatched) {
+  SignatureDef signature_def = CreateSignatureDef({{"x0"}, {"y0"}});
+  AddRaggedInput("x1", "values", "row_splits", &signature_def);
+  const TensorSignature tensor_signature =
+      TensorSignatureFromSignatureDef(signature_def);
+  EXPECT_THAT(tensor_signature.input_tensors,
+              Not(Contains(AnyOf("values", "row_splits"))));
+  EXPECT_THAT(tensor_signature.output_tensors, UnorderedElementsAre("y0"));
+}
+
+TEST(BatchingSessionTest, RaggedInputsFromSignatureDefs) {
+  SignatureDef signature_def_0 = CreateSignatureDef({{"x0"}, {"y0"}});
+  AddRaggedInput("x1", "values", "row_splits", &signature_def_0);
+  SignatureDef signature_def_1 = CreateSignatureDef({{}, {"y1"}});
+  AddRaggedInput("x1", "values", "row_splits", &signature_def_1);
+  const std::vector<RaggedTensorNames> ragged_inputs =
+      RaggedInputsFromSignatureDefs({signature_def_0, signature_def_1});
+  ASSERT_EQ(1, ragged_inputs.size());
+  EXPECT_EQ("values", ragged_inputs[0].values_tensor);
+  EXPECT_EQ("row_splits", ragged_inputs[0].row_splits_tensor);
+}
+
 TEST(BatchingSessionTest, Basic) {
   BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
   schedule_options.max_batch_size = 4;  // fits two 2-unit tasks
@@ -547,6 +675,123 @@ TEST(BatchingSessionTest, EnqueuedLongerThanTimeout) {
   request_returned.WaitForNotification();
 }
 
+TEST(BatchingSessionTest, RaggedInputs) {
+  std::unique_ptr<RowSumSession> row_sum_session(new RowSumSession);
+  auto row_sum_session_raw = row_sum_session.get();
+
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 3;  // fits a 2-row and a 1-row task
+  schedule_options.batch_timeout_micros = 1 * 1000 * 1000;  // won't trigger
+  schedule_options.num_batch_threads = 1;
+  BatchingSessionOptions batching_session_options;
+  batching_session_options.ragged_inputs = {{"values", "row_splits"}};
+  std::unique_ptr<Session> batching_session;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options,
+      {{"values", "row_splits"}, {"sums"}}, std::move(row_sum_session),
+      &batching_session));
+
+  std::unique_ptr<Thread> first_request_thread(Env::Default()->StartThread(
+      ThreadOptions(), "first_request_thread", [&batching_session] {
+        TestRowSumRequest({1.0f, 2.0f, 3.0f}, {0, 1, 3}, {1.0f, 5.0f},
+                          batching_session.get());
+      }));
+  std::unique_ptr<Thread> second_request_thread(Env::Default()->StartThread(
+      ThreadOptions(), "second_request_thread", [&batching_session] {
+        TestRowSumRequest({4.0f}, {0, 1}, {4.0f}, batching_session.get());
+      }));
+  first_request_thread.reset();
+  second_request_thread.reset();
+
+  // Both tasks ran in one batch, with their rows in either order.
+  const Tensor row_splits = row_sum_session_raw->latest_row_splits();
+  ASSERT_EQ(4, row_splits.NumElements());
+  EXPECT_EQ(4, row_splits.vec<int64>()(3));
+}
+
+TEST(BatchingSessionTest, RaggedInputsNotBatchedByDefault) {
+  std::unique_ptr<RowSumSession> row_sum_session(new RowSumSession);
+  auto row_sum_session_raw = row_sum_session.get();
+
+  SignatureDef signature_def = CreateSignatureDef({{}, {"sums"}});
+  AddRaggedInput("x", "values", "row_splits", &signature_def);
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 2;  // too small for the 3-row request
+  schedule_options.batch_timeout_micros = 1 * 1000 * 1000;  // won't trigger
+  schedule_options.num_batch_threads = 1;
+  BatchingSessionOptions batching_session_options;
+  std::unique_ptr<Session> batching_session;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options,
+      TensorSignatureFromSignatureDef(signature_def),
+      std::move(row_sum_session), &batching_session));
+
+  // Without ragged batching, the request doesn't match the signature and is
+  // run as is, rather than being batched with its components treated as
+  // ordinary tensors.
+  TestRowSumRequest({1.0f, 2.0f, 3.0f}, {0, 1, 3}, {1.0f, 5.0f},
+                    batching_session.get());
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0, 1, 3}, {3}),
+                                 row_sum_session_raw->latest_row_splits());
+}
+
+TEST(BatchingSessionTest, RaggedInputsWithAllowedBatchSizes) {
+  std::unique_ptr<RowSumSession> row_sum_session(new RowSumSession);
+  auto row_sum_session_raw = row_sum_session.get();
+
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;
+  schedule_options.batch_timeout_micros = 0;
+  schedule_options.num_batch_threads = 1;
+  BatchingSessionOptions batching_session_options;
+  batching_session_options.allowed_batch_sizes = {1, 4};
+  batching_session_options.ragged_inputs = {{"values", "row_splits"}};
+  std::unique_ptr<Session> batching_session;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options,
+      {{"values", "row_splits"}, {"sums"}}, std::move(row_sum_session),
+      &batching_session));
+
+  const int64 ragged_values =
+      internal::GetRaggedValueCount()->GetCell("values")->value();
+  const int64 padded_ragged_values =
+      internal::GetPaddedRaggedValueCount()->GetCell("values")->value();
+  TestRowSumRequest({1.0f, 2.0f, 3.0f, 4.0f}, {0, 1, 1, 4},
+                    {1.0f, 0.0f, 9.0f}, batching_session.get());
+
+  // The batch is padded from 3 to 4 rows with an empty one.
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0, 1, 1, 4, 4}),
+                                 row_sum_session_raw->latest_row_splits());
+  EXPECT_EQ(4, internal::GetRaggedValueCount()->GetCell("values")->value() -
+                   ragged_values);
+  // Padding every row to the longest one would give 4 rows of 3 values.
+  EXPECT_EQ(12,
+            internal::GetPaddedRaggedValueCount()->GetCell("values")->value() -
+                padded_ragged_values);
+}
+
+TEST(BatchingSessionTest, RaggedInputsWithInvalidRowSplits) {
+  BasicBatchScheduler<BatchingSessionTask>::Options schedule_options;
+  schedule_options.max_batch_size = 4;
+  schedule_options.batch_timeout_micros = 0;
+  schedule_options.num_batch_threads = 1;
+  BatchingSessionOptions batching_session_options;
+  batching_session_options.ragged_inputs = {{"values", "row_splits"}};
+  std::unique_ptr<Session> batching_session;
+  TF_ASSERT_OK(CreateBasicBatchingSession(
+      schedule_options, batching_session_options,
+      {{"values", "row_splits"}, {"sums"}},
+      std::unique_ptr<Session>(new RowSumSession), &batching_session));
+  ExpectError("Row splits must end with the number of values 2, got 3",
+              {{"values", test::AsTensor<float>({1.0f, 2.0f})},
+               {"row_splits", test::AsTensor<int64>({0, 1, 3})}},
+              {"sums"}, batching_session.get());
+  ExpectError("Row splits must not decrease, got 2 and 1",
+              {{"values", test::AsTensor<float>({1.0f, 2.0f})},
+               {"row_splits", test::AsTensor<int64>({0, 2, 1, 2})}},
+              {"sums"}, batching_session.get());
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow_serving/batching/batching_util.h"
 
+#include <algorithm>
 #include <string>
 
 #include "tensorflow/core/framework/register_types.h"
@@ -202,5 +203,117 @@ Status AddPadding(const Tensor& tensor, const std::vector<int>& max_dim_sizes,
 #undef CASE
   return padding_status;
 }
+
+namespace {
+
+template <typename T>
+Status ValidateRowSplitsOfType(const Tensor& row_splits, int64 num_values) {
+  const auto splits = row_splits.vec<T>();
+  if (splits(0) != 0) {
+    return errors::InvalidArgument("Row splits must start with 0, got ",
+                                   splits(0));
+  }
+  for (int64 i = 1; i < splits.size(); ++i) {
+    if (splits(i) < splits(i - 1)) {
+      return errors::InvalidArgument("Row splits must not decrease, got ",
+                                     splits(i - 1), " and ", splits(i));
+    }
+  }
+  if (splits(splits.size() - 1) != num_values) {
+    return errors::InvalidArgument(
+        "Row splits must end with the number of values ", num_values,
+        ", got ", splits(splits.size() - 1));
+  }
+  return Status::OK();
+}
+
+template <typename T>
+Tensor MergeRowSplitsOfType(const std::vector<Tensor>& row_splits,
+                            int num_padding_rows) {
+  int64 num_rows = 0;
+  for (const Tensor& splits : row_splits) {
+    num_rows += splits.NumElements() - 1;
+  }
+  Tensor merged(DataTypeToEnum<T>::value,
+                TensorShape({num_rows + num_padding_rows + 1}));
+  auto merged_splits = merged.vec<T>();
+  int64 row = 0;
+  T offset = 0;
+  merged_splits(0) = 0;
+  for (const Tensor& splits : row_splits) {
+    const auto task_splits = splits.vec<T>();
+    for (int64 i = 1; i < task_splits.size(); ++i) {
+      merged_splits(++row) = offset + task_splits(i);
+    }
+    offset += task_splits(task_splits.size() - 1);
+  }
+  for (int i = 0; i < num_padding_rows; ++i) {
+    merged_splits(++row) = offset;
+  }
+  return merged;
+}
+
+template <typename T>
+int64 MaxRowLengthOfType(const Tensor& row_splits) {
+  const auto splits = row_splits.vec<T>();
+  int64 max_row_length = 0;
+  for (int64 i = 1; i < splits.size(); ++i) {
+    max_row_length =
+        std::max(max_row_length, static_cast<int64>(splits(i) - splits(i - 1)));
+  }
+  return max_row_length;
+}
+
+}  // namespace
+
+Status ValidateRowSplits(const Tensor& row_splits, int64 num_values) {
+  if (row_splits.dims() != 1 || row_splits.NumElements() == 0) {
+    return errors::InvalidArgument(
+        "Row splits must be a non-empty vector, got shape ",
+        row_splits.shape().DebugString());
+  }
+  switch (row_splits.dtype()) {
+    case DT_INT32:
+      return ValidateRowSplitsOfType<int32>(row_splits, num_values);
+    case DT_INT64:
+      return ValidateRowSplitsOfType<int64>(row_splits, num_values);
+    default:
+      return errors::InvalidArgument("Row splits must be int32 or int64, got ",
+                                     DataTypeString(row_splits.dtype()));
+  }
+}
+
+Status MergeRowSplits(const std::vector<Tensor>& row_splits,
+                      int num_padding_rows, Tensor* merged_row_splits) {
+  if (row_splits.empty()) {
+    return errors::InvalidArgument("No row splits to merge");
+  }
+  for (const Tensor& splits : row_splits) {
+    if (splits.dtype() != row_splits[0].dtype()) {
+      return errors::InvalidArgument(
+          "Row splits to merge must have the same type, got ",
+          DataTypeString(row_splits[0].dtype()), " and ",
+          DataTypeString(splits.dtype()));
+    }
+  }
+  switch (row_splits[0].dtype()) {
+    case DT_INT32:
+      *merged_row_splits =
+          MergeRowSplitsOfType<int32>(row_splits, num_padding_rows);
+      return Status::OK();
+    case DT_INT64:
+      *merged_row_splits =
+          MergeRowSplitsOfType<int64>(row_splits, num_padding_rows);
+      return Status::OK();
+    default:
+      return errors::InvalidArgument("Row splits must be int32 or int64, got ",
+                                     DataTypeString(row_splits[0].dtype()));
+  }
+}
+
+int64 MaxRowLength(const Tensor& row_splits) {
+  return row_splits.dtype() == DT_INT32 ? MaxRowLengthOfType<int32>(row_splits)
+                                        : MaxRowLengthOfType<int64>(row_splits);
+}
 }  // namespace serving
 }  // namespace tensorflow
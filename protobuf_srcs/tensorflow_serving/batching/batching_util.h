@@ -61,6 +61,25 @@ std::map<string, std::vector<int>> CalculateMaxDimSizes(
 
 Status AddPadding(const Tensor& tensor, const std::vector<int>& max_dim_sizes,
                   Tensor* padded_tensor);
+
+// Checks that 'row_splits' are the row splits of a RaggedTensor with one
+// ragged dimension and 'num_values' values: a DT_INT32 or DT_INT64 vector
+// that starts with 0, never decreases, and ends with 'num_values'.
+Status ValidateRowSplits(const Tensor& row_splits, int64 num_values);
+
+// Concatenates the row splits of RaggedTensors with one ragged dimension into
+// the row splits of the concatenation of their values, and appends
+// 'num_padding_rows' empty rows. All row splits must be valid and have the
+// same type.
+//
+// For example, row splits [0, 2, 5] and [0, 1] with one padding row are
+// merged into [0, 2, 5, 6, 6].
+Status MergeRowSplits(const std::vector<Tensor>& row_splits,
+                      int num_padding_rows, Tensor* merged_row_splits);
+
+// Returns the length of the longest row of valid 'row_splits', or 0 if there
+// are no rows.
+int64 MaxRowLength(const Tensor& row_splits);
 }  // namespace serving
 }  // namespace tensorflow
 #endif  // TENSORFLOW_SERVING_BATCHING_BATCHING_UTIL_H_
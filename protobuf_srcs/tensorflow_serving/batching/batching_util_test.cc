@@ -19,7 +19,9 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -92,6 +94,40 @@ TEST(BatchingUtilTest, AddPaddingTensorWithUnsupportedRank) {
                 "Only tensors with rank from 1 to 6 can be padded."),
             AddPadding(tensor, max_dim_sizes, &padded_tensor));
 }
+
+TEST(BatchingUtilTest, ValidateRowSplits) {
+  TF_EXPECT_OK(ValidateRowSplits(test::AsTensor<int64>({0, 2, 2, 5}), 5));
+  TF_EXPECT_OK(ValidateRowSplits(test::AsTensor<int32>({0}), 0));
+  EXPECT_FALSE(ValidateRowSplits(test::AsTensor<int64>({1, 2}), 2).ok());
+  EXPECT_FALSE(ValidateRowSplits(test::AsTensor<int64>({0, 3, 2}), 2).ok());
+  EXPECT_FALSE(ValidateRowSplits(test::AsTensor<int64>({0, 2}), 3).ok());
+  EXPECT_FALSE(ValidateRowSplits(Tensor(DT_INT64, {0}), 0).ok());
+  EXPECT_FALSE(ValidateRowSplits(test::AsTensor<float>({0, 1}), 1).ok());
+}
+
+TEST(BatchingUtilTest, MergeRowSplits) {
+  Tensor merged;
+  TF_ASSERT_OK(MergeRowSplits(
+      {test::AsTensor<int64>({0, 2, 5}), test::AsTensor<int64>({0}),
+       test::AsTensor<int64>({0, 1})},
+      1, &merged));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0, 2, 5, 6, 6}),
+                                 merged);
+
+  TF_ASSERT_OK(MergeRowSplits({test::AsTensor<int32>({0, 3})}, 0, &merged));
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>({0, 3}), merged);
+
+  EXPECT_FALSE(MergeRowSplits({test::AsTensor<int32>({0, 3}),
+                               test::AsTensor<int64>({0, 3})},
+                              0, &merged)
+                   .ok());
+}
+
+TEST(BatchingUtilTest, MaxRowLength) {
+  EXPECT_EQ(3, MaxRowLength(test::AsTensor<int64>({0, 2, 2, 5})));
+  EXPECT_EQ(4, MaxRowLength(test::AsTensor<int32>({0, 4})));
+  EXPECT_EQ(0, MaxRowLength(test::AsTensor<int64>({0})));
+}
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
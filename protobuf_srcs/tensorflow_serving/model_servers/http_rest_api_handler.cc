@@ -189,8 +189,8 @@ Status HttpRestApiHandler::ProcessPredictRequest(
       &request, &format));
 
   PredictResponse response;
-  TF_RETURN_IF_ERROR(
-      predictor_->Predict(run_options_, core_, request, &response));
+  TF_RETURN_IF_ERROR(predictor_->PredictMovingInputs(run_options_, core_,
+                                                     &request, &response));
   TF_RETURN_IF_ERROR(MakeJsonFromTensors(response.outputs(), format, output));
   return Status::OK();
 }
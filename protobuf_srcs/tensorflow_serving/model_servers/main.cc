@@ -63,6 +63,30 @@ int main(int argc, char** argv) {
                        "If non-empty, listen to a UNIX socket for gRPC API "
                        "on the given path. Can be either relative or absolute "
                        "path."),
+      tensorflow::Flag("grpc_predict_stream_num_threads",
+                       &options.grpc_predict_stream_num_threads,
+                       "Number of threads for the requests sent on gRPC "
+                       "PredictStream calls. If not set, will be auto set "
+                       "based on number of CPUs."),
+      tensorflow::Flag("grpc_predict_stream_request_timeout_in_ms",
+                       &options.grpc_predict_stream_request_timeout_in_ms,
+                       "Timeout for the requests sent on gRPC PredictStream "
+                       "calls that do not set their own timeout_in_ms. "
+                       "Requests never run past the deadline of their stream. "
+                       "If zero, they run until that deadline."),
+      tensorflow::Flag("enable_shared_memory", &options.enable_shared_memory,
+                       "Enables the gRPC RegisterSharedMemory API, which lets "
+                       "clients on the same host pass the tensors of their "
+                       "Predict requests through POSIX shared memory regions "
+                       "rather than in the requests. Only enable it if the "
+                       "clients are trusted: a client that shrinks a shared "
+                       "memory object after registering it crashes the "
+                       "server with SIGBUS."),
+      tensorflow::Flag("shared_memory_key_prefix",
+                       &options.shared_memory_key_prefix,
+                       "With --enable_shared_memory, the prefix of the keys "
+                       "of the POSIX shared memory objects that clients can "
+                       "register."),
       tensorflow::Flag("rest_api_port", &options.http_port,
                        "Port to listen on for HTTP/REST API. If set to zero "
                        "HTTP/REST API will not be exported. This port must be "
@@ -15,24 +15,81 @@ limitations under the License.
 
 #include "tensorflow_serving/model_servers/prediction_service_impl.h"
 
+#include <algorithm>
+#include <memory>
+
+#include "absl/strings/match.h"
 #include "grpc/grpc.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow_serving/model_servers/grpc_status_util.h"
 #include "tensorflow_serving/servables/tensorflow/classification_service.h"
 #include "tensorflow_serving/servables/tensorflow/get_model_metadata_impl.h"
 #include "tensorflow_serving/servables/tensorflow/multi_inference_helper.h"
 #include "tensorflow_serving/servables/tensorflow/regression_service.h"
+#include "tensorflow_serving/util/status_util.h"
 
 namespace tensorflow {
 namespace serving {
 
 namespace {
 
+// Maximum number of requests of one PredictStream call that are run at once.
+// The stream is not read further until one of them completes, so that a client
+// cannot queue up an unbounded number of requests.
+constexpr int kMaxInFlightStreamRequests = 64;
+
+// Returns true if 'peer', as reported by ServerContext::peer(), is a client on
+// this host.
+bool IsLocalPeer(const string& peer) {
+  return absl::StartsWith(peer, "unix:") ||
+         absl::StartsWith(peer, "ipv4:127.") ||
+         absl::StartsWith(peer, "ipv6:[::1]:") ||
+         absl::StartsWith(peer, "ipv6:[::ffff:127.");
+}
+
+// Checks that shared memory is enabled and that 'context' is from a client on
+// this host, which can map the same shared memory objects.
+Status CheckSharedMemoryAccess(const SharedMemoryManager* manager,
+                               const ::grpc::ServerContext& context) {
+  if (manager == nullptr) {
+    return errors::FailedPrecondition(
+        "Shared memory is not enabled, see --enable_shared_memory");
+  }
+  if (!IsLocalPeer(context.peer())) {
+    return errors::PermissionDenied("Shared memory is only available to "
+                                    "clients on the same host, not ",
+                                    context.peer());
+  }
+  return Status::OK();
+}
+
+// Returns true if 'request' reads or writes tensors in shared memory regions.
+bool HasSharedMemoryTensors(const PredictRequest& request) {
+  return !request.shared_memory_inputs().empty() ||
+         !request.shared_memory_outputs().empty();
+}
+
 int DeadlineToTimeoutMillis(const gpr_timespec deadline) {
   return gpr_time_to_millis(
       gpr_time_sub(gpr_convert_clock_type(deadline, GPR_CLOCK_MONOTONIC),
                    gpr_now(GPR_CLOCK_MONOTONIC)));
 }
 
+// Returns the timeout of 'stream_request', in milliseconds: its own timeout, or
+// 'default_timeout_in_ms' if it has none, capped by the time left until
+// 'deadline', the deadline of the stream. A default of zero means no default.
+int64 StreamRequestTimeoutMillis(const PredictStreamRequest& stream_request,
+                                 const int64 default_timeout_in_ms,
+                                 const gpr_timespec deadline) {
+  const int64 stream_timeout_in_ms = DeadlineToTimeoutMillis(deadline);
+  const int64 request_timeout_in_ms = stream_request.timeout_in_ms() > 0
+                                          ? stream_request.timeout_in_ms()
+                                          : default_timeout_in_ms;
+  if (request_timeout_in_ms <= 0) return stream_timeout_in_ms;
+  return std::min(request_timeout_in_ms, stream_timeout_in_ms);
+}
+
 }  // namespace
 
 ::grpc::Status PredictionServiceImpl::Predict(::grpc::ServerContext *context,
@@ -43,9 +100,19 @@ int DeadlineToTimeoutMillis(const gpr_timespec deadline) {
     run_options.set_timeout_in_ms(
         DeadlineToTimeoutMillis(context->raw_deadline()));
   }
+  if (HasSharedMemoryTensors(*request)) {
+    const Status access =
+        CheckSharedMemoryAccess(shared_memory_manager_.get(), *context);
+    if (!access.ok()) {
+      VLOG(1) << "Predict failed: " << access.error_message();
+      return ToGRPCStatus(access);
+    }
+  }
 
-  const ::grpc::Status status =
-      ToGRPCStatus(predictor_->Predict(run_options, core_, *request, response));
+  // gRPC owns a mutable request for the duration of the call and does not read
+  // it afterwards, so the string inputs are moved out of it rather than copied.
+  const ::grpc::Status status = ToGRPCStatus(predictor_->PredictMovingInputs(
+      run_options, core_, const_cast<PredictRequest *>(request), response));
 
   if (!status.ok()) {
     VLOG(1) << "Predict failed: " << status.error_message();
@@ -53,6 +120,83 @@ int DeadlineToTimeoutMillis(const gpr_timespec deadline) {
   return status;
 }
 
+::grpc::Status PredictionServiceImpl::PredictStream(
+    ::grpc::ServerContext *context,
+    ::grpc::ServerReaderWriter<PredictStreamResponse, PredictStreamRequest>
+        *stream) {
+  mutex mu;
+  condition_variable request_done;
+  int num_in_flight = 0;
+  bool write_failed = false;
+  // The peer is the same for all the requests of the stream.
+  const Status shared_memory_access =
+      CheckSharedMemoryAccess(shared_memory_manager_.get(), *context);
+
+  for (;;) {
+    {
+      mutex_lock l(mu);
+      while (num_in_flight >= kMaxInFlightStreamRequests) {
+        request_done.wait(l);
+      }
+      if (write_failed) break;
+    }
+    auto stream_request = std::make_shared<PredictStreamRequest>();
+    if (!stream->Read(stream_request.get())) break;
+
+    tensorflow::RunOptions run_options = tensorflow::RunOptions();
+    if (enforce_session_run_timeout_) {
+      run_options.set_timeout_in_ms(StreamRequestTimeoutMillis(
+          *stream_request, predict_stream_request_timeout_in_ms_,
+          context->raw_deadline()));
+    }
+    {
+      mutex_lock l(mu);
+      ++num_in_flight;
+    }
+    predict_stream_threads_->Schedule([this, stream, stream_request,
+                                       run_options, shared_memory_access, &mu,
+                                       &request_done, &num_in_flight,
+                                       &write_failed]() {
+      PredictStreamResponse stream_response;
+      stream_response.set_id(stream_request->id());
+      Status status;
+      if (HasSharedMemoryTensors(stream_request->request())) {
+        status = shared_memory_access;
+      }
+      if (status.ok()) {
+        status = predictor_->PredictMovingInputs(
+            run_options, core_, stream_request->mutable_request(),
+            stream_response.mutable_response());
+      }
+      if (!status.ok()) {
+        VLOG(1) << "PredictStream request " << stream_request->id()
+                << " failed: " << status.error_message();
+        stream_response.clear_response();
+      }
+      *stream_response.mutable_status() = ToStatusProto(status);
+
+      // Only one write may be pending on the stream at a time.
+      mutex_lock l(mu);
+      if (!write_failed && !stream->Write(stream_response)) {
+        write_failed = true;
+      }
+      --num_in_flight;
+      request_done.notify_all();
+    });
+  }
+
+  // The stream and the state above must outlive the scheduled requests.
+  mutex_lock l(mu);
+  while (num_in_flight > 0) {
+    request_done.wait(l);
+  }
+  if (write_failed) {
+    return ToGRPCStatus(
+        errors::Unavailable("Failed to write a PredictStream response"));
+  }
+  return ::grpc::Status::OK;
+}
+
 ::grpc::Status PredictionServiceImpl::GetModelMetadata(
     ::grpc::ServerContext *context, const GetModelMetadataRequest *request,
     GetModelMetadataResponse *response) {
@@ -69,6 +213,37 @@ int DeadlineToTimeoutMillis(const gpr_timespec deadline) {
   return status;
 }
 
+::grpc::Status PredictionServiceImpl::RegisterSharedMemory(
+    ::grpc::ServerContext *context, const RegisterSharedMemoryRequest *request,
+    RegisterSharedMemoryResponse *response) {
+  Status status =
+      CheckSharedMemoryAccess(shared_memory_manager_.get(), *context);
+  if (status.ok()) {
+    status = shared_memory_manager_->Register(request->name(), request->key(),
+                                              request->offset(),
+                                              request->byte_size());
+  }
+  if (!status.ok()) {
+    VLOG(1) << "RegisterSharedMemory failed: " << status.error_message();
+  }
+  return ToGRPCStatus(status);
+}
+
+::grpc::Status PredictionServiceImpl::UnregisterSharedMemory(
+    ::grpc::ServerContext *context,
+    const UnregisterSharedMemoryRequest *request,
+    UnregisterSharedMemoryResponse *response) {
+  Status status =
+      CheckSharedMemoryAccess(shared_memory_manager_.get(), *context);
+  if (status.ok()) {
+    status = shared_memory_manager_->Unregister(request->name());
+  }
+  if (!status.ok()) {
+    VLOG(1) << "UnregisterSharedMemory failed: " << status.error_message();
+  }
+  return ToGRPCStatus(status);
+}
+
 ::grpc::Status PredictionServiceImpl::Classify(
     ::grpc::ServerContext *context, const ClassificationRequest *request,
     ClassificationResponse *response) {
@@ -16,9 +16,16 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_MODEL_SERVERS_PREDICTION_SERVICE_IMPL_H_
 #define TENSORFLOW_SERVING_MODEL_SERVERS_PREDICTION_SERVICE_IMPL_H_
 
+#include <algorithm>
+#include <memory>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow_serving/apis/prediction_service.grpc.pb.h"
 #include "tensorflow_serving/model_servers/server_core.h"
 #include "tensorflow_serving/servables/tensorflow/predict_impl.h"
+#include "tensorflow_serving/servables/tensorflow/shared_memory_manager.h"
 
 namespace tensorflow {
 namespace serving {
@@ -30,22 +37,68 @@ class PredictionServiceImpl final : public PredictionService::Service {
     ServerCore* server_core;
     bool use_saved_model;
     bool enforce_session_run_timeout;
+    // Number of threads running the requests of all the PredictStream calls.
+    int predict_stream_num_threads = 4 * port::NumSchedulableCPUs();
+    // Timeout, in milliseconds, of the PredictStream requests that do not set
+    // their own. Zero means that they run until the deadline of the stream.
+    int64 predict_stream_request_timeout_in_ms = 0;
+    // Whether clients on the same host can register shared memory regions
+    // and pass the tensors of their Predict requests through them.
+    bool enable_shared_memory = false;
+    // The prefix of the keys of the shared memory objects that clients can
+    // register.
+    string shared_memory_key_prefix;
   };
 
   explicit PredictionServiceImpl(const Options& options)
       : core_(options.server_core),
-        predictor_(new TensorflowPredictor(options.use_saved_model)),
+        shared_memory_manager_(options.enable_shared_memory
+                                   ? new SharedMemoryManager(
+                                         options.shared_memory_key_prefix)
+                                   : nullptr),
+        predictor_(new TensorflowPredictor(options.use_saved_model,
+                                           shared_memory_manager_.get())),
         use_saved_model_(options.use_saved_model),
-        enforce_session_run_timeout_(options.enforce_session_run_timeout) {}
+        enforce_session_run_timeout_(options.enforce_session_run_timeout),
+        predict_stream_request_timeout_in_ms_(
+            options.predict_stream_request_timeout_in_ms),
+        predict_stream_threads_(new thread::ThreadPool(
+            Env::Default(), "predict_stream",
+            std::max(1, options.predict_stream_num_threads))) {}
 
   ::grpc::Status Predict(::grpc::ServerContext* context,
                          const PredictRequest* request,
                          PredictResponse* response) override;
 
+  // Runs the requests read from the stream concurrently, so that they are
+  // batched together when batching is enabled, and writes their responses as
+  // they complete, which may be out of order. A failed request is reported in
+  // its response and does not end the stream. With
+  // Options::enforce_session_run_timeout, each request times out after its
+  // timeout_in_ms, or Options::predict_stream_request_timeout_in_ms if it has
+  // none, and never runs past the deadline of the stream.
+  ::grpc::Status PredictStream(
+      ::grpc::ServerContext* context,
+      ::grpc::ServerReaderWriter<PredictStreamResponse, PredictStreamRequest>*
+          stream) override;
+
   ::grpc::Status GetModelMetadata(::grpc::ServerContext* context,
                                   const GetModelMetadataRequest* request,
                                   GetModelMetadataResponse* response) override;
 
+  // Only clients on the same host, connected through a UNIX socket or the
+  // loopback interface, can register and unregister shared memory regions, and
+  // send Predict requests with tensors in them.
+  ::grpc::Status RegisterSharedMemory(
+      ::grpc::ServerContext* context,
+      const RegisterSharedMemoryRequest* request,
+      RegisterSharedMemoryResponse* response) override;
+
+  ::grpc::Status UnregisterSharedMemory(
+      ::grpc::ServerContext* context,
+      const UnregisterSharedMemoryRequest* request,
+      UnregisterSharedMemoryResponse* response) override;
+
   ::grpc::Status Classify(::grpc::ServerContext* context,
                           const ClassificationRequest* request,
                           ClassificationResponse* response) override;
@@ -60,9 +113,13 @@ class PredictionServiceImpl final : public PredictionService::Service {
 
  private:
   ServerCore* core_;
+  // Null unless shared memory is enabled. Outlives 'predictor_'.
+  std::unique_ptr<SharedMemoryManager> shared_memory_manager_;
   std::unique_ptr<TensorflowPredictor> predictor_;
   const bool use_saved_model_;
   const bool enforce_session_run_timeout_;
+  const int64 predict_stream_request_timeout_in_ms_;
+  std::unique_ptr<thread::ThreadPool> predict_stream_threads_;
 };
 
 }  // namespace serving
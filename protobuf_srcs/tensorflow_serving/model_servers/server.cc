@@ -318,6 +318,14 @@ Status Server::BuildAndStart(const Options& server_options) {
   predict_server_options.use_saved_model = use_saved_model;
   predict_server_options.enforce_session_run_timeout =
       server_options.enforce_session_run_timeout;
+  predict_server_options.predict_stream_num_threads =
+      server_options.grpc_predict_stream_num_threads;
+  predict_server_options.predict_stream_request_timeout_in_ms =
+      server_options.grpc_predict_stream_request_timeout_in_ms;
+  predict_server_options.enable_shared_memory =
+      server_options.enable_shared_memory;
+  predict_server_options.shared_memory_key_prefix =
+      server_options.shared_memory_key_prefix;
   prediction_service_ =
       absl::make_unique<PredictionServiceImpl>(predict_server_options);
 
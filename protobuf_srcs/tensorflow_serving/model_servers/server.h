@@ -42,6 +42,21 @@ class Server {
     tensorflow::int32 grpc_port = 8500;
     tensorflow::string grpc_channel_arguments;
     tensorflow::string grpc_socket_path;
+    // Number of threads serving the requests of PredictStream calls, shared by
+    // all the streams.
+    tensorflow::int32 grpc_predict_stream_num_threads =
+        4.0 * port::NumSchedulableCPUs();
+    // Timeout, in milliseconds, of the requests sent on PredictStream calls
+    // that do not set their own, rather than the whole remaining deadline of
+    // the stream. Defaults to 60 seconds.
+    tensorflow::int64 grpc_predict_stream_request_timeout_in_ms = 60000;
+    // Lets clients on the same host pass tensors through shared memory. A
+    // client that shrinks a shared memory object after registering it makes
+    // the server crash with SIGBUS when it accesses the missing pages.
+    bool enable_shared_memory = false;
+    // Clients can only register the shared memory objects whose keys start
+    // with this prefix.
+    tensorflow::string shared_memory_key_prefix = "/min_tfs_client_";
 
     //
     // HTTP Server options.
@@ -20,7 +20,10 @@ from __future__ import division
 from __future__ import print_function
 
 import json
+import mmap
 import os
+import socket
+import struct
 import subprocess
 import time
 
@@ -37,8 +40,10 @@ from tensorflow_serving.apis import classification_pb2
 from tensorflow_serving.apis import get_model_status_pb2
 from tensorflow_serving.apis import inference_pb2
 from tensorflow_serving.apis import model_service_pb2_grpc
+from tensorflow_serving.apis import predict_pb2
 from tensorflow_serving.apis import prediction_service_pb2_grpc
 from tensorflow_serving.apis import regression_pb2
+from tensorflow_serving.apis import shared_memory_pb2
 from tensorflow_serving.model_servers.test_util import tensorflow_model_server_test_base
 
 FLAGS = flags.FLAGS
@@ -47,6 +52,20 @@ RPC_TIMEOUT = 5.0
 GRPC_SOCKET_PATH = '/tmp/tf-serving.sock'
 
 
+def _NonLoopbackAddress():
+  """Returns an IPv4 address of this host off the loopback interface."""
+  sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  try:
+    # Connecting a UDP socket sends nothing, but picks the outgoing address.
+    sock.connect(('10.255.255.255', 1))
+    address = sock.getsockname()[0]
+  except socket.error:
+    return None
+  finally:
+    sock.close()
+  return None if address.startswith('127.') else address
+
+
 class TensorflowModelServerTest(
     tensorflow_model_server_test_base.TensorflowModelServerTestBase):
   """This class defines integration test cases for tensorflow_model_server."""
@@ -200,6 +219,121 @@ class TensorflowModelServerTest(
     """Test PredictionService.Predict implementation with SavedModel."""
     self._TestPredict(self._GetSavedModelBundlePath())
 
+  def testPredictStream(self):
+    """Test PredictionService.PredictStream implementation."""
+    model_path = self._GetSavedModelBundlePath()
+    model_server_address = TensorflowModelServerTest.RunServer(
+        'default', model_path)[1]
+
+    print('Sending PredictStream requests...')
+    requests = []
+    for i in range(8):
+      stream_request = predict_pb2.PredictStreamRequest(id=i)
+      stream_request.request.model_spec.name = 'default'
+      stream_request.request.inputs['x'].CopyFrom(
+          tf.make_tensor_proto([float(i)], shape=[1]))
+      requests.append(stream_request)
+    # A request can set its own timeout, within the deadline of the stream.
+    requests[0].timeout_in_ms = int(RPC_TIMEOUT * 1000)
+    # The last request fails, without failing the others.
+    requests[-1].request.model_spec.name = 'unknown'
+
+    channel = grpc.insecure_channel(model_server_address)
+    stub = prediction_service_pb2_grpc.PredictionServiceStub(channel)
+    responses = {
+        response.id: response
+        for response in stub.PredictStream(iter(requests), RPC_TIMEOUT)
+    }
+    self.assertEqual(set(range(8)), set(responses))
+    for i in range(7):
+      self.assertEqual(0, responses[i].status.error_code)
+      self.assertEqual(i * 0.5 + 2,
+                       responses[i].response.outputs['y'].float_val[0])
+    self.assertNotEqual(0, responses[7].status.error_code)
+
+  def testPredictWithSharedMemory(self):
+    """Test Predict with tensors in a registered shared memory region."""
+    model_path = self._GetSavedModelBundlePath()
+    model_server_address = TensorflowModelServerTest.RunServer(
+        'default', model_path, enable_shared_memory=True)[1]
+
+    key = '/tensorflow_model_server_test_%d' % os.getpid()
+    with open(os.path.join('/dev/shm', key[1:]), 'w+b') as f:
+      f.truncate(4096)
+      region = mmap.mmap(f.fileno(), 4096)
+    self.addCleanup(os.unlink, os.path.join('/dev/shm', key[1:]))
+    region[0:12] = struct.pack('3f', 1.0, 2.0, 3.0)
+
+    channel = grpc.insecure_channel(model_server_address)
+    stub = prediction_service_pb2_grpc.PredictionServiceStub(channel)
+    print('Sending RegisterSharedMemory request...')
+    with self.assertRaises(grpc.RpcError) as ectxt:
+      stub.RegisterSharedMemory(
+          shared_memory_pb2.RegisterSharedMemoryRequest(
+              name='region', key='/other_key', offset=0, byte_size=4096),
+          RPC_TIMEOUT)
+    self.assertIs(grpc.StatusCode.PERMISSION_DENIED, ectxt.exception.code())
+    stub.RegisterSharedMemory(
+        shared_memory_pb2.RegisterSharedMemoryRequest(
+            name='region', key=key, offset=0, byte_size=4096), RPC_TIMEOUT)
+
+    request = predict_pb2.PredictRequest()
+    request.model_spec.name = 'default'
+    shared_input = request.shared_memory_inputs['x']
+    shared_input.region = 'region'
+    shared_input.byte_size = 12
+    shared_input.dtype = tf.float32.as_datatype_enum
+    shared_input.tensor_shape.dim.add(size=3)
+    shared_output = request.shared_memory_outputs['y']
+    shared_output.region = 'region'
+    shared_output.offset = 64
+    shared_output.byte_size = 64
+    print('Sending Predict request with shared memory tensors...')
+    response = stub.Predict(request, RPC_TIMEOUT)
+    self.assertFalse(response.outputs)
+    self.assertEqual(12, response.shared_memory_outputs['y'].byte_size)
+    self.assertEqual((2.5, 3.0, 3.5), struct.unpack('3f', region[64:76]))
+
+    stub.UnregisterSharedMemory(
+        shared_memory_pb2.UnregisterSharedMemoryRequest(name='region'),
+        RPC_TIMEOUT)
+    with self.assertRaises(grpc.RpcError) as ectxt:
+      stub.Predict(request, RPC_TIMEOUT)
+    self.assertIs(grpc.StatusCode.NOT_FOUND, ectxt.exception.code())
+
+  def testPredictWithSharedMemoryFromRemotePeer(self):
+    """Test that clients on other hosts cannot use shared memory regions."""
+    address = _NonLoopbackAddress()
+    if address is None:
+      self.skipTest('This host has no address off the loopback interface')
+    model_path = self._GetSavedModelBundlePath()
+    model_server_address = TensorflowModelServerTest.RunServer(
+        'default', model_path, enable_shared_memory=True)[1]
+    port = model_server_address.split(':')[1]
+
+    request = predict_pb2.PredictRequest()
+    request.model_spec.name = 'default'
+    shared_input = request.shared_memory_inputs['x']
+    shared_input.region = 'region'
+    shared_input.byte_size = 4
+    shared_input.dtype = tf.float32.as_datatype_enum
+    shared_input.tensor_shape.dim.add(size=1)
+
+    channel = grpc.insecure_channel('%s:%s' % (address, port))
+    stub = prediction_service_pb2_grpc.PredictionServiceStub(channel)
+    print('Sending Predict request with shared memory tensors...')
+    with self.assertRaises(grpc.RpcError) as ectxt:
+      stub.Predict(request, RPC_TIMEOUT)
+    self.assertIs(grpc.StatusCode.PERMISSION_DENIED, ectxt.exception.code())
+
+    print('Sending PredictStream request with shared memory tensors...')
+    stream_request = predict_pb2.PredictStreamRequest(id=0)
+    stream_request.request.CopyFrom(request)
+    responses = list(stub.PredictStream(iter([stream_request]), RPC_TIMEOUT))
+    self.assertEqual(1, len(responses))
+    self.assertEqual(grpc.StatusCode.PERMISSION_DENIED.value[0],
+                     responses[0].status.error_code)
+
   def _TestBadModel(self):
     """Helper method to test against a bad model export."""
     # Both SessionBundle and SavedModel use the same bad model path, but in the
@@ -154,7 +154,8 @@ class TensorflowModelServerTestBase(tf.test.TestCase):
                 grpc_channel_arguments='',
                 wait_for_server_ready=True,
                 pipe=None,
-                model_config_file_poll_period=None):
+                model_config_file_poll_period=None,
+                enable_shared_memory=False):
     """Run tensorflow_model_server using test config.
 
     A unique instance of server is started for each set of arguments.
@@ -173,6 +174,7 @@ class TensorflowModelServerTestBase(tf.test.TestCase):
       pipe: subpipe.PIPE object to read stderr from server.
       model_config_file_poll_period: Period for polling the
       filesystem to discover new model configs.
+      enable_shared_memory: Enable the gRPC shared memory API.
 
     Returns:
       3-tuple (<Popen object>, <grpc host:port>, <rest host:port>).
@@ -219,6 +221,9 @@ class TensorflowModelServerTestBase(tf.test.TestCase):
       command += ' --batching_parameters_file=' + batching_parameters_file
     if grpc_channel_arguments:
       command += ' --grpc_channel_arguments=' + grpc_channel_arguments
+    if enable_shared_memory:
+      command += ' --enable_shared_memory'
+      command += ' --shared_memory_key_prefix=/tensorflow_model_server_test_'
     print(command)
     proc = subprocess.Popen(shlex.split(command), stderr=pipe)
     atexit.register(proc.kill)
@@ -180,6 +180,11 @@ Status WrapSessionForBatching(const BatchingParameters& batching_config,
   batching_session_options.pad_variable_length_inputs =
       batching_config.pad_variable_length_inputs();
 
+  if (batching_config.batch_ragged_inputs()) {
+    batching_session_options.ragged_inputs =
+        RaggedInputsFromSignatureDefs(signatures);
+  }
+
   auto create_queue = [batch_scheduler, queue_options](
       std::function<void(std::unique_ptr<Batch<BatchingSessionTask>>)>
           process_batch_callback,
@@ -192,7 +197,8 @@ Status WrapSessionForBatching(const BatchingParameters& batching_config,
       signatures_with_scheduler_creators;
   for (const SignatureDef& signature : signatures) {
     const TensorSignature tensor_signature =
-        TensorSignatureFromSignatureDef(signature);
+        TensorSignatureFromSignatureDef(signature,
+                                        batching_config.batch_ragged_inputs());
     signatures_with_scheduler_creators.push_back(
         {tensor_signature, create_queue});
   }
@@ -56,6 +56,15 @@ Status SessionBundlePredict(
   }
   GenericSignature output_signature = signature.generic_signature();
 
+  if (!request.shared_memory_inputs().empty() ||
+      !request.shared_memory_outputs().empty()) {
+    return errors::Unimplemented(
+        "Shared memory inputs and outputs require a SavedModel");
+  }
+  if (request.has_output_encoding()) {
+    return errors::Unimplemented("Output encodings require a SavedModel");
+  }
+
   // Verify and prepare input.
   if (request.inputs().size() != input_signature.map().size()) {
     return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
@@ -178,5 +187,24 @@ Status TensorflowPredictor::PredictWithModelSpec(const RunOptions& run_options,
       bundle->session.get());
 }
 
+Status TensorflowPredictor::PredictMovingInputs(const RunOptions& run_options,
+                                                ServerCore* core,
+                                                PredictRequest* request,
+                                                PredictResponse* response) {
+  if (!use_saved_model_) {
+    return Predict(run_options, core, *request, response);
+  }
+  if (!request->has_model_spec()) {
+    return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
+                              "Missing ModelSpec");
+  }
+  ServableHandle<SavedModelBundle> bundle;
+  TF_RETURN_IF_ERROR(core->GetServableHandle(request->model_spec(), &bundle));
+  return internal::RunPredictMovingInputs(
+      run_options, bundle->meta_graph_def, bundle.id().version,
+      core->predict_response_tensor_serialization_option(),
+      shared_memory_manager_, bundle->session.get(), request, response);
+}
+
 }  // namespace serving
 }  // namespace tensorflow
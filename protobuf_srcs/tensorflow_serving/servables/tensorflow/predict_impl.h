@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow_serving/apis/predict.pb.h"
 #include "tensorflow_serving/model_servers/server_core.h"
+#include "tensorflow_serving/servables/tensorflow/shared_memory_manager.h"
 
 namespace tensorflow {
 namespace serving {
@@ -29,7 +30,16 @@ namespace serving {
 class TensorflowPredictor {
  public:
   explicit TensorflowPredictor(bool use_saved_model)
-      : use_saved_model_(use_saved_model) {}
+      : TensorflowPredictor(use_saved_model, nullptr) {}
+
+  // The shared memory inputs and outputs of the requests passed to
+  // PredictMovingInputs() are in the regions of 'shared_memory_manager',
+  // which must outlive the predictor. Requests that have some fail if it is
+  // null.
+  TensorflowPredictor(bool use_saved_model,
+                      const SharedMemoryManager* shared_memory_manager)
+      : use_saved_model_(use_saved_model),
+        shared_memory_manager_(shared_memory_manager) {}
 
   Status Predict(const RunOptions& run_options, ServerCore* core,
                  const PredictRequest& request, PredictResponse* response);
@@ -41,11 +51,20 @@ class TensorflowPredictor {
                               const PredictRequest& request,
                               PredictResponse* response);
 
+  // Like Predict(), but moves the string values of the inputs out of 'request'
+  // instead of copying them, for callers that own the request and no longer
+  // need its inputs.
+  Status PredictMovingInputs(const RunOptions& run_options, ServerCore* core,
+                             PredictRequest* request,
+                             PredictResponse* response);
+
  private:
   // If use_saved_model_ is true, a SavedModelBundle handle will be retrieved
   // from the ServerCore and the new SavedModel SignatureDef format will be
   // used.
   bool use_saved_model_;
+
+  const SharedMemoryManager* const shared_memory_manager_;
 };
 
 }  // namespace serving
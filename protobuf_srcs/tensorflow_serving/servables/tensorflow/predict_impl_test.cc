@@ -307,6 +307,31 @@ TEST_P(PredictImplTest, PredictionSuccess) {
   EXPECT_THAT(response, test_util::EqualsProto(expected_response));
 }
 
+// Output encodings are only supported with SavedModel.
+TEST_P(PredictImplTest, PredictionWithOutputEncoding) {
+  PredictRequest request;
+  PredictResponse response;
+
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+  request.mutable_output_encoding()->set_precision(OutputEncoding::FLOAT16);
+
+  TensorflowPredictor predictor(GetParam());
+  const Status status =
+      predictor.Predict(GetRunOptions(), GetServerCore(), request, &response);
+  if (GetParam()) {
+    TF_EXPECT_OK(status);
+  } else {
+    EXPECT_EQ(tensorflow::error::UNIMPLEMENTED, status.code());
+  }
+}
+
 // Test querying a model with a named regression signature (not default). This
 // will work with SavedModel but not supported in the legacy SessionBundle.
 TEST_P(PredictImplTest, PredictionWithNamedRegressionSignature) {
@@ -15,16 +15,21 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/predict_util.h"
 
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <zlib.h>
+
 #include "absl/strings/str_join.h"
 #include "absl/strings/substitute.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/protobuf/named_tensor.pb.h"
 #include "tensorflow_serving/servables/tensorflow/util.h"
@@ -64,8 +69,14 @@ std::set<string> SetDifference(std::set<string> set_a, std::set<string> set_b) {
 
 Status VerifyRequestInputsSize(const SignatureDef& signature,
                                const PredictRequest& request) {
-  if (request.inputs().size() != signature.inputs().size()) {
-    const std::set<string> request_inputs = GetMapKeys(request.inputs());
+  const int num_request_inputs =
+      request.inputs().size() + request.shared_memory_inputs().size();
+  if (num_request_inputs != signature.inputs().size()) {
+    std::set<string> request_inputs = GetMapKeys(request.inputs());
+    const std::set<string> shared_memory_inputs =
+        GetMapKeys(request.shared_memory_inputs());
+    request_inputs.insert(shared_memory_inputs.begin(),
+                          shared_memory_inputs.end());
     const std::set<string> signature_inputs = GetMapKeys(signature.inputs());
     const std::set<string> sent_extra =
         SetDifference(request_inputs, signature_inputs);
@@ -74,7 +85,7 @@ Status VerifyRequestInputsSize(const SignatureDef& signature,
     return tensorflow::Status(
         tensorflow::error::INVALID_ARGUMENT,
         absl::StrCat(
-            "input size does not match signature: ", request.inputs().size(),
+            "input size does not match signature: ", num_request_inputs,
             "!=", signature.inputs().size(), " len({",
             absl::StrJoin(request_inputs, ","), "}) != len({",
             absl::StrJoin(signature_inputs, ","), "}). Sent extra: {",
@@ -84,32 +95,79 @@ Status VerifyRequestInputsSize(const SignatureDef& signature,
   return Status::OK();
 }
 
+// Looks up the name of the tensor to feed for the input 'alias' of
+// 'signature'. Composite inputs, such as RaggedTensors, have no name of their
+// own, and can only be fed as their components by calling Session::Run()
+// directly.
+Status GetInputTensorName(const SignatureDef& signature, const string& alias,
+                          string* tensor_name) {
+  auto iter = signature.inputs().find(alias);
+  if (iter == signature.inputs().end()) {
+    return tensorflow::Status(
+        tensorflow::error::INVALID_ARGUMENT,
+        strings::StrCat("input tensor alias not found in signature: ", alias,
+                        ". Inputs expected to be in the set {",
+                        absl::StrJoin(GetMapKeys(signature.inputs()), ","),
+                        "}."));
+  }
+  if (iter->second.has_composite_tensor()) {
+    return errors::Unimplemented(
+        "Predict does not support composite tensor inputs: ", alias);
+  }
+  *tensor_name = iter->second.name();
+  return Status::OK();
+}
+
 // Validate a SignatureDef to make sure it's compatible with prediction, and
-// if so, populate the input and output tensor names.
+// if so, populate the input and output tensor names. If 'mutable_request' is
+// set, it is 'request', and the string inputs are moved out of it rather than
+// copied. The shared memory inputs are read from 'shared_memory_manager'.
 Status PreProcessPrediction(const SignatureDef& signature,
                             const PredictRequest& request,
+                            PredictRequest* mutable_request,
+                            const SharedMemoryManager* shared_memory_manager,
                             std::vector<std::pair<string, Tensor>>* inputs,
                             std::vector<string>* output_tensor_names,
                             std::vector<string>* output_tensor_aliases) {
   TF_RETURN_IF_ERROR(VerifySignature(signature));
   TF_RETURN_IF_ERROR(VerifyRequestInputsSize(signature, request));
-  for (auto& input : request.inputs()) {
+  for (auto& input : request.shared_memory_inputs()) {
     const string& alias = input.first;
-    auto iter = signature.inputs().find(alias);
-    if (iter == signature.inputs().end()) {
-      return tensorflow::Status(
-          tensorflow::error::INVALID_ARGUMENT,
-          strings::StrCat("input tensor alias not found in signature: ", alias,
-                          ". Inputs expected to be in the set {",
-                          absl::StrJoin(GetMapKeys(signature.inputs()), ","),
-                          "}."));
+    string tensor_name;
+    TF_RETURN_IF_ERROR(GetInputTensorName(signature, alias, &tensor_name));
+    if (request.inputs().count(alias) > 0) {
+      return errors::InvalidArgument(
+          "input tensor alias is both in inputs and shared_memory_inputs: ",
+          alias);
+    }
+    Tensor tensor;
+    const Status status =
+        shared_memory_manager->ReadTensor(input.second, &tensor);
+    if (!status.ok()) {
+      return Status(status.code(),
+                    strings::StrCat("shared memory input ", alias, ": ",
+                                    status.error_message()));
     }
+    inputs->emplace_back(std::move(tensor_name), std::move(tensor));
+  }
+  for (auto& input : request.inputs()) {
+    const string& alias = input.first;
+    string tensor_name;
+    TF_RETURN_IF_ERROR(GetInputTensorName(signature, alias, &tensor_name));
     Tensor tensor;
-    if (!tensor.FromProto(input.second)) {
+    bool parsed;
+    if (mutable_request != nullptr) {
+      parsed = TensorFromProtoMovingStrings(
+          &mutable_request->mutable_inputs()->at(alias), &tensor);
+    } else {
+      parsed = tensor.FromProto(input.second);
+      RecordCopiedStringInputBytes(input.second);
+    }
+    if (!parsed) {
       return tensorflow::Status(tensorflow::error::INVALID_ARGUMENT,
                                 "tensor parsing error: " + alias);
     }
-    inputs->emplace_back(std::make_pair(iter->second.name(), tensor));
+    inputs->emplace_back(std::move(tensor_name), tensor);
   }
 
   // Prepare run target.
@@ -142,48 +200,135 @@ Status PreProcessPrediction(const SignatureDef& signature,
       output_tensor_aliases->emplace_back(iter.first);
     }
   }
+  for (auto& output : request.shared_memory_outputs()) {
+    if (std::find(output_tensor_aliases->begin(), output_tensor_aliases->end(),
+                  output.first) == output_tensor_aliases->end()) {
+      return errors::InvalidArgument(
+          "shared memory output alias is not an output of the request: ",
+          output.first);
+    }
+  }
+  return Status::OK();
+}
+
+// Quantizes 'values' to 'quantized', such that each value is about its
+// quantized value times the returned scale. NaNs are quantized to 0.
+float QuantizeToInt8(TTypes<float>::ConstFlat values,
+                     TTypes<int8>::Flat quantized) {
+  float max_abs = 0;
+  for (int64 i = 0; i < values.size(); ++i) {
+    if (std::isfinite(values(i))) {
+      max_abs = std::max(max_abs, std::abs(values(i)));
+    }
+  }
+  const float scale = max_abs > 0 ? max_abs / 127 : 1;
+  for (int64 i = 0; i < values.size(); ++i) {
+    const float value = std::isnan(values(i)) ? 0 : values(i) / scale;
+    quantized(i) = static_cast<int8>(
+        std::round(std::min(127.0f, std::max(-127.0f, value))));
+  }
+  return scale;
+}
+
+// Shuffles the bytes of the 'element_size' byte values in 'content', so that
+// the i-th bytes of all the values are next to each other, and compresses
+// them with zlib. Leaves 'content' as is if that does not make it smaller.
+Status ShuffleAndCompress(int element_size, string* content,
+                          EncodedTensorInfo* info) {
+  const size_t size = content->size();
+  const size_t num_values = size / element_size;
+  string shuffled(size, '\0');
+  for (int b = 0; b < element_size; ++b) {
+    for (size_t i = 0; i < num_values; ++i) {
+      shuffled[b * num_values + i] = (*content)[i * element_size + b];
+    }
+  }
+  uLongf compressed_size = compressBound(size);
+  string compressed(compressed_size, '\0');
+  const int result = compress2(reinterpret_cast<Bytef*>(&compressed[0]),
+                               &compressed_size,
+                               reinterpret_cast<const Bytef*>(shuffled.data()),
+                               size, Z_BEST_SPEED);
+  if (result != Z_OK) {
+    return errors::Internal("Failed to compress output, zlib error: ", result);
+  }
+  if (compressed_size >= size) return Status::OK();
+  compressed.resize(compressed_size);
+  content->swap(compressed);
+  info->set_compression(OutputEncoding::SHUFFLE_ZLIB);
   return Status::OK();
 }
 
 // Validate results and populate a PredictResponse.
-// Tensors are serialized as specified.
+// Tensors are serialized as specified, unless they are encoded with
+// 'encoding', or written to the regions of 'shared_memory_manager' when they
+// are in 'shared_memory_outputs'.
 Status PostProcessPredictionResult(
     const std::vector<string>& output_tensor_aliases,
     const std::vector<Tensor>& output_tensors,
     const internal::PredictResponseTensorSerializationOption option,
+    const OutputEncoding& encoding,
+    const google::protobuf::Map<string, SharedMemoryTensor>&
+        shared_memory_outputs,
+    const SharedMemoryManager* shared_memory_manager,
     PredictResponse* response) {
   // Validate and return output.
   if (output_tensors.size() != output_tensor_aliases.size()) {
     return tensorflow::Status(tensorflow::error::UNKNOWN,
                               "Predict internal error");
   }
-  switch (option) {
-    case internal::PredictResponseTensorSerializationOption::kAsProtoField: {
-      for (int i = 0; i < output_tensors.size(); i++) {
-        output_tensors[i].AsProtoField(
-            &((*response->mutable_outputs())[output_tensor_aliases[i]]));
-      }
-    } break;
-    case internal::PredictResponseTensorSerializationOption::kAsProtoContent: {
-      for (int i = 0; i < output_tensors.size(); i++) {
-        output_tensors[i].AsProtoTensorContent(
-            &((*response->mutable_outputs())[output_tensor_aliases[i]]));
+  for (int i = 0; i < output_tensors.size(); i++) {
+    const string& alias = output_tensor_aliases[i];
+    auto shared_memory_output = shared_memory_outputs.find(alias);
+    if (shared_memory_output != shared_memory_outputs.end()) {
+      SharedMemoryTensor* shared_tensor =
+          &(*response->mutable_shared_memory_outputs())[alias];
+      *shared_tensor = shared_memory_output->second;
+      const Status status =
+          shared_memory_manager->WriteTensor(output_tensors[i], shared_tensor);
+      if (!status.ok()) {
+        return Status(status.code(),
+                      strings::StrCat("shared memory output ", alias, ": ",
+                                      status.error_message()));
       }
-    } break;
+      continue;
+    }
+    TensorProto* tensor_proto = &(*response->mutable_outputs())[alias];
+    if (internal::OutputEncodingApplies(encoding, output_tensors[i].dtype())) {
+      TF_RETURN_IF_ERROR(internal::EncodeOutputTensor(
+          encoding, output_tensors[i], tensor_proto,
+          &(*response->mutable_output_encodings())[alias]));
+      continue;
+    }
+    switch (option) {
+      case internal::PredictResponseTensorSerializationOption::kAsProtoField:
+        output_tensors[i].AsProtoField(tensor_proto);
+        break;
+      case internal::PredictResponseTensorSerializationOption::kAsProtoContent:
+        output_tensors[i].AsProtoTensorContent(tensor_proto);
+        break;
+    }
   }
 
   return Status::OK();
 }
 
-}  // namespace
-
-namespace internal {
-Status RunPredict(
+// Implements RunPredict(), moving the string inputs out of 'mutable_request'
+// if it is set, in which case it is 'request'.
+Status RunPredictImpl(
     const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
     const optional<int64>& servable_version,
     const internal::PredictResponseTensorSerializationOption option,
-    Session* session, const PredictRequest& request,
+    const SharedMemoryManager* shared_memory_manager, Session* session,
+    const PredictRequest& request, PredictRequest* mutable_request,
     PredictResponse* response) {
+  if (shared_memory_manager == nullptr &&
+      (!request.shared_memory_inputs().empty() ||
+       !request.shared_memory_outputs().empty())) {
+    return errors::FailedPrecondition(
+        "Shared memory inputs and outputs are not enabled");
+  }
+
   // Validate signatures.
   const string signature_name = request.model_spec().signature_name().empty()
                                     ? kDefaultServingSignatureDefKey
@@ -201,17 +346,103 @@ Status RunPredict(
   std::vector<std::pair<string, Tensor>> input_tensors;
   std::vector<string> output_tensor_names;
   std::vector<string> output_tensor_aliases;
-  TF_RETURN_IF_ERROR(PreProcessPrediction(signature, request, &input_tensors,
-                                          &output_tensor_names,
-                                          &output_tensor_aliases));
+  TF_RETURN_IF_ERROR(PreProcessPrediction(
+      signature, request, mutable_request, shared_memory_manager,
+      &input_tensors, &output_tensor_names, &output_tensor_aliases));
   std::vector<Tensor> outputs;
   RunMetadata run_metadata;
   TF_RETURN_IF_ERROR(session->Run(run_options, input_tensors,
                                   output_tensor_names, {}, &outputs,
                                   &run_metadata));
 
-  return PostProcessPredictionResult(output_tensor_aliases, outputs, option,
-                                     response);
+  return PostProcessPredictionResult(
+      output_tensor_aliases, outputs, option, request.output_encoding(),
+      request.shared_memory_outputs(), shared_memory_manager, response);
+}
+
+}  // namespace
+
+namespace internal {
+bool OutputEncodingApplies(const OutputEncoding& encoding, DataType dtype) {
+  if (encoding.precision() != OutputEncoding::FULL_PRECISION &&
+      dtype == DT_FLOAT) {
+    return true;
+  }
+  return encoding.compression() != OutputEncoding::NO_COMPRESSION &&
+         DataTypeCanUseMemcpy(dtype);
+}
+
+Status EncodeOutputTensor(const OutputEncoding& encoding, const Tensor& tensor,
+                          TensorProto* tensor_proto, EncodedTensorInfo* info) {
+  info->Clear();
+  info->set_original_dtype(tensor.dtype());
+  Tensor encoded = tensor;
+  if (tensor.dtype() == DT_FLOAT) {
+    const auto values = tensor.flat<float>();
+    switch (encoding.precision()) {
+      case OutputEncoding::FULL_PRECISION:
+        break;
+      case OutputEncoding::FLOAT16: {
+        encoded = Tensor(DT_HALF, tensor.shape());
+        auto encoded_values = encoded.flat<Eigen::half>();
+        for (int64 i = 0; i < values.size(); ++i) {
+          encoded_values(i) = static_cast<Eigen::half>(values(i));
+        }
+      } break;
+      case OutputEncoding::BFLOAT16: {
+        encoded = Tensor(DT_BFLOAT16, tensor.shape());
+        auto encoded_values = encoded.flat<bfloat16>();
+        for (int64 i = 0; i < values.size(); ++i) {
+          encoded_values(i) = static_cast<bfloat16>(values(i));
+        }
+      } break;
+      case OutputEncoding::INT8:
+        encoded = Tensor(DT_INT8, tensor.shape());
+        info->set_scale(QuantizeToInt8(values, encoded.flat<int8>()));
+        break;
+      default:
+        return errors::InvalidArgument("Unknown output precision: ",
+                                       encoding.precision());
+    }
+    info->set_precision(encoding.precision());
+  }
+  encoded.AsProtoTensorContent(tensor_proto);
+  info->set_uncompressed_size(tensor_proto->tensor_content().size());
+  switch (encoding.compression()) {
+    case OutputEncoding::NO_COMPRESSION:
+      break;
+    case OutputEncoding::SHUFFLE_ZLIB:
+      TF_RETURN_IF_ERROR(
+          ShuffleAndCompress(DataTypeSize(encoded.dtype()),
+                             tensor_proto->mutable_tensor_content(), info));
+      break;
+    default:
+      return errors::InvalidArgument("Unknown output compression: ",
+                                     encoding.compression());
+  }
+  return Status::OK();
+}
+
+Status RunPredict(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    const optional<int64>& servable_version,
+    const internal::PredictResponseTensorSerializationOption option,
+    Session* session, const PredictRequest& request,
+    PredictResponse* response) {
+  return RunPredictImpl(run_options, meta_graph_def, servable_version, option,
+                        /*shared_memory_manager=*/nullptr, session, request,
+                        nullptr, response);
+}
+
+Status RunPredictMovingInputs(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    const optional<int64>& servable_version,
+    const internal::PredictResponseTensorSerializationOption option,
+    const SharedMemoryManager* shared_memory_manager, Session* session,
+    PredictRequest* request, PredictResponse* response) {
+  return RunPredictImpl(run_options, meta_graph_def, servable_version, option,
+                        shared_memory_manager, session, *request, request,
+                        response);
 }
 }  // namespace internal
 
@@ -16,11 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_UTIL_H_
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_PREDICT_UTIL_H_
 
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow_serving/apis/predict.pb.h"
+#include "tensorflow_serving/servables/tensorflow/shared_memory_manager.h"
 #include "tensorflow_serving/util/optional.h"
 
 namespace tensorflow {
@@ -41,6 +44,27 @@ Status RunPredict(
     const PredictResponseTensorSerializationOption tensor_serialization_option,
     Session* session, const PredictRequest& request, PredictResponse* response);
 
+// Returns whether 'encoding' changes how an output of 'dtype' is serialized.
+bool OutputEncodingApplies(const OutputEncoding& encoding, DataType dtype);
+
+// Serializes 'tensor' into the tensor_content of 'tensor_proto' with
+// 'encoding', which must apply to its dtype, and describes how it was encoded
+// in 'info'.
+Status EncodeOutputTensor(const OutputEncoding& encoding, const Tensor& tensor,
+                          TensorProto* tensor_proto, EncodedTensorInfo* info);
+
+// Like RunPredict() above, but moves the string values of the inputs out of
+// 'request' into the input tensors instead of copying them. They are left
+// empty in 'request'. The shared memory inputs and outputs of 'request' are
+// read from and written to the regions of 'shared_memory_manager'; requests
+// that have some fail if it is null.
+Status RunPredictMovingInputs(
+    const RunOptions& run_options, const MetaGraphDef& meta_graph_def,
+    const optional<int64>& servable_version,
+    const PredictResponseTensorSerializationOption tensor_serialization_option,
+    const SharedMemoryManager* shared_memory_manager, Session* session,
+    PredictRequest* request, PredictResponse* response);
+
 }  // namespace internal
 
 // Implementation of Predict using the SavedModel SignatureDef format.
@@ -15,12 +15,25 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/predict_util.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <limits>
+
+#include <zlib.h>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/str_cat.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
 #include "tensorflow_serving/model_servers/model_platform_types.h"
 #include "tensorflow_serving/model_servers/platform_config_util.h"
@@ -269,6 +282,33 @@ TEST_F(PredictImplTest, ModelMissingSignatures) {
                         request, &response).code());
 }
 
+TEST_F(PredictImplTest, CompositeInputNotSupported) {
+  ServableHandle<SavedModelBundle> bundle;
+  TF_ASSERT_OK(GetSavedModelServableHandle(GetServerCore(), &bundle));
+  MetaGraphDef meta_graph_def = bundle->meta_graph_def;
+  SignatureDef& signature_def =
+      (*meta_graph_def.mutable_signature_def())[kDefaultServingSignatureDefKey];
+  // Replaces the input with a composite of the same tensor.
+  TensorInfo& input = (*signature_def.mutable_inputs())[kInputTensorKey];
+  const string tensor_name = input.name();
+  input.mutable_composite_tensor()->add_components()->set_name(tensor_name);
+
+  PredictRequest request;
+  PredictResponse response;
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+
+  const Status status =
+      RunPredict(GetRunOptions(), meta_graph_def, kTestModelVersion,
+                 bundle->session.get(), request, &response);
+  EXPECT_EQ(tensorflow::error::UNIMPLEMENTED, status.code());
+}
+
 TEST_F(PredictImplTest, PredictionSuccess) {
   PredictRequest request;
   PredictResponse response;
@@ -296,6 +336,124 @@ TEST_F(PredictImplTest, PredictionSuccess) {
   EXPECT_THAT(response, test_util::EqualsProto(expected_response));
 }
 
+TEST_F(PredictImplTest, PredictionMovingInputsSuccess) {
+  PredictRequest request;
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+
+  PredictResponse expected_response;
+  TF_ASSERT_OK(CallPredict(GetServerCore(), request, &expected_response));
+
+  ServableHandle<SavedModelBundle> bundle;
+  TF_ASSERT_OK(GetSavedModelServableHandle(GetServerCore(), &bundle));
+  PredictResponse response;
+  TF_ASSERT_OK(internal::RunPredictMovingInputs(
+      GetRunOptions(), bundle->meta_graph_def, kTestModelVersion,
+      internal::PredictResponseTensorSerializationOption::kAsProtoField,
+      /*shared_memory_manager=*/nullptr, bundle->session.get(), &request,
+      &response));
+  EXPECT_THAT(response, test_util::EqualsProto(expected_response));
+}
+
+TEST_F(PredictImplTest, PredictionWithSharedMemory) {
+  const string key =
+      absl::StrCat("/predict_util_test_", Env::Default()->NowMicros());
+  const int fd = shm_open(key.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(0, ftruncate(fd, 4096));
+  void* mapping =
+      mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  ASSERT_NE(MAP_FAILED, mapping);
+  float* data = static_cast<float*>(mapping);
+  data[0] = 2.0;
+  data[1] = 4.0;
+
+  SharedMemoryManager manager("/predict_util_test_");
+  TF_ASSERT_OK(manager.Register("region", key, 0, 4096));
+
+  PredictRequest request;
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+  SharedMemoryTensor* input =
+      &(*request.mutable_shared_memory_inputs())[kInputTensorKey];
+  input->set_region("region");
+  input->set_byte_size(2 * sizeof(float));
+  input->set_dtype(DT_FLOAT);
+  TensorShape({2}).AsProto(input->mutable_tensor_shape());
+  SharedMemoryTensor* output =
+      &(*request.mutable_shared_memory_outputs())[kOutputTensorKey];
+  output->set_region("region");
+  output->set_offset(64);
+  output->set_byte_size(64);
+
+  ServableHandle<SavedModelBundle> bundle;
+  TF_ASSERT_OK(GetSavedModelServableHandle(GetServerCore(), &bundle));
+  PredictRequest request_without_manager = request;
+  PredictResponse response;
+  EXPECT_EQ(tensorflow::error::FAILED_PRECONDITION,
+            internal::RunPredictMovingInputs(
+                GetRunOptions(), bundle->meta_graph_def, kTestModelVersion,
+                internal::PredictResponseTensorSerializationOption::
+                    kAsProtoField,
+                /*shared_memory_manager=*/nullptr, bundle->session.get(),
+                &request_without_manager, &response)
+                .code());
+
+  TF_ASSERT_OK(internal::RunPredictMovingInputs(
+      GetRunOptions(), bundle->meta_graph_def, kTestModelVersion,
+      internal::PredictResponseTensorSerializationOption::kAsProtoField,
+      &manager, bundle->session.get(), &request, &response));
+  EXPECT_TRUE(response.outputs().empty());
+  EXPECT_THAT(response.shared_memory_outputs().at(kOutputTensorKey),
+              test_util::EqualsProto(R"(
+                region: "region"
+                offset: 64
+                byte_size: 8
+                dtype: DT_FLOAT
+                tensor_shape { dim { size: 2 } }
+              )"));
+  EXPECT_EQ(3.0, data[16]);
+  EXPECT_EQ(4.0, data[17]);
+
+  munmap(mapping, 4096);
+  shm_unlink(key.c_str());
+}
+
+TEST_F(PredictImplTest, PredictionWithEncodedOutputs) {
+  PredictRequest request;
+  ModelSpec* model_spec = request.mutable_model_spec();
+  model_spec->set_name(kTestModelName);
+  model_spec->mutable_version()->set_value(kTestModelVersion);
+  request.mutable_output_encoding()->set_precision(OutputEncoding::FLOAT16);
+
+  TensorProto tensor_proto;
+  tensor_proto.add_float_val(2.0);
+  tensor_proto.set_dtype(tensorflow::DT_FLOAT);
+  (*request.mutable_inputs())[kInputTensorKey] = tensor_proto;
+
+  PredictResponse response;
+  TF_ASSERT_OK(CallPredict(GetServerCore(), request, &response));
+  Tensor output;
+  ASSERT_TRUE(output.FromProto(response.outputs().at(kOutputTensorKey)));
+  test::ExpectTensorEqual<Eigen::half>(
+      test::AsTensor<Eigen::half>({Eigen::half(3.0f)}, TensorShape({})),
+      output);
+  EXPECT_THAT(response.output_encodings().at(kOutputTensorKey),
+              test_util::EqualsProto(R"(
+                original_dtype: DT_FLOAT
+                precision: FLOAT16
+                uncompressed_size: 2
+              )"));
+}
+
 // Test querying a model with a named regression signature (not default). This
 TEST_F(PredictImplTest, PredictionWithNamedRegressionSignature) {
   PredictRequest request;
@@ -443,6 +601,196 @@ TEST_F(PredictImplTest, PredictionWithCustomizedSignatures) {
   EXPECT_THAT(response, test_util::EqualsProto(expected_incr_counter_by));
 }
 
+// Decodes 'tensor_proto' as encoded with 'info' the way clients do, and
+// returns the values of the output, converted back to its original dtype.
+Tensor DecodeOutput(const TensorProto& tensor_proto,
+                    const EncodedTensorInfo& info) {
+  TensorProto decoded_proto = tensor_proto;
+  if (info.compression() == OutputEncoding::SHUFFLE_ZLIB) {
+    string shuffled(info.uncompressed_size(), '\0');
+    uLongf size = shuffled.size();
+    CHECK_EQ(Z_OK,
+             uncompress(reinterpret_cast<Bytef*>(&shuffled[0]), &size,
+                        reinterpret_cast<const Bytef*>(
+                            tensor_proto.tensor_content().data()),
+                        tensor_proto.tensor_content().size()));
+    const int element_size = DataTypeSize(tensor_proto.dtype());
+    const size_t num_values = shuffled.size() / element_size;
+    string* content = decoded_proto.mutable_tensor_content();
+    for (int b = 0; b < element_size; ++b) {
+      for (size_t i = 0; i < num_values; ++i) {
+        (*content)[i * element_size + b] = shuffled[b * num_values + i];
+      }
+    }
+  }
+  Tensor encoded;
+  CHECK(encoded.FromProto(decoded_proto));
+  if (encoded.dtype() == info.original_dtype()) return encoded;
+  Tensor decoded(DT_FLOAT, encoded.shape());
+  auto decoded_values = decoded.flat<float>();
+  for (int64 i = 0; i < decoded_values.size(); ++i) {
+    switch (encoded.dtype()) {
+      case DT_HALF:
+        decoded_values(i) = static_cast<float>(encoded.flat<Eigen::half>()(i));
+        break;
+      case DT_BFLOAT16:
+        decoded_values(i) = static_cast<float>(encoded.flat<bfloat16>()(i));
+        break;
+      case DT_INT8:
+        decoded_values(i) = encoded.flat<int8>()(i) * info.scale();
+        break;
+      default:
+        LOG(FATAL) << "Unexpected encoded dtype: " << encoded.dtype();
+    }
+  }
+  return decoded;
+}
+
+// Returns embeddings like outputs of 'num_values' floats in [-1, 1).
+Tensor EmbeddingsTensor(int64 num_values) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor tensor(DT_FLOAT, TensorShape({num_values}));
+  auto values = tensor.flat<float>();
+  for (int64 i = 0; i < num_values; ++i) {
+    values(i) = rnd.RandFloat() * 2 - 1;
+  }
+  return tensor;
+}
+
+OutputEncoding MakeOutputEncoding(OutputEncoding::Precision precision,
+                                  OutputEncoding::Compression compression) {
+  OutputEncoding encoding;
+  encoding.set_precision(precision);
+  encoding.set_compression(compression);
+  return encoding;
+}
+
+// Encodes and decodes 'tensor' with 'encoding', and expects the values to be
+// within 'tolerance' of the original ones.
+void ExpectEncodedOutputNear(const Tensor& tensor,
+                             const OutputEncoding& encoding, float tolerance) {
+  ASSERT_TRUE(internal::OutputEncodingApplies(encoding, tensor.dtype()));
+  TensorProto tensor_proto;
+  EncodedTensorInfo info;
+  TF_ASSERT_OK(
+      internal::EncodeOutputTensor(encoding, tensor, &tensor_proto, &info));
+  EXPECT_EQ(DT_FLOAT, info.original_dtype());
+  EXPECT_EQ(encoding.precision(), info.precision());
+  test::ExpectTensorNear<float>(tensor, DecodeOutput(tensor_proto, info),
+                                tolerance);
+}
+
+TEST(EncodeOutputTensorTest, Float16) {
+  ExpectEncodedOutputNear(
+      EmbeddingsTensor(1000),
+      MakeOutputEncoding(OutputEncoding::FLOAT16,
+                         OutputEncoding::NO_COMPRESSION),
+      1e-3);
+}
+
+TEST(EncodeOutputTensorTest, Bfloat16) {
+  ExpectEncodedOutputNear(
+      EmbeddingsTensor(1000),
+      MakeOutputEncoding(OutputEncoding::BFLOAT16,
+                         OutputEncoding::NO_COMPRESSION),
+      1e-2);
+}
+
+TEST(EncodeOutputTensorTest, Int8) {
+  Tensor tensor = EmbeddingsTensor(1000);
+  tensor.flat<float>()(0) = 2;
+  // The values are within half a step of 2 / 127 of the originals.
+  ExpectEncodedOutputNear(
+      tensor,
+      MakeOutputEncoding(OutputEncoding::INT8, OutputEncoding::NO_COMPRESSION),
+      1.0 / 127 + 1e-6);
+}
+
+TEST(EncodeOutputTensorTest, Int8WithNonFiniteValues) {
+  Tensor tensor = test::AsTensor<float>(
+      {1, -0.5, std::numeric_limits<float>::infinity(), std::nanf("")});
+  TensorProto tensor_proto;
+  EncodedTensorInfo info;
+  TF_ASSERT_OK(internal::EncodeOutputTensor(
+      MakeOutputEncoding(OutputEncoding::INT8, OutputEncoding::NO_COMPRESSION),
+      tensor, &tensor_proto, &info));
+  EXPECT_FLOAT_EQ(1.0 / 127, info.scale());
+  Tensor quantized;
+  ASSERT_TRUE(quantized.FromProto(tensor_proto));
+  test::ExpectTensorEqual<int8>(test::AsTensor<int8>({127, -64, 127, 0}),
+                                quantized);
+}
+
+TEST(EncodeOutputTensorTest, ShuffleZlib) {
+  // Full precision values keep their dtype, and are decoded exactly.
+  ExpectEncodedOutputNear(
+      EmbeddingsTensor(1000),
+      MakeOutputEncoding(OutputEncoding::FULL_PRECISION,
+                         OutputEncoding::SHUFFLE_ZLIB),
+      0);
+  ExpectEncodedOutputNear(
+      EmbeddingsTensor(1000),
+      MakeOutputEncoding(OutputEncoding::INT8, OutputEncoding::SHUFFLE_ZLIB),
+      1.0 / 127);
+}
+
+TEST(EncodeOutputTensorTest, ShuffleZlibOfRepeatedValues) {
+  Tensor tensor(DT_INT64, TensorShape({1000}));
+  tensor.flat<int64>().setConstant(42);
+  const OutputEncoding encoding = MakeOutputEncoding(
+      OutputEncoding::FULL_PRECISION, OutputEncoding::SHUFFLE_ZLIB);
+  ASSERT_TRUE(internal::OutputEncodingApplies(encoding, DT_INT64));
+  TensorProto tensor_proto;
+  EncodedTensorInfo info;
+  TF_ASSERT_OK(
+      internal::EncodeOutputTensor(encoding, tensor, &tensor_proto, &info));
+  EXPECT_EQ(OutputEncoding::SHUFFLE_ZLIB, info.compression());
+  EXPECT_EQ(8000, info.uncompressed_size());
+  EXPECT_LT(tensor_proto.tensor_content().size(), 100);
+  test::ExpectTensorEqual<int64>(tensor, DecodeOutput(tensor_proto, info));
+}
+
+TEST(EncodeOutputTensorTest, DoesNotApply) {
+  const OutputEncoding float16 = MakeOutputEncoding(
+      OutputEncoding::FLOAT16, OutputEncoding::NO_COMPRESSION);
+  EXPECT_FALSE(internal::OutputEncodingApplies(float16, DT_INT64));
+  EXPECT_FALSE(internal::OutputEncodingApplies(float16, DT_DOUBLE));
+  EXPECT_FALSE(internal::OutputEncodingApplies(OutputEncoding(), DT_FLOAT));
+  const OutputEncoding zlib = MakeOutputEncoding(
+      OutputEncoding::FULL_PRECISION, OutputEncoding::SHUFFLE_ZLIB);
+  EXPECT_FALSE(internal::OutputEncodingApplies(zlib, DT_STRING));
+}
+
+// Encodes 1M embedding values with the precision and compression in
+// 'precision_and_compression', and reports the size of the encoded values
+// relative to the original ones.
+static void BM_EncodeOutputTensor(int iters, int precision_and_compression) {
+  testing::StopTiming();
+  const int64 kNumValues = 1 << 20;
+  const Tensor tensor = EmbeddingsTensor(kNumValues);
+  const OutputEncoding encoding = MakeOutputEncoding(
+      static_cast<OutputEncoding::Precision>(precision_and_compression / 2),
+      static_cast<OutputEncoding::Compression>(precision_and_compression % 2));
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumValues *
+                          sizeof(float));
+  TensorProto tensor_proto;
+  EncodedTensorInfo info;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(
+        internal::EncodeOutputTensor(encoding, tensor, &tensor_proto, &info));
+  }
+  testing::StopTiming();
+  testing::SetLabel(strings::StrCat(
+      OutputEncoding::Precision_Name(encoding.precision()), " ",
+      OutputEncoding::Compression_Name(encoding.compression()), " ",
+      tensor_proto.tensor_content().size() * 100 / (kNumValues * sizeof(float)),
+      "% of float32"));
+}
+
+BENCHMARK(BM_EncodeOutputTensor)->DenseRange(0, 7);
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -0,0 +1,246 @@
+/* Copyright 2020 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/shared_memory_manager.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/error.h"
+#include "tensorflow/core/util/overflow.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A registered region, which is unmapped when destroyed.
+class SharedMemoryManager::Region {
+ public:
+  Region(void* mapping, size_t mapping_size, char* data, uint64 byte_size)
+      : mapping_(mapping),
+        mapping_size_(mapping_size),
+        data_(data),
+        byte_size_(byte_size) {}
+
+  ~Region() { munmap(mapping_, mapping_size_); }
+
+  char* data() const { return data_; }
+  uint64 byte_size() const { return byte_size_; }
+
+ private:
+  void* const mapping_;
+  const size_t mapping_size_;
+  char* const data_;
+  const uint64 byte_size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Region);
+};
+
+// The buffer of a tensor in a region, which keeps the region mapped.
+class SharedMemoryManager::RegionBuffer : public TensorBuffer {
+ public:
+  RegionBuffer(std::shared_ptr<Region> region, char* data, size_t size)
+      : TensorBuffer(data), region_(std::move(region)), size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("shared_memory");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<Region> region_;
+  const size_t size_;
+};
+
+Status SharedMemoryManager::Register(const string& name, const string& key,
+                                     uint64 offset, uint64 byte_size) {
+  if (name.empty()) {
+    return errors::InvalidArgument("Missing shared memory region name");
+  }
+  if (byte_size == 0) {
+    return errors::InvalidArgument("Shared memory region ", name,
+                                   " is empty");
+  }
+  if (!str_util::StartsWith(key, key_prefix_)) {
+    return errors::PermissionDenied("Shared memory object ", key,
+                                    " does not start with ", key_prefix_);
+  }
+  const int fd = shm_open(key.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return IOError(strings::StrCat("Failed to open shared memory object ", key),
+                   errno);
+  }
+  struct stat object_stat;
+  if (fstat(fd, &object_stat) != 0) {
+    const int fstat_errno = errno;
+    close(fd);
+    return IOError(strings::StrCat("Failed to stat shared memory object ", key),
+                   fstat_errno);
+  }
+  const uint64 object_size = object_stat.st_size;
+  if (byte_size > object_size || offset > object_size - byte_size) {
+    close(fd);
+    return errors::InvalidArgument(
+        "Shared memory region ", name, " of ", byte_size, " bytes at offset ",
+        offset, " is out of shared memory object ", key, " of ", object_size,
+        " bytes");
+  }
+
+  // The mapping has to start at a multiple of the page size.
+  const uint64 mapping_offset = offset - offset % sysconf(_SC_PAGESIZE);
+  const size_t mapping_size = offset - mapping_offset + byte_size;
+  void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, mapping_offset);
+  const int mmap_errno = errno;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return IOError(strings::StrCat("Failed to map shared memory object ", key),
+                   mmap_errno);
+  }
+  auto region = std::make_shared<Region>(
+      mapping, mapping_size,
+      static_cast<char*>(mapping) + (offset - mapping_offset), byte_size);
+
+  mutex_lock l(mu_);
+  if (!regions_.emplace(name, std::move(region)).second) {
+    return errors::AlreadyExists("Shared memory region ", name,
+                                 " is already registered");
+  }
+  return Status::OK();
+}
+
+Status SharedMemoryManager::Unregister(const string& name) {
+  if (name.empty()) {
+    return errors::InvalidArgument("Missing shared memory region name");
+  }
+  mutex_lock l(mu_);
+  if (regions_.erase(name) == 0) {
+    return errors::NotFound("Shared memory region ", name,
+                            " is not registered");
+  }
+  return Status::OK();
+}
+
+Status SharedMemoryManager::FindRange(const SharedMemoryTensor& shared_tensor,
+                                      uint64 byte_size,
+                                      std::shared_ptr<Region>* region,
+                                      char** data) const {
+  {
+    mutex_lock l(mu_);
+    auto iter = regions_.find(shared_tensor.region());
+    if (iter == regions_.end()) {
+      return errors::NotFound("Shared memory region ", shared_tensor.region(),
+                              " is not registered");
+    }
+    *region = iter->second;
+  }
+  const uint64 region_size = (*region)->byte_size();
+  if (byte_size > region_size ||
+      shared_tensor.offset() > region_size - byte_size) {
+    return errors::InvalidArgument(
+        byte_size, " bytes at offset ", shared_tensor.offset(),
+        " are out of shared memory region ", shared_tensor.region(), " of ",
+        region_size, " bytes");
+  }
+  *data = (*region)->data() + shared_tensor.offset();
+  return Status::OK();
+}
+
+Status SharedMemoryManager::ReadTensor(const SharedMemoryTensor& shared_tensor,
+                                       Tensor* tensor) const {
+  const DataType dtype = shared_tensor.dtype();
+  if (!DataTypeCanUseMemcpy(dtype)) {
+    return errors::InvalidArgument("Tensors of type ", DataTypeString(dtype),
+                                   " cannot be in shared memory");
+  }
+  if (!TensorShape::IsValid(shared_tensor.tensor_shape())) {
+    return errors::InvalidArgument(
+        "Invalid shape of shared memory tensor: ",
+        shared_tensor.tensor_shape().ShortDebugString());
+  }
+  const TensorShape shape(shared_tensor.tensor_shape());
+  const int64 num_bytes =
+      MultiplyWithoutOverflow(shape.num_elements(), DataTypeSize(dtype));
+  if (num_bytes < 0) {
+    return errors::InvalidArgument("Shared memory tensor of shape ",
+                                   shape.DebugString(), " and type ",
+                                   DataTypeString(dtype), " is too large");
+  }
+  const uint64 byte_size = num_bytes;
+  if (shared_tensor.byte_size() != byte_size) {
+    return errors::InvalidArgument(
+        "Shared memory tensor of ", shared_tensor.byte_size(),
+        " bytes, expected ", byte_size, " bytes for a ", DataTypeString(dtype),
+        " tensor of shape ", shape.DebugString());
+  }
+  std::shared_ptr<Region> region;
+  char* data;
+  TF_RETURN_IF_ERROR(FindRange(shared_tensor, byte_size, &region, &data));
+
+  auto* buffer = new RegionBuffer(std::move(region), data, byte_size);
+  *tensor = Tensor(dtype, shape, buffer);
+  buffer->Unref();
+  if (!tensor->IsAligned()) {
+    Tensor aligned(dtype, shape);
+    std::memcpy(const_cast<char*>(aligned.tensor_data().data()), data,
+                byte_size);
+    *tensor = std::move(aligned);
+  }
+  return Status::OK();
+}
+
+Status SharedMemoryManager::WriteTensor(
+    const Tensor& tensor, SharedMemoryTensor* shared_tensor) const {
+  if (!DataTypeCanUseMemcpy(tensor.dtype())) {
+    return errors::InvalidArgument("Tensors of type ",
+                                   DataTypeString(tensor.dtype()),
+                                   " cannot be in shared memory");
+  }
+  const StringPiece contents = tensor.tensor_data();
+  if (contents.size() > shared_tensor->byte_size()) {
+    return errors::ResourceExhausted(
+        "Tensor of ", contents.size(), " bytes does not fit in the ",
+        shared_tensor->byte_size(), " bytes of shared memory reserved for it");
+  }
+  std::shared_ptr<Region> region;
+  char* data;
+  TF_RETURN_IF_ERROR(
+      FindRange(*shared_tensor, contents.size(), &region, &data));
+  // The client may have placed the output where the input it was computed
+  // from is, so the ranges can overlap.
+  std::memmove(data, contents.data(), contents.size());
+
+  shared_tensor->set_byte_size(contents.size());
+  shared_tensor->set_dtype(tensor.dtype());
+  tensor.shape().AsProto(shared_tensor->mutable_tensor_shape());
+  return Status::OK();
+}
+
+}  // namespace serving
+}  // namespace tensorflow
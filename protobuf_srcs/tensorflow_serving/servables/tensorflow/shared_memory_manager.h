@@ -0,0 +1,90 @@
+/* Copyright 2020 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SHARED_MEMORY_MANAGER_H_
+#define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SHARED_MEMORY_MANAGER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow_serving/apis/shared_memory.pb.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Maps the POSIX shared memory regions registered by clients on the same host,
+// so that the tensors of their requests are read from and written to the
+// regions instead of being serialized. Thread-safe.
+class SharedMemoryManager {
+ public:
+  // Only the shared memory objects whose keys start with 'key_prefix' can be
+  // registered, so that clients cannot map the other objects of the host.
+  explicit SharedMemoryManager(const string& key_prefix)
+      : key_prefix_(key_prefix) {}
+  ~SharedMemoryManager() = default;
+
+  // Maps the 'byte_size' bytes at 'offset' in the shared memory object 'key'
+  // as the region 'name'. The object must not be shrunk while the region is
+  // registered: accessing the pages past its end raises SIGBUS.
+  Status Register(const string& name, const string& key, uint64 offset,
+                  uint64 byte_size);
+
+  // Unregisters the region 'name'. A region stays mapped until the tensors that
+  // refer to it are destroyed.
+  Status Unregister(const string& name);
+
+  // Sets 'tensor' to the tensor that 'shared_tensor' describes. Its buffer is
+  // the region itself, unless the contents are not aligned as TensorFlow
+  // requires, in which case they are copied. The buffer does not own its
+  // memory, so TensorFlow never reuses it for the outputs of an op.
+  Status ReadTensor(const SharedMemoryTensor& shared_tensor,
+                    Tensor* tensor) const;
+
+  // Copies the contents of 'tensor' to the region and offset of
+  // 'shared_tensor', which must have room for them, and sets its type, shape
+  // and size to those of 'tensor'.
+  Status WriteTensor(const Tensor& tensor,
+                     SharedMemoryTensor* shared_tensor) const;
+
+ private:
+  class Region;
+  class RegionBuffer;
+
+  // Sets 'region' to the region of 'shared_tensor' and 'data' to its bytes at
+  // the offset of 'shared_tensor', after checking that 'byte_size' bytes from
+  // there are in the region.
+  Status FindRange(const SharedMemoryTensor& shared_tensor, uint64 byte_size,
+                   std::shared_ptr<Region>* region, char** data) const;
+
+  const string key_prefix_;
+
+  mutable mutex mu_;
+  std::unordered_map<string, std::shared_ptr<Region>> regions_
+      GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryManager);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_SHARED_MEMORY_MANAGER_H_
@@ -0,0 +1,254 @@
+/* Copyright 2020 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_serving/servables/tensorflow/shared_memory_manager.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+constexpr size_t kObjectSize = 1 << 16;
+constexpr char kKeyPrefix[] = "/shared_memory_manager_test_";
+
+class SharedMemoryManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    key_ = strings::StrCat(kKeyPrefix, Env::Default()->NowMicros());
+    const int fd = shm_open(key_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(0, ftruncate(fd, kObjectSize));
+    void* mapping = mmap(nullptr, kObjectSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    ASSERT_NE(MAP_FAILED, mapping);
+    data_ = static_cast<char*>(mapping);
+  }
+
+  void TearDown() override {
+    munmap(data_, kObjectSize);
+    shm_unlink(key_.c_str());
+  }
+
+  // Describes a float tensor of 'shape' at 'offset' in 'region'.
+  static SharedMemoryTensor FloatTensor(const string& region, uint64 offset,
+                                       const TensorShape& shape) {
+    SharedMemoryTensor shared_tensor;
+    shared_tensor.set_region(region);
+    shared_tensor.set_offset(offset);
+    shared_tensor.set_byte_size(shape.num_elements() * sizeof(float));
+    shared_tensor.set_dtype(DT_FLOAT);
+    shape.AsProto(shared_tensor.mutable_tensor_shape());
+    return shared_tensor;
+  }
+
+  string key_;
+  // The whole shared memory object, as mapped by the client.
+  char* data_ = nullptr;
+  SharedMemoryManager manager_{kKeyPrefix};
+};
+
+TEST_F(SharedMemoryManagerTest, ReadsTensorWithoutCopying) {
+  // The region starts past the first page, at an offset that is not a
+  // multiple of the page size.
+  const uint64 region_offset = 4096 + 64;
+  TF_ASSERT_OK(manager_.Register("region", key_, region_offset, 1024));
+  const float values[] = {1, 2, 3, 4, 5, 6};
+  std::memcpy(data_ + region_offset + 128, values, sizeof(values));
+
+  Tensor tensor;
+  TF_ASSERT_OK(manager_.ReadTensor(
+      FloatTensor("region", 128, TensorShape({2, 3})), &tensor));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 2, 3, 4, 5, 6}, TensorShape({2, 3})), tensor);
+
+  // The tensor is the region itself.
+  reinterpret_cast<float*>(data_ + region_offset + 128)[0] = 7;
+  EXPECT_EQ(7, tensor.matrix<float>()(0, 0));
+}
+
+TEST_F(SharedMemoryManagerTest, CopiesUnalignedTensor) {
+  TF_ASSERT_OK(manager_.Register("region", key_, 0, 1024));
+  const float values[] = {1, 2, 3};
+  std::memcpy(data_ + 4, values, sizeof(values));
+
+  Tensor tensor;
+  TF_ASSERT_OK(
+      manager_.ReadTensor(FloatTensor("region", 4, TensorShape({3})), &tensor));
+  EXPECT_TRUE(tensor.IsAligned());
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({1, 2, 3}), tensor);
+}
+
+TEST_F(SharedMemoryManagerTest, TensorKeepsUnregisteredRegionMapped) {
+  TF_ASSERT_OK(manager_.Register("region", key_, 0, 1024));
+  const float values[] = {1, 2, 3};
+  std::memcpy(data_, values, sizeof(values));
+
+  Tensor tensor;
+  TF_ASSERT_OK(
+      manager_.ReadTensor(FloatTensor("region", 0, TensorShape({3})), &tensor));
+  TF_ASSERT_OK(manager_.Unregister("region"));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({1, 2, 3}), tensor);
+
+  EXPECT_EQ(error::NOT_FOUND,
+            manager_
+                .ReadTensor(FloatTensor("region", 0, TensorShape({3})), &tensor)
+                .code());
+  EXPECT_EQ(error::NOT_FOUND, manager_.Unregister("region").code());
+}
+
+TEST_F(SharedMemoryManagerTest, UnregistersOnlyNamedRegion) {
+  TF_ASSERT_OK(manager_.Register("first", key_, 0, 1024));
+  TF_ASSERT_OK(manager_.Register("second", key_, 1024, 1024));
+  // Clients share the manager, so none can unregister the regions of others
+  // without naming them.
+  EXPECT_EQ(error::INVALID_ARGUMENT, manager_.Unregister("").code());
+  TF_ASSERT_OK(manager_.Unregister("first"));
+
+  Tensor tensor;
+  EXPECT_EQ(error::NOT_FOUND,
+            manager_
+                .ReadTensor(FloatTensor("first", 0, TensorShape({1})), &tensor)
+                .code());
+  TF_EXPECT_OK(
+      manager_.ReadTensor(FloatTensor("second", 0, TensorShape({1})), &tensor));
+}
+
+TEST_F(SharedMemoryManagerTest, RejectsInvalidRegions) {
+  EXPECT_EQ(error::NOT_FOUND,
+            manager_.Register("region", "/missing_shared_memory_object", 0, 1)
+                .code());
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.Register("region", key_, 1, kObjectSize).code());
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.Register("region", key_, 0, 0).code());
+  EXPECT_EQ(error::INVALID_ARGUMENT, manager_.Register("", key_, 0, 1).code());
+
+  TF_ASSERT_OK(manager_.Register("region", key_, 0, 1024));
+  EXPECT_EQ(error::ALREADY_EXISTS,
+            manager_.Register("region", key_, 0, 1024).code());
+}
+
+TEST_F(SharedMemoryManagerTest, RejectsInvalidTensors) {
+  TF_ASSERT_OK(manager_.Register("region", key_, 0, 1024));
+  Tensor tensor;
+
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_
+                .ReadTensor(FloatTensor("region", 1024 - 8, TensorShape({3})),
+                            &tensor)
+                .code());
+
+  SharedMemoryTensor wrong_size = FloatTensor("region", 0, TensorShape({3}));
+  wrong_size.set_byte_size(4);
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.ReadTensor(wrong_size, &tensor).code());
+
+  // 2^61 int64s take 2^64 bytes, which wraps to zero.
+  SharedMemoryTensor too_large = FloatTensor("region", 0, TensorShape({}));
+  too_large.set_dtype(DT_INT64);
+  too_large.mutable_tensor_shape()->add_dim()->set_size(int64{1} << 61);
+  too_large.set_byte_size(0);
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.ReadTensor(too_large, &tensor).code());
+
+  SharedMemoryTensor strings = FloatTensor("region", 0, TensorShape({3}));
+  strings.set_dtype(DT_STRING);
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.ReadTensor(strings, &tensor).code());
+}
+
+TEST_F(SharedMemoryManagerTest, WritesTensor) {
+  TF_ASSERT_OK(manager_.Register("region", key_, 4096, 1024));
+  SharedMemoryTensor shared_tensor;
+  shared_tensor.set_region("region");
+  shared_tensor.set_offset(64);
+  shared_tensor.set_byte_size(512);
+
+  TF_ASSERT_OK(manager_.WriteTensor(
+      test::AsTensor<int64>({1, 2, 3, 4}, TensorShape({2, 2})),
+      &shared_tensor));
+  EXPECT_EQ(4 * sizeof(int64), shared_tensor.byte_size());
+  EXPECT_EQ(DT_INT64, shared_tensor.dtype());
+  EXPECT_EQ(TensorShape({2, 2}), TensorShape(shared_tensor.tensor_shape()));
+  const int64* values = reinterpret_cast<const int64*>(data_ + 4096 + 64);
+  EXPECT_EQ(1, values[0]);
+  EXPECT_EQ(4, values[3]);
+}
+
+TEST_F(SharedMemoryManagerTest, WriteFailsWhenTensorDoesNotFit) {
+  TF_ASSERT_OK(manager_.Register("region", key_, 0, 1024));
+  SharedMemoryTensor shared_tensor;
+  shared_tensor.set_region("region");
+  shared_tensor.set_byte_size(8);
+  EXPECT_EQ(error::RESOURCE_EXHAUSTED,
+            manager_.WriteTensor(test::AsTensor<float>({1, 2, 3}),
+                                 &shared_tensor)
+                .code());
+
+  shared_tensor.set_offset(1020);
+  shared_tensor.set_byte_size(64);
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.WriteTensor(test::AsTensor<float>({1, 2, 3}),
+                                 &shared_tensor)
+                .code());
+
+  shared_tensor.set_offset(0);
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            manager_.WriteTensor(test::AsTensor<tstring>({"a"}),
+                                 &shared_tensor)
+                .code());
+}
+
+TEST_F(SharedMemoryManagerTest, RejectsKeyWithoutPrefix) {
+  SharedMemoryManager manager("/other_prefix_");
+  EXPECT_EQ(error::PERMISSION_DENIED,
+            manager.Register("region", key_, 0, 1024).code());
+}
+
+TEST_F(SharedMemoryManagerTest, WritesTensorOverItsInput) {
+  TF_ASSERT_OK(manager_.Register("region", key_, 0, 1024));
+  const float values[] = {1, 2, 3, 4};
+  std::memcpy(data_, values, sizeof(values));
+
+  // The output starts in the middle of the input it is read from.
+  Tensor input;
+  TF_ASSERT_OK(
+      manager_.ReadTensor(FloatTensor("region", 0, TensorShape({4})), &input));
+  SharedMemoryTensor output = FloatTensor("region", 8, TensorShape({4}));
+  TF_ASSERT_OK(manager_.WriteTensor(input, &output));
+  const float* written = reinterpret_cast<const float*>(data_ + 8);
+  EXPECT_EQ(std::vector<float>({1, 2, 3, 4}),
+            std::vector<float>(written, written + 4));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "google/protobuf/wrappers.pb.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/example/example.pb.h"
@@ -44,6 +47,12 @@ auto* example_count_total = monitoring::Counter<1>::New(
     "/tensorflow/serving/request_example_count_total",
     "The total number of tensorflow.Examples.", "model");
 
+auto* string_input_bytes = monitoring::Counter<1>::New(
+    "/tensorflow/serving/string_input_bytes",
+    "The total bytes of string input tensors, by whether they were moved out "
+    "of the request or copied.",
+    "ingest");
+
 // Returns the number of examples in the Input.
 int NumInputExamples(const internal::SerializedInput& input) {
   switch (input.kind_case()) {
@@ -65,6 +74,8 @@ monitoring::Sampler<1>* GetExampleCounts() { return example_counts; }
 
 monitoring::Counter<1>* GetExampleCountTotal() { return example_count_total; }
 
+monitoring::Counter<1>* GetStringInputBytes() { return string_input_bytes; }
+
 }  // namespace internal
 
 void RecordRequestExampleCount(const string& model_name, size_t count) {
@@ -143,6 +154,44 @@ Status PerformOneShotTensorComputation(
                       output_tensor_names, {}, outputs, &run_metadata);
 }
 
+bool TensorFromProtoMovingStrings(TensorProto* proto, Tensor* tensor) {
+  // Strings serialized in tensor_content have to be decoded anyway.
+  if (proto->dtype() != DT_STRING || !proto->tensor_content().empty()) {
+    return tensor->FromProto(*proto);
+  }
+  if (!TensorShape::IsValid(proto->tensor_shape())) return false;
+  Tensor parsed(DT_STRING, TensorShape(proto->tensor_shape()));
+  auto parsed_flat = parsed.flat<tstring>();
+  const int64 num_elements = parsed_flat.size();
+  const int64 num_values =
+      std::min<int64>(num_elements, proto->string_val_size());
+  int64 moved_bytes = 0;
+  for (int64 i = 0; i < num_values; ++i) {
+    string* value = proto->mutable_string_val(i);
+    moved_bytes += value->size();
+    parsed_flat(i).swap(*value);
+  }
+  // Like Tensor::FromProto(), repeats the last value to fill the tensor.
+  int64 copied_bytes = 0;
+  for (int64 i = num_values; num_values > 0 && i < num_elements; ++i) {
+    parsed_flat(i) = parsed_flat(num_values - 1);
+    copied_bytes += parsed_flat(i).size();
+  }
+  string_input_bytes->GetCell("moved")->IncrementBy(moved_bytes);
+  string_input_bytes->GetCell("copied")->IncrementBy(copied_bytes);
+  *tensor = std::move(parsed);
+  return true;
+}
+
+void RecordCopiedStringInputBytes(const TensorProto& proto) {
+  if (proto.dtype() != DT_STRING) return;
+  int64 copied_bytes = 0;
+  for (const string& value : proto.string_val()) {
+    copied_bytes += value.size();
+  }
+  string_input_bytes->GetCell("copied")->IncrementBy(copied_bytes);
+}
+
 void MakeModelSpec(const string& model_name,
                    const optional<string>& signature_name,
                    const optional<int64>& version, ModelSpec* model_spec) {
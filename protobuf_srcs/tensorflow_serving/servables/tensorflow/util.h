@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_UTIL_H_
 
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
@@ -35,6 +36,8 @@ monitoring::Sampler<1>* GetExampleCounts();
 
 monitoring::Counter<1>* GetExampleCountTotal();
 
+monitoring::Counter<1>* GetStringInputBytes();
+
 }  // namespace internal
 
 // Records the example count of this request with the metric tracking the
@@ -64,6 +67,16 @@ Status PerformOneShotTensorComputation(
     const std::vector<string>& output_tensor_names, Session* session,
     std::vector<Tensor>* outputs, int* num_input_examples);
 
+// Parses 'proto' into 'tensor' like Tensor::FromProto(), but moves the values
+// of a DT_STRING proto into the tensor instead of copying their bytes, which
+// leaves them empty in 'proto'. Returns false if 'proto' is not a valid
+// tensor.
+bool TensorFromProtoMovingStrings(TensorProto* proto, Tensor* tensor);
+
+// Records the bytes of string values parsed from 'proto' by
+// Tensor::FromProto(), which copies them.
+void RecordCopiedStringInputBytes(const TensorProto& proto);
+
 // Populates given model_spec based on the model name and optional
 // signature/version information.
 // If signature_name has a value and is empty, model_spec's signature_name is
@@ -19,12 +19,14 @@ limitations under the License.
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow_serving/test_util/test_util.h"
 
 namespace tensorflow {
@@ -226,6 +228,115 @@ TEST(ExampleCountsTest, Simple) {
   EXPECT_EQ(3, after_count - before_count);
 }
 
+TEST(TensorFromProtoMovingStringsTest, MovesStrings) {
+  TensorProto proto;
+  proto.set_dtype(DT_STRING);
+  proto.mutable_tensor_shape()->add_dim()->set_size(2);
+  proto.add_string_val("first");
+  proto.add_string_val("second");
+
+  const int64 before_moved =
+      internal::GetStringInputBytes()->GetCell("moved")->value();
+  Tensor tensor;
+  ASSERT_TRUE(TensorFromProtoMovingStrings(&proto, &tensor));
+  test::ExpectTensorEqual<tstring>(test::AsTensor<tstring>({"first", "second"}),
+                                   tensor);
+  EXPECT_TRUE(proto.string_val(0).empty());
+  EXPECT_TRUE(proto.string_val(1).empty());
+  EXPECT_EQ(11, internal::GetStringInputBytes()->GetCell("moved")->value() -
+                    before_moved);
+}
+
+TEST(TensorFromProtoMovingStringsTest, RepeatsLastValue) {
+  TensorProto proto;
+  proto.set_dtype(DT_STRING);
+  proto.mutable_tensor_shape()->add_dim()->set_size(3);
+  proto.add_string_val("a");
+  proto.add_string_val("bc");
+
+  Tensor tensor;
+  ASSERT_TRUE(TensorFromProtoMovingStrings(&proto, &tensor));
+  test::ExpectTensorEqual<tstring>(test::AsTensor<tstring>({"a", "bc", "bc"}),
+                                   tensor);
+}
+
+TEST(TensorFromProtoMovingStringsTest, SameAsFromProto) {
+  TensorProto proto;
+  proto.set_dtype(DT_FLOAT);
+  proto.mutable_tensor_shape()->add_dim()->set_size(2);
+  proto.add_float_val(1.0);
+  proto.add_float_val(2.0);
+  Tensor tensor;
+  ASSERT_TRUE(TensorFromProtoMovingStrings(&proto, &tensor));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({1.0, 2.0}), tensor);
+
+  TensorProto empty_proto;
+  empty_proto.set_dtype(DT_STRING);
+  empty_proto.mutable_tensor_shape()->add_dim()->set_size(2);
+  Tensor expected;
+  ASSERT_TRUE(expected.FromProto(empty_proto));
+  ASSERT_TRUE(TensorFromProtoMovingStrings(&empty_proto, &tensor));
+  test::ExpectTensorEqual<tstring>(expected, tensor);
+}
+
+TEST(TensorFromProtoMovingStringsTest, InvalidShape) {
+  TensorProto proto;
+  proto.set_dtype(DT_STRING);
+  proto.mutable_tensor_shape()->add_dim()->set_size(-2);
+  proto.add_string_val("a");
+  Tensor tensor;
+  EXPECT_FALSE(TensorFromProtoMovingStrings(&proto, &tensor));
+}
+
+TEST(TensorFromProtoMovingStringsTest, RecordCopiedStringInputBytes) {
+  TensorProto proto;
+  proto.set_dtype(DT_STRING);
+  proto.add_string_val("abc");
+  proto.add_string_val("de");
+  const int64 before_copied =
+      internal::GetStringInputBytes()->GetCell("copied")->value();
+  RecordCopiedStringInputBytes(proto);
+  EXPECT_EQ(5, internal::GetStringInputBytes()->GetCell("copied")->value() -
+                   before_copied);
+}
+
+// Parses a proto of 'num_strings' strings of 'string_size' bytes, either with
+// Tensor::FromProto() or by moving its strings.
+static void BM_TensorFromProtoStrings(int iters, int num_strings,
+                                      int string_size, bool move) {
+  testing::StopTiming();
+  TensorProto proto;
+  proto.set_dtype(DT_STRING);
+  proto.mutable_tensor_shape()->add_dim()->set_size(num_strings);
+  for (int i = 0; i < num_strings; ++i) {
+    proto.add_string_val(string(string_size, 'x'));
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * num_strings *
+                          string_size);
+  for (int i = 0; i < iters; ++i) {
+    // Parsing the request is not timed, but a moving parse needs a fresh one.
+    TensorProto request_proto = proto;
+    Tensor tensor;
+    testing::StartTiming();
+    if (move) {
+      CHECK(TensorFromProtoMovingStrings(&request_proto, &tensor));
+    } else {
+      CHECK(tensor.FromProto(request_proto));
+    }
+    testing::StopTiming();
+  }
+}
+
+static void BM_TensorFromProtoCopyingStrings(int iters, int string_size) {
+  BM_TensorFromProtoStrings(iters, 64, string_size, false);
+}
+static void BM_TensorFromProtoMovingStrings(int iters, int string_size) {
+  BM_TensorFromProtoStrings(iters, 64, string_size, true);
+}
+
+BENCHMARK(BM_TensorFromProtoCopyingStrings)->Arg(64)->Arg(4096)->Arg(65536);
+BENCHMARK(BM_TensorFromProtoMovingStrings)->Arg(64)->Arg(4096)->Arg(65536);
+
 TEST(ModelSpecTest, NoOptional) {
   ModelSpec model_spec;
   MakeModelSpec("foo", /*signature_name=*/{}, /*version=*/{}, &model_spec);
@@ -0,0 +1,149 @@
+"""Compares the throughput and latency of the sync and async clients against a stand-in server.
+
+The stand-in server doubles its "x" input. Each call costs it a fixed overhead plus a cost per
+row, and it runs at most --server-concurrency calls at once, like a model server whose requests
+are dominated by per-call costs:
+
+    python scripts/benchmark_async_client.py --num-requests 2000 --concurrency 64
+"""
+import argparse
+import asyncio
+import threading
+import time
+from typing import Awaitable, Callable, List
+
+import grpc
+import numpy as np
+
+from min_tfs_client.async_requests import AsyncTensorServingClient
+from min_tfs_client.requests import TensorServingClient
+from min_tfs_client.tensors import ndarray_to_tensor_proto, tensor_proto_to_ndarray
+from tensorflow_serving.apis.predict_pb2 import PredictResponse
+from tensorflow_serving.apis.prediction_service_pb2_grpc import (
+    PredictionServiceServicer,
+    add_PredictionServiceServicer_to_server,
+)
+
+
+class StandInServicer(PredictionServiceServicer):
+    def __init__(self, call_cost_ms: float, row_cost_ms: float, concurrency: int) -> None:
+        self._call_cost = call_cost_ms / 1000
+        self._row_cost = row_cost_ms / 1000
+        self._concurrency = concurrency
+
+    async def Predict(self, request, context):
+        # The semaphore is created on the event loop of the server, which runs in its own thread.
+        if not hasattr(self, "_semaphore"):
+            self._semaphore = asyncio.Semaphore(self._concurrency)
+        x = tensor_proto_to_ndarray(request.inputs["x"])
+        async with self._semaphore:
+            await asyncio.sleep(self._call_cost + self._row_cost * x.shape[0])
+        response = PredictResponse()
+        response.outputs["y"].CopyFrom(ndarray_to_tensor_proto(x * 2))
+        return response
+
+
+def start_stand_in_server(args: argparse.Namespace) -> int:
+    started = threading.Event()
+    port: List[int] = []
+
+    async def serve() -> None:
+        server = grpc.aio.server()
+        add_PredictionServiceServicer_to_server(
+            StandInServicer(args.call_cost_ms, args.row_cost_ms, args.server_concurrency), server
+        )
+        port.append(server.add_insecure_port("127.0.0.1:0"))
+        await server.start()
+        started.set()
+        await server.wait_for_termination()
+
+    threading.Thread(
+        target=lambda: asyncio.new_event_loop().run_until_complete(serve()), daemon=True
+    ).start()
+    started.wait()
+    return port[0]
+
+
+def report(name: str, latencies: List[float], elapsed: float) -> None:
+    p50, p99 = np.percentile(latencies, [50, 99]) * 1000
+    print(
+        f"{name:32} {len(latencies) / elapsed:10.1f} requests/s"
+        f"  p50 {p50:7.2f} ms  p99 {p99:7.2f} ms"
+    )
+
+
+def run_sync(port: int, args: argparse.Namespace) -> None:
+    client = TensorServingClient(host="127.0.0.1", port=port)
+    latencies = []
+    start = time.perf_counter()
+    for i in range(args.num_requests):
+        request_start = time.perf_counter()
+        client.predict_request("default", {"x": np.array([i], dtype=np.float32)})
+        latencies.append(time.perf_counter() - request_start)
+    report("sync", latencies, time.perf_counter() - start)
+
+
+async def run_async(
+    name: str, make_client: Callable[[], AsyncTensorServingClient], args: argparse.Namespace
+) -> None:
+    latencies: List[float] = []
+    semaphore = asyncio.Semaphore(args.concurrency)
+
+    async def timed(predict: Callable[[], Awaitable]) -> None:
+        async with semaphore:
+            request_start = time.perf_counter()
+            await predict()
+            latencies.append(time.perf_counter() - request_start)
+
+    async with make_client() as client:
+        start = time.perf_counter()
+        await asyncio.gather(
+            *(
+                timed(
+                    lambda i=i: client.predict_request(
+                        "default", {"x": np.array([i], dtype=np.float32)}
+                    )
+                )
+                for i in range(args.num_requests)
+            )
+        )
+        report(name, latencies, time.perf_counter() - start)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--num-requests", type=int, default=2000)
+    parser.add_argument("--concurrency", type=int, default=64)
+    parser.add_argument("--num-channels", type=int, default=4)
+    parser.add_argument("--max-batch-size", type=int, default=32)
+    parser.add_argument("--batch-timeout-ms", type=float, default=1.0)
+    parser.add_argument("--call-cost-ms", type=float, default=2.0)
+    parser.add_argument("--row-cost-ms", type=float, default=0.02)
+    parser.add_argument("--server-concurrency", type=int, default=4)
+    args = parser.parse_args()
+
+    port = start_stand_in_server(args)
+    run_sync(port, args)
+    loop = asyncio.new_event_loop()
+    for name, make_client in [
+        ("async, 1 channel", lambda: AsyncTensorServingClient("127.0.0.1", port, num_channels=1)),
+        (
+            f"async, {args.num_channels} channels",
+            lambda: AsyncTensorServingClient("127.0.0.1", port, num_channels=args.num_channels),
+        ),
+        (
+            f"async, {args.num_channels} channels, batched",
+            lambda: AsyncTensorServingClient(
+                "127.0.0.1",
+                port,
+                num_channels=args.num_channels,
+                max_batch_size=args.max_batch_size,
+                batch_timeout_ms=args.batch_timeout_ms,
+            ),
+        ),
+    ]:
+        loop.run_until_complete(run_async(name, make_client, args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+"""Compares the throughput of unary Predict calls with that of a single PredictStream call.
+
+Requires a model server built from `protobuf_srcs`, serving the integration test model:
+
+    python scripts/benchmark_predict_stream.py --port 4080 --num-requests 1000
+"""
+import argparse
+import time
+from typing import Callable, Dict, List
+
+import numpy as np
+
+from min_tfs_client.requests import TensorServingClient
+
+
+def make_input_dicts(num_requests: int, batch_size: int) -> List[Dict[str, np.ndarray]]:
+    return [
+        {
+            "string_input": np.array(["hello world"] * batch_size),
+            "float_input": np.full(batch_size, i, dtype=np.float32),
+            "int_input": np.full(batch_size, i, dtype=np.int64),
+        }
+        for i in range(num_requests)
+    ]
+
+
+def requests_per_second(run: Callable[[], None], num_requests: int) -> float:
+    start = time.perf_counter()
+    run()
+    return num_requests / (time.perf_counter() - start)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=4080)
+    parser.add_argument("--model-name", default="default")
+    parser.add_argument("--num-requests", type=int, default=1000)
+    parser.add_argument("--batch-size", type=int, default=1)
+    args = parser.parse_args()
+
+    client = TensorServingClient(host=args.host, port=args.port, credentials=None)
+    input_dicts = make_input_dicts(args.num_requests, args.batch_size)
+
+    def run_unary() -> None:
+        for input_dict in input_dicts:
+            client.predict_request(model_name=args.model_name, input_dict=input_dict)
+
+    def run_stream() -> None:
+        for _ in client.predict_stream(model_name=args.model_name, input_dicts=input_dicts):
+            pass
+
+    # Warms up the model and the channel.
+    run_unary()
+    unary = requests_per_second(run_unary, args.num_requests)
+    stream = requests_per_second(run_stream, args.num_requests)
+    print(f"Predict:       {unary:10.1f} requests/s")
+    print(f"PredictStream: {stream:10.1f} requests/s ({stream / unary:.2f}x)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+"""Compares the throughput of Predict calls with a large float tensor in the request and response
+with that of the same calls with the tensor in shared memory.
+
+Requires a model server on the same host built from `protobuf_srcs` and run with
+`--enable_shared_memory`, serving the integration test model:
+
+    python scripts/benchmark_shared_memory.py --port 4080 --num-requests 100 --num-floats 1000000
+"""
+import argparse
+import time
+from typing import Callable
+
+import numpy as np
+
+from min_tfs_client.requests import TensorServingClient
+from min_tfs_client.shared_memory import SharedMemoryRegion
+from min_tfs_client.tensors import tensor_proto_to_ndarray
+
+
+def requests_per_second(run: Callable[[], None], num_requests: int) -> float:
+    start = time.perf_counter()
+    for _ in range(num_requests):
+        run()
+    return num_requests / (time.perf_counter() - start)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=4080)
+    parser.add_argument("--model-name", default="default")
+    parser.add_argument("--num-requests", type=int, default=100)
+    parser.add_argument("--num-floats", type=int, default=1000000)
+    args = parser.parse_args()
+
+    client = TensorServingClient(host=args.host, port=args.port, credentials=None)
+    float_input = np.random.rand(args.num_floats).astype(np.float32)
+    small_inputs = {
+        "string_input": np.array(["hello world"]),
+        "int_input": np.array([1], dtype=np.int64),
+    }
+
+    def run_proto() -> None:
+        response = client.predict_request(
+            model_name=args.model_name, input_dict={**small_inputs, "float_input": float_input}
+        )
+        tensor_proto_to_ndarray(response.outputs["float_output"])
+
+    with SharedMemoryRegion("benchmark", 2 * float_input.nbytes + 64) as region:
+        client.register_shared_memory(region)
+
+        def run_shared_memory() -> None:
+            region.reset()
+            response = client.predict_request(
+                model_name=args.model_name,
+                input_dict=small_inputs,
+                shared_memory_inputs={"float_input": region.write(float_input)},
+                shared_memory_outputs={"float_output": region.allocate(float_input.nbytes)},
+            )
+            region.read(response.shared_memory_outputs["float_output"]).copy()
+
+        try:
+            # Warms up the model and the channel.
+            run_proto()
+            run_shared_memory()
+            proto = requests_per_second(run_proto, args.num_requests)
+            shared_memory = requests_per_second(run_shared_memory, args.num_requests)
+        finally:
+            client.unregister_shared_memory(region.name)
+
+    print(f"Tensors in protos:        {proto:10.1f} requests/s")
+    print(
+        f"Tensors in shared memory: {shared_memory:10.1f} requests/s "
+        f"({shared_memory / proto:.2f}x)"
+    )
+
+
+if __name__ == "__main__":
+    main()
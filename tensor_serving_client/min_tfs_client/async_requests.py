@@ -0,0 +1,311 @@
+import asyncio
+import itertools
+from typing import Any, Awaitable, Callable, Dict, List, Optional, Set, Tuple
+
+import grpc
+import numpy as np
+
+from tensorflow.core.framework.tensor_pb2 import TensorProto
+from tensorflow.core.framework.tensor_shape_pb2 import TensorShapeProto
+from tensorflow_serving.apis.classification_pb2 import ClassificationRequest, ClassificationResponse
+from tensorflow_serving.apis.predict_pb2 import OutputEncoding, PredictRequest, PredictResponse
+from tensorflow_serving.apis.prediction_service_pb2_grpc import PredictionServiceStub
+from tensorflow_serving.apis.regression_pb2 import RegressionRequest, RegressionResponse
+from tensorflow_serving.apis.get_model_status_pb2 import (
+    GetModelStatusRequest,
+    GetModelStatusResponse,
+)
+from tensorflow_serving.apis.model_service_pb2_grpc import ModelServiceStub
+
+from .requests import RequestTypes, ResponseTypes, fill_inference_request
+from .tensors import extract_shape
+from .types import DataType
+
+SendPredict = Callable[[str, Optional[int], Dict[str, np.ndarray], int], Awaitable[PredictResponse]]
+# The model name, model version, timeout and inputs of the calls of a batch.
+BatchKey = Tuple[str, Optional[int], int, Tuple[Any, ...]]
+
+# asyncio.get_running_loop is only available from Python 3.7, before which get_event_loop returns
+# the running loop when called from a coroutine.
+_get_running_loop = getattr(asyncio, "get_running_loop", asyncio.get_event_loop)
+
+
+def _num_rows(input_dict: Dict[str, np.ndarray]) -> Optional[int]:
+    # Inputs can only be batched when they all have the same first dimension.
+    num_rows = {value.shape[0] if value.ndim > 0 else None for value in input_dict.values()}
+    if len(num_rows) != 1:
+        return None
+    return num_rows.pop()
+
+
+def split_tensor_proto(tensor_proto: TensorProto, row_counts: List[int]) -> List[TensorProto]:
+    """Splits a tensor along its first dimension into tensors of `row_counts` rows."""
+    shape = extract_shape(tensor_proto)
+    if not shape or shape[0] != sum(row_counts):
+        raise ValueError(
+            f"Expected an output batched along its first dimension of size {sum(row_counts)}, "
+            f"got shape {shape}"
+        )
+    row_size = int(np.prod(shape[1:]))
+    dtype = DataType(tensor_proto.dtype)
+    if tensor_proto.tensor_content:
+        values = tensor_proto.tensor_content
+        row_size *= np.dtype(dtype.numpy_dtype).itemsize
+    else:
+        values = getattr(tensor_proto, dtype.proto_field_name)
+
+    parts = []
+    start = 0
+    for row_count in row_counts:
+        part = TensorProto(
+            dtype=tensor_proto.dtype,
+            tensor_shape=TensorShapeProto(
+                dim=[TensorShapeProto.Dim(size=d) for d in (row_count,) + shape[1:]]
+            ),
+        )
+        end = start + row_count * row_size
+        if tensor_proto.tensor_content:
+            part.tensor_content = values[start:end]
+        else:
+            getattr(part, dtype.proto_field_name).extend(values[start:end])
+        parts.append(part)
+        start = end
+    return parts
+
+
+def split_predict_response(
+    response: PredictResponse, row_counts: List[int]
+) -> List[PredictResponse]:
+    """Splits the response of a batched Predict request into the responses of its requests."""
+    if len(row_counts) == 1:
+        return [response]
+    responses = [PredictResponse(model_spec=response.model_spec) for _ in row_counts]
+    for key, tensor_proto in response.outputs.items():
+        for part_response, part in zip(responses, split_tensor_proto(tensor_proto, row_counts)):
+            part_response.outputs[key].CopyFrom(part)
+    return responses
+
+
+class _Batch:
+    def __init__(self) -> None:
+        self.input_dicts: List[Dict[str, np.ndarray]] = []
+        self.row_counts: List[int] = []
+        self.futures: List[asyncio.Future] = []
+
+    @property
+    def num_rows(self) -> int:
+        return sum(self.row_counts)
+
+
+class PredictBatcher:
+    """Merges concurrent Predict calls for the same model into fewer, larger requests.
+
+    Calls whose inputs have the same names, dtypes and shapes past the first dimension are
+    concatenated along the first dimension. A batch is sent once it holds `max_batch_size` rows,
+    or `batch_timeout_ms` after its first call. Every output of the model must be batched along
+    its first dimension too, so that it can be split back into the responses of the calls.
+    """
+
+    def __init__(self, send: SendPredict, max_batch_size: int, batch_timeout_ms: float) -> None:
+        self._send = send
+        self._max_batch_size = max_batch_size
+        self._batch_timeout = batch_timeout_ms / 1000
+        self._batches: Dict[BatchKey, _Batch] = {}
+        # The event loop only keeps weak references to tasks, so the batches being sent are
+        # referenced here until they are done.
+        self._send_tasks: Set[asyncio.Future] = set()
+
+    async def predict(
+        self,
+        model_name: str,
+        model_version: Optional[int],
+        input_dict: Dict[str, np.ndarray],
+        timeout: int,
+    ) -> PredictResponse:
+        num_rows = _num_rows(input_dict)
+        if num_rows is None or num_rows >= self._max_batch_size:
+            return await self._send(model_name, model_version, input_dict, timeout)
+
+        key: BatchKey = (
+            model_name,
+            model_version,
+            timeout,
+            tuple(sorted((k, v.dtype.type.__name__, v.shape[1:]) for k, v in input_dict.items())),
+        )
+        batch = self._batches.get(key)
+        if batch is not None and batch.num_rows + num_rows > self._max_batch_size:
+            self._flush(key, batch)
+            batch = None
+        loop = _get_running_loop()
+        if batch is None:
+            batch = _Batch()
+            self._batches[key] = batch
+            loop.call_later(self._batch_timeout, self._flush, key, batch)
+        future = loop.create_future()
+        batch.input_dicts.append(input_dict)
+        batch.row_counts.append(num_rows)
+        batch.futures.append(future)
+        if batch.num_rows >= self._max_batch_size:
+            self._flush(key, batch)
+        return await future
+
+    def _flush(self, key: BatchKey, batch: _Batch) -> None:
+        # The batch may have been sent already, when it filled up before its timeout.
+        if self._batches.get(key) is not batch:
+            return
+        del self._batches[key]
+        task = asyncio.ensure_future(self._send_batch(key, batch))
+        self._send_tasks.add(task)
+        task.add_done_callback(self._send_tasks.discard)
+
+    async def _send_batch(self, key: BatchKey, batch: _Batch) -> None:
+        model_name, model_version, timeout, _ = key
+        try:
+            if len(batch.input_dicts) == 1:
+                input_dict = batch.input_dicts[0]
+            else:
+                input_dict = {
+                    k: np.concatenate([d[k] for d in batch.input_dicts])
+                    for k in batch.input_dicts[0]
+                }
+            response = await self._send(model_name, model_version, input_dict, timeout)
+            responses = split_predict_response(response, batch.row_counts)
+        except Exception as e:
+            for future in batch.futures:
+                if not future.done():
+                    future.set_exception(e)
+            return
+        for future, part_response in zip(batch.futures, responses):
+            if not future.done():
+                future.set_result(part_response)
+
+
+class AsyncTensorServingClient:
+    """An asyncio client that spreads its calls over a pool of gRPC channels.
+
+    Each of the `num_channels` channels has its own connection to the server. When
+    `max_batch_size` is greater than one, concurrent `predict_request` calls are micro-batched by
+    a `PredictBatcher`; calls that set an `output_encoding` are always sent on their own.
+    """
+
+    def __init__(
+        self,
+        host: str,
+        port: int,
+        credentials: Optional[grpc.ChannelCredentials] = None,
+        num_channels: int = 4,
+        max_batch_size: int = 1,
+        batch_timeout_ms: float = 1.0,
+    ) -> None:
+        self._host_address = f"{host}:{port}"
+        # Channels with the same arguments would otherwise share a single connection.
+        options = [("grpc.use_local_subchannel_pool", 1)]
+        if credentials:
+            self._channels = [
+                grpc.aio.secure_channel(self._host_address, credentials, options=options)
+                for _ in range(num_channels)
+            ]
+        else:
+            self._channels = [
+                grpc.aio.insecure_channel(self._host_address, options=options)
+                for _ in range(num_channels)
+            ]
+        self._prediction_stubs = itertools.cycle(
+            [PredictionServiceStub(channel) for channel in self._channels]
+        )
+        self._model_stubs = itertools.cycle(
+            [ModelServiceStub(channel) for channel in self._channels]
+        )
+        self._batcher = (
+            PredictBatcher(self._send_predict, max_batch_size, batch_timeout_ms)
+            if max_batch_size > 1
+            else None
+        )
+
+    async def close(self) -> None:
+        await asyncio.gather(*(channel.close() for channel in self._channels))
+
+    async def __aenter__(self) -> "AsyncTensorServingClient":
+        return self
+
+    async def __aexit__(self, *args) -> None:
+        await self.close()
+
+    async def _make_inference_request(
+        self,
+        model_name: str,
+        input_dict: Dict[str, np.ndarray],
+        request_pb: RequestTypes,
+        timeout: int,
+        model_version: Optional[int],
+        output_encoding: Optional[OutputEncoding] = None,
+    ) -> ResponseTypes:
+        stub = next(self._prediction_stubs)
+        request = request_pb()
+        fill_inference_request(request, model_name, input_dict, model_version, output_encoding)
+        rpc = {
+            PredictRequest: stub.Predict,
+            ClassificationRequest: stub.Classify,
+            RegressionRequest: stub.Regress,
+        }[request_pb]
+        return await rpc(request, timeout=timeout)
+
+    async def _send_predict(
+        self,
+        model_name: str,
+        model_version: Optional[int],
+        input_dict: Dict[str, np.ndarray],
+        timeout: int,
+    ) -> PredictResponse:
+        return await self._make_inference_request(
+            model_name, input_dict, PredictRequest, timeout, model_version
+        )
+
+    async def predict_request(
+        self,
+        model_name: str,
+        input_dict: Dict[str, np.ndarray],
+        timeout: int = 60,
+        model_version: Optional[int] = None,
+        output_encoding: Optional[OutputEncoding] = None,
+    ) -> PredictResponse:
+        if self._batcher is not None and output_encoding is None:
+            return await self._batcher.predict(model_name, model_version, input_dict, timeout)
+        return await self._make_inference_request(
+            model_name, input_dict, PredictRequest, timeout, model_version, output_encoding
+        )
+
+    async def classification_request(
+        self,
+        model_name: str,
+        input_dict: Dict[str, np.ndarray],
+        timeout: int = 60,
+        model_version: Optional[int] = None,
+    ) -> ClassificationResponse:
+        return await self._make_inference_request(
+            model_name, input_dict, ClassificationRequest, timeout, model_version
+        )
+
+    async def regression_request(
+        self,
+        model_name: str,
+        input_dict: Dict[str, np.ndarray],
+        timeout: int = 60,
+        model_version: Optional[int] = None,
+    ) -> RegressionResponse:
+        return await self._make_inference_request(
+            model_name, input_dict, RegressionRequest, timeout, model_version
+        )
+
+    async def model_status_request(
+        self,
+        model_name: str,
+        model_version: Optional[int] = None,
+        timeout: Optional[int] = 10,
+    ) -> GetModelStatusResponse:
+        stub = next(self._model_stubs)
+        request = GetModelStatusRequest()
+        request.model_spec.name = model_name
+        if model_version:
+            request.model_spec.version.value = model_version
+        return await stub.GetModelStatus(request, timeout=timeout)
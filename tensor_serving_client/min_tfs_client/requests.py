@@ -1,10 +1,15 @@
-from typing import Any, Dict, Optional, Union
+from typing import Any, Dict, Iterable, Iterator, Optional, Union
 
 import grpc
 import numpy as np
 
 from tensorflow_serving.apis.classification_pb2 import ClassificationRequest, ClassificationResponse
-from tensorflow_serving.apis.predict_pb2 import PredictRequest, PredictResponse
+from tensorflow_serving.apis.predict_pb2 import (
+    OutputEncoding,
+    PredictRequest,
+    PredictResponse,
+    PredictStreamRequest,
+)
 from tensorflow_serving.apis.prediction_service_pb2_grpc import PredictionServiceStub
 from tensorflow_serving.apis.regression_pb2 import RegressionRequest, RegressionResponse
 from tensorflow_serving.apis.get_model_status_pb2 import (
@@ -12,13 +17,60 @@ from tensorflow_serving.apis.get_model_status_pb2 import (
     GetModelStatusResponse,
 )
 from tensorflow_serving.apis.model_service_pb2_grpc import ModelServiceStub
+from tensorflow_serving.apis.shared_memory_pb2 import (
+    RegisterSharedMemoryResponse,
+    SharedMemoryTensor,
+    UnregisterSharedMemoryRequest,
+    UnregisterSharedMemoryResponse,
+)
+from tensorflow_serving.util.status_pb2 import StatusProto
 
+from .shared_memory import SharedMemoryRegion
 from .tensors import ndarray_to_tensor_proto
 
 RequestTypes = Union[PredictRequest, ClassificationRequest, RegressionRequest]
 ResponseTypes = Union[PredictResponse, ClassificationResponse, RegressionResponse]
 
 
+class PredictStreamError(Exception):
+    """A request sent on a PredictStream call failed; the other requests are unaffected."""
+
+    def __init__(self, request_index: int, status: StatusProto) -> None:
+        super().__init__(
+            f"Predict request {request_index} failed with error code {status.error_code}: "
+            f"{status.error_message}"
+        )
+        self.request_index = request_index
+        self.status = status
+
+
+def fill_inference_request(
+    request: RequestTypes,
+    model_name: str,
+    input_dict: Dict[str, np.ndarray],
+    model_version: Optional[int] = None,
+    output_encoding: Optional[OutputEncoding] = None,
+    shared_memory_inputs: Optional[Dict[str, SharedMemoryTensor]] = None,
+    shared_memory_outputs: Optional[Dict[str, SharedMemoryTensor]] = None,
+) -> None:
+    request.model_spec.name = model_name
+
+    if model_version is not None:
+        request.model_spec.version.value = model_version
+
+    if output_encoding is not None:
+        request.output_encoding.CopyFrom(output_encoding)
+
+    for k, v in input_dict.items():
+        request.inputs[k].CopyFrom(ndarray_to_tensor_proto(v))
+
+    for k, shared_tensor in (shared_memory_inputs or {}).items():
+        request.shared_memory_inputs[k].CopyFrom(shared_tensor)
+
+    for k, shared_tensor in (shared_memory_outputs or {}).items():
+        request.shared_memory_outputs[k].CopyFrom(shared_tensor)
+
+
 class TensorServingClient:
     def __init__(
         self, host: str, port: int, credentials: Optional[grpc.ssl_channel_credentials] = None,
@@ -36,16 +88,21 @@ class TensorServingClient:
         request_pb: RequestTypes,
         timeout: int,
         model_version: Optional[int],
+        output_encoding: Optional[OutputEncoding] = None,
+        shared_memory_inputs: Optional[Dict[str, SharedMemoryTensor]] = None,
+        shared_memory_outputs: Optional[Dict[str, SharedMemoryTensor]] = None,
     ) -> ResponseTypes:
         stub = PredictionServiceStub(self._channel)
         request = request_pb()
-        request.model_spec.name = model_name
-
-        if model_version is not None:
-            request.model_spec.version.value = model_version
-
-        for k, v in input_dict.items():
-            request.inputs[k].CopyFrom(ndarray_to_tensor_proto(v))
+        fill_inference_request(
+            request,
+            model_name,
+            input_dict,
+            model_version,
+            output_encoding,
+            shared_memory_inputs,
+            shared_memory_outputs,
+        )
         return stub.Predict(request, timeout)
 
     def predict_request(
@@ -54,16 +111,87 @@ class TensorServingClient:
         input_dict: Dict[str, np.ndarray],
         timeout: int = 60,
         model_version: Optional[int] = None,
+        output_encoding: Optional[OutputEncoding] = None,
+        shared_memory_inputs: Optional[Dict[str, SharedMemoryTensor]] = None,
+        shared_memory_outputs: Optional[Dict[str, SharedMemoryTensor]] = None,
     ) -> PredictResponse:
+        """Sends a Predict request.
+
+        `shared_memory_inputs` are inputs written to a registered `SharedMemoryRegion` rather than
+        sent in the request, and `shared_memory_outputs` the space allocated in one for outputs,
+        which are then in the `shared_memory_outputs` of the response rather than its `outputs`.
+        """
         request_params: Dict[str, Any] = {
             "model_name": model_name,
             "model_version": model_version,
             "input_dict": input_dict,
             "request_pb": PredictRequest,
             "timeout": timeout,
+            "output_encoding": output_encoding,
+            "shared_memory_inputs": shared_memory_inputs,
+            "shared_memory_outputs": shared_memory_outputs,
         }
         return self._make_inference_request(**request_params)
 
+    def register_shared_memory(
+        self, region: SharedMemoryRegion, timeout: int = 10
+    ) -> RegisterSharedMemoryResponse:
+        """Makes the server map `region`, which requires it to run on the same host with
+        `--enable_shared_memory`."""
+        stub = PredictionServiceStub(self._channel)
+        return stub.RegisterSharedMemory(region.register_request(), timeout)
+
+    def unregister_shared_memory(
+        self, name: str, timeout: int = 10
+    ) -> UnregisterSharedMemoryResponse:
+        """Makes the server unmap the region `name`."""
+        stub = PredictionServiceStub(self._channel)
+        return stub.UnregisterSharedMemory(UnregisterSharedMemoryRequest(name=name), timeout)
+
+    def predict_stream(
+        self,
+        model_name: str,
+        input_dicts: Iterable[Dict[str, np.ndarray]],
+        timeout: int = 60,
+        model_version: Optional[int] = None,
+        output_encoding: Optional[OutputEncoding] = None,
+        request_timeout_ms: int = 0,
+    ) -> Iterator[PredictResponse]:
+        """Sends a Predict request per input dict on a single PredictStream call.
+
+        The requests are sent without waiting for the responses of the previous ones, so that
+        the server can run them together, and the responses are yielded in the order of
+        `input_dicts`. `timeout` applies to the whole call, and `request_timeout_ms` to each
+        request; if it is zero, the server's `--grpc_predict_stream_request_timeout_in_ms` applies
+        instead. Raises `PredictStreamError` when a request fails.
+        """
+        stub = PredictionServiceStub(self._channel)
+
+        def stream_requests() -> Iterator[PredictStreamRequest]:
+            for request_index, input_dict in enumerate(input_dicts):
+                stream_request = PredictStreamRequest(
+                    id=request_index, timeout_in_ms=request_timeout_ms
+                )
+                fill_inference_request(
+                    stream_request.request, model_name, input_dict, model_version, output_encoding
+                )
+                yield stream_request
+
+        # The server writes the responses as the requests complete, so they may be out of order.
+        stream_responses = stub.PredictStream(stream_requests(), timeout)
+        completed: Dict[int, PredictResponse] = {}
+        next_index = 0
+        try:
+            for stream_response in stream_responses:
+                if stream_response.status.error_code != 0:
+                    raise PredictStreamError(stream_response.id, stream_response.status)
+                completed[stream_response.id] = stream_response.response
+                while next_index in completed:
+                    yield completed.pop(next_index)
+                    next_index += 1
+        finally:
+            stream_responses.cancel()
+
     def classification_request(
         self,
         model_name: str,
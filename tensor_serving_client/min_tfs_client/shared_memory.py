@@ -0,0 +1,117 @@
+import mmap
+import os
+import uuid
+from typing import Optional
+
+import numpy as np
+
+from tensorflow.core.framework.tensor_shape_pb2 import TensorShapeProto
+from tensorflow_serving.apis.shared_memory_pb2 import (
+    RegisterSharedMemoryRequest,
+    SharedMemoryTensor,
+)
+
+from .types import DataType
+
+# POSIX shared memory objects are files in this directory on Linux.
+SHM_DIRECTORY = "/dev/shm"
+
+# Tensors are placed at multiples of this many bytes, so that the server can use them in place.
+TENSOR_ALIGNMENT = 64
+
+
+class SharedMemoryRegion:
+    """A POSIX shared memory region for the tensors of Predict requests to a model server on the
+    same host, which reads the inputs from and writes the outputs to the region rather than the
+    requests and responses.
+
+    The region is created with `byte_size` bytes, and must be registered with the server (see
+    `TensorServingClient.register_shared_memory`) before it is referred to by requests. Tensors
+    are allocated one after the other until `reset` is called; it is up to the caller not to
+    reuse the space of a request in flight. Linux only.
+
+    The server only accepts the keys that start with its `--shared_memory_key_prefix`, which is
+    the prefix of the default keys, `/min_tfs_client_`, unless it is changed.
+    """
+
+    def __init__(self, name: str, byte_size: int, key: Optional[str] = None) -> None:
+        if byte_size <= 0:
+            raise ValueError(f"Shared memory region {name} must not be empty")
+        self.name = name
+        self.byte_size = byte_size
+        self.key = key or f"/min_tfs_client_{uuid.uuid4().hex}"
+        self._path = os.path.join(SHM_DIRECTORY, self.key.lstrip("/"))
+        fd = os.open(self._path, os.O_RDWR | os.O_CREAT | os.O_EXCL, 0o600)
+        try:
+            os.ftruncate(fd, byte_size)
+            self._buffer = mmap.mmap(fd, byte_size)
+        except BaseException:
+            os.unlink(self._path)
+            raise
+        finally:
+            os.close(fd)
+        self._next_offset = 0
+
+    def register_request(self) -> RegisterSharedMemoryRequest:
+        return RegisterSharedMemoryRequest(
+            name=self.name, key=self.key, offset=0, byte_size=self.byte_size
+        )
+
+    def allocate(self, byte_size: int) -> SharedMemoryTensor:
+        """Reserves `byte_size` bytes for an output tensor of a request."""
+        offset = self._next_offset
+        if byte_size > self.byte_size - offset:
+            raise MemoryError(
+                f"{byte_size} bytes do not fit in shared memory region {self.name}, which has "
+                f"{self.byte_size - offset} bytes left"
+            )
+        self._next_offset = min(
+            self.byte_size, -(-(offset + byte_size) // TENSOR_ALIGNMENT) * TENSOR_ALIGNMENT
+        )
+        return SharedMemoryTensor(region=self.name, offset=offset, byte_size=byte_size)
+
+    def write(self, ndarray: np.ndarray) -> SharedMemoryTensor:
+        """Copies `ndarray` to the region, for an input tensor of a request."""
+        dtype = DataType(ndarray.dtype.type)
+        if not dtype.is_numeric:
+            raise ValueError(f"Tensors of type {dtype.tf_dtype} cannot be in shared memory")
+        shared_tensor = self.allocate(ndarray.nbytes)
+        self._view(shared_tensor.offset, ndarray.dtype, ndarray.shape)[...] = ndarray
+        shared_tensor.dtype = dtype.enum
+        shared_tensor.tensor_shape.CopyFrom(
+            TensorShapeProto(dim=[TensorShapeProto.Dim(size=d) for d in ndarray.shape])
+        )
+        return shared_tensor
+
+    def read(self, shared_tensor: SharedMemoryTensor) -> np.ndarray:
+        """Returns the tensor that the server wrote to the region, without copying it.
+
+        The array is only valid until its space in the region is reused.
+        """
+        dtype = DataType(shared_tensor.dtype).numpy_dtype
+        shape = tuple(int(d.size) for d in shared_tensor.tensor_shape.dim)
+        return self._view(shared_tensor.offset, dtype, shape)
+
+    def reset(self) -> None:
+        """Makes the whole region available again to `allocate` and `write`."""
+        self._next_offset = 0
+
+    def close(self) -> None:
+        """Removes the shared memory object. The server keeps it mapped until it is unregistered,
+        and the region stays mapped here until the arrays returned by `read` are released."""
+        if os.path.exists(self._path):
+            os.unlink(self._path)
+        try:
+            self._buffer.close()
+        except BufferError:
+            pass
+
+    def __enter__(self) -> "SharedMemoryRegion":
+        return self
+
+    def __exit__(self, *exc_info) -> None:
+        self.close()
+
+    def _view(self, offset: int, dtype: type, shape: tuple) -> np.ndarray:
+        count = int(np.prod(shape, dtype=np.int64))
+        return np.frombuffer(self._buffer, dtype=dtype, count=count, offset=offset).reshape(shape)
@@ -1,10 +1,14 @@
+import zlib
+
 from .types import DataType
+from tensorflow.core.framework import types_pb2
 from tensorflow.core.framework.tensor_pb2 import TensorProto
 from tensorflow.core.framework.tensor_shape_pb2 import TensorShapeProto
+from tensorflow_serving.apis.predict_pb2 import EncodedTensorInfo, OutputEncoding, PredictResponse
 import numpy as np
 
 
-from typing import Iterable, AnyStr, Tuple
+from typing import Dict, Iterable, AnyStr, Optional, Tuple
 
 
 def coerce_to_bytes(text: AnyStr) -> bytes:
@@ -42,5 +46,48 @@ def extract_shape(tensor_proto: TensorProto) -> Tuple[int, ...]:
 def tensor_proto_to_ndarray(tensor_proto: TensorProto) -> np.ndarray:
     dtype = DataType(tensor_proto.dtype)
     shape = extract_shape(tensor_proto)
+    if dtype.is_numeric and tensor_proto.tensor_content:
+        # np.frombuffer makes a read-only view of the proto's bytes, so it is copied to be writable
+        # like the arrays made from the typed fields.
+        values = np.frombuffer(tensor_proto.tensor_content, dtype=dtype.numpy_dtype)
+        return values.reshape(shape).copy()
     proto_values = getattr(tensor_proto, dtype.proto_field_name)
     return np.array([element for element in proto_values], dtype=dtype.numpy_dtype).reshape(*shape)
+
+
+def _unshuffle_bytes(shuffled: bytes, element_size: int) -> bytes:
+    # The server groups the i-th bytes of all the values together.
+    return np.frombuffer(shuffled, dtype=np.uint8).reshape(element_size, -1).T.tobytes()
+
+
+def decode_output_tensor(
+    tensor_proto: TensorProto, encoding_info: Optional[EncodedTensorInfo] = None
+) -> np.ndarray:
+    if encoding_info is None:
+        return tensor_proto_to_ndarray(tensor_proto)
+    if tensor_proto.dtype == types_pb2.DT_BFLOAT16:
+        # numpy has no bfloat16, whose bits are the upper half of a float32.
+        encoded_dtype = np.dtype(np.uint16)
+    else:
+        encoded_dtype = np.dtype(DataType(tensor_proto.dtype).numpy_dtype)
+    content = tensor_proto.tensor_content
+    if encoding_info.compression == OutputEncoding.SHUFFLE_ZLIB:
+        content = _unshuffle_bytes(zlib.decompress(content), encoded_dtype.itemsize)
+    values = np.frombuffer(content, dtype=encoded_dtype).reshape(extract_shape(tensor_proto))
+    if encoding_info.precision == OutputEncoding.FLOAT16:
+        return values.astype(np.float32)
+    if encoding_info.precision == OutputEncoding.BFLOAT16:
+        return (values.astype(np.uint32) << 16).view(np.float32)
+    if encoding_info.precision == OutputEncoding.INT8:
+        return values.astype(np.float32) * np.float32(encoding_info.scale)
+    return values.copy()
+
+
+def predict_response_to_ndarrays(response: PredictResponse) -> Dict[str, np.ndarray]:
+    return {
+        key: decode_output_tensor(
+            tensor_proto,
+            response.output_encodings[key] if key in response.output_encodings else None,
+        )
+        for key, tensor_proto in response.outputs.items()
+    }
@@ -0,0 +1,178 @@
+import asyncio
+
+import grpc
+import numpy as np
+import pytest
+from numpy.testing import assert_array_equal
+
+from min_tfs_client.async_requests import (
+    AsyncTensorServingClient,
+    PredictBatcher,
+    split_predict_response,
+    split_tensor_proto,
+)
+from min_tfs_client.tensors import ndarray_to_tensor_proto, tensor_proto_to_ndarray
+from tensorflow_serving.apis.predict_pb2 import PredictResponse
+from tensorflow_serving.apis.prediction_service_pb2_grpc import (
+    PredictionServiceServicer,
+    add_PredictionServiceServicer_to_server,
+)
+
+
+def _run(coroutine):
+    loop = asyncio.new_event_loop()
+    try:
+        return loop.run_until_complete(coroutine)
+    finally:
+        loop.close()
+
+
+def _doubling_response(input_dict) -> PredictResponse:
+    response = PredictResponse()
+    response.outputs["y"].CopyFrom(ndarray_to_tensor_proto(input_dict["x"] * 2))
+    return response
+
+
+class _DoublingServicer(PredictionServiceServicer):
+    def __init__(self):
+        self.batch_sizes = []
+
+    async def Predict(self, request, context):
+        x = tensor_proto_to_ndarray(request.inputs["x"])
+        self.batch_sizes.append(x.shape[0])
+        return _doubling_response({"x": x})
+
+
+def test_split_tensor_proto_splits_repeated_values():
+    tensor_proto = ndarray_to_tensor_proto(np.arange(10, dtype=np.float32).reshape(5, 2))
+
+    parts = split_tensor_proto(tensor_proto, [2, 3])
+
+    assert_array_equal(tensor_proto_to_ndarray(parts[0]), [[0, 1], [2, 3]])
+    assert_array_equal(tensor_proto_to_ndarray(parts[1]), [[4, 5], [6, 7], [8, 9]])
+
+
+def test_split_tensor_proto_splits_tensor_content():
+    values = np.arange(6, dtype=np.int64).reshape(3, 2)
+    tensor_proto = ndarray_to_tensor_proto(values)
+    del tensor_proto.int64_val[:]
+    tensor_proto.tensor_content = values.tobytes()
+
+    parts = split_tensor_proto(tensor_proto, [1, 2])
+
+    assert_array_equal(tensor_proto_to_ndarray(parts[0]), [[0, 1]])
+    assert_array_equal(tensor_proto_to_ndarray(parts[1]), [[2, 3], [4, 5]])
+
+
+def test_split_tensor_proto_splits_strings():
+    tensor_proto = ndarray_to_tensor_proto(np.array(["a", "b", "c"]))
+
+    parts = split_tensor_proto(tensor_proto, [2, 1])
+
+    assert list(parts[0].string_val) == [b"a", b"b"]
+    assert list(parts[1].string_val) == [b"c"]
+
+
+def test_split_tensor_proto_rejects_unbatched_output():
+    tensor_proto = ndarray_to_tensor_proto(np.array([1.0, 2.0], dtype=np.float32))
+
+    with pytest.raises(ValueError):
+        split_tensor_proto(tensor_proto, [2, 1])
+
+
+def test_split_predict_response_returns_a_single_response_as_is():
+    response = _doubling_response({"x": np.array([1.0], dtype=np.float32)})
+
+    assert split_predict_response(response, [1])[0] is response
+
+
+def test_predict_batcher_merges_concurrent_calls():
+    sent = []
+
+    async def send(model_name, model_version, input_dict, timeout):
+        sent.append(input_dict["x"].shape[0])
+        return _doubling_response(input_dict)
+
+    batcher = PredictBatcher(send, max_batch_size=8, batch_timeout_ms=10)
+
+    async def predict_concurrently():
+        return await asyncio.gather(
+            *(
+                batcher.predict("default", None, {"x": np.full(2, i, dtype=np.float32)}, 60)
+                for i in range(6)
+            )
+        )
+
+    responses = _run(predict_concurrently())
+
+    assert sent == [8, 4]
+    assert not batcher._send_tasks
+    for i, response in enumerate(responses):
+        assert_array_equal(tensor_proto_to_ndarray(response.outputs["y"]), [2 * i, 2 * i])
+
+
+def test_predict_batcher_does_not_merge_different_inputs():
+    sent = []
+
+    async def send(model_name, model_version, input_dict, timeout):
+        sent.append((model_name, input_dict["x"].shape))
+        return _doubling_response(input_dict)
+
+    async def predict_concurrently():
+        batcher = PredictBatcher(send, max_batch_size=8, batch_timeout_ms=1)
+        return await asyncio.gather(
+            batcher.predict("a", None, {"x": np.zeros((1, 2), dtype=np.float32)}, 60),
+            batcher.predict("a", None, {"x": np.zeros((1, 3), dtype=np.float32)}, 60),
+            batcher.predict("b", None, {"x": np.zeros((1, 2), dtype=np.float32)}, 60),
+        )
+
+    _run(predict_concurrently())
+
+    assert sorted(sent) == [("a", (1, 2)), ("a", (1, 3)), ("b", (1, 2))]
+
+
+def test_predict_batcher_fails_every_call_of_a_failed_batch():
+    async def send(model_name, model_version, input_dict, timeout):
+        raise RuntimeError("unavailable")
+
+    async def predict_concurrently():
+        batcher = PredictBatcher(send, max_batch_size=8, batch_timeout_ms=1)
+        return await asyncio.gather(
+            *(
+                batcher.predict("default", None, {"x": np.zeros(1, dtype=np.float32)}, 60)
+                for _ in range(3)
+            ),
+            return_exceptions=True,
+        )
+
+    results = _run(predict_concurrently())
+
+    assert all(isinstance(result, RuntimeError) for result in results)
+
+
+def test_async_client_batches_predict_requests_over_a_channel_pool():
+    servicer = _DoublingServicer()
+
+    async def predict_concurrently():
+        server = grpc.aio.server()
+        add_PredictionServiceServicer_to_server(servicer, server)
+        port = server.add_insecure_port("127.0.0.1:0")
+        await server.start()
+        try:
+            async with AsyncTensorServingClient(
+                "127.0.0.1", port, num_channels=2, max_batch_size=4, batch_timeout_ms=50
+            ) as client:
+                return await asyncio.gather(
+                    *(
+                        client.predict_request("default", {"x": np.array([i], dtype=np.float32)})
+                        for i in range(8)
+                    )
+                )
+        finally:
+            await server.stop(None)
+
+    responses = _run(predict_concurrently())
+
+    assert servicer.batch_sizes == [4, 4]
+    for i, response in enumerate(responses):
+        assert_array_equal(tensor_proto_to_ndarray(response.outputs["y"]), [2 * i])
@@ -0,0 +1,126 @@
+import mmap
+import os
+from concurrent import futures
+
+import grpc
+import numpy as np
+import pytest
+from numpy.testing import assert_array_equal
+
+from min_tfs_client.requests import TensorServingClient
+from min_tfs_client.shared_memory import SHM_DIRECTORY, SharedMemoryRegion
+from tensorflow.core.framework import types_pb2
+from tensorflow_serving.apis.predict_pb2 import PredictResponse
+from tensorflow_serving.apis.prediction_service_pb2_grpc import (
+    PredictionServiceServicer,
+    add_PredictionServiceServicer_to_server,
+)
+from tensorflow_serving.apis.shared_memory_pb2 import RegisterSharedMemoryResponse
+
+
+class _DoublingServicer(PredictionServiceServicer):
+    """Stands in for a model server that doubles the shared memory input "x" into "y"."""
+
+    def __init__(self):
+        self.regions = {}
+
+    def RegisterSharedMemory(self, request, context):
+        with open(os.path.join(SHM_DIRECTORY, request.key.lstrip("/")), "r+b") as f:
+            self.regions[request.name] = mmap.mmap(f.fileno(), request.byte_size)
+        return RegisterSharedMemoryResponse()
+
+    def Predict(self, request, context):
+        x_tensor = request.shared_memory_inputs["x"]
+        x = np.frombuffer(
+            self.regions[x_tensor.region],
+            dtype=np.float32,
+            count=x_tensor.byte_size // 4,
+            offset=x_tensor.offset,
+        )
+        response = PredictResponse()
+        y_tensor = response.shared_memory_outputs["y"]
+        y_tensor.CopyFrom(request.shared_memory_outputs["y"])
+        y = np.frombuffer(
+            self.regions[y_tensor.region], dtype=np.float32, count=x.size, offset=y_tensor.offset
+        )
+        y[...] = x * 2
+        y_tensor.byte_size = y.nbytes
+        y_tensor.dtype = types_pb2.DT_FLOAT
+        y_tensor.tensor_shape.CopyFrom(x_tensor.tensor_shape)
+        return response
+
+
+@pytest.fixture
+def region():
+    with SharedMemoryRegion("region", 1024) as region:
+        yield region
+
+
+def test_write_and_read_round_trip(region):
+    values = np.arange(6, dtype=np.int64).reshape(2, 3)
+
+    shared_tensor = region.write(values)
+
+    assert shared_tensor.region == "region"
+    assert shared_tensor.byte_size == values.nbytes
+    assert shared_tensor.dtype == types_pb2.DT_INT64
+    assert [d.size for d in shared_tensor.tensor_shape.dim] == [2, 3]
+    assert_array_equal(region.read(shared_tensor), values)
+
+
+def test_tensors_are_aligned(region):
+    first = region.write(np.ones(3, dtype=np.float32))
+    second = region.allocate(8)
+    third = region.write(np.ones(1, dtype=np.float64))
+
+    assert (first.offset, second.offset, third.offset) == (0, 64, 128)
+
+    region.reset()
+    assert region.allocate(8).offset == 0
+
+
+def test_allocate_fails_when_region_is_full(region):
+    region.allocate(1000)
+
+    with pytest.raises(MemoryError):
+        region.allocate(64)
+
+
+def test_write_rejects_strings(region):
+    with pytest.raises(ValueError):
+        region.write(np.array(["a"]))
+
+
+def test_close_removes_shared_memory_object():
+    region = SharedMemoryRegion("region", 64)
+    path = os.path.join(SHM_DIRECTORY, region.key.lstrip("/"))
+    assert os.path.exists(path)
+
+    region.close()
+
+    assert not os.path.exists(path)
+
+
+def test_predict_request_passes_tensors_through_shared_memory(region):
+    servicer = _DoublingServicer()
+    server = grpc.server(futures.ThreadPoolExecutor(max_workers=2))
+    add_PredictionServiceServicer_to_server(servicer, server)
+    port = server.add_insecure_port("127.0.0.1:0")
+    server.start()
+    try:
+        client = TensorServingClient(host="127.0.0.1", port=port)
+        client.register_shared_memory(region)
+
+        response = client.predict_request(
+            model_name="default",
+            input_dict={},
+            shared_memory_inputs={"x": region.write(np.array([1, 2, 3], dtype=np.float32))},
+            shared_memory_outputs={"y": region.allocate(64)},
+        )
+
+        assert not response.outputs
+        assert_array_equal(region.read(response.shared_memory_outputs["y"]), [2, 4, 6])
+    finally:
+        server.stop(None)
+        for mapping in servicer.regions.values():
+            mapping.close()
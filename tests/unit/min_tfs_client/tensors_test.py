@@ -1,14 +1,17 @@
 import textwrap
+import zlib
 
 import numpy as np
 from google.protobuf import text_format
 
-from min_tfs_client.tensors import (coerce_to_bytes, extract_shape, ndarray_to_tensor_proto,
+from min_tfs_client.tensors import (coerce_to_bytes, decode_output_tensor, extract_shape,
+                                    ndarray_to_tensor_proto, predict_response_to_ndarrays,
                                     tensor_proto_to_ndarray, write_values_to_tensor_proto)
 from min_tfs_client.types import DataType
 from tensorflow.core.framework import types_pb2
 from tensorflow.core.framework.tensor_pb2 import TensorProto
 from tensorflow.core.framework.tensor_shape_pb2 import TensorShapeProto
+from tensorflow_serving.apis.predict_pb2 import EncodedTensorInfo, OutputEncoding, PredictResponse
 
 
 def _assert_proto_equal(proto, expected: str) -> None:
@@ -115,3 +118,98 @@ def test_ndarray_to_tensor_proto_inverse():
     result = tensor_proto_to_ndarray(tensor_proto)
 
     np.testing.assert_almost_equal(result, array)
+
+
+def _content_tensor_proto(array: np.ndarray, dtype: int, content: bytes) -> TensorProto:
+    return TensorProto(
+        dtype=dtype,
+        tensor_shape=TensorShapeProto(dim=[TensorShapeProto.Dim(size=d) for d in array.shape]),
+        tensor_content=content,
+    )
+
+
+def _embeddings() -> np.ndarray:
+    return np.random.RandomState(42).uniform(-1, 1, size=(4, 16)).astype(np.float32)
+
+
+def test_tensor_proto_to_ndarray_from_tensor_content():
+    array = np.array([[1, 2], [3, 4]], dtype=np.int64)
+    tensor_proto = _content_tensor_proto(array, types_pb2.DT_INT64, array.tobytes())
+
+    result = tensor_proto_to_ndarray(tensor_proto)
+
+    np.testing.assert_array_equal(result, array)
+    assert result.flags.writeable
+
+
+def test_decode_output_tensor_float16():
+    array = _embeddings()
+    tensor_proto = _content_tensor_proto(
+        array, types_pb2.DT_HALF, array.astype(np.float16).tobytes()
+    )
+    info = EncodedTensorInfo(original_dtype=types_pb2.DT_FLOAT, precision=OutputEncoding.FLOAT16)
+
+    result = decode_output_tensor(tensor_proto, info)
+
+    assert result.dtype == np.float32
+    np.testing.assert_allclose(result, array, atol=1e-3)
+
+
+def test_decode_output_tensor_bfloat16():
+    array = _embeddings()
+    bfloat16_bits = (array.view(np.uint32) >> 16).astype(np.uint16)
+    tensor_proto = _content_tensor_proto(array, types_pb2.DT_BFLOAT16, bfloat16_bits.tobytes())
+    info = EncodedTensorInfo(original_dtype=types_pb2.DT_FLOAT, precision=OutputEncoding.BFLOAT16)
+
+    result = decode_output_tensor(tensor_proto, info)
+
+    assert result.dtype == np.float32
+    np.testing.assert_allclose(result, array, atol=1e-2)
+
+
+def test_decode_output_tensor_int8():
+    array = _embeddings()
+    scale = np.abs(array).max() / 127
+    quantized = np.round(array / scale).astype(np.int8)
+    tensor_proto = _content_tensor_proto(array, types_pb2.DT_INT8, quantized.tobytes())
+    info = EncodedTensorInfo(
+        original_dtype=types_pb2.DT_FLOAT, precision=OutputEncoding.INT8, scale=scale
+    )
+
+    result = decode_output_tensor(tensor_proto, info)
+
+    assert result.dtype == np.float32
+    np.testing.assert_allclose(result, array, atol=scale / 2 + 1e-6)
+
+
+def test_decode_output_tensor_shuffle_zlib():
+    array = _embeddings()
+    shuffled = np.frombuffer(array.tobytes(), dtype=np.uint8).reshape(-1, 4).T.tobytes()
+    tensor_proto = _content_tensor_proto(array, types_pb2.DT_FLOAT, zlib.compress(shuffled))
+    info = EncodedTensorInfo(
+        original_dtype=types_pb2.DT_FLOAT,
+        compression=OutputEncoding.SHUFFLE_ZLIB,
+        uncompressed_size=array.nbytes,
+    )
+
+    result = decode_output_tensor(tensor_proto, info)
+
+    np.testing.assert_array_equal(result, array)
+    assert result.flags.writeable
+
+
+def test_predict_response_to_ndarrays():
+    array = _embeddings()
+    response = PredictResponse()
+    response.outputs["encoded"].CopyFrom(
+        _content_tensor_proto(array, types_pb2.DT_HALF, array.astype(np.float16).tobytes())
+    )
+    response.output_encodings["encoded"].CopyFrom(
+        EncodedTensorInfo(original_dtype=types_pb2.DT_FLOAT, precision=OutputEncoding.FLOAT16)
+    )
+    response.outputs["plain"].CopyFrom(ndarray_to_tensor_proto(np.array([1, 2], dtype=np.int64)))
+
+    result = predict_response_to_ndarrays(response)
+
+    np.testing.assert_allclose(result["encoded"], array, atol=1e-3)
+    np.testing.assert_array_equal(result["plain"], np.array([1, 2]))